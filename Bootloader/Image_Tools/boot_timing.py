@@ -0,0 +1,108 @@
+import sys
+import argparse
+import struct
+
+# Decode the boot timing record the bootloader leaves in RAM (see Common/boot_timing_record.h).
+#
+# Input is a binary dump of RAM, e.g. saved by the debugger, containing the record at the given offset.
+# For a dump of the 256 byte BOOT_RECORD region (from 0x2007FF00) the offset is 0.
+#
+# Record (all little endian):
+# Magic         - 4 bytes, "YSBT"
+# Format        - 4 bytes (5)
+# Phase count   - 4 bytes
+# Core clock    - 4 bytes, Hz
+# Total cycles  - 8 bytes
+# Phases        - Phase count entries of: cycles (8 bytes), bytes (4 bytes), calls (4 bytes)
+# Counts        - 4 bytes each: main image blocks erased, main image blocks left unchanged by an update, flash and
+#                 QSPI driver opens saved by the storage sessions, image verifies reused from earlier in the boot, update
+#                 images rejected before being hashed
+# Check         - 4 bytes, bitwise inverse of the 32 bit sum of all the words before it
+
+record_magic    = 0x54425359
+record_format   = 5
+record_address  = 0x2007FF00
+phase_names     = ["Driver open", "Blank check", "Hash", "ECC verify", "Erase", "Program", "Handoff", "Compare", "Update", "Storage", "CRC"]
+count_names     = ["Main image blocks erased", "Main image blocks unchanged", "Storage opens saved", "Verifies reused", "Verifies skipped"]
+storage_phase   = 9
+storage_count   = 2
+
+def decode(data):
+    if (len(data) < 24):
+        print("ERROR: Dump too short for a boot timing record")
+        sys.exit(2)
+
+    magic, format, phase_count, core_clock_hz, total_cycles = struct.unpack_from("<IIIIQ", data, 0)
+    if (magic != record_magic):
+        print("ERROR: No boot timing record (magic 0x%08X)" % magic)
+        sys.exit(2)
+    if (format != record_format):
+        print("ERROR: Unknown boot timing record format %d" % format)
+        sys.exit(2)
+
+    check_offset = 24 + (phase_count * 16) + (len(count_names) * 4)
+    if (len(data) < (check_offset + 4)):
+        print("ERROR: Dump too short for %d phases" % phase_count)
+        sys.exit(2)
+
+    words = struct.unpack_from("<%dI" % (check_offset // 4), data, 0)
+    check = struct.unpack_from("<I", data, check_offset)[0]
+    if (check != (~sum(words) & 0xFFFFFFFF)):
+        print("ERROR: Boot timing record check failed")
+        sys.exit(2)
+
+    def ms(cycles):
+        return (cycles * 1000.0) / core_clock_hz
+
+    print("Core clock: %d Hz" % core_clock_hz)
+    print("Total:      %12d cycles %10.3f ms" % (total_cycles, ms(total_cycles)))
+    print("")
+    print("%-12s %12s %10s %10s %6s %10s" % ("Phase", "Cycles", "ms", "Bytes", "Calls", "KB/s"))
+    for i in range(phase_count):
+        cycles, nbytes, calls = struct.unpack_from("<QII", data, 24 + (i * 16))
+        name = phase_names[i] if (i < len(phase_names)) else ("Phase %d" % i)
+        rate = ""
+        if ((0 != nbytes) and (0 != cycles)):
+            rate = "%10.1f" % ((nbytes / 1024.0) / (ms(cycles) / 1000.0))
+        print("%-12s %12d %10.3f %10d %6d %10s" % (name, cycles, ms(cycles), nbytes, calls, rate))
+
+    print("")
+    counts = struct.unpack_from("<%dI" % len(count_names), data, 24 + (phase_count * 16))
+    for name, count in zip(count_names, counts):
+        print("%-28s %d" % (name + ":", count))
+
+    # Each saved open would also have needed a close. The storage phase has one call for each driver open, and one
+    # for closing them all before the handoff, so the cost of an open and close is about its cycles per open.
+    if (phase_count > storage_phase):
+        cycles, nbytes, calls = struct.unpack_from("<QII", data, 24 + (storage_phase * 16))
+        if (calls > 1):
+            saved = (counts[storage_count] * cycles) // (calls - 1)
+            print("%-28s %d cycles %.3f ms" % ("Storage sessions saved:", saved, ms(saved)))
+
+def main(argv):
+    parser = argparse.ArgumentParser(description="Decode the bootloader boot timing record from a RAM dump.",
+                                    epilog='e.g. Decoding a dump of the BOOT_RECORD region (0x2007FF00, 256 bytes):\n \
+    \tpython boot_timing.py -i boot_record.bin\n\n \
+    Decoding a dump of all of RAM (from 0x1FFE0000):\n \
+    \tpython boot_timing.py -i ram.bin -a 0x1FFE0000', formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('-i', '--inputfile', type=str, required=True, help='Binary RAM dump')
+    parser.add_argument('-a', '--address', type=lambda x: int(x, 0), default=record_address, help='Address the dump starts at (default 0x%08X)' % record_address)
+    args = parser.parse_args()
+
+    try:
+        f = open(args.inputfile, "rb")
+    except:
+        print("ERROR: Cannot open file for reading: " + args.inputfile)
+        sys.exit(2)
+    data = f.read()
+    f.close()
+
+    offset = record_address - args.address
+    if ((offset < 0) or (offset >= len(data))):
+        print("ERROR: Dump does not include the boot timing record at 0x%08X" % record_address)
+        sys.exit(2)
+
+    decode(data[offset:])
+
+if __name__ == "__main__":
+    main(sys.argv[1:])
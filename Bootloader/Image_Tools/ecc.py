@@ -160,8 +160,11 @@ def point_add(point1, point2):
     return result
 
 
-def scalar_mult(k, point):
-    """Returns k * point computed using the double and point_add algorithm."""
+def scalar_mult_affine(k, point):
+    """Returns k * point computed using the double and point_add algorithm.
+    This is the original (slow) implementation, kept as the reference for the
+    known-answer checks and the benchmark (see the end of this file).
+    """
     assert is_on_curve(point)
 
     if k % curve.n == 0 or point is None:
@@ -169,7 +172,7 @@ def scalar_mult(k, point):
 
     if k < 0:
         # k * point = -k * (-point)
-        return scalar_mult(-k, point_neg(point))
+        return scalar_mult_affine(-k, point_neg(point))
 
     result = None
     addend = point
@@ -189,6 +192,202 @@ def scalar_mult(k, point):
     return result
 
 
+# Jacobian coordinates ########################################################
+#
+# (X, Y, Z) is the affine point (X / Z^2, Y / Z^3), None is the point at
+# infinity. Points are only converted back to affine (one inverse_mod) at the
+# end of a scalar multiplication, instead of an inverse_mod in every step.
+
+# Bits per window of the scalar multiplications.
+WINDOW_BITS = 4
+
+# Table of j * 2^(WINDOW_BITS * i) * curve.g, built on first use.
+_base_table = None
+
+
+def jacobian_double(point):
+    """Returns 2 * point, for a point in Jacobian coordinates."""
+    if point is None:
+        return None
+
+    x, y, z = point
+    p = curve.p
+
+    if y == 0:
+        return None
+
+    yy = y * y % p
+    s = 4 * x * yy % p
+    m = 3 * x * x
+    if curve.a:
+        zz = z * z % p
+        m += curve.a * zz * zz
+    m %= p
+
+    x3 = (m * m - 2 * s) % p
+    y3 = (m * (s - x3) - 8 * yy * yy) % p
+    z3 = 2 * y * z % p
+
+    return (x3, y3, z3)
+
+
+def jacobian_add_affine(point1, point2):
+    """Returns point1 + point2, for point1 in Jacobian coordinates and point2
+    affine (as the points of the window tables are)."""
+    if point2 is None:
+        return point1
+    if point1 is None:
+        return (point2[0], point2[1], 1)
+
+    x1, y1, z1 = point1
+    x2, y2 = point2
+    p = curve.p
+
+    z1z1 = z1 * z1 % p
+    h = (x2 * z1z1 - x1) % p
+    r = (y2 * z1 * z1z1 - y1) % p
+
+    if h == 0:
+        if r == 0:
+            # This is the case point1 == point2.
+            return jacobian_double(point1)
+        # point1 + (-point1) = 0
+        return None
+
+    hh = h * h % p
+    hhh = h * hh % p
+    v = x1 * hh % p
+
+    x3 = (r * r - hhh - 2 * v) % p
+    y3 = (r * (v - x3) - y1 * hhh) % p
+    z3 = z1 * h % p
+
+    return (x3, y3, z3)
+
+
+def jacobian_to_affine(point):
+    """Returns a point in Jacobian coordinates as an affine point."""
+    if point is None:
+        return None
+
+    x, y, z = point
+    z_inv = inverse_mod(z, curve.p)
+    z_inv2 = z_inv * z_inv % curve.p
+
+    return (x * z_inv2 % curve.p, y * z_inv2 * z_inv % curve.p)
+
+
+def jacobian_to_affine_all(points):
+    """Returns a list of points in Jacobian coordinates (none at infinity) as
+    affine points, with a single inverse_mod (Montgomery's trick)."""
+    p = curve.p
+    products = []
+    product = 1
+    for x, y, z in points:
+        product = product * z % p
+        products.append(product)
+
+    product_inv = inverse_mod(product, p)
+    result = [None] * len(points)
+    for i in range(len(points) - 1, -1, -1):
+        x, y, z = points[i]
+        z_inv = product_inv * products[i - 1] % p if i else product_inv
+        product_inv = product_inv * z % p
+        z_inv2 = z_inv * z_inv % p
+        result[i] = (x * z_inv2 % p, y * z_inv2 * z_inv % p)
+
+    return result
+
+
+def window_table(point):
+    """Returns [point, 2 * point, ..., (2^WINDOW_BITS - 1) * point], affine."""
+    multiples = [(point[0], point[1], 1)]
+    for j in range(2, 1 << WINDOW_BITS):
+        multiples.append(jacobian_add_affine(multiples[-1], point))
+
+    return jacobian_to_affine_all(multiples)
+
+
+def base_table():
+    """Returns the fixed-base table for curve.g: row i holds the window_table()
+    of 2^(WINDOW_BITS * i) * curve.g, for every window of a scalar below n."""
+    global _base_table
+
+    if _base_table is None:
+        rows = []
+        point = curve.g
+        for i in range(-(-curve.n.bit_length() // WINDOW_BITS)):
+            row = window_table(point)
+            rows.append(row)
+            point = jacobian_to_affine(jacobian_add_affine(
+                (row[-1][0], row[-1][1], 1), point))
+        _base_table = rows
+
+    return _base_table
+
+
+def jacobian_mult_base(k, result=None):
+    """Returns result + k * curve.g in Jacobian coordinates, for 0 <= k < n.
+    Only additions, one for each non-zero window of k, no doublings."""
+    mask = (1 << WINDOW_BITS) - 1
+
+    for row in base_table():
+        if not k:
+            break
+        window = k & mask
+        if window:
+            result = jacobian_add_affine(result, row[window - 1])
+        k >>= WINDOW_BITS
+
+    return result
+
+
+def jacobian_mult(k, point):
+    """Returns k * point in Jacobian coordinates, for 0 <= k < n and an affine
+    point, using fixed windows of WINDOW_BITS bits."""
+    if not k or point is None:
+        return None
+
+    table = window_table(point)
+    mask = (1 << WINDOW_BITS) - 1
+    shift = (k.bit_length() - 1) // WINDOW_BITS * WINDOW_BITS
+    result = None
+
+    while shift >= 0:
+        for i in range(WINDOW_BITS):
+            result = jacobian_double(result)
+        window = (k >> shift) & mask
+        if window:
+            result = jacobian_add_affine(result, table[window - 1])
+        shift -= WINDOW_BITS
+
+    return result
+
+
+def scalar_mult(k, point):
+    """Returns k * point, in Jacobian coordinates with a window table (the
+    precomputed one for curve.g)."""
+    assert is_on_curve(point)
+
+    if k % curve.n == 0 or point is None:
+        return None
+
+    if k < 0:
+        # k * point = -k * (-point)
+        return scalar_mult(-k, point_neg(point))
+
+    k %= curve.n
+
+    if point == curve.g:
+        result = jacobian_to_affine(jacobian_mult_base(k))
+    else:
+        result = jacobian_to_affine(jacobian_mult(k, point))
+
+    assert is_on_curve(result)
+
+    return result
+
+
 # Keypair generation and ECDHE ################################################
 
 def make_keypair():
@@ -216,8 +415,12 @@ def hash_message(message):
 
 
 def sign_message(private_key, message):
-    z = hash_message(message)
+    return sign_hash(private_key, hash_message(message))
 
+
+def sign_hash(private_key, z):
+    """Signs the hash z of a message (as hash_message() returns), for a message
+    hashed as it is built."""
     r = 0
     s = 0
 
@@ -240,10 +443,155 @@ def verify_signature(public_key, message, signature):
     u1 = (z * w) % curve.n
     u2 = (r * w) % curve.n
 
-    x, y = point_add(scalar_mult(u1, curve.g),
-                     scalar_mult(u2, public_key))
+    # u1 * g + u2 * public_key, only converted to affine once
+    assert is_on_curve(public_key)
+    x, y = jacobian_to_affine(jacobian_mult_base(u1,
+                                                 jacobian_mult(u2, public_key)))
 
     if (r % curve.n) == (x % curve.n):
         return True
     else:
         return False
+
+
+# Known-answer checks and benchmark ###########################################
+#
+# python ecc.py checks the Jacobian / window table code gives the same results
+# as the original affine code, then gives the signatures and verifications per
+# second of each.
+
+# Private key, public key, message and signature (from the original code), all
+# of which verify.
+KNOWN_ANSWERS = [
+    (0xe0f579c53f512bea46d68fe18b4ad08ba137fd0fdbb9b4cc677a0668d61a3700,
+     (0x951fff88a623b8748f68616432aefb738a2a0226adee92e171619b464a543cd3,
+      0x134ed9a60d22cc4f7fa37f797a09c817bfd2493104b0858a759565d4fdd05cfa),
+     b'',
+     (0xbdf9477621e85288f3446e9a48ff7e0ba716378f3356bdc5acdeefe405ac14dd,
+      0xd66de5c63f30f6cdc6d393bb48aea3712be5a3df74dff4010b3c06b3ee4ab00c)),
+    (0x2a2894a3294ac9fde34a6de5e9ca6d5d13ac7021799bfdc34bcc33f7451b15e2,
+     (0xa02413d45d876acaaf888e211d94b08e92f2742f42a72c07ad6730986efd778e,
+      0xd27af5a4616221bfb6238311c28bb0bd4f6855fd9ba938ade7d9bae2042ff723),
+     b'YASB',
+     (0x85e6965e6279765a979e883979518e24c4115d710c947f8980b186155c3f4bf6,
+      0x24acb54cc2d433700267a0a6c5540db88b349767b43fb55e628578642f907c63)),
+    (0x9a3560ce3315723a1d3624ca779f57abae2d7a87d39a187788dacb130d0e462c,
+     (0x99a9c31d34584e46481359ba6e5e5a10aea8691bba86b06d287f30b27d303fd7,
+      0xe88d2813798e9c15ca89c2ae6387bfaa47f865673394b5feb909cf9fa67f1dd8),
+     bytes(range(256)) * 3,
+     (0xd683e2499433a87b345c7b764526b6d5af6d682f1400e5e91b5b55813552e312,
+      0xc9062b6b6f04ec6da599d3c45a6ef1d4877a06076aef8652e00691a1f09c3505)),
+]
+
+
+def sign_message_affine(private_key, message):
+    """sign_message() with the original affine code, for reference."""
+    z = hash_message(message)
+
+    r = 0
+    s = 0
+
+    while not r or not s:
+        k = random.randrange(1, curve.n)
+        x, y = scalar_mult_affine(k, curve.g)
+
+        r = x % curve.n
+        s = ((z + r * private_key) * inverse_mod(k, curve.n)) % curve.n
+
+    return (r, s)
+
+
+def verify_signature_affine(public_key, message, signature):
+    """verify_signature() with the original affine code, for reference."""
+    z = hash_message(message)
+
+    r, s = signature
+
+    w = inverse_mod(s, curve.n)
+    u1 = (z * w) % curve.n
+    u2 = (r * w) % curve.n
+
+    x, y = point_add(scalar_mult_affine(u1, curve.g),
+                     scalar_mult_affine(u2, public_key))
+
+    return (r % curve.n) == (x % curve.n)
+
+
+def check_known_answers():
+    """Returns the number of known-answer checks failed."""
+    failed = 0
+
+    def check(name, result, expected):
+        nonlocal failed
+        if result != expected:
+            print('FAIL: ' + name)
+            failed += 1
+
+    for i, (private_key, public_key, message, signature) in enumerate(KNOWN_ANSWERS):
+        r, s = signature
+        tampered_message = message + b'\x00'
+        tampered_signature = (r, (s + 1) % curve.n)
+
+        check('public key %d' % i, scalar_mult(private_key, curve.g), public_key)
+        check('public key %d (variable base)' % i,
+              jacobian_to_affine(jacobian_mult(private_key, curve.g)), public_key)
+        for verify in (verify_signature, verify_signature_affine):
+            check('%s %d' % (verify.__name__, i),
+                  verify(public_key, message, signature), True)
+            check('%s %d (message changed)' % (verify.__name__, i),
+                  verify(public_key, tampered_message, signature), False)
+            check('%s %d (signature changed)' % (verify.__name__, i),
+                  verify(public_key, message, tampered_signature), False)
+
+        # The same nonce gives the same signature
+        state = random.getstate()
+        fast = sign_message(private_key, message)
+        random.setstate(state)
+        check('sign_message %d' % i, fast, sign_message_affine(private_key, message))
+
+    # Edge cases of the scalar, on the base point and another point
+    point = KNOWN_ANSWERS[0][1]
+    for k in (1, 2, 15, 16, 17, 1 << 255, curve.n - 1, curve.n, curve.n + 1, -1, -2,
+              random.randrange(1, curve.n)):
+        for base in (curve.g, point):
+            check('scalar_mult %#x' % k, scalar_mult(k, base), scalar_mult_affine(k, base))
+
+    return failed
+
+
+def benchmark(seconds=2.0):
+    """Prints signatures and verifications per second, original and Jacobian."""
+    import time
+
+    private_key, public_key, message, signature = KNOWN_ANSWERS[1]
+
+    def rate(function):
+        count = 0
+        start = time.perf_counter()
+        while time.perf_counter() - start < seconds:
+            function()
+            count += 1
+        return count / (time.perf_counter() - start)
+
+    base_table()
+
+    sign_affine = rate(lambda: sign_message_affine(private_key, message))
+    sign_fast = rate(lambda: sign_message(private_key, message))
+    verify_affine = rate(lambda: verify_signature_affine(public_key, message, signature))
+    verify_fast = rate(lambda: verify_signature(public_key, message, signature))
+
+    print('%-8s %12s %12s %8s' % ('', 'affine/s', 'jacobian/s', 'speedup'))
+    print('%-8s %12.1f %12.1f %7.1fx' % ('sign', sign_affine, sign_fast, sign_fast / sign_affine))
+    print('%-8s %12.1f %12.1f %7.1fx' % ('verify', verify_affine, verify_fast, verify_fast / verify_affine))
+
+
+if __name__ == '__main__':
+    import sys
+
+    failed = check_known_answers()
+    if failed:
+        print('%d known-answer checks FAILED' % failed)
+        sys.exit(1)
+    print('Known-answer checks passed')
+
+    benchmark()
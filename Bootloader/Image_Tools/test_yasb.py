@@ -0,0 +1,333 @@
+"""Regression test of the images yasb.py makes.
+
+Signs a set of images (sign with and without -b, -c, -r and -a, and delta) with
+the random state fixed, so each signature nonce is known, and checks each image
+is byte for byte the one in EXPECTED and that its signature verifies.
+
+EXPECTED was made by the yasb.py before images were built in one buffer and
+hashed in chunks (the parent of the commit adding this test), so the output of
+that rework is checked against the code it replaced:
+
+    git show <commit>:Bootloader/Image_Tools/yasb.py > old/yasb.py
+    git show <commit>:Bootloader/Image_Tools/ecc.py > old/ecc.py
+    python test_yasb.py generate old
+
+One output change is intended: an r or s of the signature under 32 bytes (about
+1 signature in 128) was written from the start of its 32 byte field, so the
+bootloader could not verify the image. Both are now written as 32 byte big
+endian values, with leading zeros. The nonces of EXPECTED give full length r
+and s; check_short_signature() checks an r under 32 bytes.
+
+check_sign_batch() signs a small manifest with sign-batch, each worker's nonce
+seeded from the entry as make_images() seeds it, and checks each image is the
+one sign_image_file() makes, and that a failing entry is reported and gives
+exit code 2. The worker processes are forked, so it is skipped where fork is
+not available.
+
+Needs the modules yasb.py imports (pycryptodome, clipboard).
+
+    python test_yasb.py
+"""
+
+import contextlib
+import hashlib
+import importlib.util
+import io
+import multiprocessing
+import os
+import random
+import sys
+import tempfile
+
+IMAGE_TOOLS = os.path.dirname(os.path.abspath(__file__))
+KEY_FILENAME = os.path.join(IMAGE_TOOLS, 'signingkey.key')
+
+# name: (binary size, version, block table (-b), compress (-c), crc (-r), slot (-a))
+SIGN_CASES = {
+    'empty': (0, 1, False, False, False, None),
+    '1 byte': (1, 2, False, False, False, None),
+    '100 bytes': (100, 3, False, False, False, None),
+    '32 KB': (0x8000, 4, False, False, False, None),
+    '100000 bytes': (100000, 5, False, False, False, None),
+    '100 bytes -b': (100, 6, True, False, False, None),
+    '32 KB -b': (0x8000, 7, True, False, False, None),
+    '100000 bytes -b': (100000, 8, True, False, False, None),
+    '100 bytes -c': (100, 9, False, True, False, None),
+    '100000 bytes -c': (100000, 10, False, True, False, None),
+    '100000 bytes -b -c': (100000, 11, True, True, False, None),
+    '100 bytes -r': (100, 12, False, False, True, None),
+    '100000 bytes -r': (100000, 13, False, False, True, None),
+    '100000 bytes -b -r': (100000, 14, True, False, True, None),
+    '100000 bytes -c -r': (100000, 15, False, True, True, None),
+    '100000 bytes -a a': (100000, 16, False, False, False, 'a'),
+    '100000 bytes -a b': (100000, 17, False, False, False, 'b'),
+    '100000 bytes -b -c -r -a b': (100000, 18, True, True, True, 'b'),
+}
+
+# name: (target, base, crc (-r)), images of SIGN_CASES
+DELTA_CASES = {
+    'delta': ('100000 bytes -r', '100000 bytes', False),
+    'delta -r': ('100000 bytes -r', '100000 bytes', True),
+    'delta -b': ('100000 bytes -b -r', '100000 bytes -b', False),
+}
+
+# version: binary size, images of the sign-batch manifest (signed with -b -r)
+BATCH_CASES = {
+    21: 100,
+    22: 0x8000,
+    23: 100000,
+}
+
+# SHA256 of each image
+EXPECTED = {
+    'empty': '094067ca01adb7baa9e9a81faf658c9ddab291cab26626bd5a9eb0ce3d400e44',
+    '1 byte': '96af27022f2946b5dff7ec897c1cc2aab6b20ccd6f3609bfbc14c14183844fb2',
+    '100 bytes': '5251712ad5728de43062533ef4c0bd51250d791064122db67ae379eabecd650f',
+    '32 KB': '657dd8adae8637d22352979ce26d061a1209b1beb6fb13cb8b1fcc004691c4a3',
+    '100000 bytes': '063e76b1c7202b0f98a1aa85320c81275863e13ef5cf6ebfdaa88649af175ada',
+    '100 bytes -b': 'e60a8e6263db4dbc7ef769df5bb00847373feebfe8c423e8ec91f6e7cd59b0a2',
+    '32 KB -b': 'cb9747cf9c14aa310ecd0e8db3058b313d22b06d19d04670004ff4f19dc50247',
+    '100000 bytes -b': '67b8fc95a509d6cfb41c3db365975a3ee308c208d2219a5345c206dda6b3cc0c',
+    '100 bytes -c': '0d62367858449acdbf5b67d265d9fff22a88586f829690be31ce3ecc0632a5f6',
+    '100000 bytes -c': 'fd212a38e66b854faf207552b9e7dda50534e539438081cb4ef46d371dc6969e',
+    '100000 bytes -b -c': 'e069fef11fa1fedb7471c6a12471a79877f35e6a9493a8ad476924f6a73a98da',
+    '100 bytes -r': '3ef268425325697bb271e4afc49f4b2b27e8ab6de75c727f0806af6153f8efda',
+    '100000 bytes -r': 'c44616b6c1ed68a34fb7d9fcfb477e4b17f6c06a035071048ea17fb93bb5010a',
+    '100000 bytes -b -r': '7be8b2da2d7b0f049ee4ea4fe260b249d8f0d6a255b8d0c4958e89ab8fb2787c',
+    '100000 bytes -c -r': '113c3c7b25b1bec0d52633b6ada1b3fc958f8da399f60663ac73ca52b3865603',
+    '100000 bytes -a a': '7fdd55a5c8182604d8bb5ca142357244ccfb69a642a42355e4146b8d6ac1404a',
+    '100000 bytes -a b': 'c616ae431e6a1ede0c969d8c594b8dd78a2fb81b48b01f285973987577480bd8',
+    '100000 bytes -b -c -r -a b': 'da657c0398bcfd38967f86d316869c490021a04b43e0a9fae7c90f7ee6571bda',
+    'delta': 'd92d896195238d876b227dbf7b94277dd15531baea7b215a899c9cf83face553',
+    'delta -r': '4f5c8421cbdb04f7a65287f9754f05a092e80039d1700fc132f2896b439cf445',
+    'delta -b': '66766c224abd805b4caa4655ee42edc7be588138508ca56c8540d31f7399686e',
+}
+
+
+def load_yasb(directory):
+    """Imports yasb.py (and the ecc.py beside it) from directory."""
+    sys.modules.pop('ecc', None)
+    sys.path.insert(0, directory)
+    try:
+        spec = importlib.util.spec_from_file_location('yasb_under_test', os.path.join(directory, 'yasb.py'))
+        module = importlib.util.module_from_spec(spec)
+        # Registered so sign-batch can pass its functions to worker processes
+        sys.modules['yasb_under_test'] = module
+        spec.loader.exec_module(module)
+    finally:
+        sys.path.pop(0)
+    return module
+
+
+def binary(size, seed, slot, yasb):
+    """A binary of size bytes, half pseudo random and half zeros (so it
+    compresses), with a reset vector in slot if given."""
+    rng = random.Random(seed)
+    data = bytearray(rng.getrandbits(8) for i in range(size // 2)) + bytes(size - (size // 2))
+    if slot:
+        reset_vector = yasb.ab_slot_address[slot] + yasb.header_size + 0x101
+        data[4:8] = reset_vector.to_bytes(4, 'little')
+    return data
+
+
+def make_images(yasb, directory):
+    """Makes every image of SIGN_CASES and DELTA_CASES in directory, each with
+    the random state seeded from its position. Returns {name: filename}."""
+    filenames = {}
+
+    with contextlib.redirect_stdout(io.StringIO()):
+        for seed, (name, (size, version, block_table, compress, crc, slot)) in enumerate(SIGN_CASES.items()):
+            input_filename = os.path.join(directory, 'input.bin')
+            with open(input_filename, 'wb') as f:
+                f.write(binary(size, seed, slot, yasb))
+            filenames[name] = os.path.join(directory, 'sign%d.bin' % seed)
+            random.seed(seed)
+            yasb.create_and_sign_image(input_filename, KEY_FILENAME, version, filenames[name],
+                                       block_table, compress, slot, crc)
+
+        for seed, (name, (target, base, crc)) in enumerate(DELTA_CASES.items(), 1000):
+            filenames[name] = os.path.join(directory, 'delta%d.bin' % seed)
+            random.seed(seed)
+            yasb.create_and_sign_delta(filenames[target], filenames[base], KEY_FILENAME, filenames[name], crc)
+
+    return filenames
+
+
+def signed_message(yasb, image):
+    """The part of an image its signature is of: from the length field, but for
+    a block table image just the header and the table."""
+    header_version = int.from_bytes(image[(12 + yasb.signature_len):(16 + yasb.signature_len)], 'little')
+    if header_version == yasb.header_version_block_table:
+        block_count = int.from_bytes(image[(20 + yasb.signature_len):(24 + yasb.signature_len)], 'little')
+        table_len = block_count * yasb.block_hash_len
+        return image[(4 + yasb.signature_len):yasb.header_size] + image[(len(image) - table_len):]
+    return image[(4 + yasb.signature_len):]
+
+
+def signature_verifies(yasb, ecc, image):
+    half = yasb.signature_len // 2
+    r = int.from_bytes(image[4:(4 + half)], 'big')
+    s = int.from_bytes(image[(4 + half):(4 + yasb.signature_len)], 'big')
+    public_key = ecc.scalar_mult(yasb.read_private_key(KEY_FILENAME), ecc.curve.g)
+    return ecc.verify_signature(public_key, bytes(signed_message(yasb, image)), (r, s))
+
+
+def check_short_signature(yasb, ecc, directory):
+    """Signs with an r under 32 bytes and checks it is written with a leading
+    zero byte and verifies. Returns True if it passed."""
+    input_filename = os.path.join(directory, 'short.bin')
+    output_filename = os.path.join(directory, 'short_signed.bin')
+    with open(input_filename, 'wb') as f:
+        f.write(binary(100, 0, None, yasb))
+
+    # Find a nonce giving a short r, then sign with it
+    sign_hash = yasb.sign_hash
+    short = []
+
+    def sign_hash_short_r(private_key, z):
+        while True:
+            state = random.getstate()
+            r, s = sign_hash(private_key, z)
+            if r.bit_length() <= 248 and s.bit_length() > 248:
+                short.append(state)
+                return r, s
+
+    yasb.sign_hash = sign_hash_short_r
+    try:
+        random.seed(1)
+        with contextlib.redirect_stdout(io.StringIO()):
+            yasb.create_and_sign_image(input_filename, KEY_FILENAME, 1, output_filename)
+    finally:
+        yasb.sign_hash = sign_hash
+
+    with open(output_filename, 'rb') as f:
+        image = f.read()
+
+    return (len(short) == 1) and (image[4] == 0) and (image[4 + (yasb.signature_len // 2)] != 0) and \
+        signature_verifies(yasb, ecc, image)
+
+
+# yasb.batch_sign_entry() while check_sign_batch() has replaced it with
+# batch_sign_entry_seeded(), inherited by the forked workers
+batch_sign_entry_unseeded = None
+
+
+def batch_sign_entry_seeded(entry):
+    """batch_sign_entry() with the random state seeded from the entry version,
+    so the nonce of each image is known whichever worker signs it."""
+    random.seed(entry[1])
+    return batch_sign_entry_unseeded(entry)
+
+
+def check_sign_batch(yasb, directory):
+    """Signs BATCH_CASES, and an entry with a missing input, with sign-batch
+    and compares each image with sign_image_file() output. Returns the number of
+    checks failed, or None if skipped."""
+    global batch_sign_entry_unseeded
+
+    if 'fork' not in multiprocessing.get_all_start_methods():
+        return None
+
+    private_key = yasb.read_private_key(KEY_FILENAME)
+    manifest_filename = os.path.join(directory, 'manifest.txt')
+    missing_input = os.path.join(directory, 'batch_missing.bin')
+    missing_output = os.path.join(directory, 'batch_missing_signed.bin')
+    expected = {}
+
+    with open(manifest_filename, 'w') as manifest, contextlib.redirect_stdout(io.StringIO()):
+        for version, size in BATCH_CASES.items():
+            input_filename = os.path.join(directory, 'batch%d.bin' % version)
+            with open(input_filename, 'wb') as f:
+                f.write(binary(size, version, None, yasb))
+            manifest.write('%s %d %s\n' % (input_filename, version, os.path.join(directory, 'batch%d_signed.bin' % version)))
+
+            reference_filename = os.path.join(directory, 'batch%d_reference.bin' % version)
+            random.seed(version)
+            yasb.sign_image_file(input_filename, private_key, version, reference_filename, True, False, None, True)
+            with open(reference_filename, 'rb') as f:
+                expected[version] = f.read()
+        manifest.write('%s %d %s\n' % (missing_input, 24, missing_output))
+
+    output = io.StringIO()
+    exit_code = 0
+    start_method = multiprocessing.get_start_method(allow_none=True)
+    batch_sign_entry_unseeded = yasb.batch_sign_entry
+    yasb.batch_sign_entry = batch_sign_entry_seeded
+    multiprocessing.set_start_method('fork', force=True)
+    try:
+        with contextlib.redirect_stdout(output):
+            yasb.sign_batch(manifest_filename, KEY_FILENAME, 2, True, False, None, True)
+    except SystemExit as e:
+        exit_code = e.code
+    finally:
+        multiprocessing.set_start_method(start_method, force=True)
+        yasb.batch_sign_entry = batch_sign_entry_unseeded
+
+    failed = 0
+    for version in BATCH_CASES:
+        with open(os.path.join(directory, 'batch%d_signed.bin' % version), 'rb') as f:
+            identical = f.read() == expected[version]
+        print('%-28s %8d bytes  %s' % ('sign-batch version %d' % version, len(expected[version]),
+                                        'identical' if identical else 'CHANGED'))
+        failed += not identical
+
+    reported = (exit_code == 2) and ((missing_output + ': FAILED') in output.getvalue()) and \
+        (('Cannot open file for reading: ' + missing_input) in output.getvalue())
+    print('%-28s %s' % ('sign-batch missing input', 'exit code 2, reported' if reported else 'NOT REPORTED'))
+    failed += not reported
+
+    return failed
+
+
+def generate(directory):
+    """Prints EXPECTED for the yasb.py in directory."""
+    yasb = load_yasb(os.path.abspath(directory))
+    with tempfile.TemporaryDirectory() as output_directory:
+        filenames = make_images(yasb, output_directory)
+        print('EXPECTED = {')
+        for name, filename in filenames.items():
+            with open(filename, 'rb') as f:
+                print("    '%s': '%s'," % (name, hashlib.sha256(f.read()).hexdigest()))
+        print('}')
+
+
+def check():
+    """Returns the number of checks failed."""
+    failed = 0
+    yasb = load_yasb(IMAGE_TOOLS)
+    ecc = sys.modules['ecc']
+
+    with tempfile.TemporaryDirectory() as directory:
+        filenames = make_images(yasb, directory)
+        for name, filename in filenames.items():
+            with open(filename, 'rb') as f:
+                image = f.read()
+            identical = hashlib.sha256(image).hexdigest() == EXPECTED.get(name)
+            verifies = signature_verifies(yasb, ecc, image)
+            print('%-28s %8d bytes  %-9s %s' % (name, len(image), 'identical' if identical else 'CHANGED',
+                                                'verifies' if verifies else 'BAD SIGNATURE'))
+            failed += (not identical) + (not verifies)
+
+        short = check_short_signature(yasb, ecc, directory)
+        print('%-28s %s' % ('r under 32 bytes', 'written as 32 bytes' if short else 'FAILED'))
+        failed += not short
+
+        batch = check_sign_batch(yasb, directory)
+        if batch is None:
+            print('%-28s %s' % ('sign-batch', 'skipped, needs fork'))
+        else:
+            failed += batch
+
+    return failed
+
+
+if __name__ == '__main__':
+    if (len(sys.argv) == 3) and (sys.argv[1] == 'generate'):
+        generate(sys.argv[2])
+        sys.exit(0)
+
+    failed = check()
+    if failed:
+        print('%d checks FAILED' % failed)
+        sys.exit(1)
+    print('All images identical')
@@ -1,12 +1,18 @@
 import sys
+import os
+import io
+import time
+import contextlib
+import multiprocessing
 import argparse
 import math
 import random
 from ecc import make_keypair
-from ecc import sign_message
+from ecc import sign_hash
 from ecc import verify_signature
 from ecc import scalar_mult
 import collections
+import zlib
 import clipboard
 # pip install clipboard
 # https://pypi.org/project/clipboard/
@@ -17,7 +23,7 @@ from Crypto.Hash import SHA256
 # Magic Number | Signature | Length | Version | Padding | Binary Image
 # 
 # Magic number  - 4 bytes
-# Signature     - 64 bytes for ECC-256
+# Signature     - 64 bytes for ECC-256, r then s, each 32 bytes big endian
 # Length        - 4 bytes
 # Version       - 4 bytes
 # Padding       - Space added to make header up to the specified header_size
@@ -29,6 +35,49 @@ from Crypto.Hash import SHA256
 # The Length field is from (and including) the Version field
 # So, total size of the image is:
 # Length + 4 (Length field) + 64 (Signature) + 4 (Magic Number)
+#
+# Block table images (sign -b) start the padding with:
+# Header version - 4 bytes (1)
+# Block size     - 4 bytes
+# Block count    - 4 bytes
+# and end with a table of Block count SHA256 hashes, one for each block of the image before the table (the first
+# block from the Length field). The table is included in the Length.
+# The Signature is of the header (from the Length field) followed by the table, so the bootloader can check the
+# image one block at a time.
+#
+# Delta images (delta) rebuild a new signed image (the target) from the signed image currently in the main image area
+# of the device (the base). They start the padding with:
+# Header version - 4 bytes (2)
+# Block size     - 4 bytes
+# Block count    - 4 bytes (0)
+# Base version   - 4 bytes
+# Base length    - 4 bytes, total size of the base image
+# Target length  - 4 bytes, total size of the target image
+# Target digest  - 32 bytes, SHA256 of the whole target image
+# Base signature - 64 bytes
+# The binary image is a list of ops, each producing the next bytes of the target:
+# Copy   - Length (4 bytes), Offset in the base image to copy from (4 bytes)
+# Insert - 0x80000000 | Length (4 bytes), Length bytes of data padded to a multiple of 4 bytes
+# The target is rebuilt in place one block at a time, so no op crosses a block of the target and a copy into block N
+# must come from block N of the base or later. The Signature is of the whole delta image (from the Length field).
+#
+# Compressed images (sign -c) hold a signed image (the target) compressed one block at a time. They start the
+# padding in the same way as a delta image (header version 3, no base), and the binary image has for each block of
+# the target:
+# Size - 4 bytes
+# Data - Size bytes, the block in the LZ4 block format, padded to a multiple of 4 bytes
+# Matches only refer to earlier data of the same block. The Signature is of the whole compressed image (from the
+# Length field), the target is checked against the Target digest.
+#
+# Any image can carry a CRC (sign -r, delta -r), which the bootloader checks before hashing the image so a corrupt or
+# partly written image is rejected quickly. It is in the header padding, after the fields above:
+# Crc magic     - 4 bytes, "CRC " (offset 0xC4)
+# Image CRC     - 4 bytes, CRC-32 (zlib) of the binary image, up to the block table of a block table image
+# The CRC is covered by the Signature, and is only a quick check: the Signature is always checked as well.
+#
+# For the bootloader A/B slot mode (BOOT_AB_SLOTS) an image is booted from the slot it is written to, so it must be
+# linked for that slot (PK_S5D9_BL_Blinky/script/s5d9.ld is linked for slot B by s5d9_slot_b.ld). sign -a checks the
+# reset vector of the image is in the slot.
 
 magic_number    = [89, 65, 83, 66]
 ecc_bit_len     = 256
@@ -39,6 +88,25 @@ header_size     = 0x100
 # padding size is the header size less magic number size less signature field less length field size less version field size
 padding_size    = int(header_size - len(magic_number) - signature_len - 4 - 4)
 padding_value   = 0
+header_version_block_table = 1
+# must match IMAGE_BLOCK_SIZE in the bootloader (the main image flash erase block size)
+block_size      = 32 * 1024
+block_hash_len  = 32
+header_version_delta = 2
+header_version_compressed = 3
+lz4_min_match   = 4
+lz4_max_distance = 0xFFFF
+delta_op_insert = 0x80000000
+# shortest run of bytes copied from the base, shorter runs are inserted
+delta_min_match = 16
+# A/B slots (BOOT_AB_SLOTS), slot A is the main image area and slot B the internal update area
+ab_slot_address = {'a': 0x00010000, 'b': 0x00108000}
+ab_slot_size    = 0x000F8000
+# image CRC in the header padding, after the base signature of a delta image
+crc_magic       = 0x20435243
+crc_offset      = 4 + signature_len + 4 + 4 + (6 * 4) + block_hash_len + signature_len
+# images are hashed and CRC'd in chunks of this size
+stream_chunk_size = 1024 * 1024
 
 #
 # Generate ECC 256 keypair for signing (private) and verification (public)
@@ -120,21 +188,41 @@ def print_key(key_filename):
 #   Version
 #   Padding
 #   Original binary image
+#   Block table (if block_table is True)
+# If compress is True the signed image is then compressed into a compressed image
 #
-def create_and_sign_image(input_filename, key_filename, version, output_filename):
-    # open the input file
-    try:
-        f_infile = open(input_filename, "rb")
-    except:
-        print("ERROR: Cannot open file for reading: " + input_filename)
-        sys.exit(2)
+# The image is built in one buffer, the original image read straight into it after the header, and hashed without
+# copying it, so a large (e.g. QSPI) image only takes about its own size in memory.
+#
+def create_and_sign_image(input_filename, key_filename, version, output_filename, block_table=False, compress=False, slot=None, crc=False):
+    private_key = read_private_key(key_filename)
+    sign_image_file(input_filename, private_key, version, output_filename, block_table, compress, slot, crc)
 
+#
+# Read the private signing key from a key file
+#
+def read_private_key(key_filename):
     # open the key file
     try:
         f_keyfile = open(key_filename, "rb")
     except:
         print("ERROR: Cannot open file for reading: " + key_filename)
-        f_infile.close()
+        sys.exit(2)
+
+    private_key = int.from_bytes(f_keyfile.read(int(private_key_len)), "big")
+    f_keyfile.close()
+
+    return private_key
+
+#
+# Sign an image file with a private key already read, see create_and_sign_image()
+#
+def sign_image_file(input_filename, private_key, version, output_filename, block_table=False, compress=False, slot=None, crc=False):
+    # open the input file
+    try:
+        f_infile = open(input_filename, "rb")
+    except:
+        print("ERROR: Cannot open file for reading: " + input_filename)
         sys.exit(2)
 
     # open the output file
@@ -143,102 +231,501 @@ def create_and_sign_image(input_filename, key_filename, version, output_filename
     except:
         print("ERROR: Cannot open file for writing: " + output_filename)
         f_infile.close()
-        f_keyfile.close()
         sys.exit(2)
-    
-    # read in the original image
-    image_orig = f_infile.read()
-
-    image_new = []
-
-    print("Original image length: " + str(len(image_orig)))
-    
-    # add the magic number
-    for mn in magic_number:
-        image_new.append(mn)
 
-    # add space for the signature
-    for s in range(signature_len):
-        image_new.append(0)
+    image_orig_len = os.fstat(f_infile.fileno()).st_size
+
+    print("Original image length: " + str(image_orig_len))
+
+    # number of blocks covered by the block table
+    block_count = 0
+    if (block_table):
+        block_count = int(math.ceil((header_size + image_orig_len) / block_size))
+
+    # the header, the original image and the block table
+    table_start = header_size + image_orig_len
+    image_new = bytearray(table_start + (block_count * block_hash_len))
+
+    # read in the original image, after the header
+    with memoryview(image_new) as view:
+        if (f_infile.readinto(view[header_size:table_start]) != image_orig_len):
+            print("ERROR: Cannot read file: " + input_filename)
+            f_infile.close()
+            f_outfile.close()
+            sys.exit(2)
+
+    # an A/B slot image must run from the slot it is written to
+    if (slot):
+        reset_vector = int.from_bytes(image_new[(header_size + 4):(header_size + 8)], "little")
+        slot_start = ab_slot_address[slot] + header_size
+        slot_end = ab_slot_address[slot] + ab_slot_size
+        if ((reset_vector < slot_start) or (reset_vector >= slot_end)):
+            print("ERROR: Image is not linked for slot " + slot.upper() + " (reset vector " + hex(reset_vector) + ")")
+            f_infile.close()
+            f_outfile.close()
+            sys.exit(2)
+
+    # add the magic number, the signature is added after signing
+    image_new[0:4] = bytes(magic_number)
 
     # add the length
     # add 4 for the version number
-    x = 4 + len(image_orig) + padding_size
-    # snippet from https://stackoverflow.com/questions/6187699/how-to-convert-integer-value-to-array-of-four-bytes-in-python/6187741#6187741
-    x_bytes = [x >> i & 0xff for i in (24,16,8,0)]
-    # change the endian
-    x_bytes.reverse()
-
-    for x in x_bytes:
-        image_new.append(x)
+    x = 4 + image_orig_len + padding_size + (block_count * block_hash_len)
+    image_new[(4 + signature_len):(8 + signature_len)] = (x & 0xFFFFFFFF).to_bytes(4, "little")
 
     # add the version number
-    x_bytes = [version >> i & 0xff for i in (24,16,8,0)]
-    # change the endian
-    x_bytes.reverse()
-
-    for v in x_bytes:
-        image_new.append(v)
+    image_new[(8 + signature_len):(12 + signature_len)] = (version & 0xFFFFFFFF).to_bytes(4, "little")
 
     # add the padding
-    for i in range(padding_size):
-        image_new.append(padding_value)
-    
-    # add the original image
-    for x in image_orig:
-        image_new.append(x)
-
-    # read the private signing key from the key file
-    private_key = int.from_bytes(f_keyfile.read(int(private_key_len)), "big")
+    # a block table image starts the padding with the header version, block size and block count
+    padding = bytearray()
+    if (block_table):
+        for v in (header_version_block_table, block_size, block_count):
+            padding.extend(v.to_bytes(4, "little"))
+
+    padding.extend([padding_value] * (padding_size - len(padding)))
+    image_new[(12 + signature_len):header_size] = padding
+
+    # add the CRC of the image, up to the block table (the table covers the header)
+    if (crc):
+        add_crc(image_new, table_start)
+
+    # add the block table, the hash of each block of the image from the length field
+    with memoryview(image_new) as view:
+        for b in range(block_count):
+            start = max(b * block_size, 4 + signature_len)
+            end = min((b + 1) * block_size, table_start)
+            image_new[(table_start + (b * block_hash_len)):(table_start + ((b + 1) * block_hash_len))] = sha256_chunks(view[start:end])
 
     # sign the new package
     # first element included in the signature is the length so skip over magic number and signature space
-    r, s = sign_message(private_key, bytes(image_new[(4 + signature_len):]))
+    # a block table image signs the header and the table, which covers the rest of the image
+    with memoryview(image_new) as view:
+        if (block_table):
+            digest = sha256_chunks(view[(4 + signature_len):header_size], view[table_start:])
+        else:
+            digest = sha256_chunks(view[(4 + signature_len):])
 
-    # write the signature to the new image
-    # r
-    number_of_bytes = int(math.ceil(r.bit_length() / 8))
-    x_bytes = r.to_bytes(number_of_bytes, byteorder='big')
-    
-    for i in range(0, len(x_bytes)):
-        image_new[4 + i] = x_bytes[i]
+    r, s = sign_hash(private_key, int.from_bytes(digest, "big"))
+    write_signature(image_new, r, s)
 
-    # s
-    number_of_bytes = int(math.ceil(s.bit_length() / 8))
-    x_bytes = s.to_bytes(number_of_bytes, byteorder='big')
-    
-    for i in range(0, len(x_bytes)):
-        image_new[4 + int((signature_len / 2)) + i] = x_bytes[i]
+    print("New image size: " + str(len(image_new)))
 
-    # write out the new image
-    for x in image_new:
-        f_outfile.write(x.to_bytes(1, "big"))
+    # compress the signed image into a signed compressed image
+    if (compress):
+        payload = compress_blocks(image_new)
+        target = image_new
+        image_new = target_image_header(header_version_compressed, version, len(payload), target) + payload
+        if (crc):
+            add_crc(image_new)
+        sign_whole_image(private_key, image_new)
+        print("Compressed image size: " + str(len(image_new)))
 
-    print("New image size: " + str(len(image_new)))
+    # write out the new image
+    f_outfile.write(image_new)
 
     f_infile.close()
-    f_keyfile.close()
     f_outfile.close()
 
+#
+# Read a signed image, returning its contents and header fields
+#
+def read_signed_image(filename):
+    try:
+        f = open(filename, "rb")
+    except:
+        print("ERROR: Cannot open file for reading: " + filename)
+        sys.exit(2)
+
+    image = f.read()
+    f.close()
+
+    if ((len(image) < header_size) or (list(image[0:4]) != magic_number)):
+        print("ERROR: Not a signed image: " + filename)
+        sys.exit(2)
+
+    length = int.from_bytes(image[(4 + signature_len):(8 + signature_len)], "little")
+    version = int.from_bytes(image[(8 + signature_len):(12 + signature_len)], "little")
+
+    if (len(image) != (length + 8 + signature_len)):
+        print("ERROR: Image length does not match its header: " + filename)
+        sys.exit(2)
+
+    return image, version
+
+#
+# Number of equal bytes of a from ai and b from bi, up to max_len
+#
+def match_length(a, ai, b, bi, max_len):
+    n = 0
+    # compare in chunks first
+    while ((n + 64) <= max_len) and (a[ai + n:ai + n + 64] == b[bi + n:bi + n + 64]):
+        n += 64
+    while (n < max_len) and (a[ai + n] == b[bi + n]):
+        n += 1
+    return n
+
+#
+# Build the ops rebuilding target from base, see the delta image format above
+#
+def delta_ops(base, target):
+    # index of the base, every 4 bytes
+    index = {}
+    for i in range(0, len(base) - delta_min_match + 1, 4):
+        index.setdefault(base[i:i + delta_min_match], []).append(i)
+
+    ops = bytearray()
+    insert = bytearray()
+    copied = 0
+
+    def flush_insert():
+        if (len(insert) > 0):
+            ops.extend((delta_op_insert | len(insert)).to_bytes(4, "little"))
+            ops.extend(insert)
+            ops.extend(bytes((4 - (len(insert) % 4)) % 4))
+            insert.clear()
+
+    out = 0
+    src_next = -1
+    while (out < len(target)):
+        block_start = out - (out % block_size)
+        block_end = min(block_start + block_size, len(target))
+
+        # candidate sources, continuing the last copy first
+        candidates = []
+        if (src_next >= block_start) and (src_next < len(base)):
+            candidates.append(src_next)
+        for src in index.get(bytes(target[out:out + delta_min_match]), []):
+            if (src >= block_start):
+                candidates.append(src)
+                if (len(candidates) > 8):
+                    break
+
+        best_len = 0
+        best_src = 0
+        for src in candidates:
+            n = match_length(base, src, target, out, min(block_end - out, len(base) - src))
+            if (n > best_len):
+                best_len = n
+                best_src = src
+
+        if (best_len >= delta_min_match) or ((best_len > 0) and (best_src == src_next) and (best_len == (block_end - out))):
+            flush_insert()
+            ops.extend(best_len.to_bytes(4, "little"))
+            ops.extend(best_src.to_bytes(4, "little"))
+            out += best_len
+            copied += best_len
+            src_next = best_src + best_len
+        else:
+            insert.append(target[out])
+            out += 1
+            src_next = src_next + 1 if (src_next >= 0) else -1
+
+        # no op crosses a block of the target
+        if (out == block_end):
+            flush_insert()
+
+    flush_insert()
+
+    print("Copied from base: " + str(copied) + " bytes, inserted: " + str(len(target) - copied) + " bytes")
+
+    return ops
+
+#
+# SHA256 of parts of an image (bytes, bytearrays or memoryviews), hashed in chunks without copying them
+#
+def sha256_chunks(*parts):
+    h = SHA256.new()
+    for part in parts:
+        with memoryview(part) as view:
+            for start in range(0, len(view), stream_chunk_size):
+                h.update(view[start:(start + stream_chunk_size)])
+    return h.digest()
+
+#
+# Set the CRC of an image (from the end of the header to end, or the end of the image so far) in its header, before
+# signing
+#
+def add_crc(image, end=None):
+    if (end is None):
+        end = len(image)
+    image_crc = 0
+    with memoryview(image) as view:
+        for start in range(header_size, end, stream_chunk_size):
+            image_crc = zlib.crc32(view[start:min(start + stream_chunk_size, end)], image_crc)
+    image[crc_offset:(crc_offset + 4)] = crc_magic.to_bytes(4, "little")
+    image[(crc_offset + 4):(crc_offset + 8)] = (image_crc & 0xFFFFFFFF).to_bytes(4, "little")
+
+#
+# Write the signature (r and s, big endian) to an image
+# Each is written as 32 bytes with leading zeros, an r or s under 32 bytes was once written from the start of its
+# field, so the bootloader could not verify the image (see test_yasb.py)
+#
+def write_signature(image, r, s):
+    image[4:(4 + int(signature_len / 2))] = r.to_bytes(int(signature_len / 2), byteorder='big')
+    image[(4 + int(signature_len / 2)):(4 + signature_len)] = s.to_bytes(int(signature_len / 2), byteorder='big')
+
+#
+# Sign an image from the length field and write the signature to it
+#
+def sign_whole_image(private_key, image):
+    with memoryview(image) as view:
+        digest = sha256_chunks(view[(4 + signature_len):])
+    r, s = sign_hash(private_key, int.from_bytes(digest, "big"))
+    write_signature(image, r, s)
+
+#
+# Header of a delta or compressed image, before signing
+#
+def target_image_header(header_version, version, payload_len, target, base=None):
+    header = bytearray(magic_number)
+    header.extend(bytes(signature_len))
+    header.extend((header_size - len(magic_number) - signature_len - 4 + payload_len).to_bytes(4, "little"))
+    header.extend(version.to_bytes(4, "little"))
+    base_version = 0
+    base_length = 0
+    base_signature = bytes(signature_len)
+    if (base is not None):
+        base_version = int.from_bytes(base[(8 + signature_len):(12 + signature_len)], "little")
+        base_length = len(base)
+        base_signature = base[4:(4 + signature_len)]
+    for v in (header_version, block_size, 0, base_version, base_length, len(target)):
+        header.extend(v.to_bytes(4, "little"))
+    header.extend(sha256_chunks(target))
+    header.extend(base_signature)
+    header.extend([padding_value] * (header_size - len(header)))
+    return header
+
+#
+# Add an LZ4 sequence: literals, then a match of match_len bytes distance bytes back (no match if match_len is 0)
+#
+def lz4_sequence(out, literals, distance, match_len):
+    def extra_length(v):
+        while (v >= 255):
+            out.append(255)
+            v -= 255
+        out.append(v)
+
+    token_match = 0
+    if (match_len > 0):
+        token_match = min(match_len - lz4_min_match, 15)
+    out.append((min(len(literals), 15) << 4) | token_match)
+    if (len(literals) >= 15):
+        extra_length(len(literals) - 15)
+    out.extend(literals)
+
+    if (match_len > 0):
+        out.extend(distance.to_bytes(2, "little"))
+        if ((match_len - lz4_min_match) >= 15):
+            extra_length(match_len - lz4_min_match - 15)
+
+#
+# Compress one block in the LZ4 block format (greedy, matches found with a table of the last position of each
+# 4 byte sequence)
+#
+def lz4_compress_block(data):
+    out = bytearray()
+    table = {}
+    anchor = 0
+    i = 0
+    while ((i + lz4_min_match) <= len(data)):
+        key = data[i:i + lz4_min_match]
+        candidate = table.get(key)
+        table[key] = i
+        if (candidate is not None) and ((i - candidate) <= lz4_max_distance):
+            n = lz4_min_match + match_length(data, candidate + lz4_min_match, data, i + lz4_min_match, len(data) - i - lz4_min_match)
+            lz4_sequence(out, data[anchor:i], i - candidate, n)
+            i += n
+            anchor = i
+        else:
+            i += 1
+
+    # the last sequence is literals only
+    lz4_sequence(out, data[anchor:], 0, 0)
+
+    return out
+
+#
+# Compress a signed image one block at a time, see the compressed image format above
+#
+def compress_blocks(image):
+    payload = bytearray()
+    for start in range(0, len(image), block_size):
+        data = lz4_compress_block(bytes(image[start:(start + block_size)]))
+        payload.extend(len(data).to_bytes(4, "little"))
+        payload.extend(data)
+        payload.extend(bytes((4 - (len(data) % 4)) % 4))
+    return payload
+
+#
+# Build a delta image rebuilding the signed target image from the signed base image, and sign it.
+# The version is that of the target.
+#
+def create_and_sign_delta(target_filename, base_filename, key_filename, output_filename, crc=False):
+    target, version = read_signed_image(target_filename)
+    base, base_version = read_signed_image(base_filename)
+
+    private_key = read_private_key(key_filename)
+
+    ops = delta_ops(base, target)
+
+    image_new = target_image_header(header_version_delta, version, len(ops), target, base) + ops
+    if (crc):
+        add_crc(image_new)
+
+    sign_whole_image(private_key, image_new)
+
+    # write out the new image
+    try:
+        f_outfile = open(output_filename, "wb")
+    except:
+        print("ERROR: Cannot open file for writing: " + output_filename)
+        sys.exit(2)
+
+    f_outfile.write(image_new)
+    f_outfile.close()
+
+    print("Target image size: " + str(len(target)) + ", delta image size: " + str(len(image_new)))
+
+#
+# Read a sign-batch manifest: one image per line, "input version output" (whitespace separated, paths relative to the
+# current directory as for sign). Blank lines and lines starting with # are ignored.
+#
+def read_manifest(manifest_filename):
+    try:
+        f = open(manifest_filename, "r")
+    except:
+        print("ERROR: Cannot open file for reading: " + manifest_filename)
+        sys.exit(2)
+
+    entries = []
+    for line_number, line in enumerate(f, 1):
+        fields = line.split()
+        if (len(fields) == 0) or fields[0].startswith("#"):
+            continue
+        if (len(fields) != 3) or (not fields[1].isdigit()) or (int(fields[1]) == 0):
+            print("ERROR: " + manifest_filename + " line " + str(line_number) + ": expected \"input version output\"")
+            f.close()
+            sys.exit(2)
+        entries.append((fields[0], int(fields[1]), fields[2]))
+
+    f.close()
+
+    if (len(entries) == 0):
+        print("ERROR: No images in manifest: " + manifest_filename)
+        sys.exit(2)
+
+    return entries
+
+# private key and options of a sign-batch worker process, set once by batch_worker_init()
+batch_worker = {}
+
+#
+# Set up a sign-batch worker process
+#
+def batch_worker_init(private_key, block_table, compress, slot, crc):
+    batch_worker.update(private_key=private_key, block_table=block_table, compress=compress, slot=slot, crc=crc)
+    # each worker must pick its own signing nonces: a nonce used twice with the same key gives the key away
+    random.seed()
+
+#
+# Sign one image of a sign-batch in a worker process, as sign does. Returns the entry, whether it was signed, the
+# output of sign and the time taken.
+#
+def batch_sign_entry(entry):
+    input_filename, version, output_filename = entry
+    output = io.StringIO()
+    signed = True
+    start = time.perf_counter()
+    with contextlib.redirect_stdout(output):
+        try:
+            sign_image_file(input_filename, batch_worker["private_key"], version, output_filename,
+                            batch_worker["block_table"], batch_worker["compress"], batch_worker["slot"], batch_worker["crc"])
+        except SystemExit:
+            signed = False
+    return entry, signed, output.getvalue(), time.perf_counter() - start
+
+#
+# Sign the images of a manifest across a pool of jobs processes (one per CPU if jobs is 0), with the key read once.
+# Each image is signed exactly as the sign command would sign it, with the same options.
+#
+def sign_batch(manifest_filename, key_filename, jobs=0, block_table=False, compress=False, slot=None, crc=False):
+    entries = read_manifest(manifest_filename)
+    private_key = read_private_key(key_filename)
+
+    if (jobs <= 0):
+        jobs = os.cpu_count() or 1
+    jobs = min(jobs, len(entries))
+
+    failed = 0
+    bytes_in = 0
+    bytes_out = 0
+    start = time.perf_counter()
+
+    with multiprocessing.Pool(jobs, batch_worker_init, (private_key, block_table, compress, slot, crc)) as pool:
+        for (input_filename, version, output_filename), signed, output, seconds in pool.imap(batch_sign_entry, entries):
+            if (signed):
+                size_in = os.path.getsize(input_filename)
+                size_out = os.path.getsize(output_filename)
+                bytes_in += size_in
+                bytes_out += size_out
+                print(output_filename + ": version " + str(version) + ", " + str(size_in) + " -> " + str(size_out) +
+                      " bytes in " + "%.3f" % seconds + " s")
+            else:
+                failed += 1
+                print(output_filename + ": FAILED")
+                print(output.rstrip())
+
+    seconds = time.perf_counter() - start
+    signed_count = len(entries) - failed
+
+    print("Signed " + str(signed_count) + " of " + str(len(entries)) + " images in " + "%.3f" % seconds + " s with " +
+          str(jobs) + " processes: " + "%.1f" % (signed_count / seconds) + " images/s, " +
+          "%.2f" % (bytes_in / seconds / (1024 * 1024)) + " MB/s")
+
+    if (failed):
+        sys.exit(2)
+
 def main(argv):
     # -i input file
     # -o ouput file
     # -k key file
     # -v version number
-    # command from sign/keygen/print
+    # -m manifest file (sign-batch)
+    # -j number of processes (sign-batch)
+    # command from sign/sign-batch/delta/keygen/print
     
     parser = argparse.ArgumentParser(description="Sign an image or create and show (print) keys for signing.",
                                     epilog='e.g. Signing:\n \
     \tpython yasb.py sign -i app.bin -k signingkey.bin -v 2 -o app_signed.bin\n\n \
+    Signing with a block table, so the bootloader can check the image one block at a time:\n \
+    \tpython yasb.py sign -b -i app.bin -k signingkey.bin -v 2 -o app_signed.bin\n\n \
+    Signing and compressing, to reduce the size of the update:\n \
+    \tpython yasb.py sign -c -i app.bin -k signingkey.bin -v 2 -o app_compressed.bin\n\n \
+    Signing with a CRC, so the bootloader can reject a corrupt image before hashing it:\n \
+    \tpython yasb.py sign -r -i app.bin -k signingkey.bin -v 2 -o app_signed.bin\n\n \
+    Signing an image linked for slot B of the bootloader A/B slot mode:\n \
+    \tpython yasb.py sign -a b -i app_slot_b.bin -k signingkey.bin -v 3 -o app_signed.bin\n\n \
+    Signing each image of a manifest (lines of "input version output") across a pool of processes:\n \
+    \tpython yasb.py sign-batch -b -m release.txt -k signingkey.bin\n\n \
+    Making a delta image, updating a device running base_signed.bin to app_signed.bin:\n \
+    \tpython yasb.py delta -i app_signed.bin -s base_signed.bin -k signingkey.bin -o app_delta.bin\n\n \
     Generating an ECC secp256r1 keypair:\n \
     \tpython yasb.py keygen -o signingkey.bin\n\n \
     Showing the signing key public part and copying to the clipboard:\n \
     \tpython yasb.py print -k signingkey.bin', formatter_class=argparse.RawDescriptionHelpFormatter)
-    parser.add_argument('command', choices=['sign', 'keygen', 'print'], type=str, help='Operation to perform - sign/keygen/print')
-    parser.add_argument('-i', '--inputfile', type=str, help='Input image file to be signed')
+    parser.add_argument('command', choices=['sign', 'sign-batch', 'delta', 'keygen', 'print'], type=str, help='Operation to perform - sign/sign-batch/delta/keygen/print')
+    parser.add_argument('-i', '--inputfile', type=str, help='Input image file to be signed, or signed target image for a delta')
+    parser.add_argument('-s', '--baseimage', type=str, help='Signed base image a delta is made from')
     parser.add_argument('-k', '--keyfile', type=str, help='Key file used for signing the image (input only)')
     parser.add_argument('-v', '--version', type=int, help='Version number for the signed image')
     parser.add_argument('-o', '--outputfile', type=str, help='Output file, either the signed image or generated key file')
+    parser.add_argument('-b', '--blocktable', action='store_true', help='Add a table of block hashes to the signed image')
+    parser.add_argument('-c', '--compress', action='store_true', help='Compress the signed image into a compressed update image')
+    parser.add_argument('-r', '--crc', action='store_true', help='Add a CRC of the image to the header, checked before the image is hashed')
+    parser.add_argument('-a', '--slot', choices=['a', 'b'], type=str, help='A/B slot the image is linked for, checked against its reset vector')
+    parser.add_argument('-m', '--manifest', type=str, help='Manifest of images for sign-batch, one "input version output" per line')
+    parser.add_argument('-j', '--jobs', type=int, default=0, help='Number of processes signing for sign-batch (default one per CPU)')
     args = parser.parse_args()
 
     missing_arg = False
@@ -270,6 +757,30 @@ def main(argv):
             print("Version number not specified. Use -v or -h for help.")
             missing_arg = True
 
+    if (args.command == "sign-batch"):
+        # check for batch signing arguments
+        if (not args.manifest):
+            print("Manifest not specified. Use -m or -h for help.")
+            missing_arg = True
+        if (not args.keyfile):
+            print("Keyfile not specified. Use -k or -h for help.")
+            missing_arg = True
+
+    if (args.command == "delta"):
+        # check for delta arguments
+        if (not args.inputfile):
+            print("Target image file not specified. Use -i or -h for help.")
+            missing_arg = True
+        if (not args.baseimage):
+            print("Base image file not specified. Use -s or -h for help.")
+            missing_arg = True
+        if (not args.outputfile):
+            print("Output file not specified. Use -o or -h for help.")
+            missing_arg = True
+        if (not args.keyfile):
+            print("Keyfile not specified. Use -k or -h for help.")
+            missing_arg = True
+
     if (True == missing_arg):
         sys.exit(2)
 
@@ -281,7 +792,13 @@ def main(argv):
         print("")
 
     if (args.command == "sign"):
-        create_and_sign_image(args.inputfile, args.keyfile, args.version, args.outputfile)
+        create_and_sign_image(args.inputfile, args.keyfile, args.version, args.outputfile, args.blocktable, args.compress, args.slot, args.crc)
+
+    if (args.command == "sign-batch"):
+        sign_batch(args.manifest, args.keyfile, args.jobs, args.blocktable, args.compress, args.slot, args.crc)
+
+    if (args.command == "delta"):
+        create_and_sign_delta(args.inputfile, args.baseimage, args.keyfile, args.outputfile, args.crc)
     
     print("Done")
 
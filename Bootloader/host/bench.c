@@ -0,0 +1,152 @@
+/*
+ * bench.c
+ *
+ * Boot time benchmark of the bootloader built for the host (see README.md): the time of each boot phase, from the
+ * boot timing record, of a normal boot and of an update boot for images of 16 KB to 960 KB, and the cycles per byte of
+ * the SCE hash driver and the software SHA256 backend (sha256_backend_benchmark(), built with SHA256_BENCHMARK).
+ *
+ * Usage: bench [variant name]
+ *
+ * Times are simulated (sim_latency_default()), so they compare variants and image sizes rather than predict a device.
+ */
+#include "image.h"
+#include <stdio.h>
+
+static const uint32_t bench_sizes_kb[] = { 16, 64, 256, 512, 960 };
+
+// Bytes hashed with each SHA256 backend by bench_hash_backends()
+#define BENCH_HASH_SIZE         (64 * 1024)
+
+static const char * const bench_phase_names[BOOT_PHASE_COUNT] =
+{
+    [BOOT_PHASE_DRIVER_OPEN]        = "open",
+    [BOOT_PHASE_BLANK_CHECK]        = "blank",
+    [BOOT_PHASE_HASH]               = "hash",
+    [BOOT_PHASE_ECC_VERIFY]         = "ecc",
+    [BOOT_PHASE_ERASE]              = "erase",
+    [BOOT_PHASE_PROGRAM]            = "program",
+    [BOOT_PHASE_HANDOFF]            = "handoff",
+    [BOOT_PHASE_COMPARE]            = "compare",
+    [BOOT_PHASE_UPDATE]             = "update",
+    [BOOT_PHASE_STORAGE_SESSION]    = "storage",
+    [BOOT_PHASE_CRC]                = "crc",
+};
+
+static uint8_t bench_image[IMAGE_MAX_SIZE];
+
+static double cycles_ms(uint64_t cycles)
+{
+    return ((double)cycles * 1000.0) / (double)sim_shared->record.core_clock_hz;
+}
+
+static void bench_print_header(void)
+{
+    printf("%-7s %6s %10s", "boot", "KB", "total");
+    for (uint32_t phase = 0; phase < BOOT_PHASE_COUNT; phase++)
+    {
+        printf(" %9s", bench_phase_names[phase]);
+    }
+    printf(" %9s %9s\n", "blank KB", "KB/s");
+}
+
+/*
+ * bench_boot()
+ *
+ * Boot once and print a line of the boot time and its phases (ms), the bytes blank checked and, for an update, the
+ * rate the update was applied at.
+ *
+ *  */
+static void bench_boot(const char * p_name, uint32_t size)
+{
+    const boot_timing_record_t * p_record = &sim_shared->record;
+    sim_outcome_t                outcome = sim_boot();
+
+    if ((SIM_OUTCOME_BOOTED != outcome) || (!sim_shared->record_valid))
+    {
+        printf("%-7s %6u %s %s\n", p_name, size / 1024, sim_outcome_name(outcome), sim_shared->fault);
+        return;
+    }
+
+    printf("%-7s %6u %10.3f", p_name, size / 1024, cycles_ms(p_record->total_cycles));
+    for (uint32_t phase = 0; phase < BOOT_PHASE_COUNT; phase++)
+    {
+        printf(" %9.3f", cycles_ms(p_record->phase[phase].cycles));
+    }
+    printf(" %9.2f", (double)p_record->phase[BOOT_PHASE_BLANK_CHECK].bytes / 1024.0);
+    if (0 != p_record->phase[BOOT_PHASE_UPDATE].cycles)
+    {
+        printf(" %9.1f", ((double)size / 1024.0) / (cycles_ms(p_record->phase[BOOT_PHASE_UPDATE].cycles) / 1000.0));
+    }
+    printf("\n");
+}
+
+/*
+ * bench_hash_backends()
+ *
+ * Print the cycles per byte of the SCE hash driver and of the software backend, hashing the start of a main image.
+ *
+ *  */
+static void bench_hash_backends(void)
+{
+    sha256_backend_benchmark_t  result;
+    ssp_err_t                   err;
+    uint32_t                    size;
+
+    sim_erase_all();
+    sim_shared->latency = sim_latency_default();
+    size = image_make(bench_image, MAIN_IMAGE_START_ADDRESS, BENCH_HASH_SIZE, 1, 1, 0);
+    memcpy((void *)MAIN_IMAGE_START_ADDRESS, bench_image, size);
+
+    // The cycle counts are from the DWT cycle counter, started as at the start of a boot
+    boot_timing_init();
+    err = g_sce.p_api->open(g_sce.p_ctrl, g_sce.p_cfg);
+    if (SSP_SUCCESS == err)
+    {
+        err = g_sce_hash_0.p_api->open(g_sce_hash_0.p_ctrl, g_sce_hash_0.p_cfg);
+    }
+    if (SSP_SUCCESS == err)
+    {
+        err = sha256_backend_benchmark((const uint8_t *)MAIN_IMAGE_START_ADDRESS, BENCH_HASH_SIZE, &result);
+        g_sce_hash_0.p_api->close(g_sce_hash_0.p_ctrl);
+    }
+    g_sce.p_api->close(g_sce.p_ctrl);
+
+    if (SSP_SUCCESS != err)
+    {
+        printf("hash backends: error %d\n", err);
+        return;
+    }
+    printf("hash %u KB (cycles per byte): sce %u.%02u  software %u.%02u\n", BENCH_HASH_SIZE / 1024,
+           result.sce_cycles_per_byte_x100 / 100, result.sce_cycles_per_byte_x100 % 100,
+           result.software_cycles_per_byte_x100 / 100, result.software_cycles_per_byte_x100 % 100);
+}
+
+int main(int argc, char * argv[])
+{
+    sim_init();
+    image_init(SIGNING_KEY_FILE);
+
+    printf("bench %s (times in ms)\n", (argc > 1) ? argv[1] : "");
+    bench_hash_backends();
+    bench_print_header();
+
+    for (uint32_t i = 0; i < (sizeof(bench_sizes_kb) / sizeof(bench_sizes_kb[0])); i++)
+    {
+        uint32_t size;
+
+        // Update from a small main image, then boot the updated image
+        sim_erase_all();
+        sim_shared->latency = sim_latency_default();
+        sim_shared->power_cut_after_ops = -1;
+        image_make(bench_image, MAIN_IMAGE_START_ADDRESS, 16 * 1024, 1, 1, 0);
+        memcpy((void *)MAIN_IMAGE_START_ADDRESS, bench_image, image_size(bench_image));
+        size = image_make(bench_image, MAIN_IMAGE_START_ADDRESS, (bench_sizes_kb[i] * 1024) - IMAGE_HEADER_SIZE, 2, 2, 0);
+        memcpy((void *)UPDATE_IMAGE_START_ADDRESS, bench_image, size);
+
+        bench_boot("update", size);
+        bench_boot("boot", size);
+    }
+    printf("\n");
+
+    return 0;
+}
@@ -0,0 +1,435 @@
+/*
+ * image.c
+ *
+ * Test image builders, see image.h.
+ */
+#include "image.h"
+#include "secp256k1.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define IMAGE_STACK_TOP             (0x20080000)
+
+// Delta ops (delta_update.c)
+#define DELTA_OP_INSERT             (0x80000000U)
+// Granularity the delta builder compares the base and target in
+#define DELTA_CHUNK_SIZE            (64)
+
+// LZ4 block format
+#define LZ4_MIN_MATCH               (4)
+#define LZ4_MAX_DISTANCE            (0xFFFF)
+#define LZ4_HASH_BITS               (12)
+
+static uint8_t image_private_key[SECP256K1_KEY_SIZE];
+
+/*
+ * image_init()
+ *
+ * Read the signing key (as written by yasb.py keygen: private key then public key), checking it is the key of
+ * g_public_key.
+ *
+ *  */
+void image_init(const char * p_key_filename)
+{
+    uint8_t key[SECP256K1_KEY_SIZE + SECP256K1_PUBLIC_KEY_SIZE];
+    uint8_t public_key[SECP256K1_PUBLIC_KEY_SIZE];
+    FILE *  p_file = fopen(p_key_filename, "rb");
+
+    if ((NULL == p_file) || (sizeof(key) != fread(key, 1, sizeof(key), p_file)))
+    {
+        fprintf(stderr, "image: cannot read the signing key %s\n", p_key_filename);
+        exit(2);
+    }
+    fclose(p_file);
+
+    memcpy(image_private_key, key, SECP256K1_KEY_SIZE);
+    if ((!secp256k1_public_key(image_private_key, public_key)) ||
+        (0 != memcmp(public_key, g_public_key, sizeof(public_key))))
+    {
+        fprintf(stderr, "image: %s is not the key of g_public_key\n", p_key_filename);
+        exit(2);
+    }
+}
+
+static uint32_t image_crc32_zlib(const uint8_t * p_data, uint32_t length)
+{
+    uint32_t crc = 0xFFFFFFFFU;
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        crc ^= p_data[i];
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1U)));
+        }
+    }
+
+    return ~crc;
+}
+
+static void image_sha256(uint8_t * p_digest, const uint8_t * p_first, uint32_t first_length, const uint8_t * p_second, uint32_t second_length)
+{
+    sha256_context_t ctx;
+
+    if ((SSP_SUCCESS != sha256_init(&ctx, &g_hash_software)) ||
+        (SSP_SUCCESS != sha256_update(&ctx, p_first, first_length)) ||
+        (SSP_SUCCESS != sha256_update(&ctx, p_second, second_length)) ||
+        (SSP_SUCCESS != sha256_final(&ctx, p_digest)))
+    {
+        fprintf(stderr, "image: SHA256 failed\n");
+        exit(2);
+    }
+}
+
+static void image_write_signature(uint8_t * p_image, const uint8_t * p_digest)
+{
+    if (!secp256k1_sign(image_private_key, p_digest, p_image + MAGIC_NUMBER_LEN))
+    {
+        fprintf(stderr, "image: signing failed\n");
+        exit(2);
+    }
+}
+
+/*
+ * image_size()
+ *
+ * Total size of an image, from the Length field of its header.
+ *
+ *  */
+uint32_t image_size(const uint8_t * p_image)
+{
+    return ((const bootloader_image_header_t *)p_image)->length + IMAGE_HASH_OFFSET + sizeof(uint32_t);
+}
+
+/*
+ * image_sign()
+ *
+ * Sign an image over all of it from the Length field (any header version but a block table image).
+ *
+ *  */
+void image_sign(uint8_t * p_image)
+{
+    uint8_t digest[SHA256_DIGEST_SIZE_BYTES];
+
+    image_sha256(digest, p_image + IMAGE_HASH_OFFSET, image_size(p_image) - IMAGE_HASH_OFFSET, NULL, 0);
+    image_write_signature(p_image, digest);
+}
+
+static void image_header_start(uint8_t * p_image, uint32_t header_version, uint32_t version, uint32_t payload_size)
+{
+    bootloader_image_header_t * p_header = (bootloader_image_header_t *)p_image;
+
+    memset(p_image, 0, IMAGE_HEADER_SIZE);
+    memcpy(&p_header->magic_number, MAGIC_NUMBER, MAGIC_NUMBER_LEN);
+    p_header->length = (IMAGE_HEADER_SIZE - IMAGE_HASH_OFFSET - sizeof(uint32_t)) + payload_size;
+    p_header->version = version;
+    p_header->header_version = header_version;
+    if (IMAGE_HEADER_VERSION_FLAT != header_version)
+    {
+        p_header->block_size = IMAGE_BLOCK_SIZE;
+    }
+}
+
+static void image_add_crc(uint8_t * p_image, uint32_t end)
+{
+    bootloader_image_header_t * p_header = (bootloader_image_header_t *)p_image;
+
+    p_header->crc_magic = IMAGE_CRC_MAGIC;
+    p_header->image_crc = image_crc32_zlib(p_image + IMAGE_HEADER_SIZE, end - IMAGE_HEADER_SIZE);
+}
+
+/*
+ * image_make()
+ *
+ * Make a signed flat or block table image.
+ *
+ * IN:
+ * - p_image        - Buffer for the image (up to IMAGE_MAX_SIZE bytes)
+ * - run_address    - Address of the image header when the image runs (the main image area, or an A/B slot)
+ * - binary_size    - Size of the binary after the header, at least IMAGE_MIN_BINARY_SIZE
+ * - version        - Image version
+ * - seed           - Seed of the binary contents, images with the same seed and run address have the same binary
+ * - flags          - IMAGE_MAKE_ flags
+ *
+ * RETURNS:
+ * - Total size of the image
+ *
+ *  */
+uint32_t image_make(uint8_t * p_image, uint32_t run_address, uint32_t binary_size, uint32_t version, uint32_t seed, uint32_t flags)
+{
+    bootloader_image_header_t * p_header = (bootloader_image_header_t *)p_image;
+    uint8_t *                   p_binary = p_image + IMAGE_HEADER_SIZE;
+    uint32_t *                  p_vectors = (uint32_t *)p_binary;
+    uint64_t                    entry = (uint64_t)(uintptr_t)sim_app_entry;
+    uint32_t                    table_start = IMAGE_HEADER_SIZE + binary_size;
+    uint32_t                    block_count = 0;
+    uint32_t                    state = seed | 1U;
+    uint8_t                     digest[SHA256_DIGEST_SIZE_BYTES];
+
+    if (binary_size < IMAGE_MIN_BINARY_SIZE)
+    {
+        binary_size = IMAGE_MIN_BINARY_SIZE;
+        table_start = IMAGE_HEADER_SIZE + binary_size;
+    }
+    if (flags & IMAGE_MAKE_BLOCK_TABLE)
+    {
+        block_count = (table_start + IMAGE_BLOCK_SIZE - 1) / IMAGE_BLOCK_SIZE;
+    }
+
+    image_header_start(p_image, (flags & IMAGE_MAKE_BLOCK_TABLE) ? IMAGE_HEADER_VERSION_BLOCK_TABLE : IMAGE_HEADER_VERSION_FLAT,
+                       version, binary_size + (block_count * SHA256_DIGEST_SIZE_BYTES));
+    p_header->block_count = block_count;
+
+    // Binary: pseudo random runs of bytes
+    for (uint32_t i = 0; i < binary_size; )
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        for (uint32_t run = 1 + (state & 0x0F); (run > 0) && (i < binary_size); run--, i++)
+        {
+            p_binary[i] = (uint8_t)(state >> 24);
+        }
+    }
+
+    // Vector table (initial stack and reset vector), and the reset stub: movabs rax, sim_app_entry; jmp rax
+    memset(p_binary, 0, IMAGE_STUB_OFFSET);
+    p_vectors[0] = IMAGE_STACK_TOP;
+    p_vectors[1] = run_address + IMAGE_HEADER_SIZE + IMAGE_STUB_OFFSET;
+    p_binary[IMAGE_STUB_OFFSET] = 0x48;
+    p_binary[IMAGE_STUB_OFFSET + 1] = 0xB8;
+    memcpy(&p_binary[IMAGE_STUB_OFFSET + 2], &entry, sizeof(entry));
+    p_binary[IMAGE_STUB_OFFSET + 10] = 0xFF;
+    p_binary[IMAGE_STUB_OFFSET + 11] = 0xE0;
+
+    if (flags & IMAGE_MAKE_CRC)
+    {
+        image_add_crc(p_image, table_start);
+    }
+
+    if (flags & IMAGE_MAKE_BLOCK_TABLE)
+    {
+        for (uint32_t block = 0; block < block_count; block++)
+        {
+            uint32_t start = block * IMAGE_BLOCK_SIZE;
+            uint32_t end = start + IMAGE_BLOCK_SIZE;
+
+            start = (start > IMAGE_HASH_OFFSET) ? start : IMAGE_HASH_OFFSET;
+            end = (end < table_start) ? end : table_start;
+            image_sha256(p_image + table_start + (block * SHA256_DIGEST_SIZE_BYTES), p_image + start, end - start, NULL, 0);
+        }
+        image_sha256(digest, p_image + IMAGE_HASH_OFFSET, IMAGE_HEADER_SIZE - IMAGE_HASH_OFFSET,
+                     p_image + table_start, block_count * SHA256_DIGEST_SIZE_BYTES);
+        image_write_signature(p_image, digest);
+    }
+    else
+    {
+        image_sign(p_image);
+    }
+
+    return image_size(p_image);
+}
+
+static void image_target_header(uint8_t * p_image, uint32_t header_version, uint32_t payload_size, const uint8_t * p_target, uint32_t target_size)
+{
+    bootloader_image_header_t * p_header = (bootloader_image_header_t *)p_image;
+
+    image_header_start(p_image, header_version, ((const bootloader_image_header_t *)p_target)->version, payload_size);
+    p_header->target_length = target_size;
+    image_sha256((uint8_t *)p_header->target_digest, p_target, target_size, NULL, 0);
+}
+
+static uint32_t delta_insert(uint8_t * p_out, const uint8_t * p_data, uint32_t length)
+{
+    uint32_t op = DELTA_OP_INSERT | length;
+    uint32_t padded = (length + 3) & ~3U;
+
+    memcpy(p_out, &op, sizeof(op));
+    memcpy(p_out + 4, p_data, length);
+    memset(p_out + 4 + length, 0, padded - length);
+
+    return 4 + padded;
+}
+
+/*
+ * image_make_delta()
+ *
+ * Make a signed delta update rebuilding the target image from the base image. Parts of the target the same as the
+ * base at the same offset are copied from it (so the copies of each block come from the same block of the base, the
+ * case that needs the delta backup), the rest is inserted.
+ *
+ * RETURNS:
+ * - Total size of the delta image
+ *
+ *  */
+uint32_t image_make_delta(uint8_t * p_image, const uint8_t * p_base, uint32_t base_size, const uint8_t * p_target, uint32_t target_size, uint32_t flags)
+{
+    bootloader_image_header_t * p_header = (bootloader_image_header_t *)p_image;
+    uint8_t *                   p_out = p_image + IMAGE_HEADER_SIZE;
+
+    for (uint32_t block_start = 0; block_start < target_size; block_start += IMAGE_BLOCK_SIZE)
+    {
+        uint32_t block_end = ((block_start + IMAGE_BLOCK_SIZE) < target_size) ? (block_start + IMAGE_BLOCK_SIZE) : target_size;
+        uint32_t out = block_start;
+
+        while (out < block_end)
+        {
+            uint32_t chunk_end = ((out + DELTA_CHUNK_SIZE) < block_end) ? (out + DELTA_CHUNK_SIZE) : block_end;
+            bool     same = (chunk_end <= base_size) && (0 == memcmp(p_base + out, p_target + out, chunk_end - out));
+            uint32_t run_end = chunk_end;
+
+            // Extend the run of chunks that are all the same, or all different
+            while (run_end < block_end)
+            {
+                uint32_t next_end = ((run_end + DELTA_CHUNK_SIZE) < block_end) ? (run_end + DELTA_CHUNK_SIZE) : block_end;
+                bool     next_same = (next_end <= base_size) && (0 == memcmp(p_base + run_end, p_target + run_end, next_end - run_end));
+
+                if (next_same != same)
+                {
+                    break;
+                }
+                run_end = next_end;
+            }
+
+            if (same)
+            {
+                uint32_t op[2] = { run_end - out, out };
+
+                memcpy(p_out, op, sizeof(op));
+                p_out += sizeof(op);
+            }
+            else
+            {
+                p_out += delta_insert(p_out, p_target + out, run_end - out);
+            }
+            out = run_end;
+        }
+    }
+
+    image_target_header(p_image, IMAGE_HEADER_VERSION_DELTA, (uint32_t)(p_out - (p_image + IMAGE_HEADER_SIZE)), p_target, target_size);
+    p_header->base_version = ((const bootloader_image_header_t *)p_base)->version;
+    p_header->base_length = base_size;
+    memcpy(p_header->base_signature, ((const bootloader_image_header_t *)p_base)->signature, SIGNATURE_LEN_BYTES);
+
+    if (flags & IMAGE_MAKE_CRC)
+    {
+        image_add_crc(p_image, image_size(p_image));
+    }
+    image_sign(p_image);
+
+    return image_size(p_image);
+}
+
+static void lz4_length(uint8_t ** pp_out, uint32_t length)
+{
+    while (length >= 255)
+    {
+        *(*pp_out)++ = 255;
+        length -= 255;
+    }
+    *(*pp_out)++ = (uint8_t)length;
+}
+
+static void lz4_sequence(uint8_t ** pp_out, const uint8_t * p_literals, uint32_t literal_count, uint32_t distance, uint32_t match_length)
+{
+    uint32_t token_match = 0;
+
+    if (match_length > 0)
+    {
+        token_match = ((match_length - LZ4_MIN_MATCH) < 15) ? (match_length - LZ4_MIN_MATCH) : 15;
+    }
+    *(*pp_out)++ = (uint8_t)((((literal_count < 15) ? literal_count : 15) << 4) | token_match);
+    if (literal_count >= 15)
+    {
+        lz4_length(pp_out, literal_count - 15);
+    }
+    memcpy(*pp_out, p_literals, literal_count);
+    *pp_out += literal_count;
+
+    if (match_length > 0)
+    {
+        *(*pp_out)++ = (uint8_t)distance;
+        *(*pp_out)++ = (uint8_t)(distance >> 8);
+        if ((match_length - LZ4_MIN_MATCH) >= 15)
+        {
+            lz4_length(pp_out, match_length - LZ4_MIN_MATCH - 15);
+        }
+    }
+}
+
+// Compress one block in the LZ4 block format, as yasb.py lz4_compress_block()
+static uint32_t lz4_compress_block(uint8_t * p_out, const uint8_t * p_data, uint32_t length)
+{
+    static int32_t  table[1U << LZ4_HASH_BITS];
+    uint8_t *       p_start = p_out;
+    uint32_t        anchor = 0;
+    uint32_t        i = 0;
+
+    memset(table, 0xFF, sizeof(table));
+    while ((i + LZ4_MIN_MATCH) <= length)
+    {
+        uint32_t key;
+        memcpy(&key, p_data + i, sizeof(key));
+        uint32_t slot = (key * 2654435761U) >> (32 - LZ4_HASH_BITS);
+        int32_t  candidate = table[slot];
+
+        table[slot] = (int32_t)i;
+        if ((candidate >= 0) && ((i - (uint32_t)candidate) <= LZ4_MAX_DISTANCE) &&
+            (0 == memcmp(p_data + candidate, p_data + i, LZ4_MIN_MATCH)))
+        {
+            uint32_t n = LZ4_MIN_MATCH;
+
+            while (((i + n) < length) && (p_data[candidate + n] == p_data[i + n]))
+            {
+                n++;
+            }
+            lz4_sequence(&p_out, p_data + anchor, i - anchor, i - (uint32_t)candidate, n);
+            i += n;
+            anchor = i;
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    // The last sequence is literals only
+    lz4_sequence(&p_out, p_data + anchor, length - anchor, 0, 0);
+
+    return (uint32_t)(p_out - p_start);
+}
+
+/*
+ * image_make_compressed()
+ *
+ * Make a signed compressed update holding the target image.
+ *
+ * RETURNS:
+ * - Total size of the compressed image
+ *
+ *  */
+uint32_t image_make_compressed(uint8_t * p_image, const uint8_t * p_target, uint32_t target_size, uint32_t flags)
+{
+    uint8_t * p_out = p_image + IMAGE_HEADER_SIZE;
+
+    for (uint32_t start = 0; start < target_size; start += IMAGE_BLOCK_SIZE)
+    {
+        uint32_t length = ((start + IMAGE_BLOCK_SIZE) < target_size) ? IMAGE_BLOCK_SIZE : (target_size - start);
+        uint32_t size = lz4_compress_block(p_out + 4, p_target + start, length);
+        uint32_t padded = (size + 3) & ~3U;
+
+        memcpy(p_out, &size, sizeof(size));
+        memset(p_out + 4 + size, 0, padded - size);
+        p_out += 4 + padded;
+    }
+
+    image_target_header(p_image, IMAGE_HEADER_VERSION_COMPRESSED, (uint32_t)(p_out - (p_image + IMAGE_HEADER_SIZE)), p_target, target_size);
+
+    if (flags & IMAGE_MAKE_CRC)
+    {
+        image_add_crc(p_image, image_size(p_image));
+    }
+    image_sign(p_image);
+
+    return image_size(p_image);
+}
@@ -0,0 +1,36 @@
+/*
+ * image.h
+ *
+ * Builders for the test images booted by the host build, in the formats made by Image_Tools/yasb.py (see the format
+ * comments there): flat and block table images (sign, sign -b), delta (delta) and compressed (sign -c) updates, with
+ * or without a CRC (-r). Images are signed with Image_Tools/signingkey.key, whose public key is keys.c g_public_key.
+ *
+ * The binary of a test image starts with a vector table whose reset vector is a small x86-64 stub in the image that
+ * jumps to sim_app_entry(), so starting the image (boot_application()) runs it from the flash it was booted from.
+ * The rest of the binary is pseudo random data from a seed, with runs so it can be compressed.
+ */
+
+#ifndef IMAGE_H_
+#define IMAGE_H_
+
+#include "sim.h"
+
+// Flags for image_make()
+#define IMAGE_MAKE_BLOCK_TABLE      (1U << 0)   // Header version 1 (sign -b)
+#define IMAGE_MAKE_CRC              (1U << 1)   // CRC in the header (sign -r)
+
+// Offset in the binary of the reset stub, after the vector table
+#define IMAGE_STUB_OFFSET           (0x200)
+#define IMAGE_MIN_BINARY_SIZE       (IMAGE_STUB_OFFSET + 0x10)
+
+// Largest image made (the whole QSPI update area, a compressed image can be slightly larger than its target)
+#define IMAGE_MAX_SIZE              (MAIN_IMAGE_MAX_SIZE + (MAIN_IMAGE_MAX_SIZE / 8))
+
+void     image_init(const char * p_key_filename);
+uint32_t image_make(uint8_t * p_image, uint32_t run_address, uint32_t binary_size, uint32_t version, uint32_t seed, uint32_t flags);
+uint32_t image_make_delta(uint8_t * p_image, const uint8_t * p_base, uint32_t base_size, const uint8_t * p_target, uint32_t target_size, uint32_t flags);
+uint32_t image_make_compressed(uint8_t * p_image, const uint8_t * p_target, uint32_t target_size, uint32_t flags);
+void     image_sign(uint8_t * p_image);
+uint32_t image_size(const uint8_t * p_image);
+
+#endif /* IMAGE_H_ */
@@ -0,0 +1,51 @@
+#!/bin/sh
+#
+# options.sh
+#
+# Set the build options of a copy of the bootloader sources, by editing the option lines of its headers
+# (bootloader.h, flash_layout.h, port.h, ...) the way they are set by hand for a device build:
+#   +NAME        - define NAME (uncomment "//#define NAME")
+#   -NAME        - undefine NAME (comment out "#define NAME")
+#   NAME=VALUE   - define NAME as VALUE
+# Fails if an option line is not found, so a renamed option cannot be silently ignored.
+#
+# Usage: options.sh <source folder> [option...]
+
+set -e
+
+dir="$1"
+shift
+
+for option in "$@"; do
+    case "$option" in
+        +*)
+            name="${option#+}"
+            pattern="^//[[:space:]]*#define[[:space:]]+${name}([[:space:]]|$)"
+            expression="s|^//[[:space:]]*(#define[[:space:]]+${name})([[:space:]]\|$)|\\1\\2|"
+            ;;
+        -*)
+            name="${option#-}"
+            pattern="^#define[[:space:]]+${name}([[:space:]]|$)"
+            expression="s|^(#define[[:space:]]+${name})([[:space:]]\|$)|//\\1\\2|"
+            ;;
+        *=*)
+            name="${option%%=*}"
+            value="${option#*=}"
+            pattern="^(//)?[[:space:]]*#define[[:space:]]+${name}([[:space:]]|$)"
+            expression="s|^(//)?[[:space:]]*#define[[:space:]]+${name}([[:space:]].*)?$|#define ${name}  ${value}|"
+            ;;
+        *)
+            echo "options.sh: bad option '$option'" >&2
+            exit 1
+            ;;
+    esac
+
+    files=$(grep -lE "$pattern" "$dir"/*.h || true)
+    if [ -z "$files" ]; then
+        echo "options.sh: no option line for '$option' in $dir" >&2
+        exit 1
+    fi
+    for file in $files; do
+        sed -E -i "$expression" "$file"
+    done
+done
@@ -0,0 +1,526 @@
+/*
+ * secp256k1.c
+ *
+ * ECDSA on secp256k1 (see secp256k1.h). Numbers are held as four 64 bit limbs, least significant first.
+ * Both moduli (the field prime p and the group order n) are just below 2^256, so a product is reduced by folding
+ * its top half back in: 2^256 = c (mod m), with c small.
+ */
+#include <string.h>
+#include "secp256k1.h"
+#include "sha256_hal.h"
+
+typedef struct num {
+    uint64_t v[4];
+} num_t;
+
+typedef struct modulus {
+    num_t       m;
+    uint64_t    c[3];           // 2^256 mod m
+} modulus_t;
+
+// Jacobian coordinates, x = X / Z^2, y = Y / Z^3; Z = 0 is the point at infinity
+typedef struct point {
+    num_t x;
+    num_t y;
+    num_t z;
+} point_t;
+
+static const modulus_t field =
+{
+    .m = {{ 0xFFFFFFFEFFFFFC2FULL, 0xFFFFFFFFFFFFFFFFULL, 0xFFFFFFFFFFFFFFFFULL, 0xFFFFFFFFFFFFFFFFULL }},
+    .c = { 0x00000001000003D1ULL, 0, 0 },
+};
+
+static const modulus_t order =
+{
+    .m = {{ 0xBFD25E8CD0364141ULL, 0xBAAEDCE6AF48A03BULL, 0xFFFFFFFFFFFFFFFEULL, 0xFFFFFFFFFFFFFFFFULL }},
+    .c = { 0x402DA1732FC9BEBFULL, 0x4551231950B75FC4ULL, 0x0000000000000001ULL },
+};
+
+const uint8_t secp256k1_domain[128] =
+{
+    /* a */
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    /* b */
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07,
+    /* p */
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE, 0xFF, 0xFF, 0xFC, 0x2F,
+    /* n */
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE,
+    0xBA, 0xAE, 0xDC, 0xE6, 0xAF, 0x48, 0xA0, 0x3B, 0xBF, 0xD2, 0x5E, 0x8C, 0xD0, 0x36, 0x41, 0x41,
+};
+
+const uint8_t secp256k1_generator[64] =
+{
+    /* x */
+    0x79, 0xBE, 0x66, 0x7E, 0xF9, 0xDC, 0xBB, 0xAC, 0x55, 0xA0, 0x62, 0x95, 0xCE, 0x87, 0x0B, 0x07,
+    0x02, 0x9B, 0xFC, 0xDB, 0x2D, 0xCE, 0x28, 0xD9, 0x59, 0xF2, 0x81, 0x5B, 0x16, 0xF8, 0x17, 0x98,
+    /* y */
+    0x48, 0x3A, 0xDA, 0x77, 0x26, 0xA3, 0xC4, 0x65, 0x5D, 0xA4, 0xFB, 0xFC, 0x0E, 0x11, 0x08, 0xA8,
+    0xFD, 0x17, 0xB4, 0x48, 0xA6, 0x85, 0x54, 0x19, 0x9C, 0x47, 0xD0, 0x8F, 0xFB, 0x10, 0xD4, 0xB8,
+};
+
+static void num_from_bytes(num_t * p_r, const uint8_t * p_bytes)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        uint64_t limb = 0;
+
+        for (int j = 0; j < 8; j++)
+        {
+            limb = (limb << 8) | p_bytes[((3 - i) * 8) + j];
+        }
+        p_r->v[i] = limb;
+    }
+}
+
+static void num_to_bytes(uint8_t * p_bytes, const num_t * p_a)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < 8; j++)
+        {
+            p_bytes[((3 - i) * 8) + j] = (uint8_t)(p_a->v[i] >> (56 - (8 * j)));
+        }
+    }
+}
+
+static bool num_is_zero(const num_t * p_a)
+{
+    return (0 == (p_a->v[0] | p_a->v[1] | p_a->v[2] | p_a->v[3]));
+}
+
+static int num_cmp(const num_t * p_a, const num_t * p_b)
+{
+    for (int i = 3; i >= 0; i--)
+    {
+        if (p_a->v[i] != p_b->v[i])
+        {
+            return (p_a->v[i] > p_b->v[i]) ? 1 : -1;
+        }
+    }
+
+    return 0;
+}
+
+static uint64_t num_add(num_t * p_r, const num_t * p_a, const num_t * p_b)
+{
+    unsigned __int128 carry = 0;
+
+    for (int i = 0; i < 4; i++)
+    {
+        carry += (unsigned __int128)p_a->v[i] + p_b->v[i];
+        p_r->v[i] = (uint64_t)carry;
+        carry >>= 64;
+    }
+
+    return (uint64_t)carry;
+}
+
+static uint64_t num_sub(num_t * p_r, const num_t * p_a, const num_t * p_b)
+{
+    uint64_t borrow = 0;
+
+    for (int i = 0; i < 4; i++)
+    {
+        uint64_t a = p_a->v[i];
+        uint64_t b = p_b->v[i];
+        uint64_t d = a - b - borrow;
+
+        borrow = (a < b) || ((a == b) && borrow);
+        p_r->v[i] = d;
+    }
+
+    return borrow;
+}
+
+static void mod_add(num_t * p_r, const num_t * p_a, const num_t * p_b, const modulus_t * p_mod)
+{
+    uint64_t carry = num_add(p_r, p_a, p_b);
+
+    if (carry || (num_cmp(p_r, &p_mod->m) >= 0))
+    {
+        num_sub(p_r, p_r, &p_mod->m);
+    }
+}
+
+static void mod_sub(num_t * p_r, const num_t * p_a, const num_t * p_b, const modulus_t * p_mod)
+{
+    if (num_sub(p_r, p_a, p_b))
+    {
+        num_add(p_r, p_r, &p_mod->m);
+    }
+}
+
+/*
+ * Reduce an 8 limb number, folding the limbs above 2^256 back in with 2^256 = c until none are left.
+ */
+static void mod_reduce(num_t * p_r, uint64_t wide[8], const modulus_t * p_mod)
+{
+    while (0 != (wide[4] | wide[5] | wide[6] | wide[7]))
+    {
+        uint64_t folded[8] = { wide[0], wide[1], wide[2], wide[3], 0, 0, 0, 0 };
+
+        for (int i = 0; i < 4; i++)
+        {
+            unsigned __int128 carry = 0;
+
+            for (int j = 0; j < 3; j++)
+            {
+                carry += ((unsigned __int128)wide[4 + i] * p_mod->c[j]) + folded[i + j];
+                folded[i + j] = (uint64_t)carry;
+                carry >>= 64;
+            }
+            for (int k = i + 3; (k < 8) && (0 != carry); k++)
+            {
+                carry += folded[k];
+                folded[k] = (uint64_t)carry;
+                carry >>= 64;
+            }
+        }
+        memcpy(wide, folded, sizeof(folded));
+    }
+
+    memcpy(p_r->v, wide, sizeof(p_r->v));
+    while (num_cmp(p_r, &p_mod->m) >= 0)
+    {
+        num_sub(p_r, p_r, &p_mod->m);
+    }
+}
+
+static void mod_mul(num_t * p_r, const num_t * p_a, const num_t * p_b, const modulus_t * p_mod)
+{
+    uint64_t wide[8] = { 0 };
+
+    for (int i = 0; i < 4; i++)
+    {
+        unsigned __int128 carry = 0;
+
+        for (int j = 0; j < 4; j++)
+        {
+            carry += ((unsigned __int128)p_a->v[i] * p_b->v[j]) + wide[i + j];
+            wide[i + j] = (uint64_t)carry;
+            carry >>= 64;
+        }
+        wide[i + 4] = (uint64_t)carry;
+    }
+
+    mod_reduce(p_r, wide, p_mod);
+}
+
+// Inverse by Fermat's little theorem, a^(m - 2)
+static void mod_inv(num_t * p_r, const num_t * p_a, const modulus_t * p_mod)
+{
+    num_t exponent = p_mod->m;
+    num_t two = {{ 2, 0, 0, 0 }};
+    num_t result = {{ 1, 0, 0, 0 }};
+
+    num_sub(&exponent, &exponent, &two);
+    for (int bit = 255; bit >= 0; bit--)
+    {
+        mod_mul(&result, &result, &result, p_mod);
+        if ((exponent.v[bit / 64] >> (bit % 64)) & 1)
+        {
+            mod_mul(&result, &result, p_a, p_mod);
+        }
+    }
+    *p_r = result;
+}
+
+static void point_double(point_t * p_r, const point_t * p_a)
+{
+    num_t a, b, c, d, e, f, t;
+
+    if (num_is_zero(&p_a->z) || num_is_zero(&p_a->y))
+    {
+        memset(p_r, 0, sizeof(*p_r));
+        return;
+    }
+
+    mod_mul(&a, &p_a->x, &p_a->x, &field);                  // A = X^2
+    mod_mul(&b, &p_a->y, &p_a->y, &field);                  // B = Y^2
+    mod_mul(&c, &b, &b, &field);                            // C = B^2
+    mod_add(&t, &p_a->x, &b, &field);                       // D = 2((X + B)^2 - A - C)
+    mod_mul(&t, &t, &t, &field);
+    mod_sub(&t, &t, &a, &field);
+    mod_sub(&t, &t, &c, &field);
+    mod_add(&d, &t, &t, &field);
+    mod_add(&e, &a, &a, &field);                            // E = 3A
+    mod_add(&e, &e, &a, &field);
+    mod_mul(&f, &e, &e, &field);                            // F = E^2
+
+    mod_mul(&t, &p_a->y, &p_a->z, &field);                  // Z3 = 2YZ
+    mod_add(&p_r->z, &t, &t, &field);
+    mod_sub(&p_r->x, &f, &d, &field);                       // X3 = F - 2D
+    mod_sub(&p_r->x, &p_r->x, &d, &field);
+    mod_sub(&t, &d, &p_r->x, &field);                       // Y3 = E(D - X3) - 8C
+    mod_mul(&t, &e, &t, &field);
+    mod_add(&c, &c, &c, &field);
+    mod_add(&c, &c, &c, &field);
+    mod_add(&c, &c, &c, &field);
+    mod_sub(&p_r->y, &t, &c, &field);
+}
+
+static void point_add(point_t * p_r, const point_t * p_a, const point_t * p_b)
+{
+    num_t z1z1, z2z2, u1, u2, s1, s2, h, hh, hhh, r, v, t;
+
+    if (num_is_zero(&p_a->z))
+    {
+        *p_r = *p_b;
+        return;
+    }
+    if (num_is_zero(&p_b->z))
+    {
+        *p_r = *p_a;
+        return;
+    }
+
+    mod_mul(&z1z1, &p_a->z, &p_a->z, &field);
+    mod_mul(&z2z2, &p_b->z, &p_b->z, &field);
+    mod_mul(&u1, &p_a->x, &z2z2, &field);                   // U1 = X1 Z2^2
+    mod_mul(&u2, &p_b->x, &z1z1, &field);                   // U2 = X2 Z1^2
+    mod_mul(&s1, &p_a->y, &p_b->z, &field);                 // S1 = Y1 Z2^3
+    mod_mul(&s1, &s1, &z2z2, &field);
+    mod_mul(&s2, &p_b->y, &p_a->z, &field);                 // S2 = Y2 Z1^3
+    mod_mul(&s2, &s2, &z1z1, &field);
+
+    if (0 == num_cmp(&u1, &u2))
+    {
+        if (0 == num_cmp(&s1, &s2))
+        {
+            point_double(p_r, p_a);
+        }
+        else
+        {
+            memset(p_r, 0, sizeof(*p_r));
+        }
+        return;
+    }
+
+    mod_sub(&h, &u2, &u1, &field);                          // H = U2 - U1
+    mod_sub(&r, &s2, &s1, &field);                          // R = S2 - S1
+    mod_mul(&hh, &h, &h, &field);
+    mod_mul(&hhh, &hh, &h, &field);
+    mod_mul(&v, &u1, &hh, &field);                          // V = U1 H^2
+
+    mod_mul(&t, &p_a->z, &p_b->z, &field);                  // Z3 = H Z1 Z2
+    mod_mul(&p_r->z, &t, &h, &field);
+    mod_mul(&t, &r, &r, &field);                            // X3 = R^2 - H^3 - 2V
+    mod_sub(&t, &t, &hhh, &field);
+    mod_sub(&t, &t, &v, &field);
+    mod_sub(&p_r->x, &t, &v, &field);
+    mod_sub(&t, &v, &p_r->x, &field);                       // Y3 = R(V - X3) - S1 H^3
+    mod_mul(&t, &r, &t, &field);
+    mod_mul(&s1, &s1, &hhh, &field);
+    mod_sub(&p_r->y, &t, &s1, &field);
+}
+
+// k * P, most significant bit first
+static void point_mul(point_t * p_r, const num_t * p_k, const point_t * p_p)
+{
+    point_t result;
+
+    memset(&result, 0, sizeof(result));
+    for (int bit = 255; bit >= 0; bit--)
+    {
+        point_double(&result, &result);
+        if ((p_k->v[bit / 64] >> (bit % 64)) & 1)
+        {
+            point_add(&result, &result, p_p);
+        }
+    }
+    *p_r = result;
+}
+
+static bool point_affine_x(num_t * p_x, num_t * p_y, const point_t * p_a)
+{
+    num_t zinv, zinv2;
+
+    if (num_is_zero(&p_a->z))
+    {
+        return false;
+    }
+
+    mod_inv(&zinv, &p_a->z, &field);
+    mod_mul(&zinv2, &zinv, &zinv, &field);
+    mod_mul(p_x, &p_a->x, &zinv2, &field);
+    if (NULL != p_y)
+    {
+        mod_mul(&zinv2, &zinv2, &zinv, &field);
+        mod_mul(p_y, &p_a->y, &zinv2, &field);
+    }
+
+    return true;
+}
+
+// Load an affine point, checking it is on the curve (y^2 = x^3 + 7)
+static bool point_from_bytes(point_t * p_r, const uint8_t * p_bytes)
+{
+    num_t lhs, rhs;
+    num_t seven = {{ 7, 0, 0, 0 }};
+
+    num_from_bytes(&p_r->x, p_bytes);
+    num_from_bytes(&p_r->y, p_bytes + 32);
+    memset(&p_r->z, 0, sizeof(p_r->z));
+    p_r->z.v[0] = 1;
+
+    if ((num_cmp(&p_r->x, &field.m) >= 0) || (num_cmp(&p_r->y, &field.m) >= 0))
+    {
+        return false;
+    }
+
+    mod_mul(&lhs, &p_r->y, &p_r->y, &field);
+    mod_mul(&rhs, &p_r->x, &p_r->x, &field);
+    mod_mul(&rhs, &rhs, &p_r->x, &field);
+    mod_add(&rhs, &rhs, &seven, &field);
+
+    return (0 == num_cmp(&lhs, &rhs));
+}
+
+// A scalar in [1, n - 1]
+static bool scalar_from_bytes(num_t * p_r, const uint8_t * p_bytes)
+{
+    num_from_bytes(p_r, p_bytes);
+
+    return (!num_is_zero(p_r)) && (num_cmp(p_r, &order.m) < 0);
+}
+
+// A digest as an integer mod n
+static void digest_from_bytes(num_t * p_r, const uint8_t * p_digest)
+{
+    num_from_bytes(p_r, p_digest);
+    if (num_cmp(p_r, &order.m) >= 0)
+    {
+        num_sub(p_r, p_r, &order.m);
+    }
+}
+
+/*
+ * secp256k1_public_key()
+ *
+ * The public key (x, y) of a private key.
+ *
+ *  */
+bool secp256k1_public_key(const uint8_t * p_private_key, uint8_t * p_public_key)
+{
+    point_t g, q;
+    num_t   d, x, y;
+
+    if ((!scalar_from_bytes(&d, p_private_key)) || (!point_from_bytes(&g, secp256k1_generator)))
+    {
+        return false;
+    }
+
+    point_mul(&q, &d, &g);
+    if (!point_affine_x(&x, &y, &q))
+    {
+        return false;
+    }
+    num_to_bytes(p_public_key, &x);
+    num_to_bytes(p_public_key + 32, &y);
+
+    return true;
+}
+
+/*
+ * secp256k1_sign()
+ *
+ * Sign a digest. The nonce is derived from the private key and the digest (SHA256 of both and a counter), so the
+ * same digest always gives the same signature.
+ *
+ *  */
+bool secp256k1_sign(const uint8_t * p_private_key, const uint8_t * p_digest, uint8_t * p_signature)
+{
+    point_t g, kg;
+    num_t   d, z, k, r, s, t;
+    uint8_t seed[(2 * SECP256K1_KEY_SIZE) + 1];
+    uint8_t nonce[SECP256K1_KEY_SIZE];
+
+    if ((!scalar_from_bytes(&d, p_private_key)) || (!point_from_bytes(&g, secp256k1_generator)))
+    {
+        return false;
+    }
+    digest_from_bytes(&z, p_digest);
+
+    memcpy(seed, p_private_key, SECP256K1_KEY_SIZE);
+    memcpy(seed + SECP256K1_KEY_SIZE, p_digest, SECP256K1_KEY_SIZE);
+    for (seed[2 * SECP256K1_KEY_SIZE] = 0; ; seed[2 * SECP256K1_KEY_SIZE]++)
+    {
+        if (SSP_SUCCESS != sha256_hash(&g_hash_software, seed, sizeof(seed), nonce))
+        {
+            return false;
+        }
+        if (!scalar_from_bytes(&k, nonce))
+        {
+            continue;
+        }
+
+        point_mul(&kg, &k, &g);                             // r = (kG).x mod n
+        if (!point_affine_x(&r, NULL, &kg))
+        {
+            continue;
+        }
+        if (num_cmp(&r, &order.m) >= 0)
+        {
+            num_sub(&r, &r, &order.m);
+        }
+        if (num_is_zero(&r))
+        {
+            continue;
+        }
+
+        mod_mul(&t, &r, &d, &order);                        // s = (z + r d) / k mod n
+        mod_add(&t, &t, &z, &order);
+        mod_inv(&s, &k, &order);
+        mod_mul(&s, &s, &t, &order);
+        if (!num_is_zero(&s))
+        {
+            break;
+        }
+    }
+
+    num_to_bytes(p_signature, &r);
+    num_to_bytes(p_signature + 32, &s);
+
+    return true;
+}
+
+/*
+ * secp256k1_verify()
+ *
+ * Check a signature of a digest against a public key.
+ *
+ *  */
+bool secp256k1_verify(const uint8_t * p_public_key, const uint8_t * p_digest, const uint8_t * p_signature)
+{
+    point_t g, q, p1, p2;
+    num_t   r, s, z, w, u1, u2, x;
+
+    if ((!scalar_from_bytes(&r, p_signature)) || (!scalar_from_bytes(&s, p_signature + 32)) ||
+        (!point_from_bytes(&q, p_public_key)) || (!point_from_bytes(&g, secp256k1_generator)))
+    {
+        return false;
+    }
+    digest_from_bytes(&z, p_digest);
+
+    mod_inv(&w, &s, &order);                                // R = (z / s) G + (r / s) Q
+    mod_mul(&u1, &z, &w, &order);
+    mod_mul(&u2, &r, &w, &order);
+    point_mul(&p1, &u1, &g);
+    point_mul(&p2, &u2, &q);
+    point_add(&p1, &p1, &p2);
+    if (!point_affine_x(&x, NULL, &p1))
+    {
+        return false;
+    }
+    if (num_cmp(&x, &order.m) >= 0)
+    {
+        num_sub(&x, &x, &order.m);
+    }
+
+    return (0 == num_cmp(&x, &r));
+}
@@ -0,0 +1,29 @@
+/*
+ * secp256k1.h
+ *
+ * ECDSA on the secp256k1 curve, for the host build: verifies signatures in place of the SCE (sim_sce.c) and signs
+ * the test images (image.c).
+ * All values are big endian byte arrays, as passed to the SCE: a public key is x followed by y (64 bytes), a
+ * signature r followed by s (64 bytes) and the message is the 32 byte SHA256 digest.
+ * Written for clarity, not speed or resistance to side channels; do not use it for real keys.
+ */
+
+#ifndef SECP256K1_H_
+#define SECP256K1_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SECP256K1_KEY_SIZE          32
+#define SECP256K1_PUBLIC_KEY_SIZE   64
+#define SECP256K1_SIGNATURE_SIZE    64
+
+// Domain parameters in the SCE layout (a, b, p, n then the generator x, y)
+extern const uint8_t secp256k1_domain[128];
+extern const uint8_t secp256k1_generator[64];
+
+bool secp256k1_public_key(const uint8_t * p_private_key, uint8_t * p_public_key);
+bool secp256k1_sign(const uint8_t * p_private_key, const uint8_t * p_digest, uint8_t * p_signature);
+bool secp256k1_verify(const uint8_t * p_public_key, const uint8_t * p_digest, const uint8_t * p_signature);
+
+#endif /* SECP256K1_H_ */
@@ -0,0 +1,494 @@
+/*
+ * sim.c
+ *
+ * Host simulation of the S5D9: memory map, boots in child processes, simulated time and the CMSIS core functions
+ * the bootloader uses. See sim.h.
+ */
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <signal.h>
+#include <unistd.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE         0x100000
+#endif
+
+// System control space, for the VTOR write in boot_application()
+#define SIM_SCS_START               (0xE000E000)
+#define SIM_SCS_SIZE                (0x1000)
+#define SIM_VTOR_ADDRESS            (0xE000ED08)
+
+// A boot that makes no driver call for two watchdog periods is stopped (while(1) in boot())
+#define SIM_WATCHDOG_PERIOD_MS      (250)
+
+uint32_t        SystemCoreClock = SIM_CORE_CLOCK_HZ;
+CoreDebug_Type  sim_core_debug;
+DWT_Type        sim_dwt;
+R_SPMON_Type    sim_spmon;
+
+sim_shared_t *  sim_shared;
+
+// State of the boot running in this (child) process
+static uint64_t             sim_time_ns;
+static uint32_t             sim_primask;
+static uint32_t             sim_msp;
+static volatile uint32_t    sim_progress;
+static uint32_t             sim_watchdog_progress;
+
+// The bootloader passes the addresses of RAM buffers as uint32_t, so a boot runs on a stack below 4 GB (the host
+// build is linked -no-pie, so this is too)
+static uint8_t              sim_boot_stack[512 * 1024] __attribute__((aligned(16)));
+
+void hal_entry(void);
+void __real_boot_timing_add(boot_phase_t phase, uint32_t start_cycles, uint32_t bytes);
+
+/*
+ * sim_map()
+ *
+ * Map size bytes at address, failing if anything is already there.
+ *
+ *  */
+static void sim_map(uint32_t address, uint32_t size, int flags)
+{
+    void * p = mmap((void *)(uintptr_t)address, size, PROT_READ | PROT_WRITE | PROT_EXEC, flags | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+    if (p != (void *)(uintptr_t)address)
+    {
+        fprintf(stderr, "sim: cannot map 0x%08X (%u bytes)\n", address, size);
+        exit(2);
+    }
+}
+
+/*
+ * sim_latency_default()
+ *
+ * Typical figures from the data sheets: S5D9 flash at FCLK 60 MHz, W25Q64FV at quad I/O 60 MHz, SCE7. Software
+ * SHA256 is about 30 cycles per byte at 120 MHz.
+ *
+ *  */
+sim_latency_t sim_latency_default(void)
+{
+    sim_latency_t latency = {
+        .driver_open_ns             = 20000,
+        .poll_ns                    = 1000,
+        .code_flash_erase_ns        = 220000000,
+        .code_flash_program_ns      = 500000,
+        .code_flash_blank_check_ns  = 4,
+        .code_flash_read_ns         = 4,
+        .data_flash_erase_ns        = 10000000,
+        .data_flash_program_ns      = 50000,
+        .data_flash_blank_check_ns  = 60,
+        .qspi_erase_ns              = 120000000,
+        .qspi_sector_erase_ns       = 45000000,
+        .qspi_program_ns            = 700000,
+        .qspi_read_ns               = 40,
+        .hash_ns                    = 5,
+        .software_hash_ns           = 250,
+        .ecc_verify_ns              = 5000000,
+        .compare_ns                 = 2,
+        .crc_ns                     = 60,
+    };
+
+    return latency;
+}
+
+/*
+ * sim_init()
+ *
+ * Map the flash areas and the shared state, and erase all flash. Called once by the test program.
+ *
+ *  */
+void sim_init(void)
+{
+    sim_shared = mmap(NULL, sizeof(sim_shared_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == sim_shared)
+    {
+        perror("sim: mmap");
+        exit(2);
+    }
+
+    sim_map(SIM_CODE_FLASH_START, SIM_CODE_FLASH_SIZE, MAP_SHARED);
+    sim_map(DATA_FLASH_START_ADDRESS, DATA_FLASH_SIZE, MAP_SHARED);
+    sim_map(SIM_QSPI_START, SIM_QSPI_SIZE, MAP_SHARED);
+    sim_map(SIM_SCS_START, SIM_SCS_SIZE, MAP_PRIVATE);
+
+    sim_shared->latency = sim_latency_default();
+    sim_shared->power_cut_after_ops = -1;
+    sim_shared->data_flash_seed = 1;
+    sim_erase_all();
+}
+
+/*
+ * sim_erase_all()
+ *
+ * Erase all the code flash (but the bootloader), data flash and QSPI flash, as a new device.
+ *
+ *  */
+void sim_erase_all(void)
+{
+    memset((void *)SIM_CODE_FLASH_START, ERASED_STATE, SIM_CODE_FLASH_SIZE);
+    memset((void *)SIM_QSPI_START, ERASED_STATE, SIM_QSPI_SIZE);
+    for (uint32_t address = DATA_FLASH_START_ADDRESS; address < (DATA_FLASH_START_ADDRESS + DATA_FLASH_SIZE); address += DATA_FLASH_ERASE_BLOCK_SIZE)
+    {
+        sim_data_flash_erase(address, DATA_FLASH_ERASE_BLOCK_SIZE);
+    }
+}
+
+/*
+ * sim_now(), sim_advance()
+ *
+ * The simulated time of this boot, and advancing it. The DWT cycle counter runs with it once enabled.
+ *
+ *  */
+uint64_t sim_now(void)
+{
+    return sim_time_ns;
+}
+
+void sim_advance(uint64_t ns)
+{
+    uint64_t cycles_before = (sim_time_ns * (SystemCoreClock / 1000000)) / 1000;
+
+    sim_time_ns += ns;
+    if (sim_dwt.CTRL & DWT_CTRL_CYCCNTENA_Msk)
+    {
+        sim_dwt.CYCCNT += (uint32_t)(((sim_time_ns * (SystemCoreClock / 1000000)) / 1000) - cycles_before);
+    }
+    sim_progress++;
+}
+
+/*
+ * sim_finish()
+ *
+ * End the boot running in this process.
+ *
+ *  */
+static void __attribute__((noreturn)) sim_finish(sim_outcome_t outcome)
+{
+    sim_shared->time_ns = sim_time_ns;
+    _exit(outcome);
+}
+
+/*
+ * sim_fault()
+ *
+ * A driver has been used in a way the device would not accept (or the bootloader should not do), end the boot.
+ *
+ *  */
+void sim_fault(const char * p_format, ...)
+{
+    va_list args;
+
+    va_start(args, p_format);
+    vsnprintf(sim_shared->fault, sizeof(sim_shared->fault), p_format, args);
+    va_end(args);
+
+    sim_finish(SIM_OUTCOME_FAULT);
+}
+
+/*
+ * sim_flash_op()
+ *
+ * Count an erase or program operation about to start. Returns true if the power is to be cut during it, the caller
+ * then does part of the operation and calls sim_power_cut().
+ *
+ *  */
+bool sim_flash_op(void)
+{
+    return ((int32_t)(sim_shared->stats.flash_ops++) == sim_shared->power_cut_after_ops);
+}
+
+void sim_power_cut(void)
+{
+    sim_finish(SIM_OUTCOME_POWER_CUT);
+}
+
+/*
+ * sim_app_entry()
+ *
+ * Reset handler of every test image: the application has been started. Takes the boot timing record the way
+ * PK_S5D9_BL_Blinky does (boot_timing_read()).
+ *
+ *  */
+int sim_app_entry(void)
+{
+    const boot_timing_record_t * p_record = (const boot_timing_record_t *)BOOT_TIMING_RECORD_ADDRESS;
+    const uint32_t *             p_word = (const uint32_t *)p_record;
+    uint32_t                     sum = 0;
+
+    for (uint32_t i = 0; i < (offsetof(boot_timing_record_t, check) / 4); i++)
+    {
+        sum += p_word[i];
+    }
+
+    sim_shared->record_valid = ((BOOT_TIMING_RECORD_MAGIC == p_record->magic) &&
+                                (BOOT_TIMING_RECORD_FORMAT == p_record->format) &&
+                                (BOOT_PHASE_COUNT == p_record->phase_count) &&
+                                (p_record->check == ~sum));
+    sim_shared->record = *p_record;
+    sim_shared->booted_image = *(volatile uint32_t *)SIM_VTOR_ADDRESS - IMAGE_HEADER_SIZE;
+    sim_shared->booted_stack = sim_msp;
+
+    if (0 == sim_primask)
+    {
+        sim_fault("application started with interrupts enabled");
+    }
+
+    sim_finish(SIM_OUTCOME_BOOTED);
+}
+
+/*
+ * Test_bootloader_main()
+ *
+ * Called by hal_entry() when built with _BL_TESTING, once the drivers are open.
+ *
+ *  */
+int Test_bootloader_main(void)
+{
+    boot();
+
+    return 0;
+}
+
+/*
+ * I/O port and UART, opened by hal_entry() before Test_bootloader_main() (the UART is not used)
+ *
+ *  */
+static ssp_err_t sim_ioport_pin_cfg(ioport_port_pin_t pin, uint32_t cfg)
+{
+    (void)pin;
+    (void)cfg;
+
+    return SSP_SUCCESS;
+}
+
+static ssp_err_t sim_uart_open(uart_ctrl_t * const p_ctrl, uart_cfg_t const * const p_cfg)
+{
+    (void)p_ctrl;
+    (void)p_cfg;
+
+    return SSP_SUCCESS;
+}
+
+static const ioport_api_t   sim_ioport_api = { .pinCfg = sim_ioport_pin_cfg };
+static const uart_api_t     sim_uart_api = { .open = sim_uart_open };
+static const uart_cfg_t     sim_uart_cfg = { .baud_rate = 115200 };
+const ioport_instance_t     g_ioport = { .p_api = &sim_ioport_api };
+const uart_instance_t       g_uart0 = { .p_ctrl = NULL, .p_cfg = &sim_uart_cfg, .p_api = &sim_uart_api };
+
+/*
+ * __wrap_boot_timing_add()
+ *
+ * boot_timing_add() as seen by the bootloader (the host build links with --wrap=boot_timing_add). Charges the CPU
+ * time of the phases that read memory mapped flash with the CPU before the phase is recorded:
+ * - BOOT_PHASE_BLANK_CHECK - bytes not checked by the flash driver (memory mapped QSPI)
+ * - BOOT_PHASE_HASH        - bytes not hashed by the SCE (the software backend)
+ * - BOOT_PHASE_COMPARE     - comparing a main image block with its update
+ * - BOOT_PHASE_CRC         - the table driven CRC
+ *
+ *  */
+void __wrap_boot_timing_add(boot_phase_t phase, uint32_t start_cycles, uint32_t bytes)
+{
+    sim_latency_t * p_latency = &sim_shared->latency;
+
+    switch (phase)
+    {
+        case BOOT_PHASE_BLANK_CHECK:
+        {
+            uint32_t driver_bytes = sim_flash_blank_check_bytes_take();
+            if (bytes > driver_bytes)
+            {
+                sim_advance((uint64_t)(bytes - driver_bytes) * p_latency->qspi_read_ns);
+            }
+            break;
+        }
+
+        case BOOT_PHASE_HASH:
+        {
+            uint32_t sce_bytes = sim_sce_hash_bytes_take();
+            if (bytes > sce_bytes)
+            {
+                sim_advance((uint64_t)(bytes - sce_bytes) * p_latency->software_hash_ns);
+            }
+            break;
+        }
+
+        case BOOT_PHASE_COMPARE:
+            sim_advance((uint64_t)bytes * (p_latency->compare_ns + p_latency->code_flash_read_ns));
+            break;
+
+        case BOOT_PHASE_CRC:
+            sim_advance((uint64_t)bytes * p_latency->crc_ns);
+            break;
+
+        default:
+            break;
+    }
+
+    __real_boot_timing_add(phase, start_cycles, bytes);
+}
+
+/*
+ * CMSIS core
+ *
+ *  */
+void sim_system_reset(void)
+{
+    sim_finish(SIM_OUTCOME_RESET);
+}
+
+void sim_breakpoint(int value)
+{
+    sim_fault("breakpoint %d", value);
+}
+
+void sim_idle(void)
+{
+    // Only reached once boot() has returned, which it should never do
+    sim_finish(SIM_OUTCOME_HUNG);
+}
+
+void __disable_irq(void)
+{
+    sim_primask = 1;
+}
+
+void __enable_irq(void)
+{
+    sim_primask = 0;
+}
+
+uint32_t __get_PRIMASK(void)
+{
+    return sim_primask;
+}
+
+void __set_PRIMASK(uint32_t primask)
+{
+    sim_primask = primask;
+}
+
+void __set_MSP(uint32_t top_of_main_stack)
+{
+    sim_msp = top_of_main_stack;
+}
+
+/*
+ * sim_watchdog()
+ *
+ * SIGALRM handler, stops a boot that has not called a driver for a whole period.
+ *
+ *  */
+static void sim_watchdog(int signal_number)
+{
+    (void)signal_number;
+
+    if (sim_progress == sim_watchdog_progress)
+    {
+        sim_finish(SIM_OUTCOME_HUNG);
+    }
+    sim_watchdog_progress = sim_progress;
+}
+
+static void sim_boot_entry(void)
+{
+    hal_entry();
+
+    sim_finish(SIM_OUTCOME_HUNG);
+}
+
+/*
+ * sim_boot()
+ *
+ * Power on (or reset) the device and run the bootloader until it starts an application or stops.
+ *
+ * RETURNS:
+ * - The outcome of the boot, the rest of the results are in sim_shared
+ *
+ *  */
+sim_outcome_t sim_boot(void)
+{
+    int     status;
+    pid_t   pid;
+
+    sim_shared->outcome = SIM_OUTCOME_FAULT;
+    sim_shared->booted_image = 0;
+    sim_shared->booted_stack = 0;
+    sim_shared->time_ns = 0;
+    sim_shared->record_valid = false;
+    sim_shared->fault[0] = 0;
+    memset(&sim_shared->stats, 0, sizeof(sim_shared->stats));
+    memset(&sim_shared->record, 0, sizeof(sim_shared->record));
+
+    fflush(NULL);
+    pid = fork();
+    if (pid < 0)
+    {
+        perror("sim: fork");
+        exit(2);
+    }
+
+    if (0 == pid)
+    {
+        static ucontext_t   boot_context;
+        struct itimerval    watchdog = { { 0, SIM_WATCHDOG_PERIOD_MS * 1000 }, { 0, SIM_WATCHDOG_PERIOD_MS * 1000 } };
+
+        // Power on: the core starts afresh (the test program's own hashing of test images advanced its time)
+        sim_time_ns = 0;
+        sim_primask = 0;
+        sim_msp = 0;
+        memset(&sim_core_debug, 0, sizeof(sim_core_debug));
+        memset(&sim_dwt, 0, sizeof(sim_dwt));
+        sim_flash_reset();
+        sim_sce_reset();
+        signal(SIGALRM, sim_watchdog);
+        setitimer(ITIMER_REAL, &watchdog, NULL);
+
+        getcontext(&boot_context);
+        boot_context.uc_stack.ss_sp = sim_boot_stack;
+        boot_context.uc_stack.ss_size = sizeof(sim_boot_stack);
+        boot_context.uc_link = NULL;
+        makecontext(&boot_context, sim_boot_entry, 0);
+        setcontext(&boot_context);
+        _exit(SIM_OUTCOME_FAULT);
+    }
+
+    if (waitpid(pid, &status, 0) != pid)
+    {
+        perror("sim: waitpid");
+        exit(2);
+    }
+
+    if (WIFEXITED(status) && (WEXITSTATUS(status) >= SIM_OUTCOME_BOOTED) && (WEXITSTATUS(status) <= SIM_OUTCOME_FAULT))
+    {
+        sim_shared->outcome = (sim_outcome_t)WEXITSTATUS(status);
+    }
+    else if (WIFSIGNALED(status))
+    {
+        snprintf(sim_shared->fault, sizeof(sim_shared->fault), "boot ended by signal %d", WTERMSIG(status));
+    }
+    else
+    {
+        snprintf(sim_shared->fault, sizeof(sim_shared->fault), "boot exited with status %d", WEXITSTATUS(status));
+    }
+
+    return sim_shared->outcome;
+}
+
+const char * sim_outcome_name(sim_outcome_t outcome)
+{
+    switch (outcome)
+    {
+        case SIM_OUTCOME_BOOTED:    return "booted";
+        case SIM_OUTCOME_RESET:     return "reset";
+        case SIM_OUTCOME_HUNG:      return "hung";
+        case SIM_OUTCOME_POWER_CUT: return "power cut";
+        default:                    return "fault";
+    }
+}
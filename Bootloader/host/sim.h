@@ -0,0 +1,131 @@
+/*
+ * sim.h
+ *
+ * Host simulation of the S5D9 (PK-S5D9 board) the bootloader runs on, for the host build in this folder.
+ *
+ * The bootloader sources are built unchanged with _BL_TESTING, which makes them use the test driver APIs
+ * (g_flash_on_flash_hp_test, g_qspi_on_qspi_test, g_hash_on_sce_test, g_ecc_on_sce_test) implemented by
+ * sim_flash.c and sim_sce.c. The flash areas are mapped at their device addresses:
+ *   Code flash     - SIM_CODE_FLASH_START to TOTAL_INTERNAL_FLASH_SIZE (the bootloader's own 64 KB is not mapped)
+ *   Data flash     - DATA_FLASH_START_ADDRESS, DATA_FLASH_SIZE
+ *   QSPI flash     - SIM_QSPI_START, SIM_QSPI_SIZE (memory mapped, as the bootloader reads it)
+ * and are shared between the test program and each boot, so they keep their contents across boots as the device
+ * flash does.
+ *
+ * Each boot (sim_boot()) runs in a child process from hal_entry(), so RAM starts afresh as after a reset, and ends
+ * with one of the sim_outcome_t outcomes. A boot can be cut short after a number of flash operations (a power cut),
+ * leaving the operation in progress half done.
+ *
+ * Time is modelled, not measured: every driver operation advances the simulated time by the latency set in
+ * sim_latency_t, and the DWT cycle counter the bootloader times its phases with (boot_timing.c) counts
+ * SystemCoreClock cycles of simulated time. CPU reads of memory mapped flash (blank checks of the QSPI area, block
+ * compares and CRCs) and software hashing cannot be seen by the simulation, they are charged per byte when the phase is
+ * added to the boot timing record (see __wrap_boot_timing_add() in sim.c).
+ */
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#include "bootloader.h"
+
+#define SIM_CODE_FLASH_START        (MAIN_IMAGE_START_ADDRESS)
+#define SIM_CODE_FLASH_SIZE         (TOTAL_INTERNAL_FLASH_SIZE - SIM_CODE_FLASH_START)
+#define SIM_QSPI_START              (0x60000000)
+#define SIM_QSPI_SIZE               (8 * 1024 * 1024)
+
+// Core clock of the simulated device (the DWT counts cycles of this clock)
+#define SIM_CORE_CLOCK_HZ           (120000000)
+
+/*
+ * Latency model. Defaults (sim_latency_default()) are typical figures from the S5D9 and W25Q64FV data sheets; set
+ * sim_shared->latency before a boot to model other parts.
+ */
+typedef struct sim_latency {
+    uint32_t driver_open_ns;                // Opening or closing a driver
+    uint32_t poll_ns;                       // One status poll (flash, QSPI or DTC)
+    uint32_t code_flash_erase_ns;           // Erasing a 32 KB code flash block
+    uint32_t code_flash_program_ns;         // Programming 128 bytes of code flash
+    uint32_t code_flash_blank_check_ns;     // Per byte, flash_hp blank check of code flash
+    uint32_t code_flash_read_ns;            // Per byte, CPU reads of code flash
+    uint32_t data_flash_erase_ns;           // Erasing a 64 byte data flash block
+    uint32_t data_flash_program_ns;         // Programming 4 bytes of data flash
+    uint32_t data_flash_blank_check_ns;     // Per byte, flash_hp blank check of data flash
+    uint32_t qspi_erase_ns;                 // Erasing a 32 KB QSPI block
+    uint32_t qspi_sector_erase_ns;          // Erasing a 4 KB QSPI sector
+    uint32_t qspi_program_ns;               // Programming a 256 byte QSPI page
+    uint32_t qspi_read_ns;                  // Per byte, memory mapped QSPI reads (CPU or DTC)
+    uint32_t hash_ns;                       // Per byte, SCE SHA256 (plus reading the data from where it is)
+    uint32_t software_hash_ns;              // Per byte, software SHA256 (sha256_sw.c)
+    uint32_t ecc_verify_ns;                 // One SCE ECDSA verify
+    uint32_t compare_ns;                    // Per byte, comparing a main image block (plus reading it)
+    uint32_t crc_ns;                        // Per byte, table driven CRC-32 (including its reads)
+} sim_latency_t;
+
+typedef enum e_sim_outcome {
+    SIM_OUTCOME_BOOTED = 1,     // Jumped to an application image
+    SIM_OUTCOME_RESET,          // NVIC_SystemReset()
+    SIM_OUTCOME_HUNG,           // Stopped (while(1), or waited too long for hardware)
+    SIM_OUTCOME_POWER_CUT,      // Cut short by sim_shared->power_cut_after_ops
+    SIM_OUTCOME_FAULT,          // A driver was misused (see sim_shared->fault) or the boot crashed
+} sim_outcome_t;
+
+// Driver operation counts of a boot
+typedef struct sim_stats {
+    uint32_t code_flash_blocks_erased;
+    uint32_t code_flash_bytes_programmed;
+    uint32_t data_flash_blocks_erased;
+    uint32_t data_flash_bytes_programmed;
+    uint32_t qspi_blocks_erased;
+    uint32_t qspi_bytes_programmed;
+    uint32_t blank_check_bytes;
+    uint32_t hash_calls;
+    uint32_t hash_bytes;
+    uint32_t ecc_verifies;
+    uint32_t dtc_blocks;
+    uint32_t flash_ops;             // Erase and program operations (what a power cut can interrupt)
+} sim_stats_t;
+
+// State shared by the test program and the boots it runs
+typedef struct sim_shared {
+    sim_latency_t           latency;
+    int32_t                 power_cut_after_ops;    // Cut the power during this erase/program operation (-1 never)
+    uint32_t                data_flash_seed;        // Seed for the values erased data flash reads as
+    bool                    sce_hash_fails;         // The SCE hash driver fails to open (as if not available)
+    // Results of the last boot
+    sim_outcome_t           outcome;
+    uint32_t                booted_image;           // Image address the application was started from (VTOR)
+    uint32_t                booted_stack;           // Stack pointer set for the application
+    uint64_t                time_ns;                // Simulated time from hal_entry() to the end of the boot
+    sim_stats_t             stats;
+    bool                    record_valid;           // record holds a complete boot timing record
+    boot_timing_record_t    record;                 // The record as the application found it
+    char                    fault[160];             // First driver misuse, if any
+    uint8_t                 data_flash_erased[DATA_FLASH_SIZE];    // Non-zero for each erased data flash byte
+} sim_shared_t;
+
+extern sim_shared_t * sim_shared;
+
+// sim.c
+void            sim_init(void);
+void            sim_erase_all(void);
+sim_latency_t   sim_latency_default(void);
+sim_outcome_t   sim_boot(void);
+const char *    sim_outcome_name(sim_outcome_t outcome);
+void            sim_advance(uint64_t ns);
+uint64_t        sim_now(void);
+void            sim_fault(const char * p_format, ...) __attribute__((format(printf, 1, 2), noreturn));
+bool            sim_flash_op(void);
+void            sim_power_cut(void) __attribute__((noreturn));
+int             sim_app_entry(void);
+
+// sim_flash.c
+void            sim_flash_reset(void);
+uint64_t        sim_read_ns(uint32_t address, uint32_t length);
+void            sim_data_flash_erase(uint32_t address, uint32_t length);
+uint32_t        sim_flash_blank_check_bytes_take(void);
+
+// sim_sce.c
+void            sim_sce_reset(void);
+uint32_t        sim_sce_hash_bytes_take(void);
+
+#endif /* SIM_H_ */
@@ -0,0 +1,740 @@
+/*
+ * sim_flash.c
+ *
+ * Simulated storage drivers: flash_hp (code and data flash), QSPI (W25Q64FV) and the DTC used to read the QSPI
+ * flash, with the g_flash, g_qspi and g_transfer_qspi instances and the test APIs port.c uses when built with
+ * _BL_TESTING (g_flash_on_flash_hp_test, g_qspi_on_qspi_test).
+ *
+ * Each driver checks its arguments as the device would (alignment, programming only erased flash, one operation at a
+ * time) and ends the boot with sim_fault() if they are wrong.
+ * Code flash operations are blocking and take their full time. Data flash operations run in the background (Data
+ * Flash Background Operation): the callback is made before the call returns, and the time the operation takes is
+ * charged to the next flash driver call that has to wait for it, so work done meanwhile (e.g. hashing) overlaps it.
+ */
+#include "sim.h"
+
+// Bytes moved by one DTC block, as configured for g_transfer_qspi (256 words)
+#define SIM_DTC_BLOCK_SIZE      (1024)
+
+static bool                 flash_open;
+static flash_cfg_t const *  flash_cfg;
+static uint64_t             flash_busy_until;
+static uint32_t             flash_blank_check_bytes;
+
+static bool                 qspi_open;
+static uint64_t             qspi_busy_until;
+
+static bool                 dtc_open;
+static bool                 dtc_pending;
+static uint64_t             dtc_done_at;
+static const uint8_t *      dtc_src;
+static uint8_t *            dtc_dest;
+static uint32_t             dtc_length;
+
+static bool is_code_flash(uint32_t address, uint32_t length)
+{
+    return ((address >= SIM_CODE_FLASH_START) && (address < TOTAL_INTERNAL_FLASH_SIZE) &&
+            (length <= (TOTAL_INTERNAL_FLASH_SIZE - address)));
+}
+
+static bool is_data_flash(uint32_t address, uint32_t length)
+{
+    return ((address >= DATA_FLASH_START_ADDRESS) && (address < (DATA_FLASH_START_ADDRESS + DATA_FLASH_SIZE)) &&
+            (length <= ((DATA_FLASH_START_ADDRESS + DATA_FLASH_SIZE) - address)));
+}
+
+static bool is_qspi(uint32_t address, uint32_t length)
+{
+    return ((address >= SIM_QSPI_START) && (address < (SIM_QSPI_START + SIM_QSPI_SIZE)) &&
+            (length <= ((SIM_QSPI_START + SIM_QSPI_SIZE) - address)));
+}
+
+/*
+ * sim_read_ns()
+ *
+ * Time for the CPU (or DTC) to read length bytes at address.
+ *
+ *  */
+uint64_t sim_read_ns(uint32_t address, uint32_t length)
+{
+    if (is_qspi(address, length))
+    {
+        return (uint64_t)length * sim_shared->latency.qspi_read_ns;
+    }
+    if (is_code_flash(address, length))
+    {
+        return (uint64_t)length * sim_shared->latency.code_flash_read_ns;
+    }
+
+    return 0;
+}
+
+/*
+ * sim_flash_reset()
+ *
+ * Reset the drivers, at the start of a boot.
+ *
+ *  */
+void sim_flash_reset(void)
+{
+    flash_open = false;
+    flash_cfg = NULL;
+    flash_busy_until = 0;
+    flash_blank_check_bytes = 0;
+    qspi_open = false;
+    qspi_busy_until = 0;
+    dtc_open = false;
+    dtc_pending = false;
+}
+
+/*
+ * sim_data_flash_erase()
+ *
+ * Erase data flash. Erased data flash does not read as a fixed value, it is filled with pseudo random values (from
+ * sim_shared->data_flash_seed) and marked as erased for the blank check.
+ *
+ *  */
+void sim_data_flash_erase(uint32_t address, uint32_t length)
+{
+    uint8_t * p_data = (uint8_t *)(uintptr_t)address;
+    uint32_t  seed = sim_shared->data_flash_seed;
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        seed = (seed * 1103515245U) + 12345U;
+        p_data[i] = (uint8_t)(seed >> 16);
+    }
+    sim_shared->data_flash_seed = seed;
+
+    memset(&sim_shared->data_flash_erased[address - DATA_FLASH_START_ADDRESS], 1, length);
+}
+
+/*
+ * sim_flash_blank_check_bytes_take()
+ *
+ * Bytes blank checked by the flash driver since the last call (see __wrap_boot_timing_add()).
+ *
+ *  */
+uint32_t sim_flash_blank_check_bytes_take(void)
+{
+    uint32_t bytes = flash_blank_check_bytes;
+
+    flash_blank_check_bytes = 0;
+
+    return bytes;
+}
+
+/*
+ * flash_wait()
+ *
+ * The flash sequencer does one operation at a time, wait for a background data flash operation to end.
+ *
+ *  */
+static void flash_wait(void)
+{
+    if (sim_now() < flash_busy_until)
+    {
+        sim_advance(flash_busy_until - sim_now());
+    }
+}
+
+static void flash_callback(flash_event_t event)
+{
+    flash_callback_args_t args = { .event = event, .p_context = flash_cfg->p_context };
+
+    if (NULL == flash_cfg->p_callback)
+    {
+        sim_fault("flash: background operation without a callback");
+    }
+    flash_cfg->p_callback(&args);
+}
+
+static ssp_err_t flash_open_api(flash_ctrl_t * const p_ctrl, flash_cfg_t const * const p_cfg)
+{
+    (void)p_ctrl;
+
+    if (flash_open)
+    {
+        return SSP_ERR_IN_USE;
+    }
+
+    sim_advance(sim_shared->latency.driver_open_ns);
+    flash_open = true;
+    flash_cfg = p_cfg;
+
+    return SSP_SUCCESS;
+}
+
+static ssp_err_t flash_close_api(flash_ctrl_t * const p_ctrl)
+{
+    (void)p_ctrl;
+
+    if (!flash_open)
+    {
+        return SSP_ERR_NOT_OPEN;
+    }
+
+    flash_wait();
+    sim_advance(sim_shared->latency.driver_open_ns);
+    flash_open = false;
+
+    return SSP_SUCCESS;
+}
+
+static ssp_err_t flash_write_api(flash_ctrl_t * const p_ctrl, uint32_t const src_address, uint32_t const flash_address, uint32_t const num_bytes)
+{
+    sim_latency_t * p_latency = &sim_shared->latency;
+    uint8_t *       p_dest = (uint8_t *)(uintptr_t)flash_address;
+    uint32_t        length = num_bytes;
+
+    (void)p_ctrl;
+
+    if (!flash_open)
+    {
+        return SSP_ERR_NOT_OPEN;
+    }
+
+    flash_wait();
+
+    if (is_code_flash(flash_address, num_bytes))
+    {
+        if ((0 != (flash_address % MAIN_FLASH_PROGRAMMING_PAGE_SIZE)) || (0 != (num_bytes % MAIN_FLASH_PROGRAMMING_PAGE_SIZE)))
+        {
+            sim_fault("flash: code flash write of %u bytes at 0x%08X is not in whole pages", num_bytes, flash_address);
+        }
+        if (0 == __get_PRIMASK())
+        {
+            sim_fault("flash: code flash write at 0x%08X with interrupts enabled", flash_address);
+        }
+        for (uint32_t i = 0; i < num_bytes; i++)
+        {
+            if (ERASED_STATE != p_dest[i])
+            {
+                sim_fault("flash: code flash write to 0x%08X, which is not erased", flash_address + i);
+            }
+        }
+
+        bool cut = sim_flash_op();
+        if (cut)
+        {
+            length = ((num_bytes / 2) / MAIN_FLASH_PROGRAMMING_PAGE_SIZE) * MAIN_FLASH_PROGRAMMING_PAGE_SIZE;
+        }
+        memmove(p_dest, (const void *)(uintptr_t)src_address, length);
+        if (cut)
+        {
+            sim_power_cut();
+        }
+
+        sim_shared->stats.code_flash_bytes_programmed += num_bytes;
+        sim_advance(((num_bytes / MAIN_FLASH_PROGRAMMING_PAGE_SIZE) * (uint64_t)p_latency->code_flash_program_ns) + sim_read_ns(src_address, num_bytes));
+    }
+    else if (is_data_flash(flash_address, num_bytes))
+    {
+        if ((0 != (flash_address % DATA_FLASH_PROGRAMMING_UNIT)) || (0 != (num_bytes % DATA_FLASH_PROGRAMMING_UNIT)))
+        {
+            sim_fault("flash: data flash write of %u bytes at 0x%08X is not in whole units", num_bytes, flash_address);
+        }
+        if (flash_cfg->data_flash_bgo && (0 != __get_PRIMASK()))
+        {
+            sim_fault("flash: background data flash write at 0x%08X with interrupts disabled", flash_address);
+        }
+        for (uint32_t i = 0; i < num_bytes; i++)
+        {
+            if (!sim_shared->data_flash_erased[flash_address - DATA_FLASH_START_ADDRESS + i])
+            {
+                sim_fault("flash: data flash write to 0x%08X, which is not erased", flash_address + i);
+            }
+        }
+
+        bool cut = sim_flash_op();
+        if (cut)
+        {
+            length = ((num_bytes / 2) / DATA_FLASH_PROGRAMMING_UNIT) * DATA_FLASH_PROGRAMMING_UNIT;
+        }
+        memmove(p_dest, (const void *)(uintptr_t)src_address, length);
+        memset(&sim_shared->data_flash_erased[flash_address - DATA_FLASH_START_ADDRESS], 0, length);
+        if (cut)
+        {
+            sim_power_cut();
+        }
+
+        sim_shared->stats.data_flash_bytes_programmed += num_bytes;
+        flash_busy_until = sim_now() + ((num_bytes / DATA_FLASH_PROGRAMMING_UNIT) * (uint64_t)p_latency->data_flash_program_ns);
+        if (flash_cfg->data_flash_bgo)
+        {
+            flash_callback(FLASH_EVENT_WRITE_COMPLETE);
+        }
+        else
+        {
+            flash_wait();
+        }
+    }
+    else
+    {
+        sim_fault("flash: write of %u bytes at 0x%08X is not in code or data flash", num_bytes, flash_address);
+    }
+
+    return SSP_SUCCESS;
+}
+
+static ssp_err_t flash_read_api(flash_ctrl_t * const p_ctrl, uint8_t * const p_dest_address, uint32_t const flash_address, uint32_t const num_bytes)
+{
+    (void)p_ctrl;
+
+    memcpy(p_dest_address, (const void *)(uintptr_t)flash_address, num_bytes);
+    sim_advance(sim_read_ns(flash_address, num_bytes));
+
+    return SSP_SUCCESS;
+}
+
+static ssp_err_t flash_erase_api(flash_ctrl_t * const p_ctrl, uint32_t const address, uint32_t const num_blocks)
+{
+    sim_latency_t * p_latency = &sim_shared->latency;
+
+    (void)p_ctrl;
+
+    if (!flash_open)
+    {
+        return SSP_ERR_NOT_OPEN;
+    }
+
+    flash_wait();
+
+    if (is_code_flash(address, num_blocks * MAIN_IMAGE_ERASE_BLOCK_SIZE))
+    {
+        if (0 != (address % MAIN_IMAGE_ERASE_BLOCK_SIZE))
+        {
+            sim_fault("flash: code flash erase at 0x%08X is not on a block", address);
+        }
+        if (0 == __get_PRIMASK())
+        {
+            sim_fault("flash: code flash erase at 0x%08X with interrupts enabled", address);
+        }
+
+        for (uint32_t block = 0; block < num_blocks; block++)
+        {
+            uint8_t * p_block = (uint8_t *)(uintptr_t)(address + (block * MAIN_IMAGE_ERASE_BLOCK_SIZE));
+
+            if (sim_flash_op())
+            {
+                memset(p_block, ERASED_STATE, MAIN_IMAGE_ERASE_BLOCK_SIZE / 2);
+                sim_power_cut();
+            }
+            memset(p_block, ERASED_STATE, MAIN_IMAGE_ERASE_BLOCK_SIZE);
+            sim_shared->stats.code_flash_blocks_erased++;
+            sim_advance(p_latency->code_flash_erase_ns);
+        }
+    }
+    else if (is_data_flash(address, num_blocks * DATA_FLASH_ERASE_BLOCK_SIZE))
+    {
+        if (0 != (address % DATA_FLASH_ERASE_BLOCK_SIZE))
+        {
+            sim_fault("flash: data flash erase at 0x%08X is not on a block", address);
+        }
+        if (flash_cfg->data_flash_bgo && (0 != __get_PRIMASK()))
+        {
+            sim_fault("flash: background data flash erase at 0x%08X with interrupts disabled", address);
+        }
+
+        for (uint32_t block = 0; block < num_blocks; block++)
+        {
+            uint32_t block_address = address + (block * DATA_FLASH_ERASE_BLOCK_SIZE);
+
+            if (sim_flash_op())
+            {
+                sim_data_flash_erase(block_address, DATA_FLASH_ERASE_BLOCK_SIZE / 2);
+                sim_power_cut();
+            }
+            sim_data_flash_erase(block_address, DATA_FLASH_ERASE_BLOCK_SIZE);
+            sim_shared->stats.data_flash_blocks_erased++;
+        }
+
+        flash_busy_until = sim_now() + (num_blocks * (uint64_t)p_latency->data_flash_erase_ns);
+        if (flash_cfg->data_flash_bgo)
+        {
+            flash_callback(FLASH_EVENT_ERASE_COMPLETE);
+        }
+        else
+        {
+            flash_wait();
+        }
+    }
+    else
+    {
+        sim_fault("flash: erase of %u blocks at 0x%08X is not in code or data flash", num_blocks, address);
+    }
+
+    return SSP_SUCCESS;
+}
+
+static ssp_err_t flash_blank_check_api(flash_ctrl_t * const p_ctrl, uint32_t const address, uint32_t const num_bytes, flash_result_t * const p_blank_check_result)
+{
+    sim_latency_t * p_latency = &sim_shared->latency;
+    bool            blank = true;
+
+    (void)p_ctrl;
+
+    if (!flash_open)
+    {
+        return SSP_ERR_NOT_OPEN;
+    }
+
+    flash_wait();
+
+    if ((0 != (address % 4)) || (0 != (num_bytes % 4)) || (0 == num_bytes))
+    {
+        sim_fault("flash: blank check of %u bytes at 0x%08X is not in whole words", num_bytes, address);
+    }
+
+    sim_shared->stats.blank_check_bytes += num_bytes;
+    flash_blank_check_bytes += num_bytes;
+
+    if (is_code_flash(address, num_bytes))
+    {
+        const uint8_t * p_data = (const uint8_t *)(uintptr_t)address;
+
+        for (uint32_t i = 0; blank && (i < num_bytes); i++)
+        {
+            blank = (ERASED_STATE == p_data[i]);
+        }
+
+        sim_advance(p_latency->poll_ns + ((uint64_t)num_bytes * p_latency->code_flash_blank_check_ns));
+        *p_blank_check_result = blank ? FLASH_RESULT_BLANK : FLASH_RESULT_NOT_BLANK;
+    }
+    else if (is_data_flash(address, num_bytes))
+    {
+        for (uint32_t i = 0; blank && (i < num_bytes); i++)
+        {
+            blank = (0 != sim_shared->data_flash_erased[address - DATA_FLASH_START_ADDRESS + i]);
+        }
+
+        sim_advance(p_latency->poll_ns + ((uint64_t)num_bytes * p_latency->data_flash_blank_check_ns));
+        if (flash_cfg->data_flash_bgo)
+        {
+            flash_callback(blank ? FLASH_EVENT_BLANK : FLASH_EVENT_NOT_BLANK);
+            *p_blank_check_result = FLASH_RESULT_BGO_ACTIVE;
+        }
+        else
+        {
+            *p_blank_check_result = blank ? FLASH_RESULT_BLANK : FLASH_RESULT_NOT_BLANK;
+        }
+    }
+    else
+    {
+        sim_fault("flash: blank check of %u bytes at 0x%08X is not in code or data flash", num_bytes, address);
+    }
+
+    return SSP_SUCCESS;
+}
+
+static ssp_err_t flash_status_get_api(flash_ctrl_t * const p_ctrl)
+{
+    (void)p_ctrl;
+
+    sim_advance(sim_shared->latency.poll_ns);
+
+    return (sim_now() < flash_busy_until) ? SSP_ERR_IN_USE : SSP_SUCCESS;
+}
+
+const flash_api_t g_flash_on_flash_hp_test =
+{
+    .open       = flash_open_api,
+    .write      = flash_write_api,
+    .read       = flash_read_api,
+    .erase      = flash_erase_api,
+    .blankCheck = flash_blank_check_api,
+    .close      = flash_close_api,
+    .statusGet  = flash_status_get_api,
+};
+
+// As configuration.xml: Data Flash Background Operation enabled, completion through flash_ready_callback()
+static const flash_cfg_t g_flash_cfg =
+{
+    .data_flash_bgo = true,
+    .p_callback     = flash_ready_callback,
+    .p_context      = &g_flash,
+};
+const flash_instance_t g_flash = { .p_ctrl = NULL, .p_cfg = &g_flash_cfg, .p_api = &g_flash_on_flash_hp_test };
+
+/*
+ * QSPI
+ *
+ *  */
+static ssp_err_t qspi_open_api(qspi_ctrl_t * p_ctrl, qspi_cfg_t const * const p_cfg)
+{
+    (void)p_ctrl;
+    (void)p_cfg;
+
+    if (qspi_open)
+    {
+        return SSP_ERR_IN_USE;
+    }
+
+    sim_advance(sim_shared->latency.driver_open_ns);
+    qspi_open = true;
+
+    return SSP_SUCCESS;
+}
+
+static ssp_err_t qspi_close_api(qspi_ctrl_t * p_ctrl)
+{
+    (void)p_ctrl;
+
+    if (!qspi_open)
+    {
+        return SSP_ERR_NOT_OPEN;
+    }
+
+    sim_advance(sim_shared->latency.driver_open_ns);
+    qspi_open = false;
+
+    return SSP_SUCCESS;
+}
+
+static void qspi_check_ready(const char * p_operation, uint8_t * p_device_address)
+{
+    if (!qspi_open)
+    {
+        sim_fault("qspi: %s at %p with the driver closed", p_operation, (void *)p_device_address);
+    }
+    if (sim_now() < qspi_busy_until)
+    {
+        sim_fault("qspi: %s at %p while the flash is busy", p_operation, (void *)p_device_address);
+    }
+}
+
+static ssp_err_t qspi_read_api(qspi_ctrl_t * p_ctrl, uint8_t * p_device_address, uint8_t * p_memory_address, uint32_t byte_count)
+{
+    (void)p_ctrl;
+
+    qspi_check_ready("read", p_device_address);
+    memcpy(p_memory_address, p_device_address, byte_count);
+    sim_advance((uint64_t)byte_count * sim_shared->latency.qspi_read_ns);
+
+    return SSP_SUCCESS;
+}
+
+static ssp_err_t qspi_page_program_api(qspi_ctrl_t * p_ctrl, uint8_t * p_device_address, uint8_t * p_memory_address, uint32_t byte_count)
+{
+    uint32_t address = (uint32_t)(uintptr_t)p_device_address;
+    uint32_t length = byte_count;
+
+    (void)p_ctrl;
+
+    qspi_check_ready("page program", p_device_address);
+    if ((!is_qspi(address, byte_count)) || (0 == byte_count) ||
+        (((address % FLASH_PROGRAMMING_PAGE_SIZE) + byte_count) > FLASH_PROGRAMMING_PAGE_SIZE))
+    {
+        sim_fault("qspi: page program of %u bytes at 0x%08X is not within a page", byte_count, address);
+    }
+
+    if (sim_flash_op())
+    {
+        length = byte_count / 2;
+        for (uint32_t i = 0; i < length; i++)
+        {
+            p_device_address[i] &= p_memory_address[i];
+        }
+        sim_power_cut();
+    }
+
+    // Programming can only clear bits
+    for (uint32_t i = 0; i < length; i++)
+    {
+        p_device_address[i] &= p_memory_address[i];
+    }
+
+    sim_shared->stats.qspi_bytes_programmed += byte_count;
+    qspi_busy_until = sim_now() + sim_shared->latency.qspi_program_ns;
+
+    return SSP_SUCCESS;
+}
+
+static ssp_err_t qspi_erase_api(qspi_ctrl_t * p_ctrl, uint8_t * p_device_address, uint32_t byte_count)
+{
+    uint32_t address = (uint32_t)(uintptr_t)p_device_address;
+    uint64_t erase_ns;
+
+    (void)p_ctrl;
+
+    qspi_check_ready("erase", p_device_address);
+    if (4096 == byte_count)
+    {
+        erase_ns = sim_shared->latency.qspi_sector_erase_ns;
+    }
+    else if (UPDATE_IMAGE_ERASE_BLOCK_SIZE == byte_count)
+    {
+        erase_ns = sim_shared->latency.qspi_erase_ns;
+    }
+    else
+    {
+        sim_fault("qspi: erase of %u bytes is not a sector or block", byte_count);
+    }
+    if ((!is_qspi(address, byte_count)) || (0 != (address % byte_count)))
+    {
+        sim_fault("qspi: erase of %u bytes at 0x%08X is not on a boundary", byte_count, address);
+    }
+
+    if (sim_flash_op())
+    {
+        memset(p_device_address, ERASED_STATE, byte_count / 2);
+        sim_power_cut();
+    }
+    memset(p_device_address, ERASED_STATE, byte_count);
+
+    sim_shared->stats.qspi_blocks_erased++;
+    qspi_busy_until = sim_now() + erase_ns;
+
+    return SSP_SUCCESS;
+}
+
+static ssp_err_t qspi_sector_erase_api(qspi_ctrl_t * p_ctrl, uint8_t * p_device_address)
+{
+    return qspi_erase_api(p_ctrl, p_device_address, 4096);
+}
+
+static ssp_err_t qspi_status_get_api(qspi_ctrl_t * p_ctrl, bool * p_write_in_progress)
+{
+    (void)p_ctrl;
+
+    sim_advance(sim_shared->latency.poll_ns);
+    *p_write_in_progress = (sim_now() < qspi_busy_until);
+
+    return SSP_SUCCESS;
+}
+
+const qspi_api_t g_qspi_on_qspi_test =
+{
+    .open           = qspi_open_api,
+    .close          = qspi_close_api,
+    .read           = qspi_read_api,
+    .pageProgram    = qspi_page_program_api,
+    .erase          = qspi_erase_api,
+    .sectorErase    = qspi_sector_erase_api,
+    .statusGet      = qspi_status_get_api,
+};
+
+static const qspi_cfg_t g_qspi_cfg = { .page_size_bytes = FLASH_PROGRAMMING_PAGE_SIZE };
+const qspi_instance_t g_qspi = { .p_ctrl = NULL, .p_cfg = &g_qspi_cfg, .p_api = &g_qspi_on_qspi_test };
+
+/*
+ * DTC (g_transfer_qspi)
+ *
+ * A block transfer runs alongside the CPU: it ends SIM_DTC_BLOCK_SIZE reads after it is started, and the data is
+ * only in the destination once infoGet() has seen it end.
+ *
+ *  */
+static ssp_err_t dtc_open_api(transfer_ctrl_t * const p_ctrl, transfer_cfg_t const * const p_cfg)
+{
+    (void)p_ctrl;
+
+    if (dtc_open)
+    {
+        return SSP_ERR_IN_USE;
+    }
+    if (SIM_DTC_BLOCK_SIZE != p_cfg->block_size_bytes)
+    {
+        sim_fault("dtc: block size %u is not the configured %u", p_cfg->block_size_bytes, SIM_DTC_BLOCK_SIZE);
+    }
+
+    dtc_open = true;
+    dtc_pending = false;
+
+    return SSP_SUCCESS;
+}
+
+static ssp_err_t dtc_reset_api(transfer_ctrl_t * const p_ctrl, void const * volatile p_src, void * volatile p_dest, uint16_t const num_transfers)
+{
+    (void)p_ctrl;
+
+    if (!dtc_open)
+    {
+        return SSP_ERR_NOT_OPEN;
+    }
+    if (dtc_pending)
+    {
+        sim_fault("dtc: reset while a transfer is in progress");
+    }
+
+    dtc_src = (const uint8_t *)p_src;
+    dtc_dest = (uint8_t *)p_dest;
+    dtc_length = num_transfers * SIM_DTC_BLOCK_SIZE;
+
+    return SSP_SUCCESS;
+}
+
+static ssp_err_t dtc_start_api(transfer_ctrl_t * const p_ctrl, transfer_start_mode_t mode)
+{
+    (void)p_ctrl;
+    (void)mode;
+
+    if (!dtc_open)
+    {
+        return SSP_ERR_NOT_OPEN;
+    }
+    if (dtc_pending)
+    {
+        sim_fault("dtc: start while a transfer is in progress");
+    }
+
+    dtc_pending = true;
+    dtc_done_at = sim_now() + sim_read_ns((uint32_t)(uintptr_t)dtc_src, dtc_length);
+
+    return SSP_SUCCESS;
+}
+
+static ssp_err_t dtc_stop_api(transfer_ctrl_t * const p_ctrl)
+{
+    (void)p_ctrl;
+
+    dtc_pending = false;
+
+    return SSP_SUCCESS;
+}
+
+static ssp_err_t dtc_info_get_api(transfer_ctrl_t * const p_ctrl, transfer_properties_t * const p_info)
+{
+    (void)p_ctrl;
+
+    memset(p_info, 0, sizeof(*p_info));
+
+    if (dtc_pending)
+    {
+        if (sim_now() >= dtc_done_at)
+        {
+            memcpy(dtc_dest, dtc_src, dtc_length);
+            dtc_pending = false;
+            sim_shared->stats.dtc_blocks += dtc_length / SIM_DTC_BLOCK_SIZE;
+        }
+        else
+        {
+            p_info->block_count_remaining = 1;
+        }
+    }
+    sim_advance(sim_shared->latency.poll_ns);
+
+    return SSP_SUCCESS;
+}
+
+static ssp_err_t dtc_close_api(transfer_ctrl_t * const p_ctrl)
+{
+    (void)p_ctrl;
+
+    dtc_open = false;
+    dtc_pending = false;
+
+    return SSP_SUCCESS;
+}
+
+static const transfer_api_t g_transfer_on_dtc_sim =
+{
+    .open       = dtc_open_api,
+    .reset      = dtc_reset_api,
+    .start      = dtc_start_api,
+    .stop       = dtc_stop_api,
+    .infoGet    = dtc_info_get_api,
+    .close      = dtc_close_api,
+};
+
+static const transfer_cfg_t g_transfer_qspi_cfg = { .block_size_bytes = SIM_DTC_BLOCK_SIZE };
+const transfer_instance_t g_transfer_qspi = { .p_ctrl = NULL, .p_cfg = &g_transfer_qspi_cfg, .p_api = &g_transfer_on_dtc_sim };
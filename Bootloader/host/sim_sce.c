@@ -0,0 +1,275 @@
+/*
+ * sim_sce.c
+ *
+ * Simulated Secure Cryptographic Engine: the g_sce, g_sce_hash_0 and g_sce_ecc_0 instances and the test APIs
+ * image_verify.c uses when built with _BL_TESTING (g_hash_on_sce_test, g_ecc_on_sce_test), and the factory MCU
+ * information (g_fmi) for the unique ID.
+ * The SHA256 is the software backend (sha256_sw.c) and the ECDSA verify a real secp256k1 one (secp256k1.c), so an
+ * image only boots if it is correctly signed; both take the time of the SCE (sim_latency_t).
+ */
+#include "sim.h"
+#include "secp256k1.h"
+
+static bool sce_open;
+static bool hash_open;
+static bool ecc_open;
+static uint32_t hash_bytes;
+
+/*
+ * sim_sce_reset()
+ *
+ * Reset the drivers, at the start of a boot.
+ *
+ *  */
+void sim_sce_reset(void)
+{
+    sce_open = false;
+    hash_open = false;
+    ecc_open = false;
+    hash_bytes = 0;
+}
+
+/*
+ * sim_sce_hash_bytes_take()
+ *
+ * Bytes hashed by the SCE since the last call (see __wrap_boot_timing_add()).
+ *
+ *  */
+uint32_t sim_sce_hash_bytes_take(void)
+{
+    uint32_t bytes = hash_bytes;
+
+    hash_bytes = 0;
+
+    return bytes;
+}
+
+static ssp_err_t sce_open_api(crypto_ctrl_t * const p_ctrl, crypto_cfg_t const * const p_cfg)
+{
+    (void)p_ctrl;
+    (void)p_cfg;
+
+    if (sce_open)
+    {
+        return SSP_ERR_ALREADY_OPEN;
+    }
+
+    sim_advance(sim_shared->latency.driver_open_ns);
+    sce_open = true;
+
+    return SSP_SUCCESS;
+}
+
+static ssp_err_t sce_close_api(crypto_ctrl_t * const p_ctrl)
+{
+    (void)p_ctrl;
+
+    if (!sce_open)
+    {
+        return SSP_ERR_NOT_OPEN;
+    }
+    if (hash_open || ecc_open)
+    {
+        sim_fault("sce: closed before the hash and ECC drivers");
+    }
+
+    sce_open = false;
+
+    return SSP_SUCCESS;
+}
+
+static const crypto_api_t   g_sce_on_sce_sim = { .open = sce_open_api, .close = sce_close_api };
+static const crypto_cfg_t   g_sce_cfg = { .endian_flag = 0 };
+const crypto_instance_t     g_sce = { .p_ctrl = NULL, .p_cfg = &g_sce_cfg, .p_api = &g_sce_on_sce_sim };
+
+/*
+ * Hash (SHA256)
+ *
+ *  */
+static ssp_err_t hash_open_api(hash_ctrl_t * const p_ctrl, hash_cfg_t const * const p_cfg)
+{
+    (void)p_ctrl;
+    (void)p_cfg;
+
+    if (!sce_open)
+    {
+        sim_fault("sce: hash driver opened before the SCE");
+    }
+    if (hash_open)
+    {
+        return SSP_ERR_ALREADY_OPEN;
+    }
+    if (sim_shared->sce_hash_fails)
+    {
+        return SSP_ERR_NOT_ENABLED;
+    }
+
+    sim_advance(sim_shared->latency.driver_open_ns);
+    hash_open = true;
+
+    return SSP_SUCCESS;
+}
+
+static ssp_err_t hash_close_api(hash_ctrl_t * const p_ctrl)
+{
+    (void)p_ctrl;
+
+    if (!hash_open)
+    {
+        return SSP_ERR_NOT_OPEN;
+    }
+
+    hash_open = false;
+
+    return SSP_SUCCESS;
+}
+
+static ssp_err_t hash_update_api(hash_ctrl_t * const p_ctrl, uint32_t * p_data_buffer, uint32_t num_words, uint32_t * p_digest)
+{
+    uint32_t address = (uint32_t)(uintptr_t)p_data_buffer;
+    uint32_t bytes = num_words * 4;
+
+    if (!hash_open)
+    {
+        return SSP_ERR_NOT_OPEN;
+    }
+    // The SCE takes whole 64 byte blocks of word aligned data
+    if ((0 != (address & 3U)) || (0 != (num_words % (SHA256_BLOCK_SIZE_BYTES / 4))))
+    {
+        sim_fault("sce: hash of %u words at 0x%08X is not whole blocks of aligned words", num_words, address);
+    }
+
+    sim_shared->stats.hash_calls++;
+    sim_shared->stats.hash_bytes += bytes;
+    hash_bytes += bytes;
+    sim_advance(((uint64_t)bytes * sim_shared->latency.hash_ns) + sim_read_ns(address, bytes));
+
+    return g_hash_on_software.hashUpdate(p_ctrl, p_data_buffer, num_words, p_digest);
+}
+
+static ssp_err_t hash_version_get_api(ssp_version_t * const p_version)
+{
+    return g_hash_on_software.versionGet(p_version);
+}
+
+const hash_api_t g_hash_on_sce_test =
+{
+    .open       = hash_open_api,
+    .close      = hash_close_api,
+    .hashUpdate = hash_update_api,
+    .versionGet = hash_version_get_api,
+};
+
+static const hash_cfg_t g_sce_hash_0_cfg = { .p_crypto_api = &g_sce_on_sce_sim };
+const hash_instance_t g_sce_hash_0 = { .p_ctrl = NULL, .p_cfg = &g_sce_hash_0_cfg, .p_api = &g_hash_on_sce_test };
+
+/*
+ * ECC (ECDSA verify on secp256k1)
+ *
+ *  */
+static ssp_err_t ecc_open_api(ecc_ctrl_t * const p_ctrl, ecc_cfg_t const * const p_cfg)
+{
+    (void)p_ctrl;
+    (void)p_cfg;
+
+    if (!sce_open)
+    {
+        sim_fault("sce: ECC driver opened before the SCE");
+    }
+    if (ecc_open)
+    {
+        return SSP_ERR_ALREADY_OPEN;
+    }
+
+    sim_advance(sim_shared->latency.driver_open_ns);
+    ecc_open = true;
+
+    return SSP_SUCCESS;
+}
+
+static ssp_err_t ecc_close_api(ecc_ctrl_t * const p_ctrl)
+{
+    (void)p_ctrl;
+
+    if (!ecc_open)
+    {
+        return SSP_ERR_NOT_OPEN;
+    }
+
+    ecc_open = false;
+
+    return SSP_SUCCESS;
+}
+
+static bool ecc_handle_ok(r_crypto_data_handle_t * p_handle, uint32_t length_words)
+{
+    return ((NULL != p_handle) && (NULL != p_handle->p_data) && (length_words == p_handle->data_length));
+}
+
+static ssp_err_t ecc_verify_api(ecc_ctrl_t * const p_ctrl, r_crypto_data_handle_t * const p_domain,
+                                r_crypto_data_handle_t * const p_generator_point, r_crypto_data_handle_t * const p_public_key,
+                                r_crypto_data_handle_t * const p_message_digest, r_crypto_data_handle_t * const p_signature_r,
+                                r_crypto_data_handle_t * const p_signature_s)
+{
+    uint8_t signature[SECP256K1_SIGNATURE_SIZE];
+
+    (void)p_ctrl;
+
+    if (!ecc_open)
+    {
+        return SSP_ERR_NOT_OPEN;
+    }
+    if ((!ecc_handle_ok(p_domain, ECC_256_DOMAIN_PARAMETER_WITH_ORDER_LENGTH_WORDS)) ||
+        (!ecc_handle_ok(p_generator_point, ECC_256_GENERATOR_POINT_LENGTH_WORDS)) ||
+        (!ecc_handle_ok(p_public_key, ECC_256_PUBLIC_KEY_LENGTH_WORDS)) ||
+        (!ecc_handle_ok(p_message_digest, ECC_256_MESSAGE_DIGEST_LENGTH_WORDS)) ||
+        (!ecc_handle_ok(p_signature_r, ECC_256_SIGNATURE_R_LENGTH_WORDS)) ||
+        (!ecc_handle_ok(p_signature_s, ECC_256_SIGNATURE_S_LENGTH_WORDS)))
+    {
+        sim_fault("sce: ECC verify with a missing or wrong size parameter");
+    }
+    // Only the secp256k1 curve is simulated
+    if ((0 != memcmp(p_domain->p_data, secp256k1_domain, sizeof(secp256k1_domain))) ||
+        (0 != memcmp(p_generator_point->p_data, secp256k1_generator, sizeof(secp256k1_generator))))
+    {
+        sim_fault("sce: ECC verify with domain parameters other than secp256k1");
+    }
+
+    sim_shared->stats.ecc_verifies++;
+    sim_advance(sim_shared->latency.ecc_verify_ns);
+
+    memcpy(signature, p_signature_r->p_data, SECP256K1_SIGNATURE_SIZE / 2);
+    memcpy(signature + (SECP256K1_SIGNATURE_SIZE / 2), p_signature_s->p_data, SECP256K1_SIGNATURE_SIZE / 2);
+    if (!secp256k1_verify((const uint8_t *)p_public_key->p_data, (const uint8_t *)p_message_digest->p_data, signature))
+    {
+        return SSP_ERR_INVALID_DATA;
+    }
+
+    return SSP_SUCCESS;
+}
+
+const ecc_api_t g_ecc_on_sce_test =
+{
+    .open   = ecc_open_api,
+    .close  = ecc_close_api,
+    .verify = ecc_verify_api,
+};
+
+static const ecc_cfg_t g_sce_ecc_0_cfg = { .p_crypto_api = &g_sce_on_sce_sim };
+const ecc_instance_t g_sce_ecc_0 = { .p_ctrl = NULL, .p_cfg = &g_sce_ecc_0_cfg, .p_api = &g_ecc_on_sce_test };
+
+/*
+ * Factory MCU information
+ *
+ *  */
+static ssp_err_t fmi_unique_id_get_api(fmi_unique_id_t * const p_unique_id)
+{
+    static const fmi_unique_id_t unique_id = { { 0x53354439, 0x00594153, 0x12345678, 0x9ABCDEF0 } };
+
+    *p_unique_id = unique_id;
+
+    return SSP_SUCCESS;
+}
+
+static const fmi_api_t  g_fmi_on_fmi_sim = { .uniqueIdGet = fmi_unique_id_get_api };
+const fmi_instance_t    g_fmi = { .p_ctrl = NULL, .p_api = &g_fmi_on_fmi_sim };
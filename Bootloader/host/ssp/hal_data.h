@@ -0,0 +1,271 @@
+/*
+ * hal_data.h
+ *
+ * Host build: stands in for the hal_data.h e2studio generates from configuration.xml, with the subset of the BSP,
+ * CMSIS and SSP driver interfaces the bootloader sources use. The driver instances are the simulated ones in
+ * sim_flash.c and sim_sce.c.
+ */
+
+#ifndef HAL_DATA_H_
+#define HAL_DATA_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "ssp_common_api.h"
+#include "r_hash_api.h"
+#include "r_ecc_api.h"
+
+/* BSP */
+#define BSP_ALIGN_VARIABLE(x)           __attribute__((aligned(x)))
+#define BSP_ALIGN_VARIABLE_V2(x)        __attribute__((aligned(x)))
+#define BSP_PLACE_IN_SECTION(x)         __attribute__((section(x)))
+#define BSP_PLACE_IN_SECTION_V2(x)      __attribute__((section(x)))
+#define BSP_DONT_REMOVE                 __attribute__((used))
+
+extern uint32_t SystemCoreClock;
+
+/* CMSIS core, see sim.c */
+void sim_system_reset(void);
+#define NVIC_SystemReset()              sim_system_reset()
+#define __BKPT(value)                   sim_breakpoint(value)
+#define __NOP()                         sim_idle()
+#define __DSB()                         ((void)0)
+#define __ISB()                         ((void)0)
+void     sim_breakpoint(int value);
+void     sim_idle(void);
+void     __disable_irq(void);
+void     __enable_irq(void);
+uint32_t __get_PRIMASK(void);
+void     __set_PRIMASK(uint32_t primask);
+void     __set_MSP(uint32_t top_of_main_stack);
+
+typedef struct
+{
+    volatile uint32_t DEMCR;
+} CoreDebug_Type;
+#define CoreDebug_DEMCR_TRCENA_Msk      (1UL << 24)
+
+typedef struct
+{
+    volatile uint32_t CTRL;
+    volatile uint32_t CYCCNT;
+} DWT_Type;
+#define DWT_CTRL_CYCCNTENA_Msk          (1UL)
+
+extern CoreDebug_Type   sim_core_debug;
+extern DWT_Type         sim_dwt;
+#define CoreDebug                       (&sim_core_debug)
+#define DWT                             (&sim_dwt)
+
+typedef struct
+{
+    volatile uint16_t MSPMPUCTL;
+} R_SPMON_Type;
+extern R_SPMON_Type     sim_spmon;
+#define R_SPMON                         (&sim_spmon)
+
+/* Flash (r_flash_hp) */
+typedef void flash_ctrl_t;
+
+typedef enum e_flash_event
+{
+    FLASH_EVENT_ERASE_COMPLETE,
+    FLASH_EVENT_WRITE_COMPLETE,
+    FLASH_EVENT_BLANK,
+    FLASH_EVENT_NOT_BLANK,
+    FLASH_EVENT_ERR_DF_ACCESS,
+    FLASH_EVENT_ERR_CF_ACCESS,
+    FLASH_EVENT_ERR_CMD_LOCKED,
+    FLASH_EVENT_ERR_FAILURE,
+    FLASH_EVENT_ERR_ONE_BIT,
+} flash_event_t;
+
+typedef enum e_flash_result
+{
+    FLASH_RESULT_BLANK,
+    FLASH_RESULT_NOT_BLANK,
+    FLASH_RESULT_BGO_ACTIVE,
+} flash_result_t;
+
+typedef struct st_flash_callback_args
+{
+    flash_event_t event;
+    void const *  p_context;
+} flash_callback_args_t;
+
+typedef struct st_flash_cfg
+{
+    bool            data_flash_bgo;
+    void         (* p_callback)(flash_callback_args_t * p_args);
+    void const *    p_context;
+} flash_cfg_t;
+
+typedef struct st_flash_api
+{
+    ssp_err_t (* open)(flash_ctrl_t * const p_ctrl, flash_cfg_t const * const p_cfg);
+    ssp_err_t (* write)(flash_ctrl_t * const p_ctrl, uint32_t const src_address, uint32_t const flash_address, uint32_t const num_bytes);
+    ssp_err_t (* read)(flash_ctrl_t * const p_ctrl, uint8_t * const p_dest_address, uint32_t const flash_address, uint32_t const num_bytes);
+    ssp_err_t (* erase)(flash_ctrl_t * const p_ctrl, uint32_t const address, uint32_t const num_blocks);
+    ssp_err_t (* blankCheck)(flash_ctrl_t * const p_ctrl, uint32_t const address, uint32_t const num_bytes, flash_result_t * const p_blank_check_result);
+    ssp_err_t (* close)(flash_ctrl_t * const p_ctrl);
+    ssp_err_t (* statusGet)(flash_ctrl_t * const p_ctrl);
+} flash_api_t;
+
+typedef struct st_flash_instance
+{
+    flash_ctrl_t      * p_ctrl;
+    flash_cfg_t const * p_cfg;
+    flash_api_t const * p_api;
+} flash_instance_t;
+
+/* QSPI (r_qspi) */
+typedef void qspi_ctrl_t;
+
+typedef struct st_qspi_cfg
+{
+    uint32_t page_size_bytes;
+} qspi_cfg_t;
+
+typedef struct st_qspi_api
+{
+    ssp_err_t (* open)(qspi_ctrl_t * p_ctrl, qspi_cfg_t const * const p_cfg);
+    ssp_err_t (* close)(qspi_ctrl_t * p_ctrl);
+    ssp_err_t (* read)(qspi_ctrl_t * p_ctrl, uint8_t * p_device_address, uint8_t * p_memory_address, uint32_t byte_count);
+    ssp_err_t (* pageProgram)(qspi_ctrl_t * p_ctrl, uint8_t * p_device_address, uint8_t * p_memory_address, uint32_t byte_count);
+    ssp_err_t (* erase)(qspi_ctrl_t * p_ctrl, uint8_t * p_device_address, uint32_t byte_count);
+    ssp_err_t (* sectorErase)(qspi_ctrl_t * p_ctrl, uint8_t * p_device_address);
+    ssp_err_t (* statusGet)(qspi_ctrl_t * p_ctrl, bool * p_write_in_progress);
+} qspi_api_t;
+
+typedef struct st_qspi_instance
+{
+    qspi_ctrl_t      * p_ctrl;
+    qspi_cfg_t const * p_cfg;
+    qspi_api_t const * p_api;
+} qspi_instance_t;
+
+/* Transfer (r_dtc) */
+typedef void transfer_ctrl_t;
+
+typedef enum e_transfer_start_mode
+{
+    TRANSFER_START_MODE_SINGLE,
+    TRANSFER_START_MODE_REPEAT,
+} transfer_start_mode_t;
+
+typedef struct st_transfer_properties
+{
+    uint32_t block_count_max;
+    uint32_t block_count_remaining;
+    uint32_t transfer_length_max;
+    uint32_t transfer_length_remaining;
+} transfer_properties_t;
+
+typedef struct st_transfer_cfg
+{
+    uint32_t block_size_bytes;      // Bytes moved by one block (length x transfer size of the DTC transfer_info_t)
+} transfer_cfg_t;
+
+typedef struct st_transfer_api
+{
+    ssp_err_t (* open)(transfer_ctrl_t * const p_ctrl, transfer_cfg_t const * const p_cfg);
+    ssp_err_t (* reset)(transfer_ctrl_t * const p_ctrl, void const * volatile p_src, void * volatile p_dest, uint16_t const num_transfers);
+    ssp_err_t (* start)(transfer_ctrl_t * const p_ctrl, transfer_start_mode_t mode);
+    ssp_err_t (* stop)(transfer_ctrl_t * const p_ctrl);
+    ssp_err_t (* infoGet)(transfer_ctrl_t * const p_ctrl, transfer_properties_t * const p_info);
+    ssp_err_t (* close)(transfer_ctrl_t * const p_ctrl);
+} transfer_api_t;
+
+typedef struct st_transfer_instance
+{
+    transfer_ctrl_t      * p_ctrl;
+    transfer_cfg_t const * p_cfg;
+    transfer_api_t const * p_api;
+} transfer_instance_t;
+
+/* Factory MCU information (r_fmi) */
+typedef struct st_fmi_unique_id
+{
+    uint32_t unique_id[4];
+} fmi_unique_id_t;
+
+typedef struct st_fmi_api
+{
+    ssp_err_t (* uniqueIdGet)(fmi_unique_id_t * const p_unique_id);
+} fmi_api_t;
+
+typedef struct st_fmi_instance
+{
+    void            * p_ctrl;
+    fmi_api_t const * p_api;
+} fmi_instance_t;
+
+/* SCE (r_sce) */
+typedef void crypto_ctrl_t;
+
+typedef struct st_crypto_cfg
+{
+    uint32_t endian_flag;
+} crypto_cfg_t;
+
+typedef struct st_crypto_api
+{
+    ssp_err_t (* open)(crypto_ctrl_t * const p_ctrl, crypto_cfg_t const * const p_cfg);
+    ssp_err_t (* close)(crypto_ctrl_t * const p_ctrl);
+} crypto_api_t;
+
+typedef struct st_crypto_instance
+{
+    crypto_ctrl_t      * p_ctrl;
+    crypto_cfg_t const * p_cfg;
+    crypto_api_t const * p_api;
+} crypto_instance_t;
+
+/* I/O port and UART, only opened by the _BL_TESTING path of hal_entry() */
+typedef enum e_ioport_port_pin
+{
+    IOPORT_PORT_04_PIN_11 = 0x040B,
+} ioport_port_pin_t;
+#define IOPORT_CFG_PERIPHERAL_PIN               (0x00010000UL)
+#define IOPORT_PERIPHERAL_SCI0_2_4_6_8          (0x04000000UL)
+
+typedef struct st_ioport_api
+{
+    ssp_err_t (* pinCfg)(ioport_port_pin_t pin, uint32_t cfg);
+} ioport_api_t;
+
+typedef struct st_ioport_instance
+{
+    ioport_api_t const * p_api;
+} ioport_instance_t;
+
+typedef void uart_ctrl_t;
+typedef struct st_uart_cfg
+{
+    uint32_t baud_rate;
+} uart_cfg_t;
+
+typedef struct st_uart_api
+{
+    ssp_err_t (* open)(uart_ctrl_t * const p_ctrl, uart_cfg_t const * const p_cfg);
+} uart_api_t;
+
+typedef struct st_uart_instance
+{
+    uart_ctrl_t      * p_ctrl;
+    uart_cfg_t const * p_cfg;
+    uart_api_t const * p_api;
+} uart_instance_t;
+
+extern const flash_instance_t       g_flash;
+extern const qspi_instance_t        g_qspi;
+extern const transfer_instance_t    g_transfer_qspi;
+extern const fmi_instance_t         g_fmi;
+extern const crypto_instance_t      g_sce;
+extern const hash_instance_t        g_sce_hash_0;
+extern const ecc_instance_t         g_sce_ecc_0;
+extern const ioport_instance_t      g_ioport;
+extern const uart_instance_t        g_uart0;
+
+#endif /* HAL_DATA_H_ */
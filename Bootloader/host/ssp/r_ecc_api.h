@@ -0,0 +1,51 @@
+/*
+ * r_ecc_api.h
+ *
+ * Host build: the SSP ECC driver interface (ecc_api_t) and the ECC 256 sizes used by image_verify.c.
+ * All values passed through r_crypto_data_handle_t are big endian byte arrays, as for the SCE.
+ */
+
+#ifndef R_ECC_API_H
+#define R_ECC_API_H
+
+#include "ssp_common_api.h"
+
+#define ECC_256_DOMAIN_PARAMETER_WITH_ORDER_LENGTH_WORDS    (32)
+#define ECC_256_GENERATOR_POINT_LENGTH_WORDS                (16)
+#define ECC_256_PUBLIC_KEY_LENGTH_WORDS                     (16)
+#define ECC_256_PRIVATE_KEY_LENGTH_WORDS                    (8)
+#define ECC_256_MESSAGE_DIGEST_LENGTH_WORDS                 (8)
+#define ECC_256_SIGNATURE_R_LENGTH_WORDS                    (8)
+#define ECC_256_SIGNATURE_S_LENGTH_WORDS                    (8)
+
+typedef struct st_r_crypto_data_handle
+{
+    uint32_t * p_data;
+    uint32_t   data_length;     // In words
+} r_crypto_data_handle_t;
+
+typedef void ecc_ctrl_t;
+
+typedef struct st_ecc_cfg
+{
+    void const * p_crypto_api;
+} ecc_cfg_t;
+
+typedef struct st_ecc_api
+{
+    ssp_err_t (* open)(ecc_ctrl_t * const p_ctrl, ecc_cfg_t const * const p_cfg);
+    ssp_err_t (* close)(ecc_ctrl_t * const p_ctrl);
+    ssp_err_t (* verify)(ecc_ctrl_t * const p_ctrl, r_crypto_data_handle_t * const p_domain,
+                         r_crypto_data_handle_t * const p_generator_point, r_crypto_data_handle_t * const p_public_key,
+                         r_crypto_data_handle_t * const p_message_digest, r_crypto_data_handle_t * const p_signature_r,
+                         r_crypto_data_handle_t * const p_signature_s);
+} ecc_api_t;
+
+typedef struct st_ecc_instance
+{
+    ecc_ctrl_t      * p_ctrl;
+    ecc_cfg_t const * p_cfg;
+    ecc_api_t const * p_api;
+} ecc_instance_t;
+
+#endif /* R_ECC_API_H */
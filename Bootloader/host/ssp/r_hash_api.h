@@ -0,0 +1,34 @@
+/*
+ * r_hash_api.h
+ *
+ * Host build: the SSP hash driver interface (hash_api_t) as used by sha256_hal.c.
+ */
+
+#ifndef R_HASH_API_H
+#define R_HASH_API_H
+
+#include "ssp_common_api.h"
+
+typedef void hash_ctrl_t;
+
+typedef struct st_hash_cfg
+{
+    void const * p_crypto_api;
+} hash_cfg_t;
+
+typedef struct st_hash_api
+{
+    ssp_err_t (* open)(hash_ctrl_t * const p_ctrl, hash_cfg_t const * const p_cfg);
+    ssp_err_t (* close)(hash_ctrl_t * const p_ctrl);
+    ssp_err_t (* hashUpdate)(hash_ctrl_t * const p_ctrl, uint32_t * p_data_buffer, uint32_t num_words, uint32_t * p_digest);
+    ssp_err_t (* versionGet)(ssp_version_t * const p_version);
+} hash_api_t;
+
+typedef struct st_hash_instance
+{
+    hash_ctrl_t      * p_ctrl;
+    hash_cfg_t const * p_cfg;
+    hash_api_t const * p_api;
+} hash_instance_t;
+
+#endif /* R_HASH_API_H */
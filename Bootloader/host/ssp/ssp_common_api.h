@@ -0,0 +1,45 @@
+/*
+ * ssp_common_api.h
+ *
+ * Host build: the parts of the SSP common API used by the bootloader sources (error codes and version structure).
+ * Values are not those of SSP v2.0.0, code must only compare against the names.
+ */
+
+#ifndef SSP_COMMON_API_H
+#define SSP_COMMON_API_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum e_ssp_err
+{
+    SSP_SUCCESS = 0,
+    SSP_ERR_ASSERTION,
+    SSP_ERR_INVALID_POINTER,
+    SSP_ERR_INVALID_ARGUMENT,
+    SSP_ERR_INVALID_ADDRESS,
+    SSP_ERR_INVALID_SIZE,
+    SSP_ERR_INVALID_MODE,
+    SSP_ERR_INVALID_DATA,
+    SSP_ERR_INVALID_STATE,
+    SSP_ERR_IN_USE,
+    SSP_ERR_NOT_OPEN,
+    SSP_ERR_ALREADY_OPEN,
+    SSP_ERR_NOT_ENABLED,
+    SSP_ERR_UNSUPPORTED,
+    SSP_ERR_TIMEOUT,
+    SSP_ERR_ABORTED,
+    SSP_ERR_OVERFLOW,
+    SSP_ERR_NOT_ERASED,
+    SSP_ERR_ERASE_FAILED,
+    SSP_ERR_WRITE_FAILED,
+    SSP_ERR_CRYPTO_INVALID_SIZE,
+} ssp_err_t;
+
+typedef union st_ssp_version
+{
+    uint32_t version_id;
+} ssp_version_t;
+
+#endif /* SSP_COMMON_API_H */
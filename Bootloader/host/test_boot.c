@@ -0,0 +1,787 @@
+/*
+ * test_boot.c
+ *
+ * Boot tests of the bootloader built for the host (see README.md): each test sets up the flash as a device would be
+ * found at power on, boots it and checks what was booted and what the bootloader did to the flash.
+ *
+ * The same tests run on every test variant (see Makefile), tests of options a variant is not built with are left out.
+ * A line is printed for each boot checked, with the simulated boot time and the work it took.
+ */
+#include "image.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Resets followed before a boot is taken to have failed (the bootloader resets once after a failed update)
+#define TEST_MAX_RESETS         (4)
+
+#define EXPECT(condition)       expect((condition), #condition, __LINE__)
+
+static int      test_failures;
+static uint8_t  test_image[IMAGE_MAX_SIZE];
+
+static void expect(bool condition, const char * p_text, int line)
+{
+    if (!condition)
+    {
+        printf("  FAILED line %d: %s\n", line, p_text);
+        test_failures++;
+    }
+}
+
+static void put(uint32_t address, const uint8_t * p_data, uint32_t size)
+{
+    memcpy((void *)(uintptr_t)address, p_data, size);
+}
+
+/*
+ * Flash set up, a blank device
+ *
+ *  */
+static void fresh(void)
+{
+    sim_erase_all();
+    sim_shared->latency = sim_latency_default();
+    sim_shared->power_cut_after_ops = -1;
+    sim_shared->sce_hash_fails = false;
+}
+
+// Make an image to run from run_address and program it at address (returns its size, the image is in test_image)
+static uint32_t put_image(uint32_t address, uint32_t run_address, uint32_t binary_size, uint32_t version, uint32_t seed, uint32_t flags)
+{
+    uint32_t size = image_make(test_image, run_address, binary_size, version, seed, flags);
+
+    put(address, test_image, size);
+
+    return size;
+}
+
+static uint32_t hashed(void)
+{
+    return sim_shared->record.phase[BOOT_PHASE_HASH].bytes;
+}
+
+static uint32_t count(boot_count_t counter)
+{
+    return sim_shared->record.count[counter];
+}
+
+/*
+ * run()
+ *
+ * Power on and boot, following resets, as the device would. Prints a line for the boot and checks the boot timing
+ * record an application is started with.
+ *
+ * RETURNS:
+ * - Outcome of the last boot
+ *
+ *  */
+static sim_outcome_t run(const char * p_name)
+{
+    sim_outcome_t   outcome = sim_boot();
+    uint64_t        time_ns = sim_shared->time_ns;
+    uint32_t        resets = 0;
+
+    while ((SIM_OUTCOME_RESET == outcome) && (resets < TEST_MAX_RESETS))
+    {
+        resets++;
+        outcome = sim_boot();
+        time_ns += sim_shared->time_ns;
+    }
+
+    if (NULL != p_name)
+    {
+        printf("%-36s %-9s %9.3f ms  resets %u  hashed %4u KB  ecc %u  erased %3u  unchanged %3u\n", p_name,
+               sim_outcome_name(outcome), (double)time_ns / 1e6, resets, hashed() / 1024, sim_shared->stats.ecc_verifies,
+               count(BOOT_COUNT_MAIN_BLOCKS_ERASED), count(BOOT_COUNT_MAIN_BLOCKS_UNCHANGED));
+    }
+    if (SIM_OUTCOME_FAULT == outcome)
+    {
+        printf("  fault: %s\n", sim_shared->fault);
+    }
+    if (SIM_OUTCOME_BOOTED == outcome)
+    {
+        EXPECT(sim_shared->record_valid);
+        EXPECT(0 != sim_shared->record.total_cycles);
+    }
+
+    return outcome;
+}
+
+#if !defined BOOT_AB_SLOTS
+static uint8_t  test_target[IMAGE_MAX_SIZE];
+static uint8_t  test_base[IMAGE_MAX_SIZE];
+
+static bootloader_image_header_t * header_at(uint32_t address)
+{
+    return (bootloader_image_header_t *)(uintptr_t)address;
+}
+
+static bool holds(uint32_t address, const uint8_t * p_data, uint32_t size)
+{
+    return (0 == memcmp((const void *)(uintptr_t)address, p_data, size));
+}
+
+static bool erased(uint32_t address, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++)
+    {
+        if (ERASED_STATE != ((const uint8_t *)(uintptr_t)address)[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static uint32_t put_main(uint32_t binary_size, uint32_t version, uint32_t seed, uint32_t flags)
+{
+    return put_image(MAIN_IMAGE_START_ADDRESS, MAIN_IMAGE_START_ADDRESS, binary_size, version, seed, flags);
+}
+
+static uint32_t put_update(uint32_t binary_size, uint32_t version, uint32_t seed, uint32_t flags)
+{
+    return put_image(UPDATE_IMAGE_START_ADDRESS, MAIN_IMAGE_START_ADDRESS, binary_size, version, seed, flags);
+}
+
+/*
+ * Updates of flat and block table images
+ *
+ *  */
+static void test_no_update(void)
+{
+    fresh();
+    put_main(80 * 1024, 1, 1, 0);
+    EXPECT(SIM_OUTCOME_BOOTED == run("no update"));
+    EXPECT(MAIN_IMAGE_START_ADDRESS == sim_shared->booted_image);
+    EXPECT(1 == sim_shared->stats.ecc_verifies);
+#if !defined BOOT_CACHE
+    // Nothing is written (the boot cache writes its record after a full verify), and only the header of the update
+    // area is blank checked (IMAGE_BLANK_CHECK_SIZE)
+    EXPECT(0 == sim_shared->stats.flash_ops);
+    EXPECT(IMAGE_BLANK_CHECK_SIZE == sim_shared->record.phase[BOOT_PHASE_BLANK_CHECK].bytes);
+#endif
+}
+
+static void test_update(const char * p_name, uint32_t binary_size, uint32_t flags)
+{
+    uint32_t size;
+
+    fresh();
+    put_main(80 * 1024, 1, 1, 0);
+    size = put_update(binary_size, 2, 2, flags);
+    EXPECT(SIM_OUTCOME_BOOTED == run(p_name));
+    EXPECT(holds(MAIN_IMAGE_START_ADDRESS, test_image, size));
+    EXPECT(erased(UPDATE_IMAGE_START_ADDRESS, IMAGE_HEADER_SIZE));
+
+    EXPECT(SIM_OUTCOME_BOOTED == run(NULL));
+    EXPECT(1 == sim_shared->stats.ecc_verifies);
+#if !defined BOOT_CACHE
+    EXPECT(0 == sim_shared->stats.flash_ops);
+#endif
+}
+
+static void test_blank_main(void)
+{
+    uint32_t size;
+
+    fresh();
+    size = put_update(200 * 1024 + 127, 1, 7, 0);
+    EXPECT(SIM_OUTCOME_BOOTED == run("blank main, update"));
+    EXPECT(holds(MAIN_IMAGE_START_ADDRESS, test_image, size));
+
+    fresh();
+    EXPECT(SIM_OUTCOME_HUNG == run("blank device"));
+}
+
+static void test_bad_main(void)
+{
+    fresh();
+    put_main(80 * 1024, 1, 1, 0);
+    ((uint8_t *)MAIN_IMAGE_START_ADDRESS)[40 * 1024] ^= 1;
+    EXPECT(SIM_OUTCOME_HUNG == run("corrupt main"));
+
+    fresh();
+    put_main(80 * 1024, 1, 1, IMAGE_MAKE_BLOCK_TABLE);
+    ((uint8_t *)MAIN_IMAGE_START_ADDRESS)[40 * 1024] ^= 1;
+    EXPECT(SIM_OUTCOME_HUNG == run("corrupt main (block table)"));
+}
+
+static void test_rejected_updates(void)
+{
+    // Older than the main image: rejected from its header, only the main image is hashed
+    fresh();
+    put_main(80 * 1024, 5, 1, 0);
+    put_update(60 * 1024, 4, 2, 0);
+    EXPECT(SIM_OUTCOME_BOOTED == run("downgrade"));
+    EXPECT(5 == header_at(MAIN_IMAGE_START_ADDRESS)->version);
+    EXPECT(1 == count(BOOT_COUNT_VERIFIES_SKIPPED));
+    EXPECT(1 == sim_shared->stats.ecc_verifies);
+    EXPECT(hashed() < (81 * 1024));
+    EXPECT(erased(UPDATE_IMAGE_START_ADDRESS, 60 * 1024));
+
+    // Bad signature
+    fresh();
+    put_main(80 * 1024, 1, 1, 0);
+    put_update(60 * 1024, 2, 2, 0);
+    ((uint8_t *)UPDATE_IMAGE_START_ADDRESS)[MAGIC_NUMBER_LEN] ^= 1;
+    EXPECT(SIM_OUTCOME_BOOTED == run("bad update signature"));
+    EXPECT(1 == header_at(MAIN_IMAGE_START_ADDRESS)->version);
+    EXPECT(erased(UPDATE_IMAGE_START_ADDRESS, 60 * 1024));
+
+    // Bad block in a block table update, found before the main image is touched
+    fresh();
+    put_main(80 * 1024, 1, 1, 0);
+    put_update(900 * 1024, 2, 2, IMAGE_MAKE_BLOCK_TABLE);
+    ((uint8_t *)UPDATE_IMAGE_START_ADDRESS)[(3 * IMAGE_BLOCK_SIZE) + 9] ^= 1;
+    EXPECT(SIM_OUTCOME_BOOTED == run("bad block in update (block table)"));
+    EXPECT(1 == header_at(MAIN_IMAGE_START_ADDRESS)->version);
+    EXPECT(0 == count(BOOT_COUNT_MAIN_BLOCKS_ERASED));
+
+    // Not an image
+    fresh();
+    put_main(80 * 1024, 1, 1, 0);
+    memset((void *)(UPDATE_IMAGE_START_ADDRESS + 0x20000), 0x12, 100);
+    EXPECT(SIM_OUTCOME_BOOTED == run("garbage in the update area"));
+    EXPECT(1 == header_at(MAIN_IMAGE_START_ADDRESS)->version);
+}
+
+static void test_unchanged_blocks(void)
+{
+    uint32_t size;
+    uint32_t blocks;
+
+    // An update differing from the main image in one byte (and its header): the other blocks are left as they are
+    fresh();
+    size = put_main(900 * 1024 + 13, 1, 2, 0);
+    header_at((uint32_t)(uintptr_t)test_image)->version = 2;
+    test_image[500 * 1024] ^= 1;
+    image_sign(test_image);
+    put(UPDATE_IMAGE_START_ADDRESS, test_image, size);
+    blocks = (size + MAIN_IMAGE_ERASE_BLOCK_SIZE - 1) / MAIN_IMAGE_ERASE_BLOCK_SIZE;
+
+    EXPECT(SIM_OUTCOME_BOOTED == run("update, 2 blocks differ"));
+    EXPECT(holds(MAIN_IMAGE_START_ADDRESS, test_image, size));
+    EXPECT(2 == count(BOOT_COUNT_MAIN_BLOCKS_ERASED));
+    EXPECT((blocks - 2) == count(BOOT_COUNT_MAIN_BLOCKS_UNCHANGED));
+}
+
+static void test_crc(void)
+{
+    uint32_t size;
+
+    fresh();
+    put_main(80 * 1024, 1, 1, IMAGE_MAKE_CRC);
+    size = put_update(600 * 1024 + 9, 2, 2, IMAGE_MAKE_CRC);
+    EXPECT(SIM_OUTCOME_BOOTED == run("crc: update"));
+    EXPECT(holds(MAIN_IMAGE_START_ADDRESS, test_image, size));
+    EXPECT(SIM_OUTCOME_BOOTED == run("crc: boot"));
+
+    // A corrupt update fails its CRC and is not hashed
+    fresh();
+    put_main(80 * 1024, 1, 1, 0);
+    put_update(600 * 1024 + 9, 2, 2, IMAGE_MAKE_CRC);
+    ((uint8_t *)UPDATE_IMAGE_START_ADDRESS)[300 * 1024] ^= 0x10;
+    EXPECT(SIM_OUTCOME_BOOTED == run("crc: corrupt update"));
+    EXPECT(1 == header_at(MAIN_IMAGE_START_ADDRESS)->version);
+    EXPECT(1 == sim_shared->stats.ecc_verifies);
+    EXPECT(hashed() < (100 * 1024));
+    EXPECT(erased(UPDATE_IMAGE_START_ADDRESS, IMAGE_HEADER_SIZE));
+}
+
+/*
+ * Delta and compressed updates
+ *
+ *  */
+// Target of a delta update: the main image with two bytes changed and shift bytes inserted (or removed)
+static uint32_t delta_target(uint32_t base_size, int32_t shift)
+{
+    uint32_t size = base_size;
+
+    memcpy(test_target, test_base, base_size);
+    test_target[100 * 1024] ^= 0x55;
+    test_target[100 * 1024 + 1] ^= 0x55;
+    if (shift > 0)
+    {
+        memmove(test_target + (150 * 1024) + shift, test_target + (150 * 1024), base_size - (150 * 1024));
+        memset(test_target + (150 * 1024), 0xA5, (size_t)shift);
+    }
+    else if (shift < 0)
+    {
+        memmove(test_target + (150 * 1024), test_target + (150 * 1024) - shift, base_size - (150 * 1024) + shift);
+    }
+    size = (uint32_t)((int32_t)size + shift);
+
+    header_at((uint32_t)(uintptr_t)test_target)->version = 2;
+    header_at((uint32_t)(uintptr_t)test_target)->length = size - IMAGE_HASH_OFFSET - sizeof(uint32_t);
+    image_sign(test_target);
+
+    return size;
+}
+
+static void test_delta(void)
+{
+    static const int32_t    shifts[] = { 0, 40, -100 };
+    uint32_t                base_size;
+    uint32_t                size;
+    char                    name[40];
+
+    for (uint32_t i = 0; i < (sizeof(shifts) / sizeof(shifts[0])); i++)
+    {
+        fresh();
+        base_size = put_main(300 * 1024 + 9, 1, 1, 0);
+        memcpy(test_base, test_image, base_size);
+        size = delta_target(base_size, shifts[i]);
+        put(UPDATE_IMAGE_START_ADDRESS, test_image, image_make_delta(test_image, test_base, base_size, test_target, size, 0));
+        snprintf(name, sizeof(name), "delta: shift %d", (int)shifts[i]);
+        EXPECT(SIM_OUTCOME_BOOTED == run(name));
+        EXPECT(holds(MAIN_IMAGE_START_ADDRESS, test_target, size));
+        EXPECT(erased(UPDATE_IMAGE_START_ADDRESS, IMAGE_HEADER_SIZE));
+        if (0 == shifts[i])
+        {
+            // The header block and the block changed
+            EXPECT(2 == count(BOOT_COUNT_MAIN_BLOCKS_ERASED));
+        }
+        EXPECT(SIM_OUTCOME_BOOTED == run(NULL));
+        EXPECT(1 == sim_shared->stats.ecc_verifies);
+    }
+
+    // Made from another base: rejected, the main image is left as it is
+    fresh();
+    base_size = put_main(300 * 1024 + 9, 1, 1, 0);
+    memcpy(test_base, test_image, base_size);
+    size = delta_target(base_size, 40);
+    image_make_delta(test_image, test_base, base_size, test_target, size, 0);
+    put(UPDATE_IMAGE_START_ADDRESS, test_image, image_size(test_image));
+    put_main(300 * 1024 + 9, 1, 9, 0);
+    EXPECT(SIM_OUTCOME_BOOTED == run("delta: wrong base"));
+    EXPECT(holds(MAIN_IMAGE_START_ADDRESS, test_image, base_size));
+    EXPECT(0 == count(BOOT_COUNT_MAIN_BLOCKS_ERASED));
+    EXPECT(erased(UPDATE_IMAGE_START_ADDRESS, IMAGE_HEADER_SIZE));
+
+    // Bad signature
+    fresh();
+    base_size = put_main(300 * 1024 + 9, 1, 1, 0);
+    memcpy(test_base, test_image, base_size);
+    size = delta_target(base_size, 40);
+    image_make_delta(test_image, test_base, base_size, test_target, size, 0);
+    test_image[MAGIC_NUMBER_LEN] ^= 1;
+    put(UPDATE_IMAGE_START_ADDRESS, test_image, image_size(test_image));
+    EXPECT(SIM_OUTCOME_BOOTED == run("delta: bad signature"));
+    EXPECT(holds(MAIN_IMAGE_START_ADDRESS, test_base, base_size));
+}
+
+static void test_compressed(void)
+{
+    uint32_t size;
+    uint32_t compressed_size;
+    char     name[48];
+
+    fresh();
+    put_main(80 * 1024, 1, 1, 0);
+    size = image_make(test_target, MAIN_IMAGE_START_ADDRESS, 700 * 1024 + 13, 2, 5, 0);
+    compressed_size = image_make_compressed(test_image, test_target, size, 0);
+    put(UPDATE_IMAGE_START_ADDRESS, test_image, compressed_size);
+    snprintf(name, sizeof(name), "compressed: %u KB in %u KB", size / 1024, compressed_size / 1024);
+    EXPECT(SIM_OUTCOME_BOOTED == run(name));
+    EXPECT(holds(MAIN_IMAGE_START_ADDRESS, test_target, size));
+    EXPECT(erased(UPDATE_IMAGE_START_ADDRESS, IMAGE_HEADER_SIZE));
+    EXPECT(compressed_size < size);
+    EXPECT(SIM_OUTCOME_BOOTED == run(NULL));
+    EXPECT(1 == sim_shared->stats.ecc_verifies);
+
+    // Bad signature
+    fresh();
+    put_main(80 * 1024, 1, 1, 0);
+    image_make_compressed(test_image, test_target, size, 0);
+    test_image[MAGIC_NUMBER_LEN] ^= 1;
+    put(UPDATE_IMAGE_START_ADDRESS, test_image, compressed_size);
+    EXPECT(SIM_OUTCOME_BOOTED == run("compressed: bad signature"));
+    EXPECT(1 == header_at(MAIN_IMAGE_START_ADDRESS)->version);
+}
+
+/*
+ * Power cuts: an update cut short at any flash operation is resumed on the next boot
+ *
+ *  */
+// Boot with the power cut during flash operation cut_op (returns false if the boot ended before it)
+static bool run_cut(uint32_t cut_op)
+{
+    sim_outcome_t outcome;
+
+    sim_shared->power_cut_after_ops = (int32_t)cut_op;
+    outcome = sim_boot();
+    sim_shared->power_cut_after_ops = -1;
+
+    return (SIM_OUTCOME_POWER_CUT == outcome);
+}
+
+// Time of the update phase of the last boot
+static uint64_t update_ns(void)
+{
+    return (sim_shared->record.phase[BOOT_PHASE_UPDATE].cycles * 1000U) / (SIM_CORE_CLOCK_HZ / 1000000U);
+}
+
+static void test_power_cut(void)
+{
+    uint32_t size;
+    uint32_t ops;
+    uint64_t full_ns;
+    uint64_t last_ns;
+    char     name[64];
+
+    // Flash operations of the whole update, uninterrupted
+    fresh();
+    put_main(80 * 1024, 1, 1, 0);
+    size = put_update(900 * 1024 + 13, 2, 2, 0);
+    EXPECT(SIM_OUTCOME_BOOTED == run("power cut: no cut"));
+    ops = sim_shared->stats.flash_ops;
+    full_ns = update_ns();
+    last_ns = full_ns;
+    printf("  update phase %.3f ms\n", (double)full_ns / 1e6);
+
+    // The update phase of the resumed boot falls with the work left, as the copy restarts from the last block
+    // journalled (the erase of the update area after it is the same whatever the cut)
+    for (uint32_t cut = 1; cut < ops; cut += (ops / 12))
+    {
+        fresh();
+        put_main(80 * 1024, 1, 1, 0);
+        put_update(900 * 1024 + 13, 2, 2, 0);
+        EXPECT(run_cut(cut));
+        snprintf(name, sizeof(name), "power cut: op %u of %u, resume", cut, ops);
+        EXPECT(SIM_OUTCOME_BOOTED == run(name));
+        printf("  update phase %.3f ms\n", (double)update_ns() / 1e6);
+        EXPECT(holds(MAIN_IMAGE_START_ADDRESS, test_image, size));
+        EXPECT(erased(UPDATE_IMAGE_START_ADDRESS, IMAGE_HEADER_SIZE));
+        // No longer than after the previous cut (give or take the block in progress), nor the whole update
+        EXPECT(update_ns() <= (last_ns + sim_shared->latency.code_flash_erase_ns +
+                               ((MAIN_IMAGE_ERASE_BLOCK_SIZE / MAIN_FLASH_PROGRAMMING_PAGE_SIZE) *
+                                (uint64_t)sim_shared->latency.code_flash_program_ns)));
+        EXPECT(update_ns() <= full_ns);
+        last_ns = update_ns();
+    }
+    EXPECT(last_ns < (full_ns / 4));
+
+    // Power cut during the resume too
+    for (uint32_t cut = 3; cut < ops; cut += (ops / 5))
+    {
+        fresh();
+        put_main(80 * 1024, 1, 1, 0);
+        put_update(600 * 1024 + 77, 2, 2, IMAGE_MAKE_BLOCK_TABLE);
+        run_cut(cut);
+        run_cut(cut / 2);
+        EXPECT(SIM_OUTCOME_BOOTED == run((cut == 3) ? "power cut: block table, twice" : NULL));
+        EXPECT(holds(MAIN_IMAGE_START_ADDRESS, test_image, image_size(test_image)));
+    }
+}
+
+static void test_power_cut_delta(void)
+{
+    uint32_t base_size;
+    uint32_t size;
+    uint32_t update_size;
+
+    fresh();
+    base_size = put_main(300 * 1024 + 9, 1, 1, 0);
+    memcpy(test_base, test_image, base_size);
+    size = delta_target(base_size, 40);
+    update_size = image_make_delta(test_image, test_base, base_size, test_target, size, 0);
+
+    for (uint32_t cut = 0; cut < 60; cut += 4)
+    {
+        fresh();
+        put(MAIN_IMAGE_START_ADDRESS, test_base, base_size);
+        put(UPDATE_IMAGE_START_ADDRESS, test_image, update_size);
+        run_cut(cut);
+        run_cut((cut / 2) + 1);
+        EXPECT(SIM_OUTCOME_BOOTED == run((0 == cut) ? "power cut: delta, twice" : NULL));
+        EXPECT(holds(MAIN_IMAGE_START_ADDRESS, test_target, size));
+    }
+}
+
+static void test_power_cut_compressed(void)
+{
+    uint32_t size = image_make(test_target, MAIN_IMAGE_START_ADDRESS, 700 * 1024 + 13, 2, 5, 0);
+    uint32_t update_size = image_make_compressed(test_base, test_target, size, 0);
+
+    for (uint32_t cut = 0; cut < 60; cut += 4)
+    {
+        fresh();
+        put_main(80 * 1024, 1, 1, 0);
+        put(UPDATE_IMAGE_START_ADDRESS, test_base, update_size);
+        run_cut(cut);
+        EXPECT(SIM_OUTCOME_BOOTED == run((0 == cut) ? "power cut: compressed" : NULL));
+        EXPECT(holds(MAIN_IMAGE_START_ADDRESS, test_target, size));
+    }
+}
+
+/*
+ * Version floor: the version of the image an update replaces is kept until a new main image verifies, so an older
+ * update cannot be applied over the invalid main image an interrupted or failed copy leaves
+ *
+ *  */
+static void test_version_floor(void)
+{
+    uint32_t ops;
+
+    // Cut the power half way through the copy
+    fresh();
+    put_main(80 * 1024, 5, 1, 0);
+    put_update(900 * 1024, 6, 2, 0);
+    EXPECT(SIM_OUTCOME_BOOTED == run(NULL));
+    ops = sim_shared->stats.flash_ops;
+
+    fresh();
+    put_main(80 * 1024, 5, 1, 0);
+    put_update(900 * 1024, 6, 2, 0);
+    EXPECT(run_cut(ops / 2));
+
+    // The rest of the update is changed before the copy is resumed: the new main image fails its verify
+    ((uint8_t *)UPDATE_IMAGE_START_ADDRESS)[850 * 1024] ^= 1;
+    EXPECT(SIM_OUTCOME_HUNG == run("floor: update changed during the copy"));
+    EXPECT(0 != sim_shared->stats.ecc_verifies);
+
+    // An older update is still rejected
+    put_update(900 * 1024, 4, 3, 0);
+    EXPECT(SIM_OUTCOME_HUNG == run("floor: older update"));
+    EXPECT(0 == sim_shared->stats.code_flash_bytes_programmed);
+    EXPECT(4 != header_at(MAIN_IMAGE_START_ADDRESS)->version);
+    EXPECT(erased(UPDATE_IMAGE_START_ADDRESS, IMAGE_HEADER_SIZE));
+
+    // A newer one is applied
+    put_update(900 * 1024, 7, 3, 0);
+    EXPECT(SIM_OUTCOME_BOOTED == run("floor: newer update"));
+    EXPECT(7 == header_at(MAIN_IMAGE_START_ADDRESS)->version);
+}
+
+#if defined BOOT_CACHE
+/*
+ * Boot cache
+ *
+ *  */
+static void test_boot_cache(void)
+{
+    fresh();
+    put_main(900 * 1024, 1, 1, 0);
+    EXPECT(SIM_OUTCOME_BOOTED == run("cache: first boot"));
+    EXPECT(1 == sim_shared->stats.ecc_verifies);
+
+    for (uint32_t boot = 0; boot < BOOT_CACHE_FULL_VERIFY_INTERVAL; boot++)
+    {
+        EXPECT(SIM_OUTCOME_BOOTED == run((0 == boot) ? "cache: cached boot" : NULL));
+        EXPECT(0 == sim_shared->stats.ecc_verifies);
+#if (0 == BOOT_CACHE_SAMPLE_SIZE)
+        EXPECT(hashed() >= (900 * 1024));
+#else
+        EXPECT(hashed() < (64 * 1024));
+#endif
+    }
+    EXPECT(SIM_OUTCOME_BOOTED == run("cache: full verify at the interval"));
+    EXPECT(1 == sim_shared->stats.ecc_verifies);
+
+    // A change to the fingerprint is found
+    ((uint8_t *)MAIN_IMAGE_START_ADDRESS)[(5 * MAIN_IMAGE_ERASE_BLOCK_SIZE) + 3] ^= 1;
+    EXPECT(SIM_OUTCOME_HUNG == run("cache: fingerprint changed"));
+    ((uint8_t *)MAIN_IMAGE_START_ADDRESS)[(5 * MAIN_IMAGE_ERASE_BLOCK_SIZE) + 3] ^= 1;
+
+    // A change outside the samples is only found by hashing the whole image, a sampled fingerprint boots it until the
+    // next full verify
+    EXPECT(SIM_OUTCOME_BOOTED == run(NULL));
+    ((uint8_t *)MAIN_IMAGE_START_ADDRESS)[(5 * MAIN_IMAGE_ERASE_BLOCK_SIZE) + 1000] ^= 1;
+#if (0 == BOOT_CACHE_SAMPLE_SIZE)
+    EXPECT(SIM_OUTCOME_HUNG == run("cache: changed outside samples"));
+#else
+    EXPECT(SIM_OUTCOME_BOOTED == run("cache: changed outside samples"));
+#endif
+    ((uint8_t *)MAIN_IMAGE_START_ADDRESS)[(5 * MAIN_IMAGE_ERASE_BLOCK_SIZE) + 1000] ^= 1;
+
+    // An update invalidates the record
+    EXPECT(SIM_OUTCOME_BOOTED == run(NULL));
+    put_update(100 * 1024, 2, 4, 0);
+    EXPECT(SIM_OUTCOME_BOOTED == run("cache: update"));
+    EXPECT(SIM_OUTCOME_BOOTED == run("cache: first boot after update"));
+    EXPECT(1 == sim_shared->stats.ecc_verifies);
+    EXPECT(SIM_OUTCOME_BOOTED == run(NULL));
+    EXPECT(0 == sim_shared->stats.ecc_verifies);
+}
+#endif
+
+/*
+ * Stepped verify (Common/image_verifier.c), run here rather than in a boot as an application would run it: each step
+ * budget gives the same result as verify_image()
+ *
+ *  */
+static uint16_t verify_steps(uint32_t budget_bytes)
+{
+    image_verifier_t verifier;
+
+    if (VERIFY_SUCCESS != image_verify_start(&verifier, header_at(MAIN_IMAGE_START_ADDRESS), (uint8_t *)g_public_key,
+                                             bootloader_hash(), bootloader_ecc()))
+    {
+        return VERIFY_FAIL;
+    }
+    while (!image_verify_step(&verifier, budget_bytes))
+    {
+    }
+
+    return image_verify_result(&verifier);
+}
+
+static void test_verify_steps_of(const char * p_name, uint16_t expected)
+{
+    static const uint32_t budgets[] = { 1, 63, 64, 4096 };
+    uint32_t failures = 0;
+
+    verify_image_forget(MAIN_IMAGE_START_ADDRESS);
+    EXPECT(expected == verify_image(header_at(MAIN_IMAGE_START_ADDRESS), (uint8_t *)g_public_key));
+
+    for (uint32_t i = 0; i < (sizeof(budgets) / sizeof(budgets[0])); i++)
+    {
+        if (expected != verify_steps(budgets[i]))
+        {
+            printf("  FAILED %s, step of %u bytes\n", p_name, budgets[i]);
+            failures++;
+        }
+    }
+
+    EXPECT(0 == failures);
+    printf("%-36s %-9s steps of 1, 63, 64 and 4096 bytes %s\n", p_name, (VERIFY_SUCCESS == expected) ? "valid" : "invalid",
+           (0 == failures) ? "ok" : "FAILED");
+}
+
+static void test_verify_steps(void)
+{
+    const hash_instance_t * p_hash_hal = bootloader_hash();
+    const ecc_instance_t *  p_ecc = bootloader_ecc();
+
+    // The boots open the drivers in the bootloader, here they are opened as an application would
+    fresh();
+    EXPECT(SSP_SUCCESS == g_sce.p_api->open(g_sce.p_ctrl, g_sce.p_cfg));
+    EXPECT(SSP_SUCCESS == p_hash_hal->p_api->open(p_hash_hal->p_ctrl, p_hash_hal->p_cfg));
+    EXPECT(SSP_SUCCESS == p_ecc->p_api->open(p_ecc->p_ctrl, p_ecc->p_cfg));
+
+    put_main(70 * 1024 + 5, 1, 1, 0);
+    test_verify_steps_of("verify steps, flat", VERIFY_SUCCESS);
+    test_image[MAGIC_NUMBER_LEN] ^= 1;
+    put(MAIN_IMAGE_START_ADDRESS, test_image, IMAGE_HEADER_SIZE);
+    test_verify_steps_of("verify steps, bad signature", VERIFY_FAIL);
+
+    put_main(70 * 1024 + 5, 1, 1, IMAGE_MAKE_BLOCK_TABLE);
+    test_verify_steps_of("verify steps, block table", VERIFY_SUCCESS);
+    ((uint8_t *)MAIN_IMAGE_START_ADDRESS)[40 * 1024] ^= 1;
+    test_verify_steps_of("verify steps, corrupt block", VERIFY_FAIL);
+
+    // A step of no bytes ends the verify rather than leave the loop above spinning
+    put_main(70 * 1024 + 5, 1, 1, 0);
+    EXPECT(VERIFY_FAIL == verify_steps(0));
+
+    EXPECT(SSP_SUCCESS == p_ecc->p_api->close(p_ecc->p_ctrl));
+    EXPECT(SSP_SUCCESS == p_hash_hal->p_api->close(p_hash_hal->p_ctrl));
+    EXPECT(SSP_SUCCESS == g_sce.p_api->close(g_sce.p_ctrl));
+    verify_image_forget(MAIN_IMAGE_START_ADDRESS);
+}
+
+/*
+ * SHA256 backend: the software backend is used when the SCE hash driver cannot be opened
+ *
+ *  */
+static void test_hash_fallback(void)
+{
+    uint32_t size;
+
+    fresh();
+    put_main(80 * 1024, 1, 1, 0);
+    size = put_update(300 * 1024, 2, 2, 0);
+    sim_shared->sce_hash_fails = true;
+    EXPECT(SIM_OUTCOME_BOOTED == run("SCE hash fails to open, update"));
+    EXPECT(holds(MAIN_IMAGE_START_ADDRESS, test_image, size));
+    EXPECT(0 == sim_shared->stats.hash_calls);
+    EXPECT(hashed() >= size);
+    EXPECT(SIM_OUTCOME_BOOTED == run("SCE hash fails to open"));
+}
+
+#else /* BOOT_AB_SLOTS */
+/*
+ * A/B slots: the newest valid image is booted in place
+ *
+ *  */
+static void put_slots(uint32_t version_a, uint32_t version_b)
+{
+    fresh();
+    if (0 != version_a)
+    {
+        put_image(AB_SLOT_A_ADDRESS, AB_SLOT_A_ADDRESS, 80 * 1024, version_a, 1, 0);
+    }
+    if (0 != version_b)
+    {
+        put_image(AB_SLOT_B_ADDRESS, AB_SLOT_B_ADDRESS, 90 * 1024, version_b, 2, 0);
+    }
+}
+
+static void test_ab_slots(void)
+{
+    put_slots(3, 2);
+    EXPECT(SIM_OUTCOME_BOOTED == run("ab: A newer"));
+    EXPECT(AB_SLOT_A_ADDRESS == sim_shared->booted_image);
+    EXPECT(0 == sim_shared->stats.flash_ops);
+
+    put_slots(3, 4);
+    EXPECT(SIM_OUTCOME_BOOTED == run("ab: B newer"));
+    EXPECT(AB_SLOT_B_ADDRESS == sim_shared->booted_image);
+    EXPECT(1 == sim_shared->stats.ecc_verifies);
+    EXPECT(0 == sim_shared->stats.flash_ops);
+
+    ((uint8_t *)AB_SLOT_B_ADDRESS)[0x4000] ^= 1;
+    EXPECT(SIM_OUTCOME_BOOTED == run("ab: B newer, corrupt"));
+    EXPECT(AB_SLOT_A_ADDRESS == sim_shared->booted_image);
+
+    // An image linked for slot A in slot B
+    put_slots(3, 0);
+    put_image(AB_SLOT_B_ADDRESS, AB_SLOT_A_ADDRESS, 90 * 1024, 4, 2, 0);
+    EXPECT(SIM_OUTCOME_BOOTED == run("ab: B linked for slot A"));
+    EXPECT(AB_SLOT_A_ADDRESS == sim_shared->booted_image);
+
+    put_slots(0, 1);
+    EXPECT(SIM_OUTCOME_BOOTED == run("ab: only B"));
+    EXPECT(AB_SLOT_B_ADDRESS == sim_shared->booted_image);
+
+    put_slots(3, 0);
+    ((uint8_t *)AB_SLOT_A_ADDRESS)[MAGIC_NUMBER_LEN] ^= 1;
+    EXPECT(SIM_OUTCOME_HUNG == run("ab: no valid slot"));
+}
+#endif
+
+int main(void)
+{
+    sim_init();
+    image_init(SIGNING_KEY_FILE);
+
+#if !defined BOOT_AB_SLOTS
+    test_no_update();
+    test_update("update 900 KB", 900 * 1024 + 13, 0);
+    test_update("update 70 KB", 70 * 1024 + 5, 0);
+    test_update("update 900 KB (block table)", 900 * 1024 + 13, IMAGE_MAKE_BLOCK_TABLE);
+    test_blank_main();
+    test_bad_main();
+    test_rejected_updates();
+    test_unchanged_blocks();
+    test_crc();
+    test_delta();
+    test_compressed();
+    test_power_cut();
+    test_power_cut_delta();
+    test_power_cut_compressed();
+    test_version_floor();
+#if defined BOOT_CACHE
+    test_boot_cache();
+#endif
+    test_verify_steps();
+    test_hash_fallback();
+#else
+    test_ab_slots();
+#endif
+
+    printf("%s (%d failures)\n", (0 == test_failures) ? "PASSED" : "FAILED", test_failures);
+
+    return (0 == test_failures) ? 0 : 1;
+}
@@ -0,0 +1,220 @@
+/*
+ * test_sha256.c
+ *
+ * Tests of the incremental SHA256 (Common/sha256_hal.c) built for the host (see README.md), with the simulated SCE
+ * hash driver and the software backend (Common/sha256_sw.c) under it.
+ *
+ * Each message is hashed from every alignment of its first byte, split in two at every byte, and one byte per update,
+ * and the digest checked against the FIPS 180-2 value. The hash driver calls taken for 64 KB not on a 32-bit boundary
+ * are counted, copied through the bounce buffer SHA256_BOUNCE_BUFFER_SIZE bytes at a time and one block at a time.
+ *
+ * Built with SHA256_BENCHMARK for sha256_benchmark().
+ */
+#include "sim.h"
+#include "sha256_hal.h"
+#include <stdio.h>
+
+#define EXPECT(condition)       expect((condition), #condition, __LINE__)
+
+#define TEST_LONG_SIZE          (1000000)
+#define TEST_COUNT_SIZE         (64 * 1024)
+// Split for test_digest(), one byte per update
+#define TEST_SPLIT_BYTES        (UINT32_MAX)
+
+typedef struct test_vector {
+    const char *    p_name;
+    const uint8_t * p_message;
+    uint32_t        length;
+    uint8_t         digest[SHA256_DIGEST_SIZE_BYTES];
+} test_vector_t;
+
+static int      test_failures;
+// Room for a message at any alignment, word aligned so offset 0 is on a 32-bit boundary
+static uint32_t test_buffer[(TEST_LONG_SIZE + 4) / 4];
+static uint8_t  test_mixed[2500];
+static uint8_t  test_long[TEST_LONG_SIZE];
+
+static const uint8_t test_448[] = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+static const uint8_t test_896[] = "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu";
+
+static test_vector_t test_vectors[] =
+{
+    { "empty", (const uint8_t *)"", 0,
+      { 0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14, 0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+        0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c, 0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55 } },
+    { "abc", (const uint8_t *)"abc", 3,
+      { 0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+        0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad } },
+    { "448 bit", test_448, sizeof(test_448) - 1,
+      { 0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8, 0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+        0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67, 0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1 } },
+    { "896 bit", test_896, sizeof(test_896) - 1,
+      { 0xcf, 0x5b, 0x16, 0xa7, 0x78, 0xaf, 0x83, 0x80, 0x03, 0x6c, 0xe5, 0x9e, 0x7b, 0x04, 0x92, 0x37,
+        0x0b, 0x24, 0x9b, 0x11, 0xe8, 0xf0, 0x7a, 0x51, 0xaf, 0xac, 0x45, 0x03, 0x7a, 0xfe, 0xe9, 0xd1 } },
+    // Longer than the bounce buffer, byte i is (i * 31) + (i >> 8)
+    { "2500 bytes", test_mixed, sizeof(test_mixed),
+      { 0x53, 0x91, 0xb0, 0xea, 0xe6, 0xc4, 0x32, 0x8f, 0x8a, 0x03, 0x8e, 0x6c, 0x9e, 0x04, 0x35, 0x72,
+        0xd1, 0xe6, 0x72, 0x67, 0x92, 0x14, 0xd9, 0x6e, 0xa5, 0x82, 0xe2, 0x5f, 0x78, 0xa2, 0x6d, 0x6a } },
+};
+
+// One million 'a', checked at every alignment but split at a few points only
+static test_vector_t test_vector_long =
+{
+    "1M 'a'", test_long, sizeof(test_long),
+    { 0xcd, 0xc7, 0x6e, 0x5c, 0x99, 0x14, 0xfb, 0x92, 0x81, 0xa1, 0xc7, 0xe2, 0x84, 0xd7, 0x3e, 0x67,
+      0xf1, 0x80, 0x9a, 0x48, 0xa4, 0x97, 0x20, 0x0e, 0x04, 0x6d, 0x39, 0xcc, 0xc7, 0x11, 0x2c, 0xd0 }
+};
+
+static void expect(bool condition, const char * p_text, int line)
+{
+    if (!condition)
+    {
+        printf("  FAILED line %d: %s\n", line, p_text);
+        test_failures++;
+    }
+}
+
+/*
+ * test_digest()
+ *
+ * Hash length bytes at p_message, split into an update of split bytes then one of the rest (or updates of one byte
+ * each if split is TEST_SPLIT_BYTES), and check the digest is p_digest.
+ *
+ *  */
+static bool test_digest(const hash_instance_t * p_hash_hal, const uint8_t * p_message, uint32_t length,
+                        uint32_t split, const uint8_t * p_digest)
+{
+    sha256_context_t    ctx;
+    uint8_t             digest[SHA256_DIGEST_SIZE_BYTES];
+    bool                ok = (SSP_SUCCESS == sha256_init(&ctx, p_hash_hal));
+
+    if (TEST_SPLIT_BYTES == split)
+    {
+        for (uint32_t i = 0; ok && (i < length); i++)
+        {
+            ok = (SSP_SUCCESS == sha256_update(&ctx, p_message + i, 1));
+        }
+    }
+    else
+    {
+        ok = ok && (SSP_SUCCESS == sha256_update(&ctx, p_message, split));
+        ok = ok && (SSP_SUCCESS == sha256_update(&ctx, p_message + split, length - split));
+    }
+    ok = ok && (SSP_SUCCESS == sha256_final(&ctx, digest));
+
+    return ok && (0 == memcmp(digest, p_digest, SHA256_DIGEST_SIZE_BYTES));
+}
+
+/*
+ * test_vector()
+ *
+ * Hash a vector from each alignment, split at each of the splits (every byte if p_splits is NULL), and one byte per
+ * update unless the vector is long.
+ *
+ *  */
+static void test_vector(const char * p_backend, const hash_instance_t * p_hash_hal, const test_vector_t * p_vector,
+                        const uint32_t * p_splits, uint32_t num_splits)
+{
+    uint32_t failures = 0;
+    uint32_t digests = 0;
+
+    for (uint32_t offset = 0; offset < 4; offset++)
+    {
+        uint8_t * p_message = (uint8_t *)test_buffer + offset;
+
+        memcpy(p_message, p_vector->p_message, p_vector->length);
+
+        for (uint32_t i = 0; i <= ((NULL == p_splits) ? p_vector->length : (num_splits - 1)); i++)
+        {
+            uint32_t split = (NULL == p_splits) ? i : p_splits[i];
+
+            if (!test_digest(p_hash_hal, p_message, p_vector->length, split, p_vector->digest))
+            {
+                if (0 == failures)
+                {
+                    printf("  FAILED %s, offset %u, split at %u\n", p_vector->p_name, offset, split);
+                }
+                failures++;
+            }
+            digests++;
+        }
+
+        if (NULL == p_splits)
+        {
+            if (!test_digest(p_hash_hal, p_message, p_vector->length, TEST_SPLIT_BYTES, p_vector->digest))
+            {
+                printf("  FAILED %s, offset %u, one byte per update\n", p_vector->p_name, offset);
+                failures++;
+            }
+            digests++;
+        }
+    }
+
+    EXPECT(0 == failures);
+    printf("%-10s %-13s %6u digests %s\n", p_backend, p_vector->p_name, digests, (0 == failures) ? "ok" : "FAILED");
+}
+
+static void test_vectors_on(const char * p_backend, const hash_instance_t * p_hash_hal)
+{
+    static const uint32_t long_splits[] = { 0, 1, 63, 64, 65, 1024, 1025, 999999 };
+
+    for (uint32_t i = 0; i < (sizeof(test_vectors) / sizeof(test_vectors[0])); i++)
+    {
+        test_vector(p_backend, p_hash_hal, &test_vectors[i], NULL, 0);
+    }
+    test_vector(p_backend, p_hash_hal, &test_vector_long, long_splits, sizeof(long_splits) / sizeof(long_splits[0]));
+}
+
+/*
+ * test_driver_calls()
+ *
+ * Hash driver calls for TEST_COUNT_SIZE bytes: in place when aligned, and through the bounce buffer when not, which
+ * sha256_update() fills SHA256_BOUNCE_BUFFER_SIZE bytes at a time rather than one block at a time.
+ *
+ *  */
+static void test_driver_calls(void)
+{
+    sha256_benchmark_t  result;
+    sha256_context_t    ctx;
+    uint32_t            calls;
+
+    EXPECT(SSP_SUCCESS == sha256_benchmark(&g_sce_hash_0, (const uint8_t *)test_buffer, TEST_COUNT_SIZE, &result));
+    EXPECT(1 == result.aligned_calls);
+    EXPECT((TEST_COUNT_SIZE / SHA256_BLOCK_SIZE_BYTES) == result.unaligned_block_calls);
+    EXPECT((TEST_COUNT_SIZE / SHA256_BOUNCE_BUFFER_SIZE) == result.unaligned_batched_calls);
+
+    // sha256_update() itself, counted by the simulated SCE
+    sim_shared->stats.hash_calls = 0;
+    EXPECT(SSP_SUCCESS == sha256_init(&ctx, &g_sce_hash_0));
+    EXPECT(SSP_SUCCESS == sha256_update(&ctx, (const uint8_t *)test_buffer + 1, TEST_COUNT_SIZE));
+    calls = sim_shared->stats.hash_calls;
+    EXPECT((TEST_COUNT_SIZE / SHA256_BOUNCE_BUFFER_SIZE) == calls);
+
+    printf("%u KB unaligned: %u driver calls (%u one block at a time, %u aligned)\n", TEST_COUNT_SIZE / 1024, calls,
+           result.unaligned_block_calls, result.aligned_calls);
+}
+
+int main(void)
+{
+    sim_init();
+
+    for (uint32_t i = 0; i < sizeof(test_mixed); i++)
+    {
+        test_mixed[i] = (uint8_t)((i * 31) + (i >> 8));
+    }
+    memset(test_long, 'a', sizeof(test_long));
+
+    EXPECT(SSP_SUCCESS == g_sce.p_api->open(g_sce.p_ctrl, g_sce.p_cfg));
+    EXPECT(SSP_SUCCESS == g_sce_hash_0.p_api->open(g_sce_hash_0.p_ctrl, g_sce_hash_0.p_cfg));
+
+    test_vectors_on("sce", &g_sce_hash_0);
+    test_vectors_on("software", &g_hash_software);
+    test_driver_calls();
+
+    EXPECT(SSP_SUCCESS == g_sce_hash_0.p_api->close(g_sce_hash_0.p_ctrl));
+    EXPECT(SSP_SUCCESS == g_sce.p_api->close(g_sce.p_ctrl));
+
+    printf("%s (%d failures)\n", (0 == test_failures) ? "PASSED" : "FAILED", test_failures);
+
+    return (0 == test_failures) ? 0 : 1;
+}
@@ -0,0 +1,275 @@
+/*
+ * boot_cache.c
+ *
+ * Record of the last fully verified main image, kept in data flash, so that an unchanged image does not need its
+ * signature checked (or, with BOOT_CACHE_SAMPLE_SIZE, to be fully hashed) on every boot. See BOOT_CACHE in
+ * bootloader.h for what this gives up.
+ *
+ * BOOT_CACHE_ADDRESS layout:
+ *   Record     - BOOT_CACHE_RECORD_SIZE bytes, written once after a full verify
+ *   Boot ticks - One DATA_FLASH_PROGRAMMING_UNIT word programmed per boot that used the record
+ *
+ * Erased data flash does not read as a fixed value, so the record and the ticks are found by blank checking.
+ */
+#include "bootloader.h"
+#include <stddef.h>
+
+#ifdef BOOT_CACHE
+
+#define BOOT_CACHE_MAGIC            0x43425359      // "YSBC"
+#define BOOT_CACHE_RECORD_SIZE      (2 * DATA_FLASH_ERASE_BLOCK_SIZE)
+#define BOOT_CACHE_TICKS_ADDRESS    (BOOT_CACHE_ADDRESS + BOOT_CACHE_RECORD_SIZE)
+#define BOOT_CACHE_TICK             0x00000000
+
+// Vector table of the image, included in the fingerprint along with the header
+#define BOOT_CACHE_VECTOR_TABLE_SIZE    0x400
+
+#if ((BOOT_CACHE_RECORD_SIZE + (BOOT_CACHE_FULL_VERIFY_INTERVAL * DATA_FLASH_PROGRAMMING_UNIT)) > BOOT_CACHE_SIZE)
+#error "BOOT_CACHE_FULL_VERIFY_INTERVAL boot ticks do not fit in BOOT_CACHE_SIZE"
+#endif
+
+typedef struct boot_cache_record {
+    uint32_t magic;
+    uint32_t length;
+    uint32_t version;
+    uint8_t  fingerprint[SHA256_DIGEST_SIZE_BYTES];
+    // SHA-256 of the device unique ID and the fields above, not keyed (see BOOT_CACHE in bootloader.h)
+    uint8_t  tag[SHA256_DIGEST_SIZE_BYTES];
+} boot_cache_record_t;
+
+/*
+ * boot_cache_fingerprint()
+ *
+ * Hash the whole image or, if BOOT_CACHE_SAMPLE_SIZE is not 0, the header and vector table of the image and the first
+ * BOOT_CACHE_SAMPLE_SIZE bytes of each following MAIN_IMAGE_ERASE_BLOCK_SIZE block. The header must already have
+ * been checked with verify_image_header().
+ *
+ *  */
+static ssp_err_t boot_cache_fingerprint(bootloader_image_header_t * p_image_header, uint8_t * p_fingerprint)
+{
+    ssp_err_t           err;
+    sha256_context_t    hash_ctx;
+    uint8_t *           p_image = (uint8_t *)p_image_header;
+    uint32_t            image_size = p_image_header->length + IMAGE_HASH_OFFSET + 4;
+#if (0 == BOOT_CACHE_SAMPLE_SIZE)
+    uint32_t            start_size = image_size;
+#else
+    uint32_t            start_size = IMAGE_HEADER_SIZE + BOOT_CACHE_VECTOR_TABLE_SIZE;
+
+    if (start_size > image_size)
+    {
+        start_size = image_size;
+    }
+#endif
+
+    err = sha256_init(&hash_ctx, bootloader_hash());
+    if (SSP_SUCCESS == err)
+    {
+        err = sha256_update(&hash_ctx, p_image, start_size);
+    }
+
+#if (0 != BOOT_CACHE_SAMPLE_SIZE)
+    for (uint32_t offset = MAIN_IMAGE_ERASE_BLOCK_SIZE; (SSP_SUCCESS == err) && (offset < image_size); offset += MAIN_IMAGE_ERASE_BLOCK_SIZE)
+    {
+        uint32_t sample_size = image_size - offset;
+        if (sample_size > BOOT_CACHE_SAMPLE_SIZE)
+        {
+            sample_size = BOOT_CACHE_SAMPLE_SIZE;
+        }
+
+        err = sha256_update(&hash_ctx, p_image + offset, sample_size);
+    }
+#endif
+
+    if (SSP_SUCCESS == err)
+    {
+        err = sha256_final(&hash_ctx, p_fingerprint);
+    }
+
+    return err;
+}
+
+/*
+ * boot_cache_tag()
+ *
+ * Calculate the tag of a record, binding it to this device.
+ *
+ *  */
+static ssp_err_t boot_cache_tag(boot_cache_record_t * p_record, uint8_t * p_tag)
+{
+    ssp_err_t           err;
+    fmi_unique_id_t     unique_id;
+    sha256_context_t    hash_ctx;
+
+    err = g_fmi.p_api->uniqueIdGet(&unique_id);
+    if (SSP_SUCCESS == err)
+    {
+        err = sha256_init(&hash_ctx, bootloader_hash());
+    }
+    if (SSP_SUCCESS == err)
+    {
+        err = sha256_update(&hash_ctx, (uint8_t *)&unique_id, sizeof(unique_id));
+    }
+    if (SSP_SUCCESS == err)
+    {
+        err = sha256_update(&hash_ctx, (uint8_t *)p_record, offsetof(boot_cache_record_t, tag));
+    }
+    if (SSP_SUCCESS == err)
+    {
+        err = sha256_final(&hash_ctx, p_tag);
+    }
+
+    return err;
+}
+
+/*
+ * boot_cache_check()
+ *
+ * Check the main image against the boot cache record and, if it matches, count this boot against it.
+ *
+ * RETURNS:
+ * - VERIFY_SUCCESS if the record is valid, matches the image and has been used fewer than
+ *   BOOT_CACHE_FULL_VERIFY_INTERVAL times
+ * - VERIFY_FAIL otherwise (the image must be fully verified)
+ *
+ *  */
+static uint16_t boot_cache_check(bootloader_image_header_t * p_image_header)
+{
+    boot_cache_record_t record;
+    uint8_t             digest[SHA256_DIGEST_SIZE_BYTES] BSP_ALIGN_VARIABLE_V2(4);
+    bool                blank = true;
+    uint32_t            tick_addr;
+
+    if (VERIFY_SUCCESS != verify_image_header(p_image_header))
+    {
+        return VERIFY_FAIL;
+    }
+
+    // The whole record must have been written
+    if ((SSP_SUCCESS != data_flash_blank_check(BOOT_CACHE_ADDRESS, sizeof(record), &blank)) || (blank))
+    {
+        return VERIFY_FAIL;
+    }
+
+    memcpy(&record, (void *)BOOT_CACHE_ADDRESS, sizeof(record));
+
+    if ((BOOT_CACHE_MAGIC != record.magic) ||
+        (p_image_header->length != record.length) ||
+        (p_image_header->version != record.version))
+    {
+        return VERIFY_FAIL;
+    }
+
+    if ((SSP_SUCCESS != boot_cache_tag(&record, digest)) || (0 != memcmp(digest, record.tag, sizeof(digest))))
+    {
+        return VERIFY_FAIL;
+    }
+
+    if ((SSP_SUCCESS != boot_cache_fingerprint(p_image_header, digest)) || (0 != memcmp(digest, record.fingerprint, sizeof(digest))))
+    {
+        return VERIFY_FAIL;
+    }
+
+    // Find the first unused tick, if they are all used it is time for a full verify
+    for (tick_addr = BOOT_CACHE_TICKS_ADDRESS; tick_addr < (BOOT_CACHE_TICKS_ADDRESS + (BOOT_CACHE_FULL_VERIFY_INTERVAL * DATA_FLASH_PROGRAMMING_UNIT)); tick_addr += DATA_FLASH_PROGRAMMING_UNIT)
+    {
+        if (SSP_SUCCESS != data_flash_blank_check(tick_addr, DATA_FLASH_PROGRAMMING_UNIT, &blank))
+        {
+            return VERIFY_FAIL;
+        }
+
+        if (blank)
+        {
+            uint32_t tick = BOOT_CACHE_TICK;
+            if (SSP_SUCCESS != data_flash_write((uint32_t)&tick, tick_addr, DATA_FLASH_PROGRAMMING_UNIT))
+            {
+                return VERIFY_FAIL;
+            }
+
+            return VERIFY_SUCCESS;
+        }
+    }
+
+    return VERIFY_FAIL;
+}
+
+/*
+ * boot_cache_store()
+ *
+ * Write a new record for a main image that has just passed a full verify.
+ *
+ *  */
+static void boot_cache_store(bootloader_image_header_t * p_image_header)
+{
+    boot_cache_record_t record;
+    ssp_err_t           err;
+
+    record.magic   = BOOT_CACHE_MAGIC;
+    record.length  = p_image_header->length;
+    record.version = p_image_header->version;
+
+    err = boot_cache_fingerprint(p_image_header, record.fingerprint);
+    if (SSP_SUCCESS == err)
+    {
+        err = boot_cache_tag(&record, record.tag);
+    }
+    if (SSP_SUCCESS == err)
+    {
+        err = data_flash_erase(BOOT_CACHE_ADDRESS, BOOT_CACHE_SIZE / DATA_FLASH_ERASE_BLOCK_SIZE);
+    }
+    if (SSP_SUCCESS == err)
+    {
+        // If this fails, or is interrupted, the record will not be used
+        data_flash_write((uint32_t)&record, BOOT_CACHE_ADDRESS, sizeof(record));
+    }
+}
+
+/*
+ * boot_cache_verify_main_image()
+ *
+ * Verify the main image, using the boot cache record if it matches.
+ * If the record cannot be used the image is fully verified with verify_image() and the record replaced.
+ *
+ * IN:
+ *  - p_public_key  - Public key used for a full verify
+ *
+ * RETURNS:
+ * - VERIFY_SUCCESS if the image matches the record or passes a full verify
+ * - VERIFY_FAIL otherwise
+ *
+ *  */
+uint16_t boot_cache_verify_main_image(uint8_t * p_public_key)
+{
+    bootloader_image_header_t * p_image_header = (bootloader_image_header_t *)MAIN_IMAGE_START_ADDRESS;
+    uint16_t                    result;
+
+    if (VERIFY_SUCCESS == boot_cache_check(p_image_header))
+    {
+        return VERIFY_SUCCESS;
+    }
+
+    result = verify_image(p_image_header, p_public_key);
+    if (VERIFY_SUCCESS == result)
+    {
+        boot_cache_store(p_image_header);
+    }
+    else
+    {
+        boot_cache_invalidate();
+    }
+
+    return result;
+}
+
+/*
+ * boot_cache_invalidate()
+ *
+ * Erase the boot cache record, so the next boot makes a full verify of the main image.
+ *
+ *  */
+void boot_cache_invalidate(void)
+{
+    data_flash_erase(BOOT_CACHE_ADDRESS, BOOT_CACHE_SIZE / DATA_FLASH_ERASE_BLOCK_SIZE);
+}
+
+#endif /* BOOT_CACHE */
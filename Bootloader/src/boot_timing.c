@@ -0,0 +1,104 @@
+/*
+ * boot_timing.c
+ *
+ * Boot phase timing with the DWT cycle counter, see boot_timing_record.h for the record left for the application.
+ *
+ * The cycle counter is 32 bits (about 20 seconds at 200MHz), shorter than an update can take. Each phase is
+ * timed separately, and the total is kept in 64 bits by adding the counter difference each time it is read.
+ */
+#include "boot_timing.h"
+#include <string.h>
+#include <stddef.h>
+
+#ifdef BOOT_TIMING
+
+static boot_timing_record_t boot_timing_record BSP_PLACE_IN_SECTION_V2(".boot_record");
+
+static uint32_t boot_timing_last_cycles;
+
+/*
+ * boot_timing_init()
+ *
+ * Start the DWT cycle counter and clear the record. Called first in hal_entry().
+ * The record magic is cleared, so an application started after a failed boot does not see an old record.
+ *
+ *  */
+void boot_timing_init(void)
+{
+    memset(&boot_timing_record, 0, sizeof(boot_timing_record));
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    boot_timing_last_cycles = 0;
+}
+
+/*
+ * boot_timing_now()
+ *
+ * Returns the current cycle count, to pass to boot_timing_add() at the end of a phase.
+ *
+ *  */
+uint32_t boot_timing_now(void)
+{
+    uint32_t now = DWT->CYCCNT;
+
+    boot_timing_record.total_cycles += (uint32_t)(now - boot_timing_last_cycles);
+    boot_timing_last_cycles = now;
+
+    return now;
+}
+
+/*
+ * boot_timing_add()
+ *
+ * Add the cycles since start_cycles (from boot_timing_now()) and bytes to phase.
+ *
+ *  */
+void boot_timing_add(boot_phase_t phase, uint32_t start_cycles, uint32_t bytes)
+{
+    uint32_t now = boot_timing_now();
+
+    boot_timing_record.phase[phase].cycles += (uint32_t)(now - start_cycles);
+    boot_timing_record.phase[phase].bytes  += bytes;
+    boot_timing_record.phase[phase].calls++;
+}
+
+/*
+ * boot_timing_count()
+ *
+ * Add one to a counter.
+ *
+ *  */
+void boot_timing_count(boot_count_t count)
+{
+    boot_timing_record.count[count]++;
+}
+
+/*
+ * boot_timing_complete()
+ *
+ * Complete the record just before the jump to the application.
+ *
+ *  */
+void boot_timing_complete(void)
+{
+    const uint32_t * p_word = (const uint32_t *)&boot_timing_record;
+    uint32_t sum = 0;
+
+    boot_timing_now();
+
+    boot_timing_record.format        = BOOT_TIMING_RECORD_FORMAT;
+    boot_timing_record.phase_count   = BOOT_PHASE_COUNT;
+    boot_timing_record.core_clock_hz = SystemCoreClock;
+    boot_timing_record.magic         = BOOT_TIMING_RECORD_MAGIC;
+
+    for (uint32_t i=0; i<(offsetof(boot_timing_record_t, check) / 4); i++)
+    {
+        sum += p_word[i];
+    }
+    boot_timing_record.check = ~sum;
+}
+
+#endif /* BOOT_TIMING */
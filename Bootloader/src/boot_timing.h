@@ -0,0 +1,34 @@
+/*
+ * boot_timing.h
+ *
+ * Boot phase timing with the DWT cycle counter, left for the application in the boot timing record
+ * (see boot_timing_record.h).
+ *
+ * A phase is timed by taking boot_timing_now() before it and passing the value to boot_timing_add() after it.
+ */
+
+#ifndef BOOT_TIMING_H_
+#define BOOT_TIMING_H_
+
+#include "hal_data.h"
+#include "boot_timing_record.h"
+
+// Undefine below to remove the boot timing instrumentation. The functions below then do nothing and no record is
+// written (the application will not find BOOT_TIMING_RECORD_MAGIC).
+#define BOOT_TIMING
+
+#ifdef BOOT_TIMING
+void boot_timing_init(void);
+uint32_t boot_timing_now(void);
+void boot_timing_add(boot_phase_t phase, uint32_t start_cycles, uint32_t bytes);
+void boot_timing_count(boot_count_t count);
+void boot_timing_complete(void);
+#else
+static inline void boot_timing_init(void) {}
+static inline uint32_t boot_timing_now(void) { return 0; }
+static inline void boot_timing_add(boot_phase_t phase, uint32_t start_cycles, uint32_t bytes) { (void)phase; (void)start_cycles; (void)bytes; }
+static inline void boot_timing_count(boot_count_t count) { (void)count; }
+static inline void boot_timing_complete(void) {}
+#endif
+
+#endif /* BOOT_TIMING_H_ */
@@ -7,124 +7,333 @@
 // Prototype for function pointer to the image
 typedef int (*main_fnptr)(void);
 
+#ifdef BOOT_AB_SLOTS
+#if defined(UPDATE_USES_QSPI_FLASH) || (UPDATE_IMAGE_MAX_SIZE != MAIN_IMAGE_MAX_SIZE)
+#error "BOOT_AB_SLOTS needs an internal update area the same size as the main image area"
+#endif
+
+/*
+ * ab_slot_check()
+ *
+ * Check if a slot holds an image that could be booted from it (before it is verified): a header for a version 0 or 1
+ * image, and a reset vector inside the slot.
+ *
+ * RETURNS:
+ * - VERIFY_SUCCESS if the slot can be booted once the image is verified
+ * - VERIFY_FAIL otherwise
+ *
+ *  */
+static uint16_t ab_slot_check(uint32_t slot_address)
+{
+    bootloader_image_header_t * p_image_header = (bootloader_image_header_t *)slot_address;
+    bool                        blank_status = true;
+
+    if ((SSP_SUCCESS != blank_check_image_area(slot_address, IMAGE_BLANK_CHECK_SIZE, &blank_status)) || (blank_status))
+    {
+        return VERIFY_FAIL;
+    }
+
+    if ((VERIFY_SUCCESS != verify_image_header(p_image_header)) ||
+        ((IMAGE_HEADER_VERSION_FLAT != p_image_header->header_version) && (IMAGE_HEADER_VERSION_BLOCK_TABLE != p_image_header->header_version)))
+    {
+        return VERIFY_FAIL;
+    }
+
+    // An image linked for the other slot would run from there
+    uint32_t reset_vector = *(uint32_t *)(slot_address + IMAGE_HEADER_SIZE + 4);
+    if ((reset_vector < (slot_address + IMAGE_HEADER_SIZE)) || (reset_vector >= (slot_address + AB_SLOT_SIZE)))
+    {
+        return VERIFY_FAIL;
+    }
+
+    return VERIFY_SUCCESS;
+}
+
+/*
+ * boot_newest_slot()
+ *
+ * Boot the slot holding the highest image version (slot A if they are the same) if it passes verification, or else
+ * the other slot. Does not return.
+ *
+ *  */
+static void boot_newest_slot(void)
+{
+    static const uint32_t   slot_address[2] = { AB_SLOT_A_ADDRESS, AB_SLOT_B_ADDRESS };
+    bool                    slot_valid[2];
+    uint32_t                first = 0;
+
+    slot_valid[0] = (VERIFY_SUCCESS == ab_slot_check(slot_address[0]));
+    slot_valid[1] = (VERIFY_SUCCESS == ab_slot_check(slot_address[1]));
+
+    if (slot_valid[1] && ((!slot_valid[0]) ||
+        (((bootloader_image_header_t *)slot_address[1])->version > ((bootloader_image_header_t *)slot_address[0])->version)))
+    {
+        first = 1;
+    }
+
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        uint32_t slot = first ^ i;
+
+        if (slot_valid[slot] && (VERIFY_SUCCESS == verify_image((bootloader_image_header_t *)slot_address[slot], (uint8_t *)g_public_key)))
+        {
+            boot_application(slot_address[slot]);
+        }
+    }
+
+    // STOP!
+    // Neither slot holds a valid image
+    while(1);
+}
+#endif /* BOOT_AB_SLOTS */
+
 void boot(void)
 {
+#ifdef BOOT_AB_SLOTS
+    // Images are booted from the slot they are in, nothing is copied
+    boot_newest_slot();
+#else
     bool        blank_status;
     ssp_err_t   err;
 
     // Blank check the update image area to see if there might be a valid update image to process.
-    err = blank_check_image_area(UPDATE_IMAGE_START_ADDRESS, &blank_status);
+    err = blank_check_image_area(UPDATE_IMAGE_START_ADDRESS, IMAGE_BLANK_CHECK_SIZE, &blank_status);
     if (SSP_SUCCESS == err)
     {
         if (false == blank_status)
         {
             // No - update image area not blank.
-            // Check if update area contains a valid image.
-            if (VERIFY_SUCCESS == verify_image((bootloader_image_header_t *)UPDATE_IMAGE_START_ADDRESS, (uint8_t *)g_public_key))
+            // Has a copy of this update into the main application area been interrupted?
+            // If so the copy is continued without verifying the update image again, the new main image is
+            // verified when the copy completes.
+            // Delta and compressed updates are always verified again, as the target they are checked against is in
+            // their header.
+            bool update_resume = update_journal_matches((bootloader_image_header_t *)UPDATE_IMAGE_START_ADDRESS);
+            uint32_t update_header_version = ((bootloader_image_header_t *)UPDATE_IMAGE_START_ADDRESS)->header_version;
+            bool update_is_delta = (IMAGE_HEADER_VERSION_DELTA == update_header_version);
+            bool update_is_compressed = (IMAGE_HEADER_VERSION_COMPRESSED == update_header_version);
+            bool update_verified = (update_resume && !update_is_delta && !update_is_compressed);
+
+            // Cheap checks first: the structure of the update header, then (below) its version against the current
+            // image, so an update that would be rejected anyway is not hashed and its signature not checked.
+            if (update_verified || (VERIFY_SUCCESS == verify_image_header((bootloader_image_header_t *)UPDATE_IMAGE_START_ADDRESS)))
             {
-                //  Yes - valid update image
+                //  Yes - update image header good
 
                 uint32_t main_application_version = 0;
+                bool     main_image_valid = false;
 
-                // Is the main application area blank?
-                bool main_area_blank_status = false;
-                err = blank_check_image_area(MAIN_IMAGE_START_ADDRESS, &main_area_blank_status);
-                if (err == SSP_SUCCESS)
+                if (update_resume)
                 {
-                    if (false == main_area_blank_status)
+                    // Continuing an interrupted copy, so the main image is incomplete.
+                    // Use the version of the image it replaced, recorded when the copy was started.
+                    main_application_version = update_journal_version_floor();
+                }
+                else
+                {
+                    // Is the main application area blank?
+                    bool main_area_blank_status = false;
+                    err = blank_check_image_area(MAIN_IMAGE_START_ADDRESS, IMAGE_BLANK_CHECK_SIZE, &main_area_blank_status);
+                    if (err == SSP_SUCCESS)
                     {
-                        // Main area is not blank.
-                        // Verify the application image.
-                        if (VERIFY_SUCCESS == verify_image((bootloader_image_header_t *)MAIN_IMAGE_START_ADDRESS, (uint8_t *)g_public_key))
+                        if (false == main_area_blank_status)
                         {
-                            // Main image is valid so the version number in the header can be used.
-                            bootloader_image_header_t * p_current_image_header;
-                            p_current_image_header = (bootloader_image_header_t *)MAIN_IMAGE_START_ADDRESS;
-                            main_application_version = p_current_image_header->version;
+                            // Main area is not blank.
+                            // Verify the application image.
+                            if (VERIFY_SUCCESS == verify_image((bootloader_image_header_t *)MAIN_IMAGE_START_ADDRESS, (uint8_t *)g_public_key))
+                            {
+                                // Main image is valid so the version number in the header can be used.
+                                bootloader_image_header_t * p_current_image_header;
+                                p_current_image_header = (bootloader_image_header_t *)MAIN_IMAGE_START_ADDRESS;
+                                main_application_version = p_current_image_header->version;
+                                main_image_valid = true;
+                            }
+                            else
+                            {
+                                // Main application failed verification
+                                // Set the version to zero (or to the version of the image being replaced by an
+                                // interrupted copy, see below) so the main area will be erased and replaced with the
+                                // update
+                                //
+                                // NOTE:
+                                // This is an area of weakness.
+                                // This could allow an unwanted down grade to a previous version.
+                                // Scenario:
+                                //  Valid update image in the upgrade area with a version equal or higher than the
+                                //  current version.
+                                //  Bootloader starts to erase main application area so this area will fail future
+                                //  validation.
+                                //  Device is stopped before applying the new image.
+                                //  The update image is swapped with one with an earlier version number.
+                                //  Restarting the bootloader will result in the application image being invalid and
+                                //  erased and the older update being applied.
+                                // This is an issue if it is possible to replace the update image without the need of
+                                // the application.
+                                // When the update is in internal memory then this scenario can be mitigated against.
+                                // If the update is in external memory then consider preventing an update if there is not
+                                // a valid image in the application area. This does come with a risk of being able to
+                                // brick the device.
+                                // The trade-off is between recovering from a corrupted application image (from an
+                                // interrupted update) against a down grade attack.
+                                // To prevent this possible attack at the risk of bricking stop at this point.
+                                //
+                                // The update journal closes the scenario above: the copy records the version of the
+                                // image it is replacing before the main area is touched, and that version is used
+                                // here until the copy completes.
+                                main_application_version = update_journal_version_floor();
+                            }
                         }
                         else
                         {
-                            // Main application failed verification
-                            // Set the version to zero so the main area will be erased and replaced with the update
-                            //
-                            // NOTE:
-                            // This is an area of weakness.
-                            // This could allow an unwanted down grade to a previous version.
-                            // Scenario:
-                            //  Valid update image in the upgrade area with a version equal or higher than the
-                            //  current version.
-                            //  Bootloader starts to erase main application area so this area will fail future
-                            //  validation.
-                            //  Device is stopped before applying the new image.
-                            //  The update image is swapped with one with an earlier version number.
-                            //  Restarting the bootloader will result in the application image being invalid and
-                            //  erased and the older update being applied.
-                            // This is an issue if it is possible to replace the update image without the need of
-                            // the application.
-                            // When the update is in internal memory then this scenario can be mitigated against.
-                            // If the update is in external memory then consider preventing an update if there is not
-                            // a valid image in the application area. This does come with a risk of being able to
-                            // brick the device.
-                            // The trade-off is between recovering from a corrupted application image (from an
-                            // interrupted update) against a down grade attack.
-                            // To prevent this possible attack at the risk of bricking stop at this point.
-                            main_application_version = 0;
+                            // Main area is blank so assume version as 0, unless an interrupted copy erased it
+                            main_application_version = update_journal_version_floor();
                         }
                     }
-                    else
-                    {
-                        // Main area is blank so assume version as 0
-                        main_application_version = 0;
-                    }
                 }
 
                 //  Is new version greater or equal to the current version?
                 bootloader_image_header_t * p_update_image_header;
                 p_update_image_header = (bootloader_image_header_t *)UPDATE_IMAGE_START_ADDRESS;
-                if (p_update_image_header->version >= main_application_version)
+
+                // Size of the update image (+ 4 for the length value itself)
+                uint32_t update_size = p_update_image_header->length + SIGNATURE_LEN_BYTES + MAGIC_NUMBER_LEN + 4;
+
+                // Only an update with a good version number is verified
+                bool update_older = (p_update_image_header->version < main_application_version);
+                if (update_older)
                 {
-                    //  Yes - version number good
-                    //  Erase primary application slot
-                    err = SSP_SUCCESS;
-                    if (false == main_area_blank_status)
+                    boot_timing_count(BOOT_COUNT_VERIFIES_SKIPPED);
+                }
+                else if (!update_verified)
+                {
+                    update_verified = (VERIFY_SUCCESS == verify_image(p_update_image_header, (uint8_t *)g_public_key));
+                }
+
+                // A delta update must also be for the current main image (checked before the main image is changed, so
+                // not when continuing an interrupted update)
+                if (update_verified && !update_older &&
+                    (update_resume || (VERIFY_SUCCESS == delta_update_check(p_update_image_header, main_image_valid))))
+                {
+                    //  Yes - valid update image, version number good
+#ifdef BOOT_CACHE
+                    // The main image is about to change, so the next normal boot must fully verify it
+                    boot_cache_invalidate();
+#endif
+                    verify_image_forget(MAIN_IMAGE_START_ADDRESS);
+                    // Copy new image into the primary image area
+                    // The blocks of the primary application slot the new image will occupy are erased as it is
+                    // programmed (blocks already blank are skipped)
+                    // Progress is recorded in the update journal, if the copy is interrupted it is continued from the
+                    // last block completed
+                    update_journal_t journal;
+                    uint16_t         main_image_verify = VERIFY_FAIL;
+                    uint32_t         update_start_cycles = boot_timing_now();
+
+                    err = update_journal_open(p_update_image_header, main_application_version, &journal);
+                    if (update_is_delta)
                     {
-                        err = erase_main_image_area();
+                        // Rebuild the main image in place from the patch, then check it against the target in the
+                        // header of the update
+                        if (SSP_SUCCESS == err)
+                        {
+                            err = delta_update_apply(p_update_image_header, &journal);
+                            if (SSP_SUCCESS == err)
+                            {
+                                main_image_verify = delta_update_verify(p_update_image_header);
+                            }
+                            else if (SSP_ERR_INVALID_DATA == err)
+                            {
+                                // Patch rejected
+                                err = SSP_SUCCESS;
+                            }
+                        }
                     }
-
-                    if (SSP_SUCCESS == err)
+                    else if (update_is_compressed)
                     {
-                        // Copy new image into the primary image area (+ 4 for the length value itself)
-                        uint32_t update_size = p_update_image_header->length + SIGNATURE_LEN_BYTES + MAGIC_NUMBER_LEN + 4;
-
-                        err = flash_main_image_from_update_area(UPDATE_IMAGE_START_ADDRESS, update_size);
+                        // Decompress the new image block by block into the main image area, hashing it as it is
+                        // programmed
                         if (SSP_SUCCESS == err)
                         {
-                            // Verify new application image
-                            if (VERIFY_SUCCESS == verify_image((bootloader_image_header_t *)MAIN_IMAGE_START_ADDRESS, (uint8_t *)g_public_key))
+                            err = compressed_update_apply(p_update_image_header, &journal, &main_image_verify);
+                            if (SSP_ERR_INVALID_DATA == err)
                             {
-                                // Verify pass
-                                // Erase update image area
-                                erase_update_image_area(UPDATE_IMAGE_START_ADDRESS);
+                                // Compressed data rejected
+                                err = SSP_SUCCESS;
+                            }
+                        }
+                    }
+                    else
+                    {
+#ifdef UPDATE_FUSED_COPY_VERIFY
+                        // Program and check the new image in one pass, the check is of the programmed main image area
+                        // A block table image stops the copy at the first block that does not match its hash
+                        image_copy_verify_t copy_verify;
 
-                                // Boot new application
-                                boot_main_application();
+                        if ((SSP_SUCCESS == err) && (VERIFY_SUCCESS == image_copy_verify_start(&copy_verify, p_update_image_header, (uint8_t *)g_public_key)))
+                        {
+                            err = flash_main_image_from_update_area_and_check(UPDATE_IMAGE_START_ADDRESS, update_size, &copy_verify.check, &journal);
+                            if (SSP_SUCCESS == err)
+                            {
+                                main_image_verify = image_copy_verify_end(&copy_verify, (uint8_t *)g_public_key);
                             }
-                            else
+                            else if (SSP_ERR_INVALID_DATA == err)
                             {
-                                // Verify fail
-                                // Reboot to attempt update again
-                                NVIC_SystemReset();
+                                // Copy stopped by a block that failed its check
+                                err = SSP_SUCCESS;
                             }
                         }
+#else
+                        if (SSP_SUCCESS == err)
+                        {
+                            err = flash_main_image_from_update_area(UPDATE_IMAGE_START_ADDRESS, update_size, &journal);
+                            if (SSP_SUCCESS == err)
+                            {
+                                // Verify new application image
+                                main_image_verify = verify_image((bootloader_image_header_t *)MAIN_IMAGE_START_ADDRESS, (uint8_t *)g_public_key);
+                            }
+                        }
+#endif
+                    }
+                    boot_timing_add(BOOT_PHASE_UPDATE, update_start_cycles, update_size);
+
+                    if (SSP_SUCCESS == err)
+                    {
+                        if (VERIFY_SUCCESS == main_image_verify)
+                        {
+                            // Verify pass
+                            // Erase update image area
+                            verify_image_forget(UPDATE_IMAGE_START_ADDRESS);
+                            erase_update_image_area(UPDATE_IMAGE_START_ADDRESS, update_size);
+
+                            // Update complete
+                            update_journal_close();
+
+                            // Boot new application
+                            boot_main_application();
+                        }
+                        else
+                        {
+                            // Verify fail
+                            // Reboot to attempt update again, copying the whole image
+                            // The journal keeps the version of the replaced image, so an older update is still
+                            // rejected
+                            update_journal_fail();
+                            NVIC_SystemReset();
+                        }
                     }
                 }
                 else
                 {
-                    // No - version number bad
+                    // No - version number bad, invalid update image, or a delta update not made from the current main
+                    // image
                     // Erase update image area
-                    erase_update_image_area(UPDATE_IMAGE_START_ADDRESS);
+                    // The length of an update that has not been verified (failed, or skipped as older) cannot be
+                    // trusted so erase the whole area
+                    verify_image_forget(UPDATE_IMAGE_START_ADDRESS);
+                    erase_update_image_area(UPDATE_IMAGE_START_ADDRESS, update_verified ? update_size : 0);
 
-                    // Boot original application (including verify check of this image)
+                    // Boot original application (including verify check of this image, already done above unless
+                    // continuing an interrupted update)
                     if (VERIFY_SUCCESS == verify_image((bootloader_image_header_t *)MAIN_IMAGE_START_ADDRESS, (uint8_t *)g_public_key))
                     {
                         // Verify pass
@@ -142,10 +351,12 @@ void boot(void)
             }
             else
             {
-                // No - invalid update image
+                // No - invalid update image header
                 // Erase update image area
                 // Boot original application (including verify check of this image)
-                erase_update_image_area(UPDATE_IMAGE_START_ADDRESS);
+                // The header cannot be trusted so erase the whole area
+                verify_image_forget(UPDATE_IMAGE_START_ADDRESS);
+                erase_update_image_area(UPDATE_IMAGE_START_ADDRESS, 0);
                 // Boot original application (including verify check of this image)
                 if (VERIFY_SUCCESS == verify_image((bootloader_image_header_t *)MAIN_IMAGE_START_ADDRESS, (uint8_t *)g_public_key))
                 {
@@ -164,7 +375,11 @@ void boot(void)
         {
             // Update area blank
             // Boot original application (including verify check of this image)
+#ifdef BOOT_CACHE
+            if (VERIFY_SUCCESS == boot_cache_verify_main_image((uint8_t *)g_public_key))
+#else
             if (VERIFY_SUCCESS == verify_image((bootloader_image_header_t *)MAIN_IMAGE_START_ADDRESS, (uint8_t *)g_public_key))
+#endif
             {
                 // Verify pass
                 boot_main_application();
@@ -193,29 +408,52 @@ void boot(void)
             while(1);
         }
     }
+#endif /* BOOT_AB_SLOTS */
 }
 
 void boot_main_application(void)
+{
+    boot_application(MAIN_IMAGE_START_ADDRESS);
+}
+
+/*
+ * boot_application()
+ *
+ * Close the drivers and jump to the verified image at image_address (the main image area, or an A/B slot), setting
+ * the vector table and stack from the image. Does not return.
+ *
+ *  */
+void boot_application(uint32_t image_address)
 {
     main_fnptr *p_jump_to_app; // Function pointer main that will be used to jump to application
+    uint32_t handoff_start = boot_timing_now();
+
+    const hash_instance_t * p_hash = bootloader_hash();
+    const ecc_instance_t *  p_ecc = bootloader_ecc();
+
+    // Close the flash and QSPI drivers, open since their first use in this boot
+    storage_session_close();
 
     // Close the hash driver
-    g_sce_hash_0.p_api->close(g_sce_hash_0.p_ctrl);
+    p_hash->p_api->close(p_hash->p_ctrl);
 
     // Close the ECC driver
-    g_sce_ecc_0.p_api->close(g_sce_ecc_0.p_ctrl);
+    p_ecc->p_api->close(p_ecc->p_ctrl);
 
     // Close the SCE
     g_sce.p_api->close(g_sce.p_ctrl);
 
     /* point to the start reset vector of the new image */
-    p_jump_to_app = (main_fnptr*)(MAIN_IMAGE_START_ADDRESS + IMAGE_HEADER_SIZE + 4);
+    p_jump_to_app = (main_fnptr*)(image_address + IMAGE_HEADER_SIZE + 4);
+
+    boot_timing_add(BOOT_PHASE_HANDOFF, handoff_start, 0);
+    boot_timing_complete();
 
     /* Disable interrupts */
     __disable_irq();
 
     uint32_t * p_VTOR = (uint32_t *)0xE000ED08U;
-    *p_VTOR = (uint32_t)(MAIN_IMAGE_START_ADDRESS + IMAGE_HEADER_SIZE);
+    *p_VTOR = (uint32_t)(image_address + IMAGE_HEADER_SIZE);
 
     __DSB();
 
@@ -223,7 +461,7 @@ void boot_main_application(void)
     R_SPMON->MSPMPUCTL = (uint16_t)0x0000;
 
     /* Set stack here. */
-    __set_MSP(*((uint32_t*)(MAIN_IMAGE_START_ADDRESS + IMAGE_HEADER_SIZE)));
+    __set_MSP(*((uint32_t*)(image_address + IMAGE_HEADER_SIZE)));
     /* Jump to image*/
     (*p_jump_to_app)();
 
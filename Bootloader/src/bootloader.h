@@ -9,32 +9,92 @@
 #include "sha256_hal.h"
 #include <string.h>
 #include "port.h"
+#include "image_header.h"
+#include "image_verifier.h"
+#include "boot_timing.h"
 
 #ifndef BOOTLOADER_H_
 #define BOOTLOADER_H_
 
-#define MAGIC_NUMBER            "YASB"
-#define MAGIC_NUMBER_LEN        4
+// Number of bytes blank checked to decide if an image area holds an image.
+// Only the header needs to be checked as no image can be valid without one, so a normal boot with no pending
+// update reads just the header of the update area. Set to UPDATE_IMAGE_MAX_SIZE to blank check the whole area.
+#define IMAGE_BLANK_CHECK_SIZE  IMAGE_HEADER_SIZE
 
-#define SIGNATURE_LEN           (2 * ECC_256_SIGNATURE_R_LENGTH_WORDS)
-#define SIGNATURE_LEN_BYTES     (4 * SIGNATURE_LEN)
+// Undefine below to verify the main image with a separate pass after it has been programmed from the update area.
+// When defined the new main image is hashed as it is programmed and only the signature check is done afterwards.
+#define UPDATE_FUSED_COPY_VERIFY
 
-#define IMAGE_HEADER_SIZE       0x100
+// Define below to skip the signature check of an unchanged main image when there is no update to process.
+// After the main image passes a full verify a record of it is kept in data flash (BOOT_CACHE_ADDRESS). Later boots
+// only hash a fingerprint of the image and compare it with the record. The full verify is made again on a mismatch,
+// after an update and every BOOT_CACHE_FULL_VERIFY_INTERVAL boots.
+// BOOT_CACHE trades integrity for speed. The record is bound to the device by its unique ID, which is not a secret,
+// and its tag is an unkeyed SHA256, so anyone able to write both code and data flash can make an unsigned image boot.
+// Only define it where the application cannot be made to write arbitrary code and data flash.
+// With BOOT_CACHE_SAMPLE_SIZE 0 the fingerprint is the hash of the whole image, so a cached boot saves the ECC verify
+// and any other change to the image is found. A non-zero BOOT_CACHE_SAMPLE_SIZE hashes only the header, the vector
+// table and that many bytes at the start of each erase block: a change anywhere else in code flash is not found until
+// the next full verify, up to BOOT_CACHE_FULL_VERIFY_INTERVAL boots later.
+//#define BOOT_CACHE
+#define BOOT_CACHE_FULL_VERIFY_INTERVAL     16
+#define BOOT_CACHE_SAMPLE_SIZE              0
 
-#define VERIFY_SUCCESS          0x5A3C
-#define VERIFY_FAIL             0
+// Define below to boot images in place from two slots rather than copying updates into the main image area.
+// Slot A is the main image area and slot B the (internal) update area. The application writes an update into the slot
+// it is not running from, and the bootloader boots the slot with the highest version that passes verification, falling
+// back to the other slot if it fails. Nothing is erased or copied by the bootloader.
+// Each image must be linked for the slot it is in (see APP_SLOT_B in PK_S5D9_BL_Blinky/script/s5d9.ld), an image with
+// a reset vector outside its slot is not booted. Delta and compressed updates cannot be used.
+//#define BOOT_AB_SLOTS
+#define AB_SLOT_A_ADDRESS       MAIN_IMAGE_START_ADDRESS
+#define AB_SLOT_B_ADDRESS       UPDATE_IMAGE_START_ADDRESS
+#define AB_SLOT_SIZE            MAIN_IMAGE_MAX_SIZE
 
-typedef struct bootloader_image_header {
-    uint32_t magic_number;
-    uint32_t signature[SIGNATURE_LEN];
-    uint32_t length;
-    uint32_t version;
-} bootloader_image_header_t;
+// Define below to hash images with the software SHA256 backend (sha256_sw.c) rather than the SCE hash driver.
+// When undefined the software backend is still used if the SCE hash driver fails to open (see hal_entry()).
+//#define BOOTLOADER_HASH_SOFTWARE
+
+// Check of a new main image as it is programmed from the update image (see flash_main_image_from_update_area_and_check())
+typedef struct image_copy_verify {
+    image_copy_check_t          check;
+    bootloader_image_header_t * p_image_header;     // RAM copy of the header of the update image
+    sha256_context_t            hash_ctx;
+    uint32_t                    blocks_checked;
+} image_copy_verify_t;
+
+// Number of bytes of an image hashed by each step of verify_image() (see image_verify_step())
+#define IMAGE_VERIFY_STEP_SIZE  (IMAGE_BLOCK_SIZE)
 
 extern const uint8_t g_public_key[ECC_256_PUBLIC_KEY_LENGTH_WORDS * sizeof(uint32_t)];
 
+const hash_instance_t * bootloader_hash(void);
+void bootloader_hash_use_software(void);
+const ecc_instance_t * bootloader_ecc(void);
 uint16_t verify_image(bootloader_image_header_t * p_image_header, uint8_t * p_public_key);
+uint16_t verify_image_crc(bootloader_image_header_t * p_image_header);
+void verify_image_forget(uint32_t image_address);
+uint16_t verify_image_signature(bootloader_image_header_t * p_image_header, uint8_t * p_hash, uint8_t * p_public_key);
+uint16_t verify_image_block_table(bootloader_image_header_t * p_image_header, uint8_t * p_table, uint8_t * p_public_key);
+uint16_t verify_image_block(bootloader_image_header_t * p_image_header, uint8_t * p_table, uint32_t block);
+uint16_t image_copy_verify_start(image_copy_verify_t * p_verify, bootloader_image_header_t * p_update_header, uint8_t * p_public_key);
+uint16_t image_copy_verify_end(image_copy_verify_t * p_verify, uint8_t * p_public_key);
+uint16_t boot_cache_verify_main_image(uint8_t * p_public_key);
+void boot_cache_invalidate(void);
+bool update_journal_matches(bootloader_image_header_t * p_update_header);
+uint32_t update_journal_version_floor(void);
+ssp_err_t update_journal_open(bootloader_image_header_t * p_update_header, uint32_t previous_version, update_journal_t * p_journal);
+void update_journal_close(void);
+void update_journal_fail(void);
+ssp_err_t update_journal_block_done(update_journal_t * p_journal, uint32_t block);
+ssp_err_t update_journal_backup_done(update_journal_t * p_journal, uint32_t block);
+bool update_journal_backup_valid(update_journal_t * p_journal, uint32_t block);
+uint16_t delta_update_check(bootloader_image_header_t * p_delta_header, bool main_image_valid);
+ssp_err_t delta_update_apply(bootloader_image_header_t * p_delta_header, update_journal_t * p_journal);
+uint16_t delta_update_verify(bootloader_image_header_t * p_delta_header);
+ssp_err_t compressed_update_apply(bootloader_image_header_t * p_update_header, update_journal_t * p_journal, uint16_t * p_main_image_verify);
 void boot(void);
 void boot_main_application(void);
+void boot_application(uint32_t image_address);
 
 #endif /* BOOTLOADER_H_ */
@@ -0,0 +1,252 @@
+/*
+ * compressed_update.c
+ *
+ * Compressed updates: an update image (header version 3) holding a new main image (the target) compressed one
+ * MAIN_IMAGE_ERASE_BLOCK_SIZE block at a time, so each block of the target can be decompressed into RAM on its own,
+ * programmed, and an interrupted copy continued from any block.
+ *
+ * The compressed blocks follow the header, up to the end of the image, one for each block of the target:
+ *   Size   - 4 bytes, number of bytes of compressed data
+ *   Data   - Size bytes in the LZ4 block format, padded to a multiple of 4 bytes
+ * Each block decompresses to exactly the size of its block of the target (the last block can be shorter). Matches
+ * only refer back to earlier data of the same block.
+ *
+ * The target is hashed as it is programmed (from the main image area) and checked against the target digest in the
+ * signed header, so the new main image does not need a separate verify.
+ */
+#include "bootloader.h"
+
+#define LZ4_MIN_MATCH           4
+#define LZ4_LENGTH_MASK         0x0F
+
+// The target block being decompressed
+static uint8_t compressed_block[MAIN_IMAGE_ERASE_BLOCK_SIZE] BSP_ALIGN_VARIABLE_V2(4);
+
+/*
+ * lz4_length()
+ *
+ * Add the extra bytes of a literal or match length that does not fit in its token (length is LZ4_LENGTH_MASK).
+ *
+ *  */
+static bool lz4_length(const uint8_t ** pp_in, const uint8_t * p_in_end, uint32_t * p_length)
+{
+    uint8_t extra;
+
+    do
+    {
+        if (*pp_in >= p_in_end)
+        {
+            return false;
+        }
+
+        extra = *(*pp_in)++;
+        *p_length += extra;
+    } while ((255 == extra) && (*p_length <= MAIN_IMAGE_ERASE_BLOCK_SIZE));
+
+    return true;
+}
+
+/*
+ * lz4_decompress_block()
+ *
+ * Decompress in_length bytes at p_in into compressed_block, which must then hold exactly out_length bytes.
+ *
+ * RETURNS:
+ * - true if the block decompressed to out_length bytes
+ * - false if the data is invalid
+ *
+ *  */
+static bool lz4_decompress_block(const uint8_t * p_in, uint32_t in_length, uint32_t out_length)
+{
+    const uint8_t * p_in_end = p_in + in_length;
+    uint32_t        out = 0;
+
+    while (p_in < p_in_end)
+    {
+        uint8_t  token = *p_in++;
+        uint32_t length = (uint32_t)(token >> 4);
+
+        // Literals
+        if ((LZ4_LENGTH_MASK == length) && (!lz4_length(&p_in, p_in_end, &length)))
+        {
+            return false;
+        }
+
+        if ((length > (uint32_t)(p_in_end - p_in)) || (length > (out_length - out)))
+        {
+            return false;
+        }
+
+        memcpy(&compressed_block[out], p_in, length);
+        p_in += length;
+        out += length;
+
+        // The last sequence has no match
+        if (p_in == p_in_end)
+        {
+            break;
+        }
+
+        // Match
+        if (2 > (p_in_end - p_in))
+        {
+            return false;
+        }
+
+        uint32_t distance = (uint32_t)p_in[0] | ((uint32_t)p_in[1] << 8);
+        p_in += 2;
+
+        length = token & LZ4_LENGTH_MASK;
+        if ((LZ4_LENGTH_MASK == length) && (!lz4_length(&p_in, p_in_end, &length)))
+        {
+            return false;
+        }
+        length += LZ4_MIN_MATCH;
+
+        if ((0 == distance) || (distance > out) || (length > (out_length - out)))
+        {
+            return false;
+        }
+
+        // Byte by byte, a match can overlap the bytes it produces
+        for (uint32_t i = 0; i < length; i++)
+        {
+            compressed_block[out] = compressed_block[out - distance];
+            out++;
+        }
+    }
+
+    return (out == out_length);
+}
+
+/*
+ * compressed_blocks_check()
+ *
+ * Check there is one compressed block for each block of the target, and that they end at the end of the image.
+ *
+ *  */
+static bool compressed_blocks_check(bootloader_image_header_t * p_update_header, uint32_t block_count)
+{
+    uint32_t pos = (uint32_t)p_update_header + IMAGE_HEADER_SIZE;
+    uint32_t end = (uint32_t)p_update_header + p_update_header->length + IMAGE_HASH_OFFSET + sizeof(p_update_header->length);
+
+    for (uint32_t block = 0; block < block_count; block++)
+    {
+        if ((end - pos) < 4)
+        {
+            return false;
+        }
+
+        uint32_t size = (*(uint32_t *)pos + 3) & ~3U;
+        if ((size < *(uint32_t *)pos) || (size > ((end - pos) - 4)))
+        {
+            return false;
+        }
+
+        pos += 4 + size;
+    }
+
+    return (pos == end);
+}
+
+/*
+ * compressed_update_apply()
+ *
+ * Decompress the target of a compressed update image into the main image area, continuing from the first block not
+ * recorded as done in the journal. Blocks that already hold their target are not erased or programmed (see
+ * UPDATE_SKIP_UNCHANGED_BLOCKS).
+ * The whole main image area the target occupies is hashed as it is programmed and checked against the signed header.
+ *
+ * IN:
+ * - p_update_header    - Header of the update image, already verified
+ * - p_journal          - Journal opened for the update image
+ *
+ * OUT:
+ * - p_main_image_verify    - VERIFY_SUCCESS if the main image is the target, VERIFY_FAIL otherwise
+ *
+ * RETURNS:
+ * - SSP_SUCCESS if the target has been programmed
+ * - SSP_ERR_INVALID_DATA if the compressed data is invalid (found before the main image area is changed, unless
+ *   the data of a later block is invalid)
+ * - Error values returned from flash driver or hash driver if an operation fails
+ *
+ *  */
+ssp_err_t compressed_update_apply(bootloader_image_header_t * p_update_header, update_journal_t * p_journal, uint16_t * p_main_image_verify)
+{
+    ssp_err_t           err;
+    sha256_context_t    hash_ctx;
+    uint32_t            hash[SHA256_DIGEST_SIZE_BYTES / 4];
+    uint32_t            target_length = p_update_header->target_length;
+    uint32_t            block_count = (target_length + (MAIN_IMAGE_ERASE_BLOCK_SIZE - 1)) / MAIN_IMAGE_ERASE_BLOCK_SIZE;
+    uint32_t            pos = (uint32_t)p_update_header + IMAGE_HEADER_SIZE;
+
+    *p_main_image_verify = VERIFY_FAIL;
+
+    if (!compressed_blocks_check(p_update_header, block_count))
+    {
+        return SSP_ERR_INVALID_DATA;
+    }
+
+    err = sha256_init(&hash_ctx, bootloader_hash());
+
+    for (uint32_t block = 0; (SSP_SUCCESS == err) && (block < block_count); block++)
+    {
+        uint32_t block_start = block * MAIN_IMAGE_ERASE_BLOCK_SIZE;
+        uint32_t block_length = target_length - block_start;
+        uint32_t size = *(uint32_t *)pos;
+
+        if (block_length > MAIN_IMAGE_ERASE_BLOCK_SIZE)
+        {
+            block_length = MAIN_IMAGE_ERASE_BLOCK_SIZE;
+        }
+
+        if (block >= p_journal->blocks_done)
+        {
+            if (!lz4_decompress_block((const uint8_t *)(pos + 4), size, block_length))
+            {
+                return SSP_ERR_INVALID_DATA;
+            }
+
+            // Pad the end of the image to a whole programming page
+            uint32_t padded_length = (block_length + (MAIN_FLASH_PROGRAMMING_PAGE_SIZE - 1)) & ~(uint32_t)(MAIN_FLASH_PROGRAMMING_PAGE_SIZE - 1);
+            memset(&compressed_block[block_length], ERASED_STATE, padded_length - block_length);
+
+            if (!main_image_block_unchanged(block_start, (uint32_t)compressed_block, padded_length))
+            {
+                err = flash_main_image_block(block_start, (uint32_t)compressed_block, padded_length);
+            }
+
+            if (SSP_SUCCESS == err)
+            {
+                err = update_journal_block_done(p_journal, block);
+            }
+        }
+
+        // Hash the block as programmed
+        if (SSP_SUCCESS == err)
+        {
+            err = sha256_update(&hash_ctx, (uint8_t *)(MAIN_IMAGE_START_ADDRESS + block_start), block_length);
+        }
+
+        pos += 4 + ((size + 3) & ~3U);
+    }
+
+    if (SSP_SUCCESS == err)
+    {
+        err = sha256_final(&hash_ctx, (uint8_t *)hash);
+    }
+
+    if (SSP_SUCCESS == err)
+    {
+        bootloader_image_header_t * p_main_header = (bootloader_image_header_t *)MAIN_IMAGE_START_ADDRESS;
+
+        if ((0 == memcmp(hash, p_update_header->target_digest, sizeof(hash))) &&
+            (VERIFY_SUCCESS == verify_image_header(p_main_header)) &&
+            ((p_main_header->length + IMAGE_HASH_OFFSET + sizeof(p_main_header->length)) == target_length))
+        {
+            *p_main_image_verify = VERIFY_SUCCESS;
+        }
+    }
+
+    return err;
+}
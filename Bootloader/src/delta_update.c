@@ -0,0 +1,379 @@
+/*
+ * delta_update.c
+ *
+ * Delta updates: an update image (header version 2) holding a patch that rebuilds a new main image (the target)
+ * from the current main image (the base) in place, one MAIN_IMAGE_ERASE_BLOCK_SIZE block at a time.
+ *
+ * The header identifies the base by its version, total size and signature, and holds the total size and SHA256 of
+ * the target. The patch follows the header, up to the end of the image. It is a list of ops, each producing the next
+ * bytes of the target:
+ *   COPY   - Op word (length), then the offset in the base image to copy length bytes from
+ *   INSERT - Op word (DELTA_OP_INSERT | length), then length bytes of data, padded to a multiple of 4 bytes
+ * The ops produce exactly target_length bytes, and no op crosses a target block boundary.
+ *
+ * Blocks are rebuilt in order, so when target block N is rebuilt base blocks before N have already been replaced.
+ * A COPY into target block N must therefore have a source at or after base block N. A source in base block N itself
+ * is lost when the block is erased, so before block N is erased the base block is copied to DELTA_BACKUP_ADDRESS in
+ * data flash, and read from there if the rebuild of the block is interrupted and resumed.
+ *
+ * Progress is kept in the update journal in the same way as a full copy (see update_journal.c).
+ */
+#include "bootloader.h"
+
+#define DELTA_OP_INSERT         (0x80000000U)
+#define DELTA_OP_LENGTH_MASK    (0x7FFFFFFFU)
+
+// Size of the RAM buffer a base block is copied to data flash through
+#define DELTA_BACKUP_CHUNK_SIZE (1024)
+
+#if ((DELTA_BACKUP_ADDRESS + DELTA_BACKUP_SIZE) > (DATA_FLASH_START_ADDRESS + DATA_FLASH_SIZE))
+#error "DELTA_BACKUP_SIZE does not fit in data flash"
+#endif
+
+// The target block being rebuilt
+static uint8_t delta_block[MAIN_IMAGE_ERASE_BLOCK_SIZE] BSP_ALIGN_VARIABLE_V2(4);
+
+// Position in the patch
+typedef struct delta_patch {
+    uint32_t pos;           // Address of the next op
+    uint32_t end;           // End of the delta image
+    uint32_t out;           // Target offset produced by the next op
+} delta_patch_t;
+
+typedef struct delta_op {
+    bool     insert;
+    uint32_t length;
+    uint32_t out;           // Target offset the op produces
+    uint32_t src;           // COPY - Offset in the base image, INSERT - Address of the data
+} delta_op_t;
+
+/*
+ * delta_patch_start()
+ *
+ * Start reading the patch of a delta image. The header must already have been checked.
+ *
+ *  */
+static void delta_patch_start(bootloader_image_header_t * p_delta_header, delta_patch_t * p_patch)
+{
+    p_patch->pos = (uint32_t)p_delta_header + IMAGE_HEADER_SIZE;
+    p_patch->end = (uint32_t)p_delta_header + p_delta_header->length + IMAGE_HASH_OFFSET + sizeof(p_delta_header->length);
+    p_patch->out = 0;
+}
+
+/*
+ * delta_patch_next()
+ *
+ * Read the next op of the patch and check it against the rules above.
+ *
+ * RETURNS:
+ * - true with the op in p_op
+ * - false if the op is invalid, or would run past the end of the delta image
+ *
+ *  */
+static bool delta_patch_next(bootloader_image_header_t * p_delta_header, delta_patch_t * p_patch, delta_op_t * p_op)
+{
+    uint32_t block_start = p_patch->out - (p_patch->out % MAIN_IMAGE_ERASE_BLOCK_SIZE);
+    uint32_t op;
+
+    if ((p_patch->end - p_patch->pos) < 4)
+    {
+        return false;
+    }
+
+    op = *(uint32_t *)p_patch->pos;
+    p_op->insert = (0 != (op & DELTA_OP_INSERT));
+    p_op->length = op & DELTA_OP_LENGTH_MASK;
+    p_op->out    = p_patch->out;
+
+    if ((0 == p_op->length) ||
+        (p_op->length > ((block_start + MAIN_IMAGE_ERASE_BLOCK_SIZE) - p_patch->out)) ||
+        (p_op->length > (p_delta_header->target_length - p_patch->out)))
+    {
+        return false;
+    }
+
+    if (p_op->insert)
+    {
+        uint32_t padded_length = (p_op->length + 3) & ~3U;
+
+        if ((p_patch->end - (p_patch->pos + 4)) < padded_length)
+        {
+            return false;
+        }
+
+        p_op->src = p_patch->pos + 4;
+        p_patch->pos += 4 + padded_length;
+    }
+    else
+    {
+        if ((p_patch->end - p_patch->pos) < 8)
+        {
+            return false;
+        }
+
+        p_op->src = *(uint32_t *)(p_patch->pos + 4);
+
+        // The source must not have been replaced yet, and must be within the base image
+        if ((p_op->src < block_start) || (p_op->src > p_delta_header->base_length) ||
+            (p_op->length > (p_delta_header->base_length - p_op->src)))
+        {
+            return false;
+        }
+
+        p_patch->pos += 8;
+    }
+
+    p_patch->out += p_op->length;
+
+    return true;
+}
+
+/*
+ * delta_update_check()
+ *
+ * Check an update image can be applied to the main image.
+ * An image that is not a delta can always be applied. A delta can only be applied to the base image it was made
+ * from, and its patch must be valid, so that a bad patch is found before the main image is changed.
+ *
+ * IN:
+ * - p_delta_header     - Header of the update image, already verified
+ * - main_image_valid   - true if the main image passed verification
+ *
+ * RETURNS:
+ * - VERIFY_SUCCESS if the update can be applied
+ * - VERIFY_FAIL otherwise
+ *
+ *  */
+uint16_t delta_update_check(bootloader_image_header_t * p_delta_header, bool main_image_valid)
+{
+    bootloader_image_header_t * p_main_header = (bootloader_image_header_t *)MAIN_IMAGE_START_ADDRESS;
+    delta_patch_t               patch;
+    delta_op_t                  op;
+
+    if (IMAGE_HEADER_VERSION_DELTA != p_delta_header->header_version)
+    {
+        return VERIFY_SUCCESS;
+    }
+
+    if ((!main_image_valid) ||
+        (p_main_header->version != p_delta_header->base_version) ||
+        ((p_main_header->length + IMAGE_HASH_OFFSET + sizeof(p_main_header->length)) != p_delta_header->base_length) ||
+        (0 != memcmp(p_main_header->signature, p_delta_header->base_signature, sizeof(p_main_header->signature))))
+    {
+        return VERIFY_FAIL;
+    }
+
+    delta_patch_start(p_delta_header, &patch);
+    while (patch.out < p_delta_header->target_length)
+    {
+        if (!delta_patch_next(p_delta_header, &patch, &op))
+        {
+            return VERIFY_FAIL;
+        }
+    }
+
+    // Nothing may follow the last op
+    if (patch.pos != patch.end)
+    {
+        return VERIFY_FAIL;
+    }
+
+    return VERIFY_SUCCESS;
+}
+
+/*
+ * delta_backup_block()
+ *
+ * Copy length bytes of the main image block at offset to DELTA_BACKUP_ADDRESS and record it in the journal.
+ *
+ *  */
+static ssp_err_t delta_backup_block(update_journal_t * p_journal, uint32_t block, uint32_t offset, uint32_t length)
+{
+    static uint8_t  chunk[DELTA_BACKUP_CHUNK_SIZE] BSP_ALIGN_VARIABLE_V2(4);
+    ssp_err_t       err;
+
+    length = (length + (DATA_FLASH_ERASE_BLOCK_SIZE - 1)) & ~(uint32_t)(DATA_FLASH_ERASE_BLOCK_SIZE - 1);
+
+    err = data_flash_erase(DELTA_BACKUP_ADDRESS, length / DATA_FLASH_ERASE_BLOCK_SIZE);
+
+    for (uint32_t done = 0; (SSP_SUCCESS == err) && (done < length); done += DELTA_BACKUP_CHUNK_SIZE)
+    {
+        uint32_t chunk_size = length - done;
+        if (chunk_size > DELTA_BACKUP_CHUNK_SIZE)
+        {
+            chunk_size = DELTA_BACKUP_CHUNK_SIZE;
+        }
+
+        memcpy(chunk, (void *)(MAIN_IMAGE_START_ADDRESS + offset + done), chunk_size);
+        err = data_flash_write((uint32_t)chunk, DELTA_BACKUP_ADDRESS + done, chunk_size);
+    }
+
+    if (SSP_SUCCESS == err)
+    {
+        err = update_journal_backup_done(p_journal, block);
+    }
+
+    return err;
+}
+
+/*
+ * delta_update_apply()
+ *
+ * Rebuild the main image from the base image already there and the patch of a delta update image, continuing from
+ * the first block not recorded as done in the journal. delta_update_check() must already have passed (before the
+ * journal was opened). Blocks that already hold their target are not erased or programmed (see
+ * UPDATE_SKIP_UNCHANGED_BLOCKS).
+ *
+ * IN:
+ * - p_delta_header - Header of the update image
+ * - p_journal      - Journal opened for the update image
+ *
+ * RETURNS:
+ * - SSP_SUCCESS if the main image has been rebuilt, it must then be checked with delta_update_verify()
+ * - SSP_ERR_INVALID_DATA if the patch is invalid
+ * - Error values returned from flash driver if flash operation fails
+ *
+ *  */
+ssp_err_t delta_update_apply(bootloader_image_header_t * p_delta_header, update_journal_t * p_journal)
+{
+    ssp_err_t       err = SSP_SUCCESS;
+    delta_patch_t   patch;
+    delta_op_t      op;
+    uint32_t        block_count = (p_delta_header->target_length + (MAIN_IMAGE_ERASE_BLOCK_SIZE - 1)) / MAIN_IMAGE_ERASE_BLOCK_SIZE;
+
+    delta_patch_start(p_delta_header, &patch);
+
+    for (uint32_t block = 0; (SSP_SUCCESS == err) && (block < block_count); block++)
+    {
+        uint32_t block_start = block * MAIN_IMAGE_ERASE_BLOCK_SIZE;
+        uint32_t block_end = block_start + MAIN_IMAGE_ERASE_BLOCK_SIZE;
+        bool     rebuild = (block >= p_journal->blocks_done);
+        // An interrupted rebuild of this block may have destroyed it, the copy made before it was erased is used
+        bool     from_backup = rebuild && update_journal_backup_valid(p_journal, block);
+        bool     uses_own_block = false;
+
+        if (block_end > p_delta_header->target_length)
+        {
+            block_end = p_delta_header->target_length;
+        }
+
+        while (patch.out < block_end)
+        {
+            if (!delta_patch_next(p_delta_header, &patch, &op))
+            {
+                return SSP_ERR_INVALID_DATA;
+            }
+
+            if (!rebuild)
+            {
+                // Block already done, skip its ops
+                continue;
+            }
+
+            uint8_t * p_dest = &delta_block[op.out - block_start];
+
+            if (op.insert)
+            {
+                memcpy(p_dest, (void *)op.src, op.length);
+            }
+            else
+            {
+                uint32_t src = op.src;
+                uint32_t length = op.length;
+
+                if (src < (block_start + MAIN_IMAGE_ERASE_BLOCK_SIZE))
+                {
+                    // Part of the source is in the base block being replaced
+                    uint32_t own_length = (block_start + MAIN_IMAGE_ERASE_BLOCK_SIZE) - src;
+                    if (own_length > length)
+                    {
+                        own_length = length;
+                    }
+
+                    uses_own_block = true;
+                    memcpy(p_dest, (void *)((from_backup ? DELTA_BACKUP_ADDRESS : (MAIN_IMAGE_START_ADDRESS + block_start)) + (src - block_start)), own_length);
+                    p_dest += own_length;
+                    src += own_length;
+                    length -= own_length;
+                }
+
+                // Later base blocks have not been changed yet
+                memcpy(p_dest, (void *)(MAIN_IMAGE_START_ADDRESS + src), length);
+            }
+        }
+
+        if (!rebuild)
+        {
+            continue;
+        }
+
+        // Pad the end of the image to a whole programming page
+        uint32_t program_length = block_end - block_start;
+        uint32_t padded_length = (program_length + (MAIN_FLASH_PROGRAMMING_PAGE_SIZE - 1)) & ~(uint32_t)(MAIN_FLASH_PROGRAMMING_PAGE_SIZE - 1);
+        memset(&delta_block[program_length], ERASED_STATE, padded_length - program_length);
+
+        if (!main_image_block_unchanged(block_start, (uint32_t)delta_block, padded_length))
+        {
+            if (uses_own_block && !from_backup)
+            {
+                uint32_t backup_length = p_delta_header->base_length - block_start;
+                if (backup_length > MAIN_IMAGE_ERASE_BLOCK_SIZE)
+                {
+                    backup_length = MAIN_IMAGE_ERASE_BLOCK_SIZE;
+                }
+
+                err = delta_backup_block(p_journal, block, block_start, backup_length);
+            }
+
+            if (SSP_SUCCESS == err)
+            {
+                err = flash_main_image_block(block_start, (uint32_t)delta_block, padded_length);
+            }
+        }
+
+        if (SSP_SUCCESS == err)
+        {
+            err = update_journal_block_done(p_journal, block);
+        }
+    }
+
+    return err;
+}
+
+/*
+ * delta_update_verify()
+ *
+ * Check the main image rebuilt by delta_update_apply() against the target size and SHA256 in the signed header of
+ * the delta update image.
+ *
+ * IN:
+ * - p_delta_header - Header of the update image
+ *
+ * RETURNS:
+ * - VERIFY_SUCCESS if the main image is the target image
+ * - VERIFY_FAIL otherwise
+ *
+ *  */
+uint16_t delta_update_verify(bootloader_image_header_t * p_delta_header)
+{
+    bootloader_image_header_t * p_main_header = (bootloader_image_header_t *)MAIN_IMAGE_START_ADDRESS;
+    uint32_t                    hash[SHA256_DIGEST_SIZE_BYTES / 4];
+
+    if ((VERIFY_SUCCESS != verify_image_header(p_main_header)) ||
+        ((p_main_header->length + IMAGE_HASH_OFFSET + sizeof(p_main_header->length)) != p_delta_header->target_length))
+    {
+        return VERIFY_FAIL;
+    }
+
+    if (SSP_SUCCESS != sha256_hash(bootloader_hash(), (uint8_t *)p_main_header, p_delta_header->target_length, (uint8_t *)hash))
+    {
+        return VERIFY_FAIL;
+    }
+
+    if (0 != memcmp(hash, p_delta_header->target_digest, sizeof(hash)))
+    {
+        return VERIFY_FAIL;
+    }
+
+    return VERIFY_SUCCESS;
+}
@@ -7,6 +7,9 @@ void hal_entry(void)
 {
     ssp_err_t err;
 
+    boot_timing_init();
+    uint32_t driver_open_start = boot_timing_now();
+
     // Open the SCE driver
     err = g_sce.p_api->open(g_sce.p_ctrl, g_sce.p_cfg);
     if (SSP_SUCCESS != err)
@@ -16,7 +19,8 @@ void hal_entry(void)
     }
 
     /* Open the ECC driver  - plaintext key support */
-    err = g_sce_ecc_0.p_api->open(g_sce_ecc_0.p_ctrl, g_sce_ecc_0.p_cfg);
+    const ecc_instance_t * p_ecc = bootloader_ecc();
+    err = p_ecc->p_api->open(p_ecc->p_ctrl, p_ecc->p_cfg);
     if (SSP_SUCCESS != err)
     {
         // If opening the ECC driver fails, stop. Cannot verify any image without ECC support.
@@ -24,12 +28,22 @@ void hal_entry(void)
     }
 
     /* Open the hash driver */
-    err = g_sce_hash_0.p_api->open(g_sce_hash_0.p_ctrl, g_sce_hash_0.p_cfg);
+    const hash_instance_t * p_hash = bootloader_hash();
+    err = p_hash->p_api->open(p_hash->p_ctrl, p_hash->p_cfg);
     if (SSP_SUCCESS != err)
     {
-        __BKPT(0);
+        // The SCE hash is not available, hash with the (slower) software SHA256 instead
+        bootloader_hash_use_software();
+        p_hash = bootloader_hash();
+        err = p_hash->p_api->open(p_hash->p_ctrl, p_hash->p_cfg);
+        if (SSP_SUCCESS != err)
+        {
+            __BKPT(0);
+        }
     }
 
+    boot_timing_add(BOOT_PHASE_DRIVER_OPEN, driver_open_start, 0);
+
 
 #if defined _BL_TESTING
 
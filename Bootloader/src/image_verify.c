@@ -20,49 +20,290 @@
     # The Length field is from (and including) the Version field
     # So, total size of the image is:
     # Length + 4 (Length field) + 64 (Signature) + 4 (Magic Number)
+    #
+    # Header version 1 (block table) images start the padding with:
+    # Header version - 4 bytes (1)
+    # Block size     - 4 bytes (IMAGE_BLOCK_SIZE)
+    # Block count    - 4 bytes
+    # and end with a table of Block count SHA256 hashes (32 bytes each), one for each block of the image before the
+    # table (the first block from the Length field). The table is included in the Length.
+    # The Signature is of the header (from the Length field) followed by the table.
+    #
+    # Any image can carry a CRC-32 in its header padding (offset 0xC4 Crc magic - 4 bytes, IMAGE_CRC_MAGIC, then
+    # Image CRC - 4 bytes) of the data after the header, up to the block table of a version 1 image.
  *
  *  */
 
-/* Recommended Parameters secp256k1
+// Results of verify_image() for the images verified in this boot, see verify_memo_find()
+#define VERIFY_MEMO_ENTRIES         2   // The main image and update image areas (the A/B slots are the same areas)
+#define VERIFY_MEMO_KEY_SIZE        (IMAGE_HASH_OFFSET + 12)    // Magic number, signature, Length, Version and Header version
+
+typedef struct verify_memo {
+    uint32_t    address;        // Address of the image, 0 if the entry is not used
+    uint8_t *   p_public_key;
+    uint8_t     key[VERIFY_MEMO_KEY_SIZE];
+    uint16_t    result;
+} verify_memo_t;
+
+static verify_memo_t verify_memo[VERIFY_MEMO_ENTRIES];
+
+// RAM copies of the header and block table of an image being copied, see image_copy_verify_start()
+static uint8_t image_copy_header[IMAGE_HEADER_SIZE] BSP_ALIGN_VARIABLE_V2(4);
+static uint8_t image_copy_block_table[IMAGE_BLOCK_TABLE_MAX_SIZE] BSP_ALIGN_VARIABLE_V2(4);
+
+/*
+ * bootloader_hash()
  *
- *  Curve E: y^2 = x^3 +ax + b
+ * The hash driver instance used for all image hashing.
+ * It is the SCE hash driver, or the software backend (g_hash_software) with BOOTLOADER_HASH_SOFTWARE or after
+ * bootloader_hash_use_software().
+ * When testing (_BL_TESTING) the SCE hash driver API is replaced by g_hash_on_sce_test, in the same way as the flash
+ * driver is replaced by g_flash_on_flash_hp_test in port.c, so the bootloader can be run against a test or simulated
+ * driver.
  *
- */
-uint8_t domain[ECC_256_DOMAIN_PARAMETER_WITH_ORDER_LENGTH_WORDS * sizeof(uint32_t)] =
+ *  */
+static bool bootloader_hash_software = false;
+
+const hash_instance_t * bootloader_hash(void)
 {
-  /* a */
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  /* b */
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07,
-  /* p = 2^256-2^64-1 */
-  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-  0xFF, 0xFF, 0xFF, 0xFE, 0xFF, 0xFF, 0xFC, 0x2F,
-  /* n */
-  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-  0xFF, 0xFF, 0xFF, 0xFE, 0xBA, 0xAE, 0xDC, 0xE6, 0xAF, 0x48, 0xA0, 0x3B,
-  0xBF, 0xD2, 0x5E, 0x8C, 0xD0, 0x36, 0x41, 0x41
-};
-/*
- *
- *  Base Point G (uncompressed)
+#if defined BOOTLOADER_HASH_SOFTWARE
+    return &g_hash_software;
+#else
+    if (bootloader_hash_software)
+    {
+        return &g_hash_software;
+    }
+#if defined _BL_TESTING
+    extern const hash_api_t     g_hash_on_sce_test;
+    static hash_instance_t      hash_local;
+    hash_local.p_ctrl   = g_sce_hash_0.p_ctrl;
+    hash_local.p_cfg    = g_sce_hash_0.p_cfg;
+    hash_local.p_api    = &g_hash_on_sce_test;
+
+    return &hash_local;
+#else
+    return &g_sce_hash_0;
+#endif
+#endif
+}
+
+/*
+ * bootloader_hash_use_software()
  *
- */
-uint8_t generator_point[ECC_256_GENERATOR_POINT_LENGTH_WORDS * sizeof(uint32_t)] =
+ * Use the software SHA256 backend for all later hashing, e.g. when the SCE hash driver cannot be opened.
+ *
+ *  */
+void bootloader_hash_use_software(void)
+{
+    bootloader_hash_software = true;
+}
+
+/*
+ * bootloader_ecc()
+ *
+ * The ECC driver instance used for signature verification.
+ * When testing (_BL_TESTING) the driver API is replaced by g_ecc_on_sce_test (see bootloader_hash()).
+ *
+ *  */
+const ecc_instance_t * bootloader_ecc(void)
+{
+#if defined _BL_TESTING
+    extern const ecc_api_t      g_ecc_on_sce_test;
+    static ecc_instance_t       ecc_local;
+    ecc_local.p_ctrl    = g_sce_ecc_0.p_ctrl;
+    ecc_local.p_cfg     = g_sce_ecc_0.p_cfg;
+    ecc_local.p_api     = &g_ecc_on_sce_test;
+
+    return &ecc_local;
+#else
+    return &g_sce_ecc_0;
+#endif
+}
+
+/*
+ * verify_image_crc()
+ *
+ * Function to check the CRC of an image, if its header has one (see IMAGE_CRC_MAGIC). This is a quick check for a
+ * corrupt or partly written image before it is hashed, it does not replace the signature check.
+ *
+ * IN:
+ * - p_image_header - Pointer to the header, already checked by verify_image_header()
+ *
+ * RETURNS:
+ * - VERIFY_SUCCESS if the image has no CRC or the CRC matches
+ * - VERIFY_FAIL if the CRC does not match
+ *
+ *  */
+uint16_t verify_image_crc(bootloader_image_header_t * p_image_header)
 {
-  /* x */
-  0x79, 0xBE, 0x66, 0x7E, 0xF9, 0xDC, 0xBB, 0xAC, 0x55, 0xA0, 0x62, 0x95,
-  0xCE, 0x87, 0x0B, 0x07, 0x02, 0x9B, 0xFC, 0xDB, 0x2D, 0xCE, 0x28, 0xD9,
-  0x59, 0xF2, 0x81, 0x5B, 0x16, 0xF8, 0x17, 0x98,
-  /* y */
-  0x48, 0x3a, 0xda, 0x77, 0x26, 0xa3, 0xc4, 0x65, 0x5d, 0xa4, 0xfb, 0xfc,
-  0x0e, 0x11, 0x08, 0xa8, 0xfd, 0x17, 0xb4, 0x48, 0xa6, 0x85, 0x54, 0x19,
-  0x9c, 0x47, 0xd0, 0x8f, 0xfb, 0x10, 0xd4, 0xb8,
- };
+    uint32_t end = image_total_size(p_image_header);
+
+    if (IMAGE_CRC_MAGIC != p_image_header->crc_magic)
+    {
+        return VERIFY_SUCCESS;
+    }
+
+    if (IMAGE_HEADER_VERSION_BLOCK_TABLE == p_image_header->header_version)
+    {
+        end = image_block_table_offset(p_image_header);
+    }
+
+    if ((end < IMAGE_HEADER_SIZE) ||
+        (p_image_header->image_crc != image_crc32(0, (uint32_t)p_image_header + IMAGE_HEADER_SIZE, end - IMAGE_HEADER_SIZE)))
+    {
+        return VERIFY_FAIL;
+    }
+
+    return VERIFY_SUCCESS;
+}
+
+/*
+ * verify_image_signature()
+ *
+ * Function to check the ECDSA signature in an image header against an already calculated image hash, with
+ * bootloader_ecc() (see image_signature_check()).
+ *
+ *  */
+uint16_t verify_image_signature(bootloader_image_header_t * p_image_header, uint8_t * p_hash, uint8_t * p_public_key)
+{
+    return image_signature_check(bootloader_ecc(), p_image_header, p_hash, p_public_key);
+}
+
+/*
+ * verify_image_block_table()
+ *
+ * Function to check the signature of a version 1 (block table) image, with bootloader_hash() and bootloader_ecc()
+ * (see image_block_table_check()).
+ *
+ *  */
+uint16_t verify_image_block_table(bootloader_image_header_t * p_image_header, uint8_t * p_table, uint8_t * p_public_key)
+{
+    return image_block_table_check(bootloader_hash(), bootloader_ecc(), p_image_header, p_table, p_public_key);
+}
+
+/*
+ * verify_image_block()
+ *
+ * Function to check one block of a version 1 (block table) image against its hash in the block table.
+ * Blocks can be checked in any order.
+ *
+ * IN:
+ * - p_image_header - Pointer to the header, already checked by verify_image_header()
+ * - p_table        - Pointer to the block table, already checked by verify_image_block_table()
+ * - block          - Index of the block to check
+ *
+ * RETURNS:
+ * - VERIFY_SUCCESS if the block matches its hash
+ * - VERIFY_FAIL otherwise
+ *
+ *  */
+uint16_t verify_image_block(bootloader_image_header_t * p_image_header, uint8_t * p_table, uint32_t block)
+{
+    uint32_t    hash[SHA256_DIGEST_SIZE_BYTES / 4];
+    uint32_t    block_start = block * IMAGE_BLOCK_SIZE;
+    uint32_t    block_end = block_start + IMAGE_BLOCK_SIZE;
+    uint32_t    table_offset = image_block_table_offset(p_image_header);
+
+    if (block >= p_image_header->block_count)
+    {
+        return VERIFY_FAIL;
+    }
+
+    if (block_start < IMAGE_HASH_OFFSET)
+    {
+        block_start = IMAGE_HASH_OFFSET;
+    }
+    if (block_end > table_offset)
+    {
+        block_end = table_offset;
+    }
+
+    if (SSP_SUCCESS != sha256_hash(bootloader_hash(), (uint8_t *)p_image_header + block_start, block_end - block_start, (uint8_t *)hash))
+    {
+        return VERIFY_FAIL;
+    }
+
+    if (0 != memcmp(hash, p_table + (block * SHA256_DIGEST_SIZE_BYTES), SHA256_DIGEST_SIZE_BYTES))
+    {
+        return VERIFY_FAIL;
+    }
+
+    return VERIFY_SUCCESS;
+}
+
+/*
+ * verify_memo_find()
+ *
+ * Find the result of an earlier verify_image() of the image at p_image_header in this boot. The result is only used
+ * if the start of the header (up to and including the Header version) and the public key are the same as when it was
+ * verified, and the area has not been forgotten (see verify_image_forget()) since.
+ *
+ * RETURNS:
+ * - Pointer to the entry for the image, NULL if there is none
+ *
+ *  */
+static verify_memo_t * verify_memo_find(bootloader_image_header_t * p_image_header, uint8_t * p_public_key)
+{
+    for (uint32_t i = 0; i < VERIFY_MEMO_ENTRIES; i++)
+    {
+        if ((verify_memo[i].address == (uint32_t)p_image_header) && (verify_memo[i].p_public_key == p_public_key) &&
+            (0 == memcmp(verify_memo[i].key, p_image_header, VERIFY_MEMO_KEY_SIZE)))
+        {
+            return &verify_memo[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * verify_memo_store()
+ *
+ * Record the result of verifying the image at p_image_header, replacing any earlier entry for the same address.
+ * Images at other addresses than the main image and update image areas are not recorded.
+ *
+ *  */
+static void verify_memo_store(bootloader_image_header_t * p_image_header, uint8_t * p_public_key, uint16_t result)
+{
+    uint32_t address = (uint32_t)p_image_header;
+    uint32_t entry;
+
+    if (MAIN_IMAGE_START_ADDRESS == address)
+    {
+        entry = 0;
+    }
+    else if (UPDATE_IMAGE_START_ADDRESS == address)
+    {
+        entry = 1;
+    }
+    else
+    {
+        return;
+    }
+
+    verify_memo[entry].address = address;
+    verify_memo[entry].p_public_key = p_public_key;
+    memcpy(verify_memo[entry].key, p_image_header, VERIFY_MEMO_KEY_SIZE);
+    verify_memo[entry].result = result;
+}
+
+/*
+ * verify_image_forget()
+ *
+ * Forget the result of verifying the image at image_address, so the next verify_image() of it is done in full.
+ * Must be called before an image area is erased or programmed.
+ *
+ *  */
+void verify_image_forget(uint32_t image_address)
+{
+    for (uint32_t i = 0; i < VERIFY_MEMO_ENTRIES; i++)
+    {
+        if (verify_memo[i].address == image_address)
+        {
+            verify_memo[i].address = 0;
+        }
+    }
+}
 
 /*
  * verify_image()
@@ -70,7 +311,13 @@ uint8_t generator_point[ECC_256_GENERATOR_POINT_LENGTH_WORDS * sizeof(uint32_t)]
  * Function to validate an image header. Checks:
  * - Magic number
  * - Length (is not larger than main image space)
+ * - CRC, if the header has one (see verify_image_crc())
  * - ECDSA signature (SHA256)
+ * - For a version 1 (block table) header, each block in turn, stopping at the first that fails
+ * The image is verified with image_verify_step() in steps of IMAGE_VERIFY_STEP_SIZE bytes.
+ * The result for the main image and update image areas is kept for the rest of the boot, so verifying the same
+ * image again (e.g. the main image before and after a rejected update is erased) does not hash it again. An image
+ * failing the header checks is not recorded, the checks are cheap.
  *
  * IN:
  * - p_image_header - Pointer to the start of the header information
@@ -83,53 +330,191 @@ uint8_t generator_point[ECC_256_GENERATOR_POINT_LENGTH_WORDS * sizeof(uint32_t)]
  *  */
 uint16_t verify_image(bootloader_image_header_t * p_image_header, uint8_t * p_public_key)
 {
-    ssp_err_t                   err;
-    uint16_t                    res = VERIFY_FAIL;
-    uint32_t                    hash[SHA256_DIGEST_SIZE_BYTES / 4];
-    r_crypto_data_handle_t      g_msg_digest_handle;
-    r_crypto_data_handle_t      ecdsa_public_key_handle;
-    r_crypto_data_handle_t      domain_handle = {(uint32_t *)domain, sizeof(domain)/sizeof(uint32_t)};
-    r_crypto_data_handle_t      generator_point_handle = {(uint32_t *)generator_point, sizeof(generator_point)/sizeof(uint32_t)};
-    r_crypto_data_handle_t      g_ext_sign_r_handle;
-    r_crypto_data_handle_t      g_ext_sign_s_handle;
+    image_verifier_t    verifier;
+    verify_memo_t *     p_memo;
 
-    // Check the magic number
-    // This is a simple check which will indicate whether the image header looks correct and worthy or further processing
-    if (0 != memcmp((void *)p_image_header, (void *)MAGIC_NUMBER, MAGIC_NUMBER_LEN))
+    if (VERIFY_SUCCESS != verify_image_header(p_image_header))
     {
         return VERIFY_FAIL;
     }
 
-    // Check the length in the header doesn't exceed the size of the main application space
-    uint32_t new_image_length;
-    new_image_length = p_image_header->length + sizeof(p_image_header->length) + sizeof(p_image_header->signature) + sizeof(p_image_header->magic_number);
-    if (new_image_length > MAIN_IMAGE_MAX_SIZE)
+    p_memo = verify_memo_find(p_image_header, p_public_key);
+    if (NULL != p_memo)
+    {
+        boot_timing_count(BOOT_COUNT_VERIFIES_REUSED);
+        return p_memo->result;
+    }
+
+    // The CRC (if any) is checked before the image is hashed
+    if ((VERIFY_SUCCESS != verify_image_crc(p_image_header)) ||
+        (VERIFY_SUCCESS != image_verify_start(&verifier, p_image_header, p_public_key, bootloader_hash(), bootloader_ecc())))
     {
+        verify_memo_store(p_image_header, p_public_key, VERIFY_FAIL);
         return VERIFY_FAIL;
     }
 
-    // Calculate the hash of the image
-    sha256_hash(&g_sce_hash_0, (uint8_t *)&p_image_header->length, (p_image_header->length + 4), (uint8_t *)hash);
+    while (!image_verify_step(&verifier, IMAGE_VERIFY_STEP_SIZE))
+    {
+        // Each step is bounded, other boot work could be done here
+    }
+
+    verify_memo_store(p_image_header, p_public_key, image_verify_result(&verifier));
+
+    return image_verify_result(&verifier);
+}
+
+/*
+ * image_copy_chunk_programmed()
+ *
+ * image_copy_check_t callback, checking each chunk of the main image area as it is programmed.
+ * For a version 0 image the chunk is added to the hash of the whole image.
+ * For a version 1 image the chunk is added to the hash of its block, and each block is checked against the block
+ * table when it is complete, stopping the copy at the first block that fails.
+ *
+ *  */
+static ssp_err_t image_copy_chunk_programmed(image_copy_check_t * p_check, uint32_t offset, uint32_t size)
+{
+    image_copy_verify_t *       p_verify = (image_copy_verify_t *)p_check;
+    bootloader_image_header_t * p_header = (bootloader_image_header_t *)image_copy_header;
+    uint32_t                    end = offset + size;
+    uint32_t                    data_end = end;
+    ssp_err_t                   err = SSP_SUCCESS;
 
-    // Verify the signature
-    g_msg_digest_handle.p_data          = (uint32_t *)hash;
-    g_msg_digest_handle.data_length     = ECC_256_MESSAGE_DIGEST_LENGTH_WORDS;
-    ecdsa_public_key_handle.p_data      = (uint32_t *)p_public_key;
-    ecdsa_public_key_handle.data_length = (ECC_256_PUBLIC_KEY_LENGTH_WORDS);
-    g_ext_sign_r_handle.p_data          = (uint32_t *)p_image_header->signature;
-    g_ext_sign_r_handle.data_length     = ECC_256_SIGNATURE_R_LENGTH_WORDS;
-    g_ext_sign_s_handle.p_data          = (uint32_t *)(p_image_header->signature + ECC_256_SIGNATURE_R_LENGTH_WORDS);
-    g_ext_sign_s_handle.data_length     = ECC_256_SIGNATURE_S_LENGTH_WORDS;
-    err = g_sce_ecc_0.p_api->verify(g_sce_ecc_0.p_ctrl, &domain_handle, &generator_point_handle, &ecdsa_public_key_handle, &g_msg_digest_handle, &g_ext_sign_r_handle, &g_ext_sign_s_handle);
-    if (SSP_SUCCESS != err)
+    if (IMAGE_HEADER_VERSION_BLOCK_TABLE == p_header->header_version)
     {
-        res = VERIFY_FAIL;
+        data_end = image_block_table_offset(p_header);
     }
-    else
+
+    while ((SSP_SUCCESS == err) && (offset < end))
+    {
+        // Part of the chunk within one block
+        uint32_t block_end = ((offset / IMAGE_BLOCK_SIZE) + 1) * IMAGE_BLOCK_SIZE;
+        uint32_t piece_end = (end < block_end) ? end : block_end;
+        uint32_t hash_start = (offset > IMAGE_HASH_OFFSET) ? offset : IMAGE_HASH_OFFSET;
+        uint32_t hash_end = (piece_end < data_end) ? piece_end : data_end;
+
+        if (hash_start < hash_end)
+        {
+            err = sha256_update(&p_verify->hash_ctx, (uint8_t *)(MAIN_IMAGE_START_ADDRESS + hash_start), hash_end - hash_start);
+        }
+
+        // Check a block of a version 1 image once all of it has been hashed
+        if ((SSP_SUCCESS == err) && (IMAGE_HEADER_VERSION_BLOCK_TABLE == p_header->header_version) &&
+            (offset < data_end) && ((piece_end == block_end) || (piece_end >= data_end)))
+        {
+            uint32_t hash[SHA256_DIGEST_SIZE_BYTES / 4];
+
+            err = sha256_final(&p_verify->hash_ctx, (uint8_t *)hash);
+            if ((SSP_SUCCESS == err) &&
+                (0 != memcmp(hash, image_copy_block_table + (p_verify->blocks_checked * SHA256_DIGEST_SIZE_BYTES), SHA256_DIGEST_SIZE_BYTES)))
+            {
+                err = SSP_ERR_INVALID_DATA;
+            }
+            if (SSP_SUCCESS == err)
+            {
+                p_verify->blocks_checked++;
+                err = sha256_init(&p_verify->hash_ctx, bootloader_hash());
+            }
+        }
+
+        offset = piece_end;
+    }
+
+    return err;
+}
+
+/*
+ * image_copy_verify_start()
+ *
+ * Function to start the check of a new main image as it is programmed from the update image, by passing
+ * &p_verify->check to flash_main_image_from_update_area_and_check().
+ * The header (and for a version 1 image the block table) of the update image are copied to RAM, so they cannot
+ * change while the copy is in progress. For a version 1 image the signature of the copies is verified here.
+ *
+ * IN:
+ * - p_update_header    - Pointer to the header of the update image, already checked by verify_image_header()
+ * - p_public_key       - Pointer to the public key used to verify the ECC signature
+ *
+ * OUT:
+ * - p_verify           - Check to pass to the copy
+ *
+ * RETURNS:
+ * - VERIFY_SUCCESS if the check has been started
+ * - VERIFY_FAIL otherwise
+ *
+ *  */
+uint16_t image_copy_verify_start(image_copy_verify_t * p_verify, bootloader_image_header_t * p_update_header, uint8_t * p_public_key)
+{
+    bootloader_image_header_t * p_header = (bootloader_image_header_t *)image_copy_header;
+
+    p_verify->check.p_chunk_programmed = image_copy_chunk_programmed;
+    p_verify->p_image_header = p_header;
+    p_verify->blocks_checked = 0;
+
+    memcpy(image_copy_header, p_update_header, IMAGE_HEADER_SIZE);
+    if (VERIFY_SUCCESS != verify_image_header(p_header))
+    {
+        return VERIFY_FAIL;
+    }
+
+    if (IMAGE_HEADER_VERSION_BLOCK_TABLE == p_header->header_version)
     {
-        res = VERIFY_SUCCESS;
+        memcpy(image_copy_block_table, (uint8_t *)p_update_header + image_block_table_offset(p_header), p_header->block_count * SHA256_DIGEST_SIZE_BYTES);
+        if (VERIFY_SUCCESS != verify_image_block_table(p_header, image_copy_block_table, p_public_key))
+        {
+            return VERIFY_FAIL;
+        }
     }
 
-    return (res);
+    if (SSP_SUCCESS != sha256_init(&p_verify->hash_ctx, bootloader_hash()))
+    {
+        return VERIFY_FAIL;
+    }
+
+    return VERIFY_SUCCESS;
 }
 
+/*
+ * image_copy_verify_end()
+ *
+ * Function to complete the check of a new main image once flash_main_image_from_update_area_and_check() has
+ * programmed all of it.
+ * For a version 0 image the signature is checked against the hash calculated while programming.
+ * For a version 1 image every block must have been checked, and the header and block table programmed must match
+ * the copies verified by image_copy_verify_start().
+ *
+ * IN:
+ * - p_verify       - Check started by image_copy_verify_start()
+ * - p_public_key   - Pointer to the public key used to verify the ECC signature
+ *
+ * RETURNS:
+ * - VERIFY_SUCCESS if the new main image is valid
+ * - VERIFY_FAIL otherwise
+ *
+ *  */
+uint16_t image_copy_verify_end(image_copy_verify_t * p_verify, uint8_t * p_public_key)
+{
+    bootloader_image_header_t * p_header = p_verify->p_image_header;
+    bootloader_image_header_t * p_main_header = (bootloader_image_header_t *)MAIN_IMAGE_START_ADDRESS;
+    uint32_t                    hash[SHA256_DIGEST_SIZE_BYTES / 4];
+
+    if (IMAGE_HEADER_VERSION_BLOCK_TABLE == p_header->header_version)
+    {
+        if ((p_verify->blocks_checked != p_header->block_count) ||
+            (0 != memcmp(p_main_header, image_copy_header, IMAGE_HEADER_SIZE)) ||
+            (0 != memcmp((uint8_t *)p_main_header + image_block_table_offset(p_header), image_copy_block_table, p_header->block_count * SHA256_DIGEST_SIZE_BYTES)))
+        {
+            return VERIFY_FAIL;
+        }
+
+        return VERIFY_SUCCESS;
+    }
+
+    if (SSP_SUCCESS != sha256_final(&p_verify->hash_ctx, (uint8_t *)hash))
+    {
+        return VERIFY_FAIL;
+    }
+
+    // Check the signature of the programmed image against the hash calculated while programming
+    return verify_image_signature(p_main_header, (uint8_t *)hash, p_public_key);
+}
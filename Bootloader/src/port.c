@@ -4,118 +4,918 @@
  *  Created on: 15 Mar 2021
  */
 #include "port.h"
+#include "boot_timing.h"
+
+/*
+ * area_blocks()
+ *
+ * Number of erase blocks needed to cover length bytes, limited to the blocks in an area of max_size bytes.
+ * A length of zero or larger than the area covers the whole area.
+ *
+ *  */
+static uint32_t area_blocks(uint32_t length, uint32_t max_size, uint32_t block_size)
+{
+    if ((0 == length) || (length > max_size))
+    {
+        length = max_size;
+    }
+
+    return (length + (block_size - 1)) / block_size;
+}
+
+#ifdef  UPDATE_USES_QSPI_FLASH
+/*
+ * memory_mapped_area_is_blank()
+ *
+ * Checks a memory mapped flash area (e.g. QSPI) reads as erased, four words at a time, stopping at the first
+ * group containing a programmed word.
+ * area_start_addr and size must be multiples of 4.
+ *
+ *  */
+static bool memory_mapped_area_is_blank(uint32_t area_start_addr, uint32_t size)
+{
+    const uint32_t * p_src = (const uint32_t *)area_start_addr;
+    uint32_t words = size / 4;
+    uint32_t i;
+
+    for (i=0; (i + 4) <= words; i+=4)
+    {
+        if (ERASED_WORD != (p_src[i] & p_src[i + 1] & p_src[i + 2] & p_src[i + 3]))
+        {
+            return false;
+        }
+    }
+
+    for (; i<words; i++)
+    {
+        if (ERASED_WORD != p_src[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+#endif
+
+/*
+ * Flash operation scheduler
+ *
+ * Erase and program operations are started with flash_op_start() and their completion collected with
+ * flash_op_wait(), so the caller can hash or prepare the next operation while the flash is busy.
+ * Operations on data flash run in the background when g_flash is configured for Data Flash Background Operation,
+ * completion being signalled by flash_ready_callback(). These need the flash ready interrupt, so must not be
+ * started with interrupts masked.
+ * The flash_hp driver always performs code flash operations in blocking mode (and code flash cannot be read while
+ * it is busy), so these are complete when flash_op_start() returns.
+ *
+ *  */
+typedef enum e_flash_op
+{
+    FLASH_OP_ERASE,
+    FLASH_OP_WRITE,
+    FLASH_OP_BLANK_CHECK,
+} flash_op_t;
+
+static volatile bool        flash_op_busy = false;
+static volatile ssp_err_t   flash_op_result = SSP_SUCCESS;
+static volatile bool        flash_op_blank = false;
+static flash_op_t           flash_op_pending = FLASH_OP_ERASE;
+// Timing of an outstanding background operation, added to its phase once it has completed
+static bool                 flash_op_timed = false;
+static uint32_t             flash_op_start_cycles;
+static uint32_t             flash_op_bytes;
+
+/*
+ * flash_ready_callback()
+ *
+ * g_flash callback, called from the flash ready and flash error interrupts when a background operation ends.
+ *
+ *  */
+void flash_ready_callback(flash_callback_args_t * p_args)
+{
+    switch (p_args->event)
+    {
+        case FLASH_EVENT_ERASE_COMPLETE:
+        case FLASH_EVENT_WRITE_COMPLETE:
+            flash_op_result = SSP_SUCCESS;
+            break;
+
+        case FLASH_EVENT_BLANK:
+        case FLASH_EVENT_NOT_BLANK:
+            flash_op_blank  = (FLASH_EVENT_BLANK == p_args->event);
+            flash_op_result = SSP_SUCCESS;
+            break;
+
+        default:
+            flash_op_result = (FLASH_OP_ERASE == flash_op_pending) ? SSP_ERR_ERASE_FAILED : SSP_ERR_WRITE_FAILED;
+            break;
+    }
+
+    flash_op_busy = false;
+}
+
+/*
+ * flash_op_in_background()
+ *
+ * Returns true if an operation on address runs in the background and completes through flash_ready_callback().
+ *
+ *  */
+static bool flash_op_in_background(flash_instance_t * p_flash, uint32_t address)
+{
+    return (p_flash->p_cfg->data_flash_bgo &&
+            (address >= DATA_FLASH_START_ADDRESS) && (address < (DATA_FLASH_START_ADDRESS + DATA_FLASH_SIZE)));
+}
+
+/*
+ * flash_op_wait()
+ *
+ * Wait for the operation started by flash_op_start() to complete.
+ *
+ * RETURNS:
+ * - SSP_SUCCESS if there is no operation outstanding or it completed without errors
+ * - SSP_ERR_ERASE_FAILED or SSP_ERR_WRITE_FAILED if a background operation failed
+ *
+ *  */
+static ssp_err_t flash_op_wait(void)
+{
+    ssp_err_t err;
+
+    while (flash_op_busy)
+    {
+        // Background operation in progress
+    }
+
+    if (flash_op_timed)
+    {
+        boot_timing_add((FLASH_OP_ERASE == flash_op_pending) ? BOOT_PHASE_ERASE : BOOT_PHASE_PROGRAM, flash_op_start_cycles, flash_op_bytes);
+        flash_op_timed = false;
+    }
+
+    err = flash_op_result;
+    flash_op_result = SSP_SUCCESS;
+
+    return err;
+}
+
+/*
+ * flash_op_start()
+ *
+ * Start an erase (of count blocks at dest_addr) or a write (of count bytes from src_addr to dest_addr).
+ * Any outstanding operation is waited for first, as the flash sequencer only performs one at a time.
+ *
+ * RETURNS:
+ * - SSP_SUCCESS if the operation was started (code flash operations have also completed)
+ * - Error value of the outstanding operation or from the flash driver
+ *
+ *  */
+static ssp_err_t flash_op_start(flash_instance_t * p_flash, flash_op_t op, uint32_t src_addr, uint32_t dest_addr, uint32_t count)
+{
+    ssp_err_t   err;
+    uint32_t    primask;
+    bool        background = flash_op_in_background(p_flash, dest_addr);
+
+    err = flash_op_wait();
+    if (SSP_SUCCESS != err)
+    {
+        return err;
+    }
+
+    // Erase count is in blocks, the bootloader only erases data flash blocks and main image sized code flash blocks
+    uint32_t bytes = count;
+    if (FLASH_OP_ERASE == op)
+    {
+        bytes *= (dest_addr >= DATA_FLASH_START_ADDRESS) ? DATA_FLASH_ERASE_BLOCK_SIZE : MAIN_IMAGE_ERASE_BLOCK_SIZE;
+    }
+    uint32_t start_cycles = boot_timing_now();
+
+    primask = __get_PRIMASK();
+    if (background)
+    {
+        flash_op_pending = op;
+        flash_op_busy = true;
+    }
+    else
+    {
+        // Code flash cannot be read while it is being erased or programmed, so no interrupt handler may run
+        __disable_irq();
+    }
+
+    if (FLASH_OP_ERASE == op)
+    {
+        err = p_flash->p_api->erase(p_flash->p_ctrl, dest_addr, count);
+    }
+    else
+    {
+        err = p_flash->p_api->write(p_flash->p_ctrl, src_addr, dest_addr, count);
+    }
+
+    __set_PRIMASK(primask);
+
+    if (SSP_SUCCESS != err)
+    {
+        flash_op_busy = false;
+    }
+    else if (background)
+    {
+        // Timed until flash_op_wait() finds it complete
+        flash_op_timed = true;
+        flash_op_start_cycles = start_cycles;
+        flash_op_bytes = bytes;
+    }
+    else
+    {
+        boot_timing_add((FLASH_OP_ERASE == op) ? BOOT_PHASE_ERASE : BOOT_PHASE_PROGRAM, start_cycles, bytes);
+    }
+
+    return err;
+}
+
+/*
+ * Storage sessions
+ *
+ * The flash (g_flash) and QSPI (g_qspi) drivers are opened by the first operation that needs them and then stay open,
+ * shared by every later operation, until storage_session_close() is called once before the jump to the application.
+ * Opening and closing them is timed as BOOT_PHASE_STORAGE_SESSION, and each operation that finds its driver already
+ * open (an open and close saved) is counted as BOOT_COUNT_STORAGE_OPENS_SAVED.
+ * When testing (_BL_TESTING) the driver APIs are replaced by g_flash_on_flash_hp_test and g_qspi_on_qspi_test.
+ *
+ *  */
+static flash_instance_t     flash_session;
+static bool                 flash_session_open = false;
+#ifdef  UPDATE_USES_QSPI_FLASH
+static qspi_instance_t      qspi_session;
+static bool                 qspi_session_open = false;
+#endif
+
+/*
+ * flash_session_get()
+ *
+ * Get the open flash driver, opening it if this is the first operation to use it.
+ *
+ *  */
+static ssp_err_t flash_session_get(flash_instance_t ** pp_flash)
+{
+    ssp_err_t err = SSP_SUCCESS;
+
+    if (flash_session_open)
+    {
+        boot_timing_count(BOOT_COUNT_STORAGE_OPENS_SAVED);
+    }
+    else
+    {
+        flash_session = g_flash;
+#if defined _BL_TESTING
+        extern const flash_api_t    g_flash_on_flash_hp_test;
+        flash_session.p_api = &g_flash_on_flash_hp_test;
+#endif
+        uint32_t start_cycles = boot_timing_now();
+        err = flash_session.p_api->open(flash_session.p_ctrl, flash_session.p_cfg);
+        boot_timing_add(BOOT_PHASE_STORAGE_SESSION, start_cycles, 0);
+        flash_session_open = (SSP_SUCCESS == err);
+    }
+
+    *pp_flash = &flash_session;
+
+    return err;
+}
+
+#ifdef  UPDATE_USES_QSPI_FLASH
+/*
+ * qspi_session_get()
+ *
+ * Get the open QSPI driver, opening it if this is the first operation to use it.
+ *
+ *  */
+static ssp_err_t qspi_session_get(qspi_instance_t ** pp_qspi)
+{
+    ssp_err_t err = SSP_SUCCESS;
+
+    if (qspi_session_open)
+    {
+        boot_timing_count(BOOT_COUNT_STORAGE_OPENS_SAVED);
+    }
+    else
+    {
+        qspi_session = g_qspi;
+#if defined _BL_TESTING
+        extern const qspi_api_t    g_qspi_on_qspi_test;
+        qspi_session.p_api = &g_qspi_on_qspi_test;
+#endif
+        uint32_t start_cycles = boot_timing_now();
+        err = qspi_session.p_api->open(qspi_session.p_ctrl, qspi_session.p_cfg);
+        boot_timing_add(BOOT_PHASE_STORAGE_SESSION, start_cycles, 0);
+        qspi_session_open = (SSP_SUCCESS == err);
+    }
+
+    *pp_qspi = &qspi_session;
+
+    return err;
+}
+#endif
+
+/*
+ * storage_session_close()
+ *
+ * Close the flash and QSPI drivers, if they were opened. Any outstanding flash operation is waited for first.
+ *
+ *  */
+void storage_session_close(void)
+{
+    uint32_t start_cycles = boot_timing_now();
+
+    if (flash_session_open)
+    {
+        flash_op_wait();
+        flash_session.p_api->close(flash_session.p_ctrl);
+        flash_session_open = false;
+    }
+
+#ifdef  UPDATE_USES_QSPI_FLASH
+    if (qspi_session_open)
+    {
+        qspi_session.p_api->close(qspi_session.p_ctrl);
+        qspi_session_open = false;
+    }
+#endif
+
+    boot_timing_add(BOOT_PHASE_STORAGE_SESSION, start_cycles, 0);
+}
+
+/*
+ * flash_blank_check()
+ *
+ * Blank check size bytes of internal flash from address, once any outstanding operation has completed.
+ * A background blank check (data flash) is waited for, so the result is always available on return.
+ *
+ *  */
+static ssp_err_t flash_blank_check(flash_instance_t * p_flash, uint32_t address, uint32_t size, bool * p_blank)
+{
+    ssp_err_t       err;
+    flash_result_t  f_result = FLASH_RESULT_NOT_BLANK;
+    bool            background = flash_op_in_background(p_flash, address);
+
+    err = flash_op_wait();
+    if (SSP_SUCCESS != err)
+    {
+        return err;
+    }
+
+    uint32_t start_cycles = boot_timing_now();
+
+    if (background)
+    {
+        flash_op_pending = FLASH_OP_BLANK_CHECK;
+        flash_op_busy = true;
+    }
+
+    err = p_flash->p_api->blankCheck(p_flash->p_ctrl, address, size, &f_result);
+    if ((SSP_SUCCESS == err) && (FLASH_RESULT_BGO_ACTIVE == f_result))
+    {
+        err = flash_op_wait();
+        f_result = flash_op_blank ? FLASH_RESULT_BLANK : FLASH_RESULT_NOT_BLANK;
+    }
+    else
+    {
+        flash_op_busy = false;
+    }
+
+    boot_timing_add(BOOT_PHASE_BLANK_CHECK, start_cycles, size);
+
+    *p_blank = (FLASH_RESULT_BLANK == f_result);
+
+    return err;
+}
+
+/*
+ * flash_block_erase_start()
+ *
+ * Start erasing the internal flash block at block_addr, unless it is already blank.
+ *
+ *  */
+static ssp_err_t flash_block_erase_start(flash_instance_t * p_flash, uint32_t block_addr, uint32_t block_size)
+{
+    ssp_err_t   err;
+    bool        blank = false;
+
+    err = flash_blank_check(p_flash, block_addr, block_size, &blank);
+    if ((SSP_SUCCESS == err) && (!blank))
+    {
+        err = flash_op_start(p_flash, FLASH_OP_ERASE, 0, block_addr, 1);
+
+        if ((block_addr >= MAIN_IMAGE_START_ADDRESS) && (block_addr < (MAIN_IMAGE_START_ADDRESS + MAIN_IMAGE_MAX_SIZE)))
+        {
+            boot_timing_count(BOOT_COUNT_MAIN_BLOCKS_ERASED);
+        }
+    }
+
+    return err;
+}
+
+/*
+ * main_image_block_unchanged()
+ *
+ * Function to check if a block of the main image area already holds the data it is about to be programmed with, so
+ * it does not need to be erased and programmed. The end of a last partial page must be erased, as programming pads
+ * it with the erased value.
+ * Always false if UPDATE_SKIP_UNCHANGED_BLOCKS is not defined.
+ *
+ * IN:
+ * - offset     - Offset of the block from MAIN_IMAGE_START_ADDRESS (MAIN_IMAGE_ERASE_BLOCK_SIZE aligned)
+ * - src_addr   - Address of the data in memory (RAM, or memory mapped flash)
+ * - length     - Number of bytes of data, not larger than MAIN_IMAGE_ERASE_BLOCK_SIZE
+ *
+ * RETURNS:
+ * - true if the block holds the data
+ * - false otherwise
+ *  */
+bool main_image_block_unchanged(uint32_t offset, uint32_t src_addr, uint32_t length)
+{
+#ifdef UPDATE_SKIP_UNCHANGED_BLOCKS
+    uint32_t  start_cycles = boot_timing_now();
+    uint8_t * p_main = (uint8_t *)(MAIN_IMAGE_START_ADDRESS + offset);
+    uint32_t  padded_length = ((length + (MAIN_FLASH_PROGRAMMING_PAGE_SIZE - 1)) / MAIN_FLASH_PROGRAMMING_PAGE_SIZE) * MAIN_FLASH_PROGRAMMING_PAGE_SIZE;
+    bool      unchanged = (0 == memcmp(p_main, (void *)src_addr, length));
+
+    for (uint32_t i = length; unchanged && (i < padded_length); i++)
+    {
+        unchanged = (ERASED_STATE == p_main[i]);
+    }
+
+    boot_timing_add(BOOT_PHASE_COMPARE, start_cycles, length);
+
+    if (unchanged)
+    {
+        boot_timing_count(BOOT_COUNT_MAIN_BLOCKS_UNCHANGED);
+    }
+
+    return unchanged;
+#else
+    (void)offset;
+    (void)src_addr;
+    (void)length;
+    return false;
+#endif
+}
+
+/*
+ * erase_internal_flash_blocks()
+ *
+ * Erase num_blocks internal flash blocks from start_addr, skipping blocks that are already blank.
+ * The flash driver must already be open.
+ *
+ *  */
+static ssp_err_t erase_internal_flash_blocks(flash_instance_t * p_flash, uint32_t start_addr, uint32_t num_blocks, uint32_t block_size)
+{
+    ssp_err_t       err = SSP_SUCCESS;
+
+    for (uint32_t i=0; (SSP_SUCCESS == err) && (i<num_blocks); i++)
+    {
+        err = flash_block_erase_start(p_flash, start_addr + (i * block_size), block_size);
+    }
+
+    // Wait for the last erase even if an error occurred, so none is left outstanding
+    ssp_err_t wait_err = flash_op_wait();
+
+    return (SSP_SUCCESS != err) ? err : wait_err;
+}
 
 /*
  * erase_main_image_area()
  *
- * Function to erase the main application image area.
+ * Function to erase the blocks of the main application image area needed to hold an image of length bytes.
+ * Blocks that are already blank are not erased again.
+ *
+ * IN:
+ *  - length    - Length (in bytes) of the image to be programmed, 0 to erase the whole main image area
+ *
+ * RETURNS:
+ * - SSP_SUCCESS if erasure completes without errors
+ * - Error values returned from flash driver if flash operation fails
+ *
+ *  */
+ssp_err_t erase_main_image_area(uint32_t length)
+{
+    ssp_err_t err;
+    // Internal flash being used
+    flash_instance_t *          p_flash;
+
+    err = flash_session_get(&p_flash);
+    if (SSP_SUCCESS != err)
+    {
+        return err;
+    }
+
+    // Erase the blocks of the main flash area covered by the image
+    err = erase_internal_flash_blocks(p_flash, MAIN_IMAGE_START_ADDRESS, area_blocks(length, MAIN_IMAGE_MAX_SIZE, MAIN_IMAGE_ERASE_BLOCK_SIZE), MAIN_IMAGE_ERASE_BLOCK_SIZE);
+
+    return err;
+}
+
+/*
+ * flash_main_image_from_update_area()
+ *
+ * Function to program the main flash application image area with the update image.
+ * The blocks covered by the image are erased ahead of programming, see flash_main_image_from_update_area_and_check().
  *
  * IN:
- *  - N/A
+ * - update_area_start_addr - Address of the update image in memory
+ * - length                 - Length (in bytes) of the update image to copy
+ * - p_journal              - Journal of the copy, or NULL to copy without one
+ *
+ * RETURNS:
+ * - SSP_SUCCESS if operation passes
+ * - SSP_ERR_ASSERTION if update_area_start_addr or length are zero.
+ * - Error values returned from flash driver if flash operation fails
+ *  */
+ssp_err_t flash_main_image_from_update_area(uint32_t update_area_start_addr, uint32_t length, update_journal_t * p_journal)
+{
+    return flash_main_image_from_update_area_and_check(update_area_start_addr, length, NULL, p_journal);
+}
+
+/*
+ * check_programmed_chunk()
+ *
+ * Pass a chunk of the main image area that has just been programmed to the copy check, if there is one.
+ *
+ *  */
+static ssp_err_t check_programmed_chunk(image_copy_check_t * p_check, uint32_t offset, uint32_t chunk_size)
+{
+    if ((NULL == p_check) || (0 == chunk_size))
+    {
+        return SSP_SUCCESS;
+    }
+
+    return p_check->p_chunk_programmed(p_check, offset, chunk_size);
+}
+
+/*
+ * journal_chunk_programmed()
+ *
+ * Called after each chunk is programmed. When the chunk completes a main image block (or the image) start writing
+ * the journal entry for the block. This is a data flash write, so runs in the background while the chunk is checked.
+ *
+ *  */
+static ssp_err_t journal_chunk_programmed(flash_instance_t * p_flash, update_journal_t * p_journal, uint32_t end_offset, uint32_t length)
+{
+    static const uint32_t block_done = UPDATE_JOURNAL_BLOCK_DONE;
+
+    if ((NULL == p_journal) || ((0 != (end_offset % MAIN_IMAGE_ERASE_BLOCK_SIZE)) && (end_offset < length)))
+    {
+        return SSP_SUCCESS;
+    }
+
+    uint32_t block = (end_offset - 1) / MAIN_IMAGE_ERASE_BLOCK_SIZE;
+    return flash_op_start(p_flash, FLASH_OP_WRITE, (uint32_t)&block_done, p_journal->entries_addr + (block * DATA_FLASH_PROGRAMMING_UNIT), DATA_FLASH_PROGRAMMING_UNIT);
+}
+
+/*
+ * program_main_image_direct()
+ *
+ * Program the main image area from offset straight from the memory mapped update image, one
+ * MAIN_IMAGE_ERASE_BLOCK_SIZE chunk at a time.
+ * Each block is erased (unless blank) just before being programmed, then recorded in the journal and checked.
+ * A block that already holds the update is not erased or programmed (see main_image_block_unchanged()).
+ * The flash driver must already be open.
+ *
+ *  */
+static ssp_err_t program_main_image_direct(flash_instance_t * p_flash, uint32_t update_area_start_addr, uint32_t offset, uint32_t length, image_copy_check_t * p_check, update_journal_t * p_journal)
+{
+    ssp_err_t   err = SSP_SUCCESS;
+    uint8_t     flash_page_buffer[MAIN_FLASH_PROGRAMMING_PAGE_SIZE] BSP_ALIGN_VARIABLE_V2(4);
+
+    while ((SSP_SUCCESS == err) && (offset < length))
+    {
+        uint32_t chunk_size = length - offset;
+        if (chunk_size > MAIN_IMAGE_ERASE_BLOCK_SIZE)
+        {
+            chunk_size = MAIN_IMAGE_ERASE_BLOCK_SIZE;
+        }
+
+        /* Flash must be programmed in page size */
+        /* Check if the chunk is a multiple of the programming page size (only the last chunk may not be) */
+        uint32_t page_overflow = (chunk_size % MAIN_FLASH_PROGRAMMING_PAGE_SIZE);
+        uint32_t bytes_to_program = chunk_size - page_overflow;
+
+        // A block already holding the update is left as it is
+        if (main_image_block_unchanged(offset, update_area_start_addr + offset, chunk_size))
+        {
+            bytes_to_program = 0;
+            page_overflow = 0;
+        }
+        else
+        {
+            err = flash_block_erase_start(p_flash, MAIN_IMAGE_START_ADDRESS + offset, MAIN_IMAGE_ERASE_BLOCK_SIZE);
+        }
+
+        if ((SSP_SUCCESS == err) && (bytes_to_program > 0))
+        {
+            err = flash_op_start(p_flash, FLASH_OP_WRITE, update_area_start_addr + offset, MAIN_IMAGE_START_ADDRESS + offset, bytes_to_program);
+        }
+
+        if ((SSP_SUCCESS == err) && (page_overflow > 0))
+        {
+            memset((void *)flash_page_buffer, 0xFF, MAIN_FLASH_PROGRAMMING_PAGE_SIZE);
+            memcpy((void *)flash_page_buffer, (void *)(update_area_start_addr + offset + bytes_to_program), page_overflow);
+            err = flash_op_start(p_flash, FLASH_OP_WRITE, (uint32_t)flash_page_buffer, MAIN_IMAGE_START_ADDRESS + offset + bytes_to_program, MAIN_FLASH_PROGRAMMING_PAGE_SIZE);
+        }
+
+        // Record the block in the journal, then check the programmed chunk (reading it back from the main image area)
+        if (SSP_SUCCESS == err)
+        {
+            err = journal_chunk_programmed(p_flash, p_journal, offset + chunk_size, length);
+        }
+        if (SSP_SUCCESS == err)
+        {
+            err = check_programmed_chunk(p_check, offset, chunk_size);
+        }
+
+        offset += chunk_size;
+    }
+
+    // Wait for any outstanding operation even if an error occurred, so none is left outstanding
+    ssp_err_t wait_err = flash_op_wait();
+
+    return (SSP_SUCCESS != err) ? err : wait_err;
+}
+
+#if defined(UPDATE_USES_QSPI_FLASH) && defined(QSPI_COPY_USES_DTC)
+// Double buffer, the DTC fills one while the other is programmed and checked
+static uint32_t qspi_copy_buffer[2][QSPI_COPY_BUFFER_SIZE / 4];
+
+/*
+ * qspi_copy_buffer_fill()
+ *
+ * Start a DTC block transfer of QSPI_COPY_BUFFER_SIZE bytes from the memory mapped QSPI flash into a copy buffer.
+ *
+ *  */
+static ssp_err_t qspi_copy_buffer_fill(uint32_t src_addr, uint32_t * p_buffer)
+{
+    ssp_err_t err;
+
+    err = g_transfer_qspi.p_api->reset(g_transfer_qspi.p_ctrl, (void const *)src_addr, (void *)p_buffer, 1);
+    if (SSP_SUCCESS == err)
+    {
+        err = g_transfer_qspi.p_api->start(g_transfer_qspi.p_ctrl, TRANSFER_START_MODE_SINGLE);
+    }
+
+    return err;
+}
+
+/*
+ * qspi_copy_buffer_wait()
  *
- * RETURNS:
- * - SSP_SUCCESS if erasure completes without errors
- * - Error values returned from flash driver if flash operation fails
+ * Wait for the DTC block transfer started by qspi_copy_buffer_fill() to complete.
  *
  *  */
-ssp_err_t erase_main_image_area(void)
+static ssp_err_t qspi_copy_buffer_wait(void)
 {
-    ssp_err_t err;
-    // Internal flash being used
-    flash_instance_t            p_flash_local = g_flash;
-#if defined _BL_TESTING
-    extern const flash_api_t    g_flash_on_flash_hp_test;
-    flash_instance_t            flash_local;
-    flash_local.p_ctrl  = g_flash.p_ctrl;
-    flash_local.p_cfg   = g_flash.p_cfg;
-    flash_local.p_api   = &g_flash_on_flash_hp_test;
+    ssp_err_t               err;
+    transfer_properties_t   properties;
 
-    p_flash_local       = flash_local;
+    do
+    {
+        err = g_transfer_qspi.p_api->infoGet(g_transfer_qspi.p_ctrl, &properties);
+    } while ((SSP_SUCCESS == err) && (0 != properties.block_count_remaining));
 
-#endif
+    return err;
+}
+
+/*
+ * program_main_image_from_qspi_dtc()
+ *
+ * Program the main image area from offset from an update image in QSPI flash through a pair of RAM buffers.
+ * While one buffer is programmed into the main image area and checked, the DTC fills the other with the next
+ * QSPI_COPY_BUFFER_SIZE bytes of the update image, so the QSPI reads are hidden behind the programming time.
+ * Each block is erased (unless blank) before its first chunk is programmed, and recorded in the journal after its
+ * last chunk, as for program_main_image_direct(). A block that already holds the update is skipped.
+ * The flash driver must already be open.
+ *
+ *  */
+static ssp_err_t program_main_image_from_qspi_dtc(flash_instance_t * p_flash, uint32_t update_area_start_addr, uint32_t offset, uint32_t length, image_copy_check_t * p_check, update_journal_t * p_journal)
+{
+    ssp_err_t   err;
+    uint32_t    buffer_index = 0;
 
-    err = p_flash_local.p_api->open(p_flash_local.p_ctrl, p_flash_local.p_cfg);
+    err = g_transfer_qspi.p_api->open(g_transfer_qspi.p_ctrl, g_transfer_qspi.p_cfg);
     if (SSP_SUCCESS != err)
     {
         return err;
     }
 
-    // Erase the main flash area
-    err = p_flash_local.p_api->erase(p_flash_local.p_ctrl, (uint32_t const)MAIN_IMAGE_START_ADDRESS, (MAIN_IMAGE_MAX_SIZE) / (MAIN_IMAGE_ERASE_BLOCK_SIZE));
-    // err will fall through after closing the flash driver
+    // A software started DTC transfer runs on its own and does not need interrupts, so it continues while code flash
+    // operations mask them.
+    if (offset < length)
+    {
+        err = qspi_copy_buffer_fill(update_area_start_addr + offset, qspi_copy_buffer[buffer_index]);
+    }
+
+    while ((SSP_SUCCESS == err) && (offset < length))
+    {
+        uint8_t * p_buffer = (uint8_t *)qspi_copy_buffer[buffer_index];
+        uint32_t  chunk_size = length - offset;
+
+        // A block already holding the update is left as it is (compared straight from the memory mapped QSPI flash)
+        if (0 == (offset % MAIN_IMAGE_ERASE_BLOCK_SIZE))
+        {
+            uint32_t block_size = (chunk_size > MAIN_IMAGE_ERASE_BLOCK_SIZE) ? MAIN_IMAGE_ERASE_BLOCK_SIZE : chunk_size;
+
+            if (main_image_block_unchanged(offset, update_area_start_addr + offset, block_size))
+            {
+                // Wait for the DTC to finish reading the first chunk of the block, then move on to the next block
+                err = qspi_copy_buffer_wait();
+                if (SSP_SUCCESS == err)
+                {
+                    err = journal_chunk_programmed(p_flash, p_journal, offset + block_size, length);
+                }
+                if (SSP_SUCCESS == err)
+                {
+                    err = check_programmed_chunk(p_check, offset, block_size);
+                }
+
+                offset += block_size;
+                if ((SSP_SUCCESS == err) && (offset < length))
+                {
+                    err = qspi_copy_buffer_fill(update_area_start_addr + offset, qspi_copy_buffer[buffer_index]);
+                }
+                continue;
+            }
+        }
+
+        if (chunk_size > QSPI_COPY_BUFFER_SIZE)
+        {
+            chunk_size = QSPI_COPY_BUFFER_SIZE;
+        }
+
+        err = qspi_copy_buffer_wait();
+
+        // Start filling the other buffer with the next chunk before programming this one
+        if ((SSP_SUCCESS == err) && ((offset + chunk_size) < length))
+        {
+            err = qspi_copy_buffer_fill(update_area_start_addr + offset + chunk_size, qspi_copy_buffer[buffer_index ^ 1]);
+        }
+
+        // Erase the block before its first chunk is programmed
+        if ((SSP_SUCCESS == err) && (0 == (offset % MAIN_IMAGE_ERASE_BLOCK_SIZE)))
+        {
+            err = flash_block_erase_start(p_flash, MAIN_IMAGE_START_ADDRESS + offset, MAIN_IMAGE_ERASE_BLOCK_SIZE);
+        }
+
+        if (SSP_SUCCESS == err)
+        {
+            /* Flash must be programmed in page size, pad the last chunk with the erased value */
+            uint32_t bytes_to_program = ((chunk_size + (MAIN_FLASH_PROGRAMMING_PAGE_SIZE - 1)) / MAIN_FLASH_PROGRAMMING_PAGE_SIZE) * MAIN_FLASH_PROGRAMMING_PAGE_SIZE;
+            memset((void *)(p_buffer + chunk_size), ERASED_STATE, bytes_to_program - chunk_size);
+
+            err = flash_op_start(p_flash, FLASH_OP_WRITE, (uint32_t)p_buffer, MAIN_IMAGE_START_ADDRESS + offset, bytes_to_program);
+        }
+
+        // Record a completed block in the journal, then check the programmed chunk
+        if (SSP_SUCCESS == err)
+        {
+            err = journal_chunk_programmed(p_flash, p_journal, offset + chunk_size, length);
+        }
+        if (SSP_SUCCESS == err)
+        {
+            err = check_programmed_chunk(p_check, offset, chunk_size);
+        }
+
+        offset += chunk_size;
+        buffer_index ^= 1;
+    }
+
+    // Wait for any outstanding operation even if an error occurred, so none is left outstanding
+    ssp_err_t wait_err = flash_op_wait();
+    if (SSP_SUCCESS == err)
+    {
+        err = wait_err;
+    }
 
-    // Close the flash driver
-    p_flash_local.p_api->close(p_flash_local.p_ctrl);
+    g_transfer_qspi.p_api->close(g_transfer_qspi.p_ctrl);
 
     return err;
 }
+#endif
 
 /*
- * flash_main_image_from_update_area()
+ * flash_main_image_from_update_area_and_check()
  *
- * Function to program the main flash application image area with the update image.
- * It is assumed the main application image area is already erased.
+ * Function to program the main flash application image area with the update image and check the result in the
+ * same pass.
+ * The image is programmed a chunk at a time. After each chunk is programmed it is passed to the copy check, which
+ * reads it back from the main image area (e.g. to hash it), so what is checked is what is actually in flash.
+ * With QSPI_COPY_USES_DTC defined an update image in QSPI flash is copied through RAM buffers filled by the DTC.
+ * Each block of the main application image area covered by the image is erased just before it is programmed,
+ * blocks that are already blank are not erased again. With UPDATE_SKIP_UNCHANGED_BLOCKS defined, blocks that already
+ * hold the update are not erased or programmed at all.
+ * With a journal, each block is recorded in it once programmed. Blocks the journal shows were programmed by an
+ * interrupted copy are not programmed again, only passed to the copy check.
  *
  * IN:
  * - update_area_start_addr - Address of the update image in memory
  * - length                 - Length (in bytes) of the update image to copy
+ * - p_check                - Copy check started by the caller, or NULL to program without checking
+ * - p_journal              - Journal of the copy (see update_journal_open()), or NULL to copy without one
  *
  * RETURNS:
  * - SSP_SUCCESS if operation passes
  * - SSP_ERR_ASSERTION if update_area_start_addr or length are zero.
- * - Error values returned from flash driver if flash operation fails
+ * - Error values returned from flash driver or transfer driver if an operation fails, or from the copy check
  *  */
-ssp_err_t flash_main_image_from_update_area(uint32_t update_area_start_addr, uint32_t length)
+ssp_err_t flash_main_image_from_update_area_and_check(uint32_t update_area_start_addr, uint32_t length, image_copy_check_t * p_check, update_journal_t * p_journal)
 {
     ssp_err_t err;
-    flash_instance_t            p_flash_local = g_flash;
-    uint8_t                     flash_page_buffer[MAIN_FLASH_PROGRAMMING_PAGE_SIZE] BSP_ALIGN_VARIABLE_V2(4);
-#if defined _BL_TESTING
-    extern const flash_api_t    g_flash_on_flash_hp_test;
-    flash_instance_t            flash_local;
-    flash_local.p_ctrl  = g_flash.p_ctrl;
-    flash_local.p_cfg   = g_flash.p_cfg;
-    flash_local.p_api   = &g_flash_on_flash_hp_test;
-
-    p_flash_local       = flash_local;
-#endif
+    uint32_t  offset = 0;
+    flash_instance_t *          p_flash;
 
     if ((0 == update_area_start_addr) || (0 == length))
     {
         return SSP_ERR_ASSERTION;
     }
 
-    err = p_flash_local.p_api->open(p_flash_local.p_ctrl, p_flash_local.p_cfg);
+    // Blocks already programmed by an interrupted copy only need to be checked
+    if (NULL != p_journal)
+    {
+        offset = p_journal->blocks_done * MAIN_IMAGE_ERASE_BLOCK_SIZE;
+        if (offset > length)
+        {
+            offset = length;
+        }
+    }
+
+    err = check_programmed_chunk(p_check, 0, offset);
     if (SSP_SUCCESS != err)
     {
         return err;
     }
 
-    uint32_t bytes_to_program = length;
+    err = flash_session_get(&p_flash);
+    if (SSP_SUCCESS != err)
+    {
+        return err;
+    }
 
-    /* Flash must be programmed in page size */
-    /* Check if length is a multiple of the programming page size */
-    uint32_t page_overflow = (bytes_to_program % MAIN_FLASH_PROGRAMMING_PAGE_SIZE);
-    if (page_overflow != 0)
+#if defined(UPDATE_USES_QSPI_FLASH) && defined(QSPI_COPY_USES_DTC)
+    // if the start address is not in internal flash it is assumed it is in QSPI flash
+    if (!(update_area_start_addr < (INTERNAL_FLASH_START_ADDRESS + TOTAL_INTERNAL_FLASH_SIZE)))
+    {
+        err = program_main_image_from_qspi_dtc(p_flash, update_area_start_addr, offset, length, p_check, p_journal);
+    }
+    else
+#endif
     {
-        // Not a multiple of the programming page size
-        bytes_to_program -= page_overflow;
+        err = program_main_image_direct(p_flash, update_area_start_addr, offset, length, p_check, p_journal);
     }
 
-    err = p_flash_local.p_api->write(p_flash_local.p_ctrl, (uint32_t const)update_area_start_addr, (uint32_t const)MAIN_IMAGE_START_ADDRESS, bytes_to_program);
+    return err;
+}
 
-    if (SSP_SUCCESS == err)
+/*
+ * flash_main_image_block()
+ *
+ * Function to replace one block of the main flash application image area with data from RAM.
+ * The block is erased (unless it is already blank) and programmed from the start.
+ *
+ * IN:
+ * - offset     - Offset of the block from MAIN_IMAGE_START_ADDRESS (MAIN_IMAGE_ERASE_BLOCK_SIZE aligned)
+ * - src_addr   - Address of the data in RAM
+ * - length     - Number of bytes to program, a multiple of MAIN_FLASH_PROGRAMMING_PAGE_SIZE not larger than
+ *                MAIN_IMAGE_ERASE_BLOCK_SIZE
+ *
+ * RETURNS:
+ * - SSP_SUCCESS if operation passes
+ * - SSP_ERR_ASSERTION if a parameter is invalid
+ * - Error values returned from flash driver if flash operation fails
+ *  */
+ssp_err_t flash_main_image_block(uint32_t offset, uint32_t src_addr, uint32_t length)
+{
+    ssp_err_t err;
+    flash_instance_t *          p_flash;
+
+    if ((0 != (offset % MAIN_IMAGE_ERASE_BLOCK_SIZE)) || ((offset + length) > MAIN_IMAGE_MAX_SIZE) ||
+        (0 != (length % MAIN_FLASH_PROGRAMMING_PAGE_SIZE)) || (length > MAIN_IMAGE_ERASE_BLOCK_SIZE))
     {
-        if (page_overflow > 0)
-        {
-            memset((void *)flash_page_buffer, 0xFF, MAIN_FLASH_PROGRAMMING_PAGE_SIZE);
-            memcpy((void *)flash_page_buffer, (void *)(update_area_start_addr + bytes_to_program), page_overflow);
-            err = p_flash_local.p_api->write(p_flash_local.p_ctrl, (uint32_t const)flash_page_buffer, (uint32_t const)(MAIN_IMAGE_START_ADDRESS + bytes_to_program), MAIN_FLASH_PROGRAMMING_PAGE_SIZE);
-        }
+        return SSP_ERR_ASSERTION;
+    }
+
+    err = flash_session_get(&p_flash);
+    if (SSP_SUCCESS != err)
+    {
+        return err;
     }
 
-    // Close the flash driver
-    p_flash_local.p_api->close(p_flash_local.p_ctrl);
+    err = flash_block_erase_start(p_flash, MAIN_IMAGE_START_ADDRESS + offset, MAIN_IMAGE_ERASE_BLOCK_SIZE);
+    if ((SSP_SUCCESS == err) && (0 != length))
+    {
+        err = flash_op_start(p_flash, FLASH_OP_WRITE, src_addr, MAIN_IMAGE_START_ADDRESS + offset, length);
+    }
+
+    // Wait for the last operation even if an error occurred, so none is left outstanding
+    ssp_err_t wait_err = flash_op_wait();
+    if (SSP_SUCCESS == err)
+    {
+        err = wait_err;
+    }
 
     return err;
 }
@@ -123,21 +923,23 @@ ssp_err_t flash_main_image_from_update_area(uint32_t update_area_start_addr, uin
 /*
  * erase_update_image_area()
  *
- * Function to erase the update image area.
- * The complete update image area specified by MAIN_IMAGE_MAX_SIZE is erased.
+ * Function to erase the blocks of the update image area covering length bytes.
+ * Blocks that are already blank are not erased again.
  * Supports both internal flash and QSPI update areas.
  *
  * IN:
  *  - update_area_start_addr - Address where the update image is located in memory
+ *  - length                 - Length (in bytes) of the image in the update area, 0 to erase the whole update area
  *
  * RETURNS:
  * - SSP_SUCCESS if erasure completes without errors
  * - Error values returned from flash driver if flash operation fails
  *
  *  */
-ssp_err_t erase_update_image_area(uint32_t update_area_start_addr)
+ssp_err_t erase_update_image_area(uint32_t update_area_start_addr, uint32_t length)
 {
     ssp_err_t err = SSP_ERR_ASSERTION;
+    uint32_t  num_blocks = area_blocks(length, UPDATE_IMAGE_MAX_SIZE, UPDATE_IMAGE_ERASE_BLOCK_SIZE);
 
     if (0 == update_area_start_addr)
     {
@@ -148,18 +950,8 @@ ssp_err_t erase_update_image_area(uint32_t update_area_start_addr)
     if (!(update_area_start_addr < (INTERNAL_FLASH_START_ADDRESS + TOTAL_INTERNAL_FLASH_SIZE)))
     {
 #ifdef  UPDATE_USES_QSPI_FLASH
-        qspi_instance_t            p_qspi_local = g_qspi;
-#if defined _BL_TESTING
-        extern const qspi_api_t    g_qspi_on_qspi_test;
-        qspi_instance_t           qspi_local;
-        qspi_local.p_ctrl  = g_qspi.p_ctrl;
-        qspi_local.p_cfg   = g_qspi.p_cfg;
-        qspi_local.p_api   = &g_qspi_on_qspi_test;
-
-        p_qspi_local       = qspi_local;
-#endif
-        // Open the QSPI driver
-        err = p_qspi_local.p_api->open(p_qspi_local.p_ctrl, p_qspi_local.p_cfg);
+        qspi_instance_t *          p_qspi;
+        err = qspi_session_get(&p_qspi);
         if (SSP_SUCCESS != err)
         {
             return err;
@@ -168,9 +960,20 @@ ssp_err_t erase_update_image_area(uint32_t update_area_start_addr)
         // Erase the flash area
         // QSPI flash erased in blocks of 32kB
         uint8_t * p_erase_addr = (uint8_t *)update_area_start_addr;
-        for (uint32_t i=0; i<(UPDATE_IMAGE_MAX_SIZE) / (UPDATE_IMAGE_ERASE_BLOCK_SIZE); i++)
+        for (uint32_t i=0; i<num_blocks; i++)
         {
-            err = p_qspi_local.p_api->erase(p_qspi_local.p_ctrl, p_erase_addr, UPDATE_IMAGE_ERASE_BLOCK_SIZE);
+            // Reading the memory mapped block is much quicker than erasing it so skip blocks already blank
+            uint32_t start_cycles = boot_timing_now();
+            bool     blank = memory_mapped_area_is_blank((uint32_t)p_erase_addr, UPDATE_IMAGE_ERASE_BLOCK_SIZE);
+            boot_timing_add(BOOT_PHASE_BLANK_CHECK, start_cycles, UPDATE_IMAGE_ERASE_BLOCK_SIZE);
+            if (true == blank)
+            {
+                p_erase_addr += UPDATE_IMAGE_ERASE_BLOCK_SIZE;
+                continue;
+            }
+
+            start_cycles = boot_timing_now();
+            err = p_qspi->p_api->erase(p_qspi->p_ctrl, p_erase_addr, UPDATE_IMAGE_ERASE_BLOCK_SIZE);
             if (SSP_SUCCESS != err)
             {
                 break;
@@ -180,45 +983,32 @@ ssp_err_t erase_update_image_area(uint32_t update_area_start_addr)
             bool in_progress = true;
             while(true == in_progress)
             {
-                err = p_qspi_local.p_api->statusGet(p_qspi_local.p_ctrl, &in_progress);
+                err = p_qspi->p_api->statusGet(p_qspi->p_ctrl, &in_progress);
                 if (SSP_SUCCESS != err)
                 {
                     break;
                 }
             }
+            boot_timing_add(BOOT_PHASE_ERASE, start_cycles, UPDATE_IMAGE_ERASE_BLOCK_SIZE);
 
             p_erase_addr += UPDATE_IMAGE_ERASE_BLOCK_SIZE;
         }
 
-        // Close the qspi driver
-        p_qspi_local.p_api->close(p_qspi_local.p_ctrl);
 #endif
     }
     else
     {
         // Internal flash being used
-        flash_instance_t            p_flash_local = g_flash;
-#if defined _BL_TESTING
-        extern const flash_api_t    g_flash_on_flash_hp_test;
-        flash_instance_t            flash_local;
-        flash_local.p_ctrl  = g_flash.p_ctrl;
-        flash_local.p_cfg   = g_flash.p_cfg;
-        flash_local.p_api   = &g_flash_on_flash_hp_test;
-
-        p_flash_local       = flash_local;
-#endif
-        err = p_flash_local.p_api->open(p_flash_local.p_ctrl, p_flash_local.p_cfg);
+        flash_instance_t *          p_flash;
+        err = flash_session_get(&p_flash);
         if (SSP_SUCCESS != err)
         {
             return err;
         }
 
         // Erase the flash area
-        err = p_flash_local.p_api->erase(p_flash_local.p_ctrl, (uint32_t const)update_area_start_addr, (UPDATE_IMAGE_MAX_SIZE) / (UPDATE_IMAGE_ERASE_BLOCK_SIZE));
-        // err will fall through after closing the flash driver
+        err = erase_internal_flash_blocks(p_flash, update_area_start_addr, num_blocks, UPDATE_IMAGE_ERASE_BLOCK_SIZE);
 
-        // Close the flash driver
-        p_flash_local.p_api->close(p_flash_local.p_ctrl);
     }
 
     return err;
@@ -227,30 +1017,40 @@ ssp_err_t erase_update_image_area(uint32_t update_area_start_addr)
 /*
  * blank_check_image_area()
  *
- * Function to perform a blank check of an image area.
- * Complete blank check of UPDATE_IMAGE_MAX_SIZE bytes performed.
- * As the application area max size can be no larger than UPDATE_IMAGE_MAX_SIZE this size is used for both areas.
+ * Function to perform a blank check of the first size bytes of an image area.
+ * The first word is checked before anything else, an image header starts with the magic number so an area
+ * holding an image is found to be not blank after reading a single word.
+ * Checking only the header size is enough to find out if an area holds an image. Checking UPDATE_IMAGE_MAX_SIZE
+ * bytes gives a complete blank check of the area.
  *
  * IN:
  *  - area_start_addr       - Start address of the area to be blank checked
+ *  - size                  - Number of bytes to check from area_start_addr (multiple of 4, not larger than UPDATE_IMAGE_MAX_SIZE)
  *  - p_blank_check_result  - Pointer to the boolean variable to store the result - true (blank), false (not-blank)
  *
  * RETURNS:
  * - SSP_SUCCESS if blank check completes without errors
+ * - SSP_ERR_ASSERTION if a parameter is invalid
  * - Error values returned from flash driver if flash operation fails
  *
  *  */
-ssp_err_t blank_check_image_area(uint32_t area_start_addr, bool * p_blank_check_result)
+ssp_err_t blank_check_image_area(uint32_t area_start_addr, uint32_t size, bool * p_blank_check_result)
 {
     ssp_err_t err = SSP_SUCCESS;
 
-    if ((NULL == p_blank_check_result) || (0 == area_start_addr))
+    if ((NULL == p_blank_check_result) || (0 == area_start_addr) || (0 == size) || (0 != (size % 4)) || (size > UPDATE_IMAGE_MAX_SIZE))
     {
         return SSP_ERR_ASSERTION;
     }
 
     *p_blank_check_result = false;
 
+    // First word holds the magic number of any image, if it is programmed there is no need to look further
+    if (ERASED_WORD != *(const uint32_t *)area_start_addr)
+    {
+        return SSP_SUCCESS;
+    }
+
     // if the start address is not in internal flash it is assumed it is in QSPI flash
     if (!(area_start_addr < (INTERNAL_FLASH_START_ADDRESS + TOTAL_INTERNAL_FLASH_SIZE)))
     {
@@ -258,43 +1058,26 @@ ssp_err_t blank_check_image_area(uint32_t area_start_addr, bool * p_blank_check_
         // QSPI code here
 
         // blank check
-        *p_blank_check_result = true;
-        uint8_t *p_src;
-        p_src = (uint8_t *)area_start_addr;
-        for (uint32_t i=0; i<UPDATE_IMAGE_MAX_SIZE; i++)
-        {
-            if (*p_src != ERASED_STATE)
-            {
-                *p_blank_check_result = false;
-                break;
-            }
-
-            p_src++;
-        }
+        uint32_t start_cycles = boot_timing_now();
+        *p_blank_check_result = memory_mapped_area_is_blank(area_start_addr, size);
+        boot_timing_add(BOOT_PHASE_BLANK_CHECK, start_cycles, size);
 #endif
     }
     else
     {
         // Internal flash being used
-        flash_instance_t            p_flash_local = g_flash;
-#if defined _BL_TESTING
-        extern const flash_api_t    g_flash_on_flash_hp_test;
-        flash_instance_t            flash_local;
-        flash_local.p_ctrl  = g_flash.p_ctrl;
-        flash_local.p_cfg   = g_flash.p_cfg;
-        flash_local.p_api   = &g_flash_on_flash_hp_test;
-
-        p_flash_local       = flash_local;
-#endif
-        err = p_flash_local.p_api->open(p_flash_local.p_ctrl, p_flash_local.p_cfg);
+        flash_instance_t *          p_flash;
+        err = flash_session_get(&p_flash);
         if (SSP_SUCCESS != err)
         {
             return err;
         }
 
-        // Blank check the update image area
+        // Blank check the image area
         flash_result_t f_result;
-        err = p_flash_local.p_api->blankCheck(p_flash_local.p_ctrl, (uint32_t const)area_start_addr, (uint32_t const)UPDATE_IMAGE_MAX_SIZE, &f_result);
+        uint32_t start_cycles = boot_timing_now();
+        err = p_flash->p_api->blankCheck(p_flash->p_ctrl, (uint32_t const)area_start_addr, (uint32_t const)size, &f_result);
+        boot_timing_add(BOOT_PHASE_BLANK_CHECK, start_cycles, size);
         if (SSP_SUCCESS != err)
         {
             // Error - err value will be returned
@@ -308,10 +1091,216 @@ ssp_err_t blank_check_image_area(uint32_t area_start_addr, bool * p_blank_check_
             }
         }
 
-        // Close the flash driver
-        p_flash_local.p_api->close(p_flash_local.p_ctrl);
     }
 
     return err;
 }
 
+/*
+ * data_flash_erase()
+ *
+ * Function to erase num_blocks blocks of data flash from address.
+ *
+ * IN:
+ *  - address    - Address of the first block (DATA_FLASH_ERASE_BLOCK_SIZE aligned)
+ *  - num_blocks - Number of blocks to erase
+ *
+ * RETURNS:
+ * - SSP_SUCCESS if erasure completes without errors
+ * - Error values returned from flash driver if flash operation fails
+ *
+ *  */
+ssp_err_t data_flash_erase(uint32_t address, uint32_t num_blocks)
+{
+    ssp_err_t err;
+    flash_instance_t *          p_flash;
+
+    err = flash_session_get(&p_flash);
+    if (SSP_SUCCESS != err)
+    {
+        return err;
+    }
+
+    err = flash_op_start(p_flash, FLASH_OP_ERASE, 0, address, num_blocks);
+
+    // Wait for the erase even if an error occurred, so none is left outstanding
+    ssp_err_t wait_err = flash_op_wait();
+    if (SSP_SUCCESS == err)
+    {
+        err = wait_err;
+    }
+
+    return err;
+}
+
+/*
+ * data_flash_write()
+ *
+ * Function to program length bytes of data flash at address from RAM.
+ *
+ * IN:
+ *  - src_addr  - Address of the data to program
+ *  - address   - Data flash address to program (DATA_FLASH_PROGRAMMING_UNIT aligned)
+ *  - length    - Number of bytes to program (a multiple of DATA_FLASH_PROGRAMMING_UNIT)
+ *
+ * RETURNS:
+ * - SSP_SUCCESS if programming completes without errors
+ * - Error values returned from flash driver if flash operation fails
+ *
+ *  */
+ssp_err_t data_flash_write(uint32_t src_addr, uint32_t address, uint32_t length)
+{
+    ssp_err_t err;
+    flash_instance_t *          p_flash;
+
+    err = flash_session_get(&p_flash);
+    if (SSP_SUCCESS != err)
+    {
+        return err;
+    }
+
+    err = flash_op_start(p_flash, FLASH_OP_WRITE, src_addr, address, length);
+
+    // Wait for the write even if an error occurred, so none is left outstanding
+    ssp_err_t wait_err = flash_op_wait();
+    if (SSP_SUCCESS == err)
+    {
+        err = wait_err;
+    }
+
+    return err;
+}
+
+/*
+ * data_flash_blank_check()
+ *
+ * Function to blank check size bytes of data flash from address.
+ * Erased data flash does not read as a fixed value, so the driver blank check must be used to find unwritten areas.
+ *
+ * IN:
+ *  - address   - Data flash address to check (DATA_FLASH_PROGRAMMING_UNIT aligned)
+ *  - size      - Number of bytes to check (a multiple of DATA_FLASH_PROGRAMMING_UNIT)
+ *
+ * OUT:
+ *  - p_blank_check_result  - true if the area is blank, false otherwise
+ *
+ * RETURNS:
+ * - SSP_SUCCESS if the blank check completes without errors
+ * - Error values returned from flash driver if flash operation fails
+ *
+ *  */
+ssp_err_t data_flash_blank_check(uint32_t address, uint32_t size, bool * p_blank_check_result)
+{
+    ssp_err_t err;
+    flash_instance_t *          p_flash;
+
+    *p_blank_check_result = false;
+
+    err = flash_session_get(&p_flash);
+    if (SSP_SUCCESS != err)
+    {
+        return err;
+    }
+
+    err = flash_blank_check(p_flash, address, size, p_blank_check_result);
+
+    return err;
+}
+
+/*
+ * Image CRC
+ *
+ * CRC-32 (as zlib crc32(), reflected polynomial 0xEDB88320) used as a cheap check of an image before it is hashed.
+ * With IMAGE_CRC_USES_CRC_UNIT the whole words are fed to the CRC calculator peripheral, otherwise (and for any bytes
+ * left over) a 256 entry table is used, built in RAM on first use.
+ *
+ *  */
+#define CRC32_POLYNOMIAL_REFLECTED  (0xEDB88320U)
+#ifdef IMAGE_CRC_USES_CRC_UNIT
+// CRCCR0: CRC-32 (GPS 4), LSB first (LMS 0), clear CRCDOR (DORCLR)
+#define CRC_UNIT_CRCCR0_CRC32       (0x84U)
+#endif
+
+static uint32_t crc32_table[256];
+static bool     crc32_table_built = false;
+
+/*
+ * crc32_bytes()
+ *
+ * Continue a CRC-32 over length bytes at p_data, a byte at a time from the table.
+ *
+ *  */
+static uint32_t crc32_bytes(uint32_t crc, const uint8_t * p_data, uint32_t length)
+{
+    if (!crc32_table_built)
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (uint32_t bit = 0; bit < 8; bit++)
+            {
+                c = (c & 1U) ? ((c >> 1) ^ CRC32_POLYNOMIAL_REFLECTED) : (c >> 1);
+            }
+            crc32_table[i] = c;
+        }
+        crc32_table_built = true;
+    }
+
+    crc = ~crc;
+    while (length--)
+    {
+        crc = crc32_table[(crc ^ *p_data++) & 0xFFU] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+/*
+ * image_crc32()
+ *
+ * Function to continue a CRC-32 over length bytes of memory (RAM, or memory mapped flash) at address.
+ *
+ * IN:
+ *  - crc       - CRC of the data before address, 0 to start
+ *  - address   - Address of the data
+ *  - length    - Number of bytes
+ *
+ * RETURNS:
+ * - The CRC of the data before address followed by the length bytes at address
+ *
+ *  */
+uint32_t image_crc32(uint32_t crc, uint32_t address, uint32_t length)
+{
+    uint32_t start_cycles = boot_timing_now();
+    uint32_t total = length;
+
+#ifdef IMAGE_CRC_USES_CRC_UNIT
+    if ((0 == (address & 3U)) && (length >= 4))
+    {
+        const uint32_t * p_word = (const uint32_t *)address;
+        uint32_t         words = length / 4;
+
+        // Release the CRC calculator from the module stop state, and seed it
+        R_MSTP->MSTPCRC_b.MSTPC1 = 0U;
+        R_CRC->CRCCR0 = CRC_UNIT_CRCCR0_CRC32;
+        R_CRC->CRCDOR = ~crc;
+
+        for (uint32_t i = 0; i < words; i++)
+        {
+            R_CRC->CRCDIR = p_word[i];
+        }
+
+        crc = ~R_CRC->CRCDOR;
+        R_MSTP->MSTPCRC_b.MSTPC1 = 1U;
+
+        address += words * 4;
+        length -= words * 4;
+    }
+#endif
+
+    crc = crc32_bytes(crc, (const uint8_t *)address, length);
+
+    boot_timing_add(BOOT_PHASE_CRC, start_cycles, total);
+
+    return crc;
+}
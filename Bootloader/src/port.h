@@ -10,41 +10,56 @@
 #include "hal_data.h"
 #include <string.h>
 
-/* MCU specific definitions */
-#define PK_S5D9
-#ifdef PK_S5D9
-
-// Undefine below to use external QSPI flash as the image update area.
-//#define UPDATE_USES_QSPI_FLASH
-
-#define INTERNAL_FLASH_START_ADDRESS 0
-#define TOTAL_INTERNAL_FLASH_SIZE   (0x00200000)
-// The address of the main executable application image in flash
-// The first part of this image will be the header.
-// So, the actual link address for this application will be offset by the header size (default H'100 bytes)
-#define MAIN_IMAGE_START_ADDRESS    (0x00010000)
-#define MAIN_IMAGE_ERASE_BLOCK_SIZE (32 * 1024)
-#define MAIN_FLASH_PROGRAMMING_PAGE_SIZE (128)
-#ifdef  UPDATE_USES_QSPI_FLASH
-// All the internal flash (less the bootloader) is avaliable for the application as the update image is in QSPI flash
-#define MAIN_IMAGE_MAX_SIZE         (TOTAL_INTERNAL_FLASH_SIZE - MAIN_IMAGE_START_ADDRESS)
-#define UPDATE_IMAGE_START_ADDRESS  (0x60000000)
-// QSPI - W25Q64FV
-#define FLASH_PROGRAMMING_PAGE_SIZE (256)
-#define UPDATE_IMAGE_ERASE_BLOCK_SIZE (32 * 1024)
-#else
-// The main image size is half of the internal flash excluding the Bootloader itself
-#define MAIN_IMAGE_MAX_SIZE         ((TOTAL_INTERNAL_FLASH_SIZE - MAIN_IMAGE_START_ADDRESS) / 2)
-#define UPDATE_IMAGE_START_ADDRESS  (MAIN_IMAGE_START_ADDRESS + MAIN_IMAGE_MAX_SIZE)
-#define UPDATE_IMAGE_ERASE_BLOCK_SIZE (32 * 1024)
-#endif /* QSPI Flash */
-#define UPDATE_IMAGE_MAX_SIZE       (MAIN_IMAGE_MAX_SIZE)
-#define ERASED_STATE                (0xFF)
-#endif /* PK_S5D9 */
-
-ssp_err_t erase_main_image_area(void);
-ssp_err_t flash_main_image_from_update_area(uint32_t update_area_start_addr, uint32_t length);
-ssp_err_t erase_update_image_area(uint32_t update_area_start_addr);
-ssp_err_t blank_check_image_area(uint32_t area_start_addr, bool * p_blank_check_result);
+#include "flash_layout.h"
+
+#ifdef UPDATE_USES_QSPI_FLASH
+// Undefine below to program the main image directly from the memory mapped QSPI flash.
+// When defined the DTC (g_transfer_qspi) reads the update image into one RAM buffer while the other is programmed.
+#define QSPI_COPY_USES_DTC
+// Size of each copy buffer, one DTC block of 256 words (must be a multiple of MAIN_FLASH_PROGRAMMING_PAGE_SIZE)
+#define QSPI_COPY_BUFFER_SIZE       (1024)
+#endif
+
+// Undefine below to erase and program every main image block an update covers.
+// When defined each block is compared with the update before it is erased, and a block that already holds the update
+// is left as it is (saving the erase and program time, and an erase cycle).
+#define UPDATE_SKIP_UNCHANGED_BLOCKS
+
+// Define below to calculate image CRCs (see IMAGE_CRC_MAGIC in bootloader.h) with the CRC calculator peripheral.
+// When undefined a table driven software CRC is used.
+//#define IMAGE_CRC_USES_CRC_UNIT
+
+// Value of a journal entry, programmed once a main image block has been erased and programmed
+#define UPDATE_JOURNAL_BLOCK_DONE   (0x600DB10CU)
+
+// Check applied to the main image area as it is programmed from the update image.
+// p_chunk_programmed is called for each chunk, in order, once it has been programmed and can stop the copy by
+// returning an error. Implementations embed this as their first member.
+typedef struct image_copy_check image_copy_check_t;
+struct image_copy_check {
+    ssp_err_t (* p_chunk_programmed)(image_copy_check_t * p_check, uint32_t offset, uint32_t size);
+};
+
+// Progress of copying an update into the main image area, so an interrupted copy can be resumed
+typedef struct update_journal {
+    uint32_t entries_addr;      // Data flash address of the entry for the first main image block
+    uint32_t backups_addr;      // Data flash address of the delta backup entry for the first main image block
+    uint32_t blocks_done;       // Number of leading main image blocks already programmed
+} update_journal_t;
+
+void flash_ready_callback(flash_callback_args_t * p_args);
+
+ssp_err_t erase_main_image_area(uint32_t length);
+ssp_err_t flash_main_image_from_update_area(uint32_t update_area_start_addr, uint32_t length, update_journal_t * p_journal);
+ssp_err_t flash_main_image_from_update_area_and_check(uint32_t update_area_start_addr, uint32_t length, image_copy_check_t * p_check, update_journal_t * p_journal);
+ssp_err_t flash_main_image_block(uint32_t offset, uint32_t src_addr, uint32_t length);
+bool main_image_block_unchanged(uint32_t offset, uint32_t src_addr, uint32_t length);
+ssp_err_t erase_update_image_area(uint32_t update_area_start_addr, uint32_t length);
+ssp_err_t blank_check_image_area(uint32_t area_start_addr, uint32_t size, bool * p_blank_check_result);
+ssp_err_t data_flash_erase(uint32_t address, uint32_t num_blocks);
+ssp_err_t data_flash_write(uint32_t src_addr, uint32_t address, uint32_t length);
+ssp_err_t data_flash_blank_check(uint32_t address, uint32_t size, bool * p_blank_check_result);
+void storage_session_close(void);
+uint32_t image_crc32(uint32_t crc, uint32_t address, uint32_t length);
 
 #endif /* PORT_H_ */
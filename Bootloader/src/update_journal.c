@@ -0,0 +1,331 @@
+/*
+ * update_journal.c
+ *
+ * Journal of the copy of an update into the main image area, kept in data flash, so a copy interrupted by a reset
+ * or power failure is resumed from the last completed block rather than started again.
+ *
+ * UPDATE_JOURNAL_ADDRESS layout:
+ *   Header  - UPDATE_JOURNAL_HEADER_SIZE bytes identifying the update being copied, written when the copy starts
+ *   Entries - One DATA_FLASH_PROGRAMMING_UNIT word per main image block, UPDATE_JOURNAL_BLOCK_DONE once the block
+ *             has been erased and programmed (written by flash_main_image_from_update_area_and_check(), or by
+ *             delta_update_apply())
+ *   Backups - One DATA_FLASH_PROGRAMMING_UNIT word per main image block, UPDATE_JOURNAL_BLOCK_DONE once the block
+ *             has been copied to DELTA_BACKUP_ADDRESS before a delta update rebuilds it
+ *
+ * Erased data flash does not read as a fixed value, so unwritten words are found by blank checking. The header is
+ * only valid once its commit word has been written after the rest of it. A copy that failed its final verify has its
+ * failed word written, so it is not continued, but the header (and the version floor in it) is kept until an update
+ * completes.
+ */
+#include "bootloader.h"
+#include <stddef.h>
+
+#define UPDATE_JOURNAL_MAGIC            0x4A425359      // "YSBJ"
+#define UPDATE_JOURNAL_COMMIT           0xC0111117U
+#define UPDATE_JOURNAL_FAILED           0xFA11ED00U
+#define UPDATE_JOURNAL_HEADER_SIZE      (2 * DATA_FLASH_ERASE_BLOCK_SIZE)
+#define UPDATE_JOURNAL_ENTRIES_ADDRESS  (UPDATE_JOURNAL_ADDRESS + UPDATE_JOURNAL_HEADER_SIZE)
+#define UPDATE_JOURNAL_MAX_BLOCKS       (MAIN_IMAGE_MAX_SIZE / MAIN_IMAGE_ERASE_BLOCK_SIZE)
+#define UPDATE_JOURNAL_BACKUPS_ADDRESS  (UPDATE_JOURNAL_ENTRIES_ADDRESS + (UPDATE_JOURNAL_MAX_BLOCKS * DATA_FLASH_PROGRAMMING_UNIT))
+
+#if ((UPDATE_JOURNAL_HEADER_SIZE + (2 * UPDATE_JOURNAL_MAX_BLOCKS * DATA_FLASH_PROGRAMMING_UNIT)) > UPDATE_JOURNAL_SIZE)
+#error "Update journal entries for every main image block do not fit in UPDATE_JOURNAL_SIZE"
+#endif
+
+typedef struct update_journal_header {
+    uint32_t magic;
+    // Signature, Length and Version of the update being copied
+    uint32_t signature[SIGNATURE_LEN];
+    uint32_t length;
+    uint32_t version;
+    // Version of the main image the update replaces
+    uint32_t previous_version;
+    uint32_t commit;
+    // Written after commit if the copy fails its final verify
+    uint32_t failed;
+} update_journal_header_t;
+
+/*
+ * update_journal_header_read()
+ *
+ * Read the journal header, if one has been completely written.
+ *
+ * RETURNS:
+ * - true if p_header holds a valid header
+ * - false otherwise
+ *
+ *  */
+static bool update_journal_header_read(update_journal_header_t * p_header)
+{
+    bool blank = true;
+
+    if ((SSP_SUCCESS != data_flash_blank_check(UPDATE_JOURNAL_ADDRESS + offsetof(update_journal_header_t, commit), DATA_FLASH_PROGRAMMING_UNIT, &blank)) || (blank))
+    {
+        return false;
+    }
+
+    memcpy(p_header, (void *)UPDATE_JOURNAL_ADDRESS, sizeof(update_journal_header_t));
+
+    return ((UPDATE_JOURNAL_MAGIC == p_header->magic) && (UPDATE_JOURNAL_COMMIT == p_header->commit));
+}
+
+/*
+ * update_journal_blocks_done()
+ *
+ * Count the leading main image blocks recorded as programmed.
+ *
+ * RETURNS:
+ * - true if the entries are consistent, with the count in p_blocks_done
+ * - false if an entry was left partly written, the journal cannot be continued
+ *
+ *  */
+static bool update_journal_blocks_done(uint32_t * p_blocks_done)
+{
+    bool blank = true;
+
+    for (uint32_t block = 0; block < UPDATE_JOURNAL_MAX_BLOCKS; block++)
+    {
+        uint32_t entry_addr = UPDATE_JOURNAL_ENTRIES_ADDRESS + (block * DATA_FLASH_PROGRAMMING_UNIT);
+
+        if (SSP_SUCCESS != data_flash_blank_check(entry_addr, DATA_FLASH_PROGRAMMING_UNIT, &blank))
+        {
+            return false;
+        }
+
+        if (blank)
+        {
+            *p_blocks_done = block;
+            return true;
+        }
+
+        if (UPDATE_JOURNAL_BLOCK_DONE != *(uint32_t *)entry_addr)
+        {
+            return false;
+        }
+    }
+
+    *p_blocks_done = UPDATE_JOURNAL_MAX_BLOCKS;
+    return true;
+}
+
+/*
+ * update_journal_resume()
+ *
+ * Check the journal is for the update image and count the blocks already programmed.
+ *
+ *  */
+static bool update_journal_resume(bootloader_image_header_t * p_update_header, uint32_t * p_blocks_done)
+{
+    update_journal_header_t header;
+
+    if (!update_journal_header_read(&header))
+    {
+        return false;
+    }
+
+    if ((0 != memcmp(header.signature, p_update_header->signature, sizeof(header.signature))) ||
+        (header.length != p_update_header->length) ||
+        (header.version != p_update_header->version))
+    {
+        return false;
+    }
+
+    // A copy that failed its final verify is not continued (any written failed word counts, in case writing it was
+    // interrupted)
+    bool blank = true;
+    if ((SSP_SUCCESS != data_flash_blank_check(UPDATE_JOURNAL_ADDRESS + offsetof(update_journal_header_t, failed), DATA_FLASH_PROGRAMMING_UNIT, &blank)) || (!blank))
+    {
+        return false;
+    }
+
+    return update_journal_blocks_done(p_blocks_done);
+}
+
+/*
+ * update_journal_matches()
+ *
+ * Check if the journal records an interrupted copy of the update image.
+ *
+ * IN:
+ *  - p_update_header   - Header of the update image
+ *
+ * RETURNS:
+ * - true if the journal is for this update and can be continued
+ * - false otherwise
+ *
+ *  */
+bool update_journal_matches(bootloader_image_header_t * p_update_header)
+{
+    uint32_t blocks_done;
+
+    return update_journal_resume(p_update_header, &blocks_done);
+}
+
+/*
+ * update_journal_version_floor()
+ *
+ * An interrupted copy leaves the main image invalid, so its version can no longer be read from it. The journal
+ * keeps the version of the main image the update was replacing, so that older updates can still be rejected.
+ *
+ * RETURNS:
+ * - Version of the main image replaced by the update recorded in the journal, 0 if there is no journal
+ *
+ *  */
+uint32_t update_journal_version_floor(void)
+{
+    update_journal_header_t header;
+
+    if (!update_journal_header_read(&header))
+    {
+        return 0;
+    }
+
+    return header.previous_version;
+}
+
+/*
+ * update_journal_open()
+ *
+ * Start the journal for copying the update image into the main image area, or continue the journal of an
+ * interrupted copy of the same update.
+ *
+ * IN:
+ *  - p_update_header   - Header of the update image
+ *  - previous_version  - Version of the main image the update replaces
+ *
+ * OUT:
+ *  - p_journal         - Journal to pass to flash_main_image_from_update_area_and_check()
+ *
+ * RETURNS:
+ * - SSP_SUCCESS if the journal is ready
+ * - Error values returned from flash driver if flash operation fails
+ *
+ *  */
+ssp_err_t update_journal_open(bootloader_image_header_t * p_update_header, uint32_t previous_version, update_journal_t * p_journal)
+{
+    ssp_err_t               err;
+    update_journal_header_t header;
+
+    p_journal->entries_addr = UPDATE_JOURNAL_ENTRIES_ADDRESS;
+    p_journal->backups_addr = UPDATE_JOURNAL_BACKUPS_ADDRESS;
+    p_journal->blocks_done  = 0;
+
+    if (update_journal_resume(p_update_header, &p_journal->blocks_done))
+    {
+        // Continue the interrupted copy
+        return SSP_SUCCESS;
+    }
+
+    header.magic = UPDATE_JOURNAL_MAGIC;
+    memcpy(header.signature, p_update_header->signature, sizeof(header.signature));
+    header.length           = p_update_header->length;
+    header.version          = p_update_header->version;
+    header.previous_version = previous_version;
+    header.commit           = UPDATE_JOURNAL_COMMIT;
+
+    err = data_flash_erase(UPDATE_JOURNAL_ADDRESS, UPDATE_JOURNAL_SIZE / DATA_FLASH_ERASE_BLOCK_SIZE);
+    if (SSP_SUCCESS == err)
+    {
+        err = data_flash_write((uint32_t)&header, UPDATE_JOURNAL_ADDRESS, offsetof(update_journal_header_t, commit));
+    }
+    if (SSP_SUCCESS == err)
+    {
+        // The header is valid from here
+        err = data_flash_write((uint32_t)&header.commit, UPDATE_JOURNAL_ADDRESS + offsetof(update_journal_header_t, commit), DATA_FLASH_PROGRAMMING_UNIT);
+    }
+
+    return err;
+}
+
+/*
+ * update_journal_close()
+ *
+ * Erase the journal, once the copy has completed and been verified.
+ *
+ *  */
+void update_journal_close(void)
+{
+    data_flash_erase(UPDATE_JOURNAL_ADDRESS, UPDATE_JOURNAL_SIZE / DATA_FLASH_ERASE_BLOCK_SIZE);
+}
+
+/*
+ * update_journal_fail()
+ *
+ * Mark the copy as failed, once the new main image has failed verification. The copy is not continued, an update
+ * is copied again from the start, but the journal header is kept so update_journal_version_floor() still returns
+ * the version of the image that was replaced. Erasing the journal here would let an older update be applied to the
+ * now invalid main image.
+ *
+ *  */
+void update_journal_fail(void)
+{
+    static const uint32_t failed = UPDATE_JOURNAL_FAILED;
+
+    data_flash_write((uint32_t)&failed, UPDATE_JOURNAL_ADDRESS + offsetof(update_journal_header_t, failed), DATA_FLASH_PROGRAMMING_UNIT);
+}
+
+/*
+ * update_journal_entry_write()
+ *
+ * Write the entry at entry_addr.
+ *
+ *  */
+static ssp_err_t update_journal_entry_write(uint32_t entry_addr)
+{
+    static const uint32_t entry = UPDATE_JOURNAL_BLOCK_DONE;
+
+    return data_flash_write((uint32_t)&entry, entry_addr, DATA_FLASH_PROGRAMMING_UNIT);
+}
+
+/*
+ * update_journal_block_done()
+ *
+ * Record that a main image block has been programmed, for updates not programmed by
+ * flash_main_image_from_update_area_and_check() (which writes its own entries).
+ * Blocks must be recorded in order.
+ *
+ *  */
+ssp_err_t update_journal_block_done(update_journal_t * p_journal, uint32_t block)
+{
+    ssp_err_t err = update_journal_entry_write(p_journal->entries_addr + (block * DATA_FLASH_PROGRAMMING_UNIT));
+
+    if (SSP_SUCCESS == err)
+    {
+        p_journal->blocks_done = block + 1;
+    }
+
+    return err;
+}
+
+/*
+ * update_journal_backup_done()
+ *
+ * Record that a main image block has been copied to DELTA_BACKUP_ADDRESS, so it can be read from there if it is
+ * lost by an interrupted erase or program.
+ *
+ *  */
+ssp_err_t update_journal_backup_done(update_journal_t * p_journal, uint32_t block)
+{
+    return update_journal_entry_write(p_journal->backups_addr + (block * DATA_FLASH_PROGRAMMING_UNIT));
+}
+
+/*
+ * update_journal_backup_valid()
+ *
+ * RETURNS:
+ * - true if DELTA_BACKUP_ADDRESS holds a complete copy of the main image block
+ * - false otherwise
+ *
+ *  */
+bool update_journal_backup_valid(update_journal_t * p_journal, uint32_t block)
+{
+    uint32_t entry_addr = p_journal->backups_addr + (block * DATA_FLASH_PROGRAMMING_UNIT);
+    bool     blank = true;
+
+    if ((SSP_SUCCESS != data_flash_blank_check(entry_addr, DATA_FLASH_PROGRAMMING_UNIT, &blank)) || (blank))
+    {
+        return false;
+    }
+
+    return (UPDATE_JOURNAL_BLOCK_DONE == *(uint32_t *)entry_addr);
+}
@@ -0,0 +1,84 @@
+/*
+ * boot_timing_record.h
+ *
+ * Format of the boot timing record the bootloader leaves in RAM for the application.
+ * This file is shared by the bootloader and the application, both projects build it from the Common linked folder.
+ *
+ * The record is placed in the .boot_record section, which the linker scripts of both projects reserve at
+ * BOOT_TIMING_RECORD_ADDRESS. The section is not initialised by the startup code of either, so the application finds
+ * the record as the bootloader left it at handoff (until it writes to it or the device is powered off).
+ *
+ * All fields are little endian. Offsets in bytes from BOOT_TIMING_RECORD_ADDRESS:
+ *   0x00   magic           - BOOT_TIMING_RECORD_MAGIC, written last, once the rest of the record is complete
+ *   0x04   format          - BOOT_TIMING_RECORD_FORMAT
+ *   0x08   phase_count     - Number of entries in phase[] (BOOT_PHASE_COUNT)
+ *   0x0C   core_clock_hz   - Core clock (SystemCoreClock) the cycle counts were taken at
+ *   0x10   total_cycles    - 64 bit, cycles from the start of hal_entry() to the jump to the application
+ *   0x18   phase[]         - phase_count entries of 16 bytes, indexed by boot_phase_t:
+ *          +0x00 cycles    - 64 bit, total cycles spent in the phase
+ *          +0x08 bytes     - Total bytes handled by the phase (0 for phases with no data)
+ *          +0x0C calls     - Number of times the phase was entered
+ *   then   count[]         - BOOT_COUNT_COUNT counters of 4 bytes, indexed by boot_count_t
+ *   then   check           - Bitwise inverse of the 32 bit sum of all the words before it (from magic)
+ *
+ * Cycles are counted with the DWT cycle counter. A phase can be entered from within the time of another (e.g. hashing
+ * the new image while it is copied), so the phase cycles do not add up to total_cycles.
+ */
+
+#ifndef BOOT_TIMING_RECORD_H_
+#define BOOT_TIMING_RECORD_H_
+
+#include <stdint.h>
+
+#define BOOT_TIMING_RECORD_ADDRESS  (0x2007FF00)
+#define BOOT_TIMING_RECORD_SIZE     (0x100)
+#define BOOT_TIMING_RECORD_MAGIC    (0x54425359)    // "YSBT"
+#define BOOT_TIMING_RECORD_FORMAT   (5)
+
+typedef enum e_boot_phase
+{
+    BOOT_PHASE_DRIVER_OPEN,     // Opening the SCE, ECC and hash drivers in hal_entry()
+    BOOT_PHASE_BLANK_CHECK,     // Blank checks of code flash, data flash or memory mapped QSPI flash (bytes checked)
+    BOOT_PHASE_HASH,            // SHA256 hash driver updates (bytes hashed)
+    BOOT_PHASE_ECC_VERIFY,      // SCE ECC signature verifies
+    BOOT_PHASE_ERASE,           // Code flash, data flash and QSPI flash erases (bytes erased)
+    BOOT_PHASE_PROGRAM,         // Code flash and data flash programming (bytes programmed)
+    BOOT_PHASE_HANDOFF,         // boot_main_application() closing drivers, up to the jump to the application
+    BOOT_PHASE_COMPARE,         // Comparing main image blocks with an update before they are erased (bytes compared)
+    BOOT_PHASE_UPDATE,          // Applying an update to the main image area, including its check (update image bytes)
+    BOOT_PHASE_STORAGE_SESSION, // Opening and closing the flash and QSPI drivers (port.c storage sessions)
+    BOOT_PHASE_CRC,             // Image CRC checks before hashing (bytes checked)
+    BOOT_PHASE_COUNT
+} boot_phase_t;
+
+typedef enum e_boot_count
+{
+    BOOT_COUNT_MAIN_BLOCKS_ERASED,      // Main image area blocks erased (code flash erase cycles)
+    BOOT_COUNT_MAIN_BLOCKS_UNCHANGED,   // Main image area blocks an update left as they were, as they already held it
+    BOOT_COUNT_STORAGE_OPENS_SAVED,     // Flash and QSPI operations that used an open driver rather than opening it
+    BOOT_COUNT_VERIFIES_REUSED,         // Image verifies answered by an earlier verify of the same image in this boot
+    BOOT_COUNT_VERIFIES_SKIPPED,        // Update images rejected by their header before being hashed
+    BOOT_COUNT_COUNT
+} boot_count_t;
+
+typedef struct boot_timing_phase {
+    uint64_t cycles;
+    uint32_t bytes;
+    uint32_t calls;
+} boot_timing_phase_t;
+
+typedef struct boot_timing_record {
+    uint32_t            magic;
+    uint32_t            format;
+    uint32_t            phase_count;
+    uint32_t            core_clock_hz;
+    uint64_t            total_cycles;
+    boot_timing_phase_t phase[BOOT_PHASE_COUNT];
+    uint32_t            count[BOOT_COUNT_COUNT];
+    uint32_t            check;
+} boot_timing_record_t;
+
+// The record must fit the .boot_record section the linker scripts reserve
+_Static_assert(sizeof(boot_timing_record_t) <= BOOT_TIMING_RECORD_SIZE, "boot_timing_record_t does not fit in BOOT_TIMING_RECORD_SIZE");
+
+#endif /* BOOT_TIMING_RECORD_H_ */
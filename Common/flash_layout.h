@@ -0,0 +1,63 @@
+/*
+ * flash_layout.h
+ *
+ * Flash memory map of the bootloader: the main image area, the update image area (internal or QSPI flash) and the
+ * data flash the bootloader reserves. Shared by the bootloader (port.h) and applications writing updates (see
+ * PK_S5D9_BL_Blinky/src/update_writer.h), both projects build it from the Common linked folder.
+ */
+
+#ifndef FLASH_LAYOUT_H_
+#define FLASH_LAYOUT_H_
+
+/* MCU specific definitions */
+#define PK_S5D9
+#ifdef PK_S5D9
+
+// Undefine below to use external QSPI flash as the image update area.
+//#define UPDATE_USES_QSPI_FLASH
+
+#define INTERNAL_FLASH_START_ADDRESS 0
+#define TOTAL_INTERNAL_FLASH_SIZE   (0x00200000)
+// The address of the main executable application image in flash
+// The first part of this image will be the header.
+// So, the actual link address for this application will be offset by the header size (default H'100 bytes)
+#define MAIN_IMAGE_START_ADDRESS    (0x00010000)
+#define MAIN_IMAGE_ERASE_BLOCK_SIZE (32 * 1024)
+#define MAIN_FLASH_PROGRAMMING_PAGE_SIZE (128)
+// QSPI - W25Q64FV
+#define FLASH_PROGRAMMING_PAGE_SIZE (256)
+#ifdef  UPDATE_USES_QSPI_FLASH
+// All the internal flash (less the bootloader) is avaliable for the application as the update image is in QSPI flash
+#define MAIN_IMAGE_MAX_SIZE         (TOTAL_INTERNAL_FLASH_SIZE - MAIN_IMAGE_START_ADDRESS)
+#define UPDATE_IMAGE_START_ADDRESS  (0x60000000)
+#define UPDATE_IMAGE_ERASE_BLOCK_SIZE (32 * 1024)
+#define UPDATE_IMAGE_MAX_SIZE       (MAIN_IMAGE_MAX_SIZE)
+#else
+// The update image area is half of the internal flash excluding the Bootloader itself, and the main image has the rest.
+// If all updates are compressed (IMAGE_HEADER_VERSION_COMPRESSED) the update area can be made smaller to give the main
+// image more space (keep it a multiple of MAIN_IMAGE_ERASE_BLOCK_SIZE). The application must still fit the update area
+// once compressed.
+#define UPDATE_IMAGE_MAX_SIZE       ((TOTAL_INTERNAL_FLASH_SIZE - MAIN_IMAGE_START_ADDRESS) / 2)
+#define MAIN_IMAGE_MAX_SIZE         (TOTAL_INTERNAL_FLASH_SIZE - MAIN_IMAGE_START_ADDRESS - UPDATE_IMAGE_MAX_SIZE)
+#define UPDATE_IMAGE_START_ADDRESS  (MAIN_IMAGE_START_ADDRESS + MAIN_IMAGE_MAX_SIZE)
+#define UPDATE_IMAGE_ERASE_BLOCK_SIZE (32 * 1024)
+#endif /* QSPI Flash */
+#define ERASED_STATE                (0xFF)
+#define ERASED_WORD                 (0xFFFFFFFFU)
+// Data flash, erase/program operations on it can run in the background (g_flash Data Flash Background Operation)
+#define DATA_FLASH_START_ADDRESS    (0x40100000)
+#define DATA_FLASH_SIZE             (64 * 1024)
+#define DATA_FLASH_ERASE_BLOCK_SIZE (64)
+#define DATA_FLASH_PROGRAMMING_UNIT (4)
+// Data flash reserved for the bootloader's boot cache record (see BOOT_CACHE in bootloader.h)
+#define BOOT_CACHE_ADDRESS          (DATA_FLASH_START_ADDRESS)
+#define BOOT_CACHE_SIZE             (4 * DATA_FLASH_ERASE_BLOCK_SIZE)
+// Data flash reserved for the update journal
+#define UPDATE_JOURNAL_ADDRESS      (BOOT_CACHE_ADDRESS + BOOT_CACHE_SIZE)
+#define UPDATE_JOURNAL_SIZE         (16 * DATA_FLASH_ERASE_BLOCK_SIZE)
+// Data flash reserved for a copy of the main image block a delta update is rebuilding
+#define DELTA_BACKUP_ADDRESS        (UPDATE_JOURNAL_ADDRESS + UPDATE_JOURNAL_SIZE)
+#define DELTA_BACKUP_SIZE           (MAIN_IMAGE_ERASE_BLOCK_SIZE)
+#endif /* PK_S5D9 */
+
+#endif /* FLASH_LAYOUT_H_ */
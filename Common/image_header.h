@@ -0,0 +1,69 @@
+/*
+ * image_header.h
+ *
+ * Format of a signed image and its header. Shared by the bootloader (bootloader.h) and applications writing updates
+ * (see PK_S5D9_BL_Blinky/src/update_writer.h), both projects build it from the Common linked folder. Images are made
+ * by Bootloader/Image_Tools/yasb.py.
+ */
+
+#ifndef IMAGE_HEADER_H_
+#define IMAGE_HEADER_H_
+
+#include "hal_data.h"
+#include "r_ecc_api.h"
+#include "sha256_hal.h"
+#include "flash_layout.h"
+
+#define MAGIC_NUMBER            "YASB"
+#define MAGIC_NUMBER_LEN        4
+
+#define SIGNATURE_LEN           (2 * ECC_256_SIGNATURE_R_LENGTH_WORDS)
+#define SIGNATURE_LEN_BYTES     (4 * SIGNATURE_LEN)
+
+#define IMAGE_HEADER_SIZE       0x100
+
+// Offset of the first hashed byte of an image (the Length field)
+#define IMAGE_HASH_OFFSET       (MAGIC_NUMBER_LEN + SIGNATURE_LEN_BYTES)
+
+// Header versions
+// 0 - One signature over the SHA256 of the whole image (from the Length field)
+// 1 - The image ends with a table of SHA256 hashes of each IMAGE_BLOCK_SIZE block of the image before the table
+//     (the first block from the Length field). The signature is over the SHA256 of the header (from the Length field)
+//     followed by the table, so each block can be checked on its own.
+// 2 - Delta update. The payload is a patch rebuilding a new main image (the target) from the current one (the base),
+//     see delta_update.c. Signed in the same way as version 0. Only valid as an update image.
+// 3 - Compressed update. The payload is a new main image (the target, any other version) compressed one
+//     IMAGE_BLOCK_SIZE block at a time, see compressed_update.c. Signed in the same way as version 0. Only valid as
+//     an update image.
+#define IMAGE_HEADER_VERSION_FLAT           0
+#define IMAGE_HEADER_VERSION_BLOCK_TABLE    1
+#define IMAGE_HEADER_VERSION_DELTA          2
+#define IMAGE_HEADER_VERSION_COMPRESSED     3
+
+// An image of any header version can carry a CRC-32 (as zlib crc32()) of the data after the header, up to the block
+// table of a version 1 image (sign -r). It is in the signed header, and verify_image() checks it before any hashing so
+// a corrupt or partly written image is rejected quickly. It is only a pre-filter, the signature is always checked.
+#define IMAGE_CRC_MAGIC             0x20435243  // "CRC ", in crc_magic when image_crc is set
+
+#define IMAGE_BLOCK_SIZE            MAIN_IMAGE_ERASE_BLOCK_SIZE
+#define IMAGE_BLOCK_TABLE_MAX_SIZE  ((MAIN_IMAGE_MAX_SIZE / IMAGE_BLOCK_SIZE) * SHA256_DIGEST_SIZE_BYTES)
+
+typedef struct bootloader_image_header {
+    uint32_t magic_number;
+    uint32_t signature[SIGNATURE_LEN];
+    uint32_t length;
+    uint32_t version;
+    // Fields below are in the header padding, so are zero in a version 0 header
+    uint32_t header_version;
+    uint32_t block_size;                        // Version 1, 2 and 3, IMAGE_BLOCK_SIZE
+    uint32_t block_count;                       // Version 1
+    uint32_t base_version;                      // Version 2, version of the base image
+    uint32_t base_length;                       // Version 2, total size of the base image
+    uint32_t target_length;                     // Version 2 and 3, total size of the target image
+    uint32_t target_digest[SHA256_DIGEST_SIZE_BYTES / 4];  // Version 2 and 3, SHA256 of the whole target image
+    uint32_t base_signature[SIGNATURE_LEN];     // Version 2, signature of the base image
+    uint32_t crc_magic;                         // IMAGE_CRC_MAGIC if image_crc is set
+    uint32_t image_crc;                         // CRC-32 of the image after the header (see IMAGE_CRC_MAGIC)
+} bootloader_image_header_t;
+
+#endif /* IMAGE_HEADER_H_ */
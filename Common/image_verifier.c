@@ -0,0 +1,437 @@
+/*
+ * image_verifier.c
+ *
+ * Checks of a signed image (see image_header.h): the header, the signature, and a verify of the whole image made a step
+ * at a time. Shared by the bootloader (image_verify.c) and applications, both projects build it from the Common linked
+ * folder. Each project opens its own hash and ECC drivers and passes the instances in.
+ */
+#include "image_verifier.h"
+#include "boot_timing.h"
+
+// State of an image_verifier_t
+#define IMAGE_VERIFIER_HASH         0   // Hashing the image (version 0) or its blocks (version 1)
+#define IMAGE_VERIFIER_SIGNATURE    1   // Checking the signature, of the image hash (version 0) or block table (version 1)
+#define IMAGE_VERIFIER_DONE         2
+
+/* Recommended Parameters secp256k1
+ *
+ *  Curve E: y^2 = x^3 +ax + b
+ *
+ */
+static const uint8_t image_verifier_domain[ECC_256_DOMAIN_PARAMETER_WITH_ORDER_LENGTH_WORDS * sizeof(uint32_t)] =
+{
+  /* a */
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  /* b */
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07,
+  /* p = 2^256-2^64-1 */
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFE, 0xFF, 0xFF, 0xFC, 0x2F,
+  /* n */
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFE, 0xBA, 0xAE, 0xDC, 0xE6, 0xAF, 0x48, 0xA0, 0x3B,
+  0xBF, 0xD2, 0x5E, 0x8C, 0xD0, 0x36, 0x41, 0x41
+};
+/*
+ *
+ *  Base Point G (uncompressed)
+ *
+ */
+static const uint8_t image_verifier_generator_point[ECC_256_GENERATOR_POINT_LENGTH_WORDS * sizeof(uint32_t)] =
+{
+  /* x */
+  0x79, 0xBE, 0x66, 0x7E, 0xF9, 0xDC, 0xBB, 0xAC, 0x55, 0xA0, 0x62, 0x95,
+  0xCE, 0x87, 0x0B, 0x07, 0x02, 0x9B, 0xFC, 0xDB, 0x2D, 0xCE, 0x28, 0xD9,
+  0x59, 0xF2, 0x81, 0x5B, 0x16, 0xF8, 0x17, 0x98,
+  /* y */
+  0x48, 0x3a, 0xda, 0x77, 0x26, 0xa3, 0xc4, 0x65, 0x5d, 0xa4, 0xfb, 0xfc,
+  0x0e, 0x11, 0x08, 0xa8, 0xfd, 0x17, 0xb4, 0x48, 0xa6, 0x85, 0x54, 0x19,
+  0x9c, 0x47, 0xd0, 0x8f, 0xfb, 0x10, 0xd4, 0xb8,
+ };
+
+/*
+ * image_total_size()
+ *
+ * Total size of an image, including the header. The header must already have been checked.
+ *
+ *  */
+uint32_t image_total_size(bootloader_image_header_t * p_image_header)
+{
+    return p_image_header->length + IMAGE_HASH_OFFSET + sizeof(p_image_header->length);
+}
+
+/*
+ * image_block_table_offset()
+ *
+ * Offset of the block table from the start of a version 1 image (the end of the blocks it covers).
+ * The header must already have been checked.
+ *
+ *  */
+uint32_t image_block_table_offset(bootloader_image_header_t * p_image_header)
+{
+    return image_total_size(p_image_header) - (p_image_header->block_count * SHA256_DIGEST_SIZE_BYTES);
+}
+
+/*
+ * verify_image_header()
+ *
+ * Function to perform the structural checks on an image header. Checks:
+ * - Magic number
+ * - Length (is not larger than main image space)
+ *
+ * IN:
+ * - p_image_header - Pointer to the start of the header information
+ *
+ * RETURNS:
+ * - VERIFY_SUCCESS if the header checks pass
+ * - VERIFY_FAIL if any of the header checks fails
+ *
+ *  */
+uint16_t verify_image_header(bootloader_image_header_t * p_image_header)
+{
+    // Check the magic number
+    // This is a simple check which will indicate whether the image header looks correct and worthy or further processing
+    if (0 != memcmp((void *)p_image_header, (void *)MAGIC_NUMBER, MAGIC_NUMBER_LEN))
+    {
+        return VERIFY_FAIL;
+    }
+
+    // Check the length in the header doesn't exceed the size of the main application space
+    uint32_t new_image_length;
+    new_image_length = p_image_header->length + sizeof(p_image_header->length) + sizeof(p_image_header->signature) + sizeof(p_image_header->magic_number);
+    if ((new_image_length > MAIN_IMAGE_MAX_SIZE) || (new_image_length < p_image_header->length))
+    {
+        return VERIFY_FAIL;
+    }
+
+    // An update image must also fit in the update area, which can be smaller than the main image area
+    if (((uint32_t)p_image_header == UPDATE_IMAGE_START_ADDRESS) && (new_image_length > UPDATE_IMAGE_MAX_SIZE))
+    {
+        return VERIFY_FAIL;
+    }
+
+    if (IMAGE_HEADER_VERSION_BLOCK_TABLE == p_image_header->header_version)
+    {
+        // The table must fit after the header and have one entry for each block before it
+        if ((p_image_header->block_size != IMAGE_BLOCK_SIZE) ||
+            (p_image_header->block_count > (IMAGE_BLOCK_TABLE_MAX_SIZE / SHA256_DIGEST_SIZE_BYTES)) ||
+            ((p_image_header->block_count * SHA256_DIGEST_SIZE_BYTES) > (new_image_length - IMAGE_HEADER_SIZE)))
+        {
+            return VERIFY_FAIL;
+        }
+
+        uint32_t table_offset = new_image_length - (p_image_header->block_count * SHA256_DIGEST_SIZE_BYTES);
+        if (p_image_header->block_count != ((table_offset + (IMAGE_BLOCK_SIZE - 1)) / IMAGE_BLOCK_SIZE))
+        {
+            return VERIFY_FAIL;
+        }
+    }
+    else if (IMAGE_HEADER_VERSION_DELTA == p_image_header->header_version)
+    {
+        // The patch follows the header, and both the base and target must fit in the main image area
+        if ((p_image_header->block_size != IMAGE_BLOCK_SIZE) || (new_image_length < IMAGE_HEADER_SIZE) ||
+            (p_image_header->base_length < IMAGE_HEADER_SIZE) || (p_image_header->base_length > MAIN_IMAGE_MAX_SIZE) ||
+            (p_image_header->target_length < IMAGE_HEADER_SIZE) || (p_image_header->target_length > MAIN_IMAGE_MAX_SIZE))
+        {
+            return VERIFY_FAIL;
+        }
+    }
+    else if (IMAGE_HEADER_VERSION_COMPRESSED == p_image_header->header_version)
+    {
+        // The compressed blocks follow the header, and the target must fit in the main image area
+        if ((p_image_header->block_size != IMAGE_BLOCK_SIZE) || (new_image_length < IMAGE_HEADER_SIZE) ||
+            (p_image_header->target_length < IMAGE_HEADER_SIZE) || (p_image_header->target_length > MAIN_IMAGE_MAX_SIZE))
+        {
+            return VERIFY_FAIL;
+        }
+    }
+    else if (IMAGE_HEADER_VERSION_FLAT != p_image_header->header_version)
+    {
+        return VERIFY_FAIL;
+    }
+
+    return VERIFY_SUCCESS;
+}
+
+/*
+ * image_signature_check()
+ *
+ * Function to check the ECDSA signature in an image header against an already calculated image hash.
+ *
+ * IN:
+ * - p_ecc          - ECC driver instance, open
+ * - p_image_header - Pointer to the start of the header information (source of the signature)
+ * - p_hash         - Pointer to the SHA256 hash of the image (from the Length field to the end of the image)
+ * - p_public_key   - Pointer to the public key used to verify the ECC signature
+ *
+ * RETURNS:
+ * - VERIFY_SUCCESS if the signature is valid for the hash
+ * - VERIFY_FAIL if the signature check fails
+ *
+ *  */
+uint16_t image_signature_check(const ecc_instance_t * p_ecc, bootloader_image_header_t * p_image_header, uint8_t * p_hash, uint8_t * p_public_key)
+{
+    ssp_err_t                   err;
+    uint16_t                    res = VERIFY_FAIL;
+    r_crypto_data_handle_t      g_msg_digest_handle;
+    r_crypto_data_handle_t      ecdsa_public_key_handle;
+    r_crypto_data_handle_t      domain_handle = {(uint32_t *)image_verifier_domain, sizeof(image_verifier_domain)/sizeof(uint32_t)};
+    r_crypto_data_handle_t      generator_point_handle = {(uint32_t *)image_verifier_generator_point, sizeof(image_verifier_generator_point)/sizeof(uint32_t)};
+    r_crypto_data_handle_t      g_ext_sign_r_handle;
+    r_crypto_data_handle_t      g_ext_sign_s_handle;
+
+    // Verify the signature
+    g_msg_digest_handle.p_data          = (uint32_t *)p_hash;
+    g_msg_digest_handle.data_length     = ECC_256_MESSAGE_DIGEST_LENGTH_WORDS;
+    ecdsa_public_key_handle.p_data      = (uint32_t *)p_public_key;
+    ecdsa_public_key_handle.data_length = (ECC_256_PUBLIC_KEY_LENGTH_WORDS);
+    g_ext_sign_r_handle.p_data          = (uint32_t *)p_image_header->signature;
+    g_ext_sign_r_handle.data_length     = ECC_256_SIGNATURE_R_LENGTH_WORDS;
+    g_ext_sign_s_handle.p_data          = (uint32_t *)(p_image_header->signature + ECC_256_SIGNATURE_R_LENGTH_WORDS);
+    g_ext_sign_s_handle.data_length     = ECC_256_SIGNATURE_S_LENGTH_WORDS;
+    uint32_t start_cycles = boot_timing_now();
+    err = p_ecc->p_api->verify(p_ecc->p_ctrl, &domain_handle, &generator_point_handle, &ecdsa_public_key_handle, &g_msg_digest_handle, &g_ext_sign_r_handle, &g_ext_sign_s_handle);
+    boot_timing_add(BOOT_PHASE_ECC_VERIFY, start_cycles, 0);
+    if (SSP_SUCCESS != err)
+    {
+        res = VERIFY_FAIL;
+    }
+    else
+    {
+        res = VERIFY_SUCCESS;
+    }
+
+    return (res);
+}
+
+/*
+ * image_block_table_check()
+ *
+ * Function to check the signature of a version 1 (block table) image, which is over the header and the block table.
+ * Once this passes the hashes in the table can be trusted.
+ *
+ * IN:
+ * - p_hash_hal     - Hash driver instance, open
+ * - p_ecc          - ECC driver instance, open
+ * - p_image_header - Pointer to the header, already checked by verify_image_header()
+ * - p_table        - Pointer to the block table of the image (or a copy of it)
+ * - p_public_key   - Pointer to the public key used to verify the ECC signature
+ *
+ * RETURNS:
+ * - VERIFY_SUCCESS if the signature is valid
+ * - VERIFY_FAIL if the signature check fails
+ *
+ *  */
+uint16_t image_block_table_check(const hash_instance_t * p_hash_hal, const ecc_instance_t * p_ecc, bootloader_image_header_t * p_image_header, uint8_t * p_table, uint8_t * p_public_key)
+{
+    ssp_err_t           err;
+    sha256_context_t    hash_ctx;
+    uint32_t            hash[SHA256_DIGEST_SIZE_BYTES / 4];
+
+    err = sha256_init(&hash_ctx, p_hash_hal);
+    if (SSP_SUCCESS == err)
+    {
+        err = sha256_update(&hash_ctx, (uint8_t *)&p_image_header->length, IMAGE_HEADER_SIZE - IMAGE_HASH_OFFSET);
+    }
+    if (SSP_SUCCESS == err)
+    {
+        err = sha256_update(&hash_ctx, p_table, p_image_header->block_count * SHA256_DIGEST_SIZE_BYTES);
+    }
+    if (SSP_SUCCESS == err)
+    {
+        err = sha256_final(&hash_ctx, (uint8_t *)hash);
+    }
+    if (SSP_SUCCESS != err)
+    {
+        return VERIFY_FAIL;
+    }
+
+    return image_signature_check(p_ecc, p_image_header, (uint8_t *)hash, p_public_key);
+}
+
+/*
+ * image_verify_start()
+ *
+ * Function to start a verify of an image that is made a step at a time by image_verify_step(), so the time taken by
+ * each call is bounded and other work (or other threads, when used by an application) can run between the steps.
+ * The header is checked here, the image must not change until the verify is done.
+ *
+ * IN:
+ * - p_image_header - Pointer to the start of the header information
+ * - p_public_key   - Pointer to the public key used to verify the ECC signature
+ * - p_hash_hal     - Hash driver instance, open until the verify is done
+ * - p_ecc          - ECC driver instance, open until the verify is done
+ *
+ * OUT:
+ * - p_verifier     - Verify to pass to image_verify_step()
+ *
+ * RETURNS:
+ * - VERIFY_SUCCESS if the verify has been started
+ * - VERIFY_FAIL if the header checks fail (image_verify_step() then has nothing to do)
+ *
+ *  */
+uint16_t image_verify_start(image_verifier_t * p_verifier, bootloader_image_header_t * p_image_header, uint8_t * p_public_key,
+                            const hash_instance_t * p_hash_hal, const ecc_instance_t * p_ecc)
+{
+    p_verifier->p_image_header = p_image_header;
+    p_verifier->p_public_key = p_public_key;
+    p_verifier->p_hash_hal = p_hash_hal;
+    p_verifier->p_ecc = p_ecc;
+    p_verifier->offset = IMAGE_HASH_OFFSET;
+    p_verifier->block = 0;
+    p_verifier->state = IMAGE_VERIFIER_DONE;
+    p_verifier->result = VERIFY_FAIL;
+
+    if ((VERIFY_SUCCESS != verify_image_header(p_image_header)) ||
+        (SSP_SUCCESS != sha256_init(&p_verifier->hash_ctx, p_hash_hal)))
+    {
+        return VERIFY_FAIL;
+    }
+
+    // The signature of a block table is checked first, so the blocks are checked against a trusted table
+    if (IMAGE_HEADER_VERSION_BLOCK_TABLE == p_image_header->header_version)
+    {
+        p_verifier->state = IMAGE_VERIFIER_SIGNATURE;
+    }
+    else
+    {
+        p_verifier->state = IMAGE_VERIFIER_HASH;
+    }
+
+    return VERIFY_SUCCESS;
+}
+
+/*
+ * image_verify_step()
+ *
+ * Function to make the next step of a verify started by image_verify_start(). A step either hashes up to
+ * budget_bytes of the image, or checks the signature (one ECC verify, which cannot be split). For a version 1 image a
+ * step stops at the end of a block, and the block is checked against the block table before the next step.
+ * A budget that is a multiple of 4 bytes keeps the data hashed in place. A budget of 0 would make no progress, so it
+ * ends the verify with VERIFY_FAIL rather than leave a caller looping until done.
+ *
+ * IN:
+ * - p_verifier     - Verify started by image_verify_start()
+ * - budget_bytes   - Maximum number of bytes of the image to hash in this step, not 0
+ *
+ * RETURNS:
+ * - true if the verify is done (see image_verify_result())
+ * - false if more steps are needed
+ *
+ *  */
+bool image_verify_step(image_verifier_t * p_verifier, uint32_t budget_bytes)
+{
+    bootloader_image_header_t * p_image_header = p_verifier->p_image_header;
+    bool                        block_table;
+    uint32_t                    hash[SHA256_DIGEST_SIZE_BYTES / 4];
+    uint16_t                    res = VERIFY_SUCCESS;
+
+    if (IMAGE_VERIFIER_DONE == p_verifier->state)
+    {
+        return true;
+    }
+
+    block_table = (IMAGE_HEADER_VERSION_BLOCK_TABLE == p_image_header->header_version);
+
+    if (0 == budget_bytes)
+    {
+        res = VERIFY_FAIL;
+    }
+    else if (IMAGE_VERIFIER_SIGNATURE == p_verifier->state)
+    {
+        if (block_table)
+        {
+            res = image_block_table_check(p_verifier->p_hash_hal, p_verifier->p_ecc, p_image_header,
+                                          (uint8_t *)p_image_header + image_block_table_offset(p_image_header), p_verifier->p_public_key);
+            p_verifier->state = IMAGE_VERIFIER_HASH;
+        }
+        else
+        {
+            res = VERIFY_FAIL;
+            if (SSP_SUCCESS == sha256_final(&p_verifier->hash_ctx, (uint8_t *)hash))
+            {
+                res = image_signature_check(p_verifier->p_ecc, p_image_header, (uint8_t *)hash, p_verifier->p_public_key);
+            }
+            p_verifier->result = res;
+            p_verifier->state = IMAGE_VERIFIER_DONE;
+        }
+    }
+    else
+    {
+        // Hash up to the end of the data (before the block table of a version 1 image), or of the block
+        uint32_t data_end = block_table ? image_block_table_offset(p_image_header) : image_total_size(p_image_header);
+        uint32_t end = data_end;
+
+        if (block_table && (end > ((p_verifier->block + 1) * IMAGE_BLOCK_SIZE)))
+        {
+            end = (p_verifier->block + 1) * IMAGE_BLOCK_SIZE;
+        }
+        if (budget_bytes < (end - p_verifier->offset))
+        {
+            end = p_verifier->offset + budget_bytes;
+        }
+
+        if (SSP_SUCCESS != sha256_update(&p_verifier->hash_ctx, (uint8_t *)p_image_header + p_verifier->offset, end - p_verifier->offset))
+        {
+            res = VERIFY_FAIL;
+        }
+        p_verifier->offset = end;
+
+        if ((VERIFY_SUCCESS == res) && block_table &&
+            ((end == data_end) || (end == ((p_verifier->block + 1) * IMAGE_BLOCK_SIZE))))
+        {
+            // The block is complete
+            res = VERIFY_FAIL;
+            if ((SSP_SUCCESS == sha256_final(&p_verifier->hash_ctx, (uint8_t *)hash)) &&
+                (0 == memcmp(hash, (uint8_t *)p_image_header + data_end + (p_verifier->block * SHA256_DIGEST_SIZE_BYTES), SHA256_DIGEST_SIZE_BYTES)) &&
+                (SSP_SUCCESS == sha256_init(&p_verifier->hash_ctx, p_verifier->p_hash_hal)))
+            {
+                res = VERIFY_SUCCESS;
+            }
+            p_verifier->block++;
+
+            // verify_image_header() checked there is one block for each IMAGE_BLOCK_SIZE of data
+            if ((VERIFY_SUCCESS == res) && (end == data_end))
+            {
+                p_verifier->result = VERIFY_SUCCESS;
+                p_verifier->state = IMAGE_VERIFIER_DONE;
+            }
+        }
+        else if ((VERIFY_SUCCESS == res) && (end == data_end))
+        {
+            p_verifier->state = IMAGE_VERIFIER_SIGNATURE;
+        }
+    }
+
+    // Stop at the first check that fails
+    if (VERIFY_SUCCESS != res)
+    {
+        p_verifier->result = VERIFY_FAIL;
+        p_verifier->state = IMAGE_VERIFIER_DONE;
+    }
+
+    return (IMAGE_VERIFIER_DONE == p_verifier->state);
+}
+
+/*
+ * image_verify_result()
+ *
+ * RETURNS:
+ * - VERIFY_SUCCESS if a verify started by image_verify_start() is done and the image passed
+ * - VERIFY_FAIL if the image failed, or the verify is not done
+ *
+ *  */
+uint16_t image_verify_result(image_verifier_t * p_verifier)
+{
+    if (IMAGE_VERIFIER_DONE != p_verifier->state)
+    {
+        return VERIFY_FAIL;
+    }
+
+    return p_verifier->result;
+}
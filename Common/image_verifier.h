@@ -0,0 +1,40 @@
+/*
+ * image_verifier.h
+ *
+ * Checks of a signed image (see image_header.h), and a verify of the whole image made a step at a time so it can be
+ * run between other work. Shared by the bootloader (bootloader.h) and applications, both projects build it from the
+ * Common linked folder. The hash and ECC driver instances are passed in, each project opens its own.
+ */
+
+#ifndef IMAGE_VERIFIER_H_
+#define IMAGE_VERIFIER_H_
+
+#include "image_header.h"
+
+#define VERIFY_SUCCESS          0x5A3C
+#define VERIFY_FAIL             0
+
+// Verify of an image split into steps, so it can be run a part at a time (see image_verify_start())
+typedef struct image_verifier {
+    bootloader_image_header_t * p_image_header;
+    uint8_t *                   p_public_key;
+    const hash_instance_t *     p_hash_hal;
+    const ecc_instance_t *      p_ecc;
+    sha256_context_t            hash_ctx;
+    uint32_t                    offset;         // Offset in the image of the next byte to hash
+    uint32_t                    block;          // Version 1, block being hashed
+    uint16_t                    state;
+    uint16_t                    result;
+} image_verifier_t;
+
+uint32_t image_total_size(bootloader_image_header_t * p_image_header);
+uint32_t image_block_table_offset(bootloader_image_header_t * p_image_header);
+uint16_t verify_image_header(bootloader_image_header_t * p_image_header);
+uint16_t image_signature_check(const ecc_instance_t * p_ecc, bootloader_image_header_t * p_image_header, uint8_t * p_hash, uint8_t * p_public_key);
+uint16_t image_block_table_check(const hash_instance_t * p_hash_hal, const ecc_instance_t * p_ecc, bootloader_image_header_t * p_image_header, uint8_t * p_table, uint8_t * p_public_key);
+uint16_t image_verify_start(image_verifier_t * p_verifier, bootloader_image_header_t * p_image_header, uint8_t * p_public_key,
+                            const hash_instance_t * p_hash_hal, const ecc_instance_t * p_ecc);
+bool image_verify_step(image_verifier_t * p_verifier, uint32_t budget_bytes);
+uint16_t image_verify_result(image_verifier_t * p_verifier);
+
+#endif /* IMAGE_VERIFIER_H_ */
@@ -0,0 +1,360 @@
+/*
+ * sha256_hal.c
+ *
+ */
+
+#include "sha256_hal.h"
+#include "boot_timing.h"
+
+static const uint8_t sha256_initial_values[] = {
+                        0x6au, 0x09u, 0xe6u, 0x67u, 0xbbu, 0x67u, 0xaeu, 0x85u,
+                        0x3cu, 0x6eu, 0xf3u, 0x72u, 0xa5u, 0x4fu, 0xf5u, 0x3au,
+                        0x51u, 0x0eu, 0x52u, 0x7fu, 0x9bu, 0x05u, 0x68u, 0x8cu,
+                        0x1fu, 0x83u, 0xd9u, 0xabu, 0x5bu, 0xe0u, 0xcdu, 0x19u
+};
+
+#if (0 != (SHA256_BOUNCE_BUFFER_SIZE % SHA256_BLOCK_SIZE_BYTES)) || (0 == SHA256_BOUNCE_BUFFER_SIZE)
+#error "SHA256_BOUNCE_BUFFER_SIZE must be a multiple of SHA256_BLOCK_SIZE_BYTES"
+#endif
+
+// Word aligned copy of data not on a 32-bit boundary, for the hash driver
+static uint32_t sha256_bounce_buffer[SHA256_BOUNCE_BUFFER_SIZE / 4];
+
+#ifdef SHA256_BENCHMARK
+static uint32_t sha256_driver_calls;
+#endif
+
+/*
+ * sha256_hash_update()
+ *
+ * Pass whole blocks to the hash driver, timed as BOOT_PHASE_HASH.
+ *
+ *  */
+static ssp_err_t sha256_hash_update(const hash_instance_t * p_hash_hal, uint32_t * p_data, uint32_t num_words, uint32_t * p_digest)
+{
+    uint32_t  start_cycles = boot_timing_now();
+    ssp_err_t err = p_hash_hal->p_api->hashUpdate(p_hash_hal->p_ctrl, p_data, num_words, p_digest);
+
+    boot_timing_add(BOOT_PHASE_HASH, start_cycles, num_words * 4);
+#ifdef SHA256_BENCHMARK
+    sha256_driver_calls++;
+#endif
+
+    return err;
+}
+
+/*
+ * sha256_hash_update_unaligned()
+ *
+ * Pass whole blocks not on a 32-bit boundary to the hash driver, copying up to batch_size bytes (a multiple of
+ * SHA256_BLOCK_SIZE_BYTES, at most SHA256_BOUNCE_BUFFER_SIZE) at a time into the bounce buffer.
+ *
+ *  */
+static ssp_err_t sha256_hash_update_unaligned(const hash_instance_t * p_hash_hal, const uint8_t * p_input, uint32_t bytes_to_hash, uint32_t * p_digest, uint32_t batch_size)
+{
+    ssp_err_t err = SSP_SUCCESS;
+
+    while ((SSP_SUCCESS == err) && (0 != bytes_to_hash))
+    {
+        uint32_t bytes = (bytes_to_hash < batch_size) ? bytes_to_hash : batch_size;
+
+        memcpy((void *)sha256_bounce_buffer, (const void *)p_input, bytes);
+        err = sha256_hash_update(p_hash_hal, sha256_bounce_buffer, (bytes / 4), p_digest);
+
+        p_input += bytes;
+        bytes_to_hash -= bytes;
+    }
+
+    return err;
+}
+
+/*
+ * sha256_init()
+ *
+ * Start a new incremental hash.
+ * Assumes SCE and HASH drivers are open.
+ *
+ * p_ctx        - Pointer to the context to initialise
+ * p_hash_hal   - Pointer to the hash driver instance used for all updates of this context
+ *
+ * Returns  - SSP_SUCCESS or SSP_ERR_ASSERTION if a pointer is NULL
+ *
+ *  */
+ssp_err_t sha256_init(sha256_context_t * p_ctx, const hash_instance_t * const p_hash_hal)
+{
+    if ((NULL == p_ctx) || (NULL == p_hash_hal))
+    {
+        return SSP_ERR_ASSERTION;
+    }
+
+    p_ctx->p_hash_hal       = p_hash_hal;
+    p_ctx->buffered_bytes   = 0;
+    p_ctx->total_length     = 0;
+
+    /* Initialise the hash digest */
+    memcpy((uint8_t*)p_ctx->digest, sha256_initial_values, sizeof(sha256_initial_values));
+
+    return SSP_SUCCESS;
+}
+
+/*
+ * sha256_update()
+ *
+ * Add data to an incremental hash.
+ * The data may be of any length and at any alignment, calls can be split at any byte boundary.
+ *
+ * p_ctx    - Pointer to a context started with sha256_init()
+ * p_input  - Pointer to the data to be hashed (data on 32-bit boundary will result in faster hashing)
+ * length   - Number of bytes to be hashed
+ *
+ * Returns  - SSP_SUCCESS or error from hash HAL driver
+ *
+ *  */
+ssp_err_t sha256_update(sha256_context_t * p_ctx, const uint8_t * p_input, uint32_t length)
+{
+    const hash_instance_t * p_hash_hal;
+    uint32_t bytes_to_hash;     /* Bytes to hash in multiples of SHA256_BLOCK_SIZE_BYTES */
+    ssp_err_t err;
+
+    if ((NULL == p_ctx) || ((NULL == p_input) && (0 != length)))
+    {
+        return SSP_ERR_ASSERTION;
+    }
+
+    p_hash_hal = p_ctx->p_hash_hal;
+    p_ctx->total_length += length;
+
+    /* Complete any partial block left over from the previous update first */
+    if (0 != p_ctx->buffered_bytes)
+    {
+        uint32_t fill = SHA256_BLOCK_SIZE_BYTES - p_ctx->buffered_bytes;
+        if (fill > length)
+        {
+            fill = length;
+        }
+
+        memcpy((uint8_t *)p_ctx->buffer + p_ctx->buffered_bytes, p_input, fill);
+        p_ctx->buffered_bytes += fill;
+        p_input += fill;
+        length -= fill;
+
+        if (SHA256_BLOCK_SIZE_BYTES != p_ctx->buffered_bytes)
+        {
+            /* Still not a full block, nothing more to do until the next update */
+            return SSP_SUCCESS;
+        }
+
+        err = sha256_hash_update(p_hash_hal, p_ctx->buffer, (SHA256_BLOCK_SIZE_BYTES / 4), p_ctx->digest);
+        if (SSP_SUCCESS != err)
+        {
+            return err;
+        }
+        p_ctx->buffered_bytes = 0;
+    }
+
+    /* Calculate the number of bytes that are a multiple of SHA256_BLOCK_SIZE_BYTES */
+    bytes_to_hash = (length / SHA256_BLOCK_SIZE_BYTES) * SHA256_BLOCK_SIZE_BYTES;
+
+    if (0 != bytes_to_hash)
+    {
+        /* If the data to be hashed is on a 32-bit boundary it can be hashed in place */
+        if (((uint32_t)p_input & (uint32_t)0x03) == 0)
+        {
+            /*  32-bit boundary so all of bytes_to_hash number of bytes can be hashed in one operation */
+            err = sha256_hash_update(p_hash_hal, (uint32_t *)p_input, (bytes_to_hash / 4), p_ctx->digest);
+            if (SSP_SUCCESS != err)
+            {
+                return err;
+            }
+        }
+        else
+        {
+            /*  Input data is not on a 32-bit boundary. Hash through the bounce buffer, many blocks per driver call */
+            err = sha256_hash_update_unaligned(p_hash_hal, p_input, bytes_to_hash, p_ctx->digest, SHA256_BOUNCE_BUFFER_SIZE);
+            if (SSP_SUCCESS != err)
+            {
+                return err;
+            }
+        }
+
+        p_input += bytes_to_hash;
+        length -= bytes_to_hash;
+    }
+
+    /* Keep the remaining bytes for the next update or the final block */
+    if (0 != length)
+    {
+        memcpy((void *)p_ctx->buffer, (void *)p_input, length);
+        p_ctx->buffered_bytes = length;
+    }
+
+    return SSP_SUCCESS;
+}
+
+/*
+ * sha256_final()
+ *
+ * Pad the buffered data, hash the final block(s) and output the digest.
+ * The context must be started again with sha256_init() before it is reused.
+ *
+ * p_ctx    - Pointer to a context started with sha256_init()
+ * p_hash   - SHA256 hash digest of all the data passed to sha256_update()
+ *
+ * Returns  - SSP_SUCCESS or error from hash HAL driver
+ *
+ *  */
+ssp_err_t sha256_final(sha256_context_t * p_ctx, uint8_t * p_hash)
+{
+    const hash_instance_t * p_hash_hal;
+    uint32_t remaining_bytes;
+    ssp_err_t err;
+
+    if ((NULL == p_ctx) || (NULL == p_hash))
+    {
+        return SSP_ERR_ASSERTION;
+    }
+
+    p_hash_hal = p_ctx->p_hash_hal;
+    remaining_bytes = p_ctx->buffered_bytes;
+
+    /* Insert the terminator */
+    uint8_t *t;
+    t = (uint8_t *)p_ctx->buffer + remaining_bytes;
+    *t = 0x80;
+
+    /* If there is room for the 8 final bytes add them */
+    /* -1 for the terminator */
+    if ((SHA256_BLOCK_SIZE_BYTES - remaining_bytes - 1) >= 8)
+    {
+        /* Room for the final 8 bytes */
+        /* Pad with zeros  */
+        memset((t + 1), 0, (SHA256_BLOCK_SIZE_BYTES - remaining_bytes - 1 - 8));
+    }
+    else
+    {
+        /* Not enough room for the final 8 bytes */
+        /* Pad with zeros, update and then add the final 8 bytes */
+        memset((t + 1), 0, (SHA256_BLOCK_SIZE_BYTES - remaining_bytes - 1));
+
+        err = sha256_hash_update(p_hash_hal, p_ctx->buffer, (SHA256_BLOCK_SIZE_BYTES / 4), p_ctx->digest);
+        if (SSP_SUCCESS != err)
+        {
+            return err;
+        }
+
+        memset((void *)p_ctx->buffer, 0, (SHA256_BLOCK_SIZE_BYTES - 8));
+    }
+
+    uint8_t * p_bit_length = (uint8_t *)p_ctx->buffer + (SHA256_BLOCK_SIZE_BYTES - 8);
+    uint64_t  bit_length = p_ctx->total_length << 3;
+    for (uint32_t i=0; i<8; i++)
+    {
+        p_bit_length[i] = (uint8_t)(bit_length >> (56 - (8 * i)));
+    }
+
+    /* final update */
+    err = sha256_hash_update(p_hash_hal, p_ctx->buffer, (SHA256_BLOCK_SIZE_BYTES / 4), p_ctx->digest);
+    if (SSP_SUCCESS != err)
+    {
+        return err;
+    }
+
+    memcpy((void *)p_hash, (void *)p_ctx->digest, SHA256_DIGEST_SIZE_BYTES);
+    p_ctx->buffered_bytes = 0;
+
+    return SSP_SUCCESS;
+}
+
+/*
+ * One-shot hash of a single contiguous buffer.
+ * Assumes SCE and HASH drivers are open
+ *
+ * p_ctrl   - Pointer to the hash driver instance
+ * p_input  - Pointer to the data to be hashed (data on 32-bit boundary will result in faster hashing)
+ * length   - Number of bytes to be hashed
+ * p_hash   - SHA256 hash digest of the input data
+ *
+ * Returns  - SSP_SUCCESS or error from hash HAL driver
+ *
+ *  */
+ssp_err_t sha256_hash(const hash_instance_t * const p_hash_hal, uint8_t *p_input, uint32_t length, uint8_t *p_hash)
+{
+    sha256_context_t ctx;
+    ssp_err_t err;
+
+    err = sha256_init(&ctx, p_hash_hal);
+    if (SSP_SUCCESS != err)
+    {
+        return err;
+    }
+
+    err = sha256_update(&ctx, p_input, length);
+    if (SSP_SUCCESS != err)
+    {
+        return err;
+    }
+
+    return sha256_final(&ctx, p_hash);
+}
+
+#ifdef SHA256_BENCHMARK
+/*
+ * sha256_benchmark()
+ *
+ * Hash length bytes three times, giving the cycles and hash driver calls taken by each:
+ * - aligned, from p_data
+ * - unaligned, from p_data + 1, copied into the bounce buffer one block per driver call
+ * - unaligned, from p_data + 1, copied SHA256_BOUNCE_BUFFER_SIZE bytes per driver call (as sha256_update())
+ * Bytes per second is length * SystemCoreClock / cycles. Needs BOOT_TIMING for the cycle counts.
+ * Assumes SCE and HASH drivers are open.
+ *
+ * p_hash_hal   - Pointer to the hash driver instance
+ * p_data       - Data on a 32-bit boundary, length + 1 bytes must be readable (e.g. an image in flash)
+ * length       - Number of bytes to hash, a multiple of SHA256_BLOCK_SIZE_BYTES
+ * p_result     - Cycles and driver calls
+ *
+ * Returns  - SSP_SUCCESS, SSP_ERR_ASSERTION if a parameter is invalid, or error from hash HAL driver
+ *
+ *  */
+ssp_err_t sha256_benchmark(const hash_instance_t * const p_hash_hal, const uint8_t * p_data, uint32_t length, sha256_benchmark_t * p_result)
+{
+    uint32_t    digest[SHA256_DIGEST_SIZE_BYTES / 4];
+    uint32_t    start_cycles;
+    ssp_err_t   err;
+
+    if ((NULL == p_hash_hal) || (NULL == p_data) || (NULL == p_result) || (0 != ((uint32_t)p_data & 3U)) ||
+        (0 != (length % SHA256_BLOCK_SIZE_BYTES)))
+    {
+        return SSP_ERR_ASSERTION;
+    }
+
+    memcpy((uint8_t *)digest, sha256_initial_values, sizeof(digest));
+    sha256_driver_calls = 0;
+    start_cycles = boot_timing_now();
+    err = sha256_hash_update(p_hash_hal, (uint32_t *)p_data, (length / 4), digest);
+    p_result->aligned_cycles = boot_timing_now() - start_cycles;
+    p_result->aligned_calls = sha256_driver_calls;
+
+    if (SSP_SUCCESS == err)
+    {
+        memcpy((uint8_t *)digest, sha256_initial_values, sizeof(digest));
+        sha256_driver_calls = 0;
+        start_cycles = boot_timing_now();
+        err = sha256_hash_update_unaligned(p_hash_hal, p_data + 1, length, digest, SHA256_BLOCK_SIZE_BYTES);
+        p_result->unaligned_block_cycles = boot_timing_now() - start_cycles;
+        p_result->unaligned_block_calls = sha256_driver_calls;
+    }
+
+    if (SSP_SUCCESS == err)
+    {
+        memcpy((uint8_t *)digest, sha256_initial_values, sizeof(digest));
+        sha256_driver_calls = 0;
+        start_cycles = boot_timing_now();
+        err = sha256_hash_update_unaligned(p_hash_hal, p_data + 1, length, digest, SHA256_BOUNCE_BUFFER_SIZE);
+        p_result->unaligned_batched_cycles = boot_timing_now() - start_cycles;
+        p_result->unaligned_batched_calls = sha256_driver_calls;
+    }
+
+    return err;
+}
+#endif
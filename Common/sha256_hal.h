@@ -0,0 +1,67 @@
+/*
+ * sha256_hal.h
+ *
+ */
+
+#ifndef SHA256_HAL_H_
+#define SHA256_HAL_H_
+
+#include "r_hash_api.h"
+#include <string.h>
+
+#define SHA256_DIGEST_SIZE_BYTES    32
+#define SHA256_BLOCK_SIZE_BYTES     64
+
+// Size of the word aligned RAM buffer data not on a 32-bit boundary is copied into for the hash driver, a multiple of
+// SHA256_BLOCK_SIZE_BYTES. Each driver call hashes up to this many bytes, so a larger buffer makes fewer calls. Set to
+// SHA256_BLOCK_SIZE_BYTES to save RAM (one driver call per block).
+#define SHA256_BOUNCE_BUFFER_SIZE   1024
+
+// Define below to build sha256_benchmark(), comparing the throughput of aligned and unaligned data
+//#define SHA256_BENCHMARK
+
+/*
+ * Incremental hashing context.
+ * Partial blocks are held in buffer until a full SHA256_BLOCK_SIZE_BYTES block is available for the hash driver.
+ */
+typedef struct sha256_context {
+    const hash_instance_t * p_hash_hal;
+    uint32_t digest[SHA256_DIGEST_SIZE_BYTES / 4];
+    uint32_t buffer[SHA256_BLOCK_SIZE_BYTES / 4];
+    uint32_t buffered_bytes;
+    uint64_t total_length;
+} sha256_context_t;
+
+#ifdef SHA256_BENCHMARK
+// Result of sha256_benchmark(), cycles (DWT, see boot_timing.h) and hash driver calls to hash the same data
+typedef struct sha256_benchmark {
+    uint32_t aligned_cycles;            // Data on a 32-bit boundary, hashed in place
+    uint32_t aligned_calls;
+    uint32_t unaligned_block_cycles;    // Data not on a 32-bit boundary, copied one block at a time
+    uint32_t unaligned_block_calls;
+    uint32_t unaligned_batched_cycles;  // Data not on a 32-bit boundary, copied SHA256_BOUNCE_BUFFER_SIZE bytes at a time
+    uint32_t unaligned_batched_calls;
+} sha256_benchmark_t;
+
+// Result of sha256_backend_benchmark(), in 1/100ths of a cycle per byte
+typedef struct sha256_backend_benchmark {
+    uint32_t sce_cycles_per_byte_x100;
+    uint32_t software_cycles_per_byte_x100;
+} sha256_backend_benchmark_t;
+#endif
+
+// Software SHA256 backend (sha256_sw.c), a hash driver that can be passed to sha256_init() in place of the SCE hash
+extern const hash_api_t         g_hash_on_software;
+extern const hash_instance_t    g_hash_software;
+
+ssp_err_t sha256_init(sha256_context_t * p_ctx, const hash_instance_t * const p_hash_hal);
+ssp_err_t sha256_update(sha256_context_t * p_ctx, const uint8_t * p_input, uint32_t length);
+ssp_err_t sha256_final(sha256_context_t * p_ctx, uint8_t * p_hash);
+
+ssp_err_t sha256_hash(const hash_instance_t * const p_hash_hal, uint8_t *p_input, uint32_t length, uint8_t *p_hash);
+#ifdef SHA256_BENCHMARK
+ssp_err_t sha256_benchmark(const hash_instance_t * const p_hash_hal, const uint8_t * p_data, uint32_t length, sha256_benchmark_t * p_result);
+ssp_err_t sha256_backend_benchmark(const uint8_t * p_data, uint32_t length, sha256_backend_benchmark_t * p_result);
+#endif
+
+#endif /* SHA256_HAL_H_ */
@@ -0,0 +1,231 @@
+/*
+ * sha256_sw.c
+ *
+ * Software SHA256 backend, with the same interface as the SCE hash driver (hash_api_t), so it can be used in place of
+ * g_sce_hash_0 by sha256_init() on parts or configurations without the SCE hash, or on a host.
+ *
+ * hashUpdate() hashes whole blocks in place: the data must be on a 32-bit boundary and a multiple of
+ * SHA256_BLOCK_SIZE_BYTES (sha256_update() takes care of both). The digest is held as the SCE driver holds it, as
+ * big endian bytes. The rounds are fully unrolled and the message schedule is kept in a 16 word window, so no block
+ * is copied.
+ *
+ * Assumes a little endian core (as the S5D9 bootloader is built).
+ */
+
+#include "sha256_hal.h"
+#include "boot_timing.h"
+
+#define SHA256_SW_VERSION           (1)
+
+#define SHA256_SW_BE32(x)           __builtin_bswap32(x)
+#define SHA256_SW_ROR(x, n)         (((x) >> (n)) | ((x) << (32 - (n))))
+
+#define SHA256_SW_SIGMA0(x)         (SHA256_SW_ROR((x), 2) ^ SHA256_SW_ROR((x), 13) ^ SHA256_SW_ROR((x), 22))
+#define SHA256_SW_SIGMA1(x)         (SHA256_SW_ROR((x), 6) ^ SHA256_SW_ROR((x), 11) ^ SHA256_SW_ROR((x), 25))
+#define SHA256_SW_GAMMA0(x)         (SHA256_SW_ROR((x), 7) ^ SHA256_SW_ROR((x), 18) ^ ((x) >> 3))
+#define SHA256_SW_GAMMA1(x)         (SHA256_SW_ROR((x), 17) ^ SHA256_SW_ROR((x), 19) ^ ((x) >> 10))
+#define SHA256_SW_CH(x, y, z)       ((z) ^ ((x) & ((y) ^ (z))))
+#define SHA256_SW_MAJ(x, y, z)      (((x) & (y)) | ((z) & ((x) | (y))))
+
+// Message schedule word i, in the 16 word window
+#define SHA256_SW_W(i)              w[(i) & 15]
+// Rounds 0 to 15 take the words of the block, later rounds extend the schedule in the window
+#define SHA256_SW_LOAD(i)           (SHA256_SW_W(i) = SHA256_SW_BE32(p_block[(i)]))
+#define SHA256_SW_EXTEND(i)         (SHA256_SW_W(i) += SHA256_SW_GAMMA1(SHA256_SW_W((i) - 2)) + SHA256_SW_W((i) - 7) + \
+                                                       SHA256_SW_GAMMA0(SHA256_SW_W((i) - 15)))
+
+// One round. The working variables are renamed by the caller rather than moved.
+#define SHA256_SW_ROUND(a, b, c, d, e, f, g, h, i, schedule)                                                        \
+    do {                                                                                                            \
+        uint32_t t1 = (h) + SHA256_SW_SIGMA1(e) + SHA256_SW_CH((e), (f), (g)) + sha256_sw_k[(i)] + schedule(i);     \
+        (d) += t1;                                                                                                  \
+        (h) = t1 + SHA256_SW_SIGMA0(a) + SHA256_SW_MAJ((a), (b), (c));                                              \
+    } while (0)
+
+// Eight rounds, after which the working variables are back in their original places
+#define SHA256_SW_ROUND8(i, schedule)                                                                               \
+    SHA256_SW_ROUND(a, b, c, d, e, f, g, h, (i) + 0, schedule);                                                     \
+    SHA256_SW_ROUND(h, a, b, c, d, e, f, g, (i) + 1, schedule);                                                     \
+    SHA256_SW_ROUND(g, h, a, b, c, d, e, f, (i) + 2, schedule);                                                     \
+    SHA256_SW_ROUND(f, g, h, a, b, c, d, e, (i) + 3, schedule);                                                     \
+    SHA256_SW_ROUND(e, f, g, h, a, b, c, d, (i) + 4, schedule);                                                     \
+    SHA256_SW_ROUND(d, e, f, g, h, a, b, c, (i) + 5, schedule);                                                     \
+    SHA256_SW_ROUND(c, d, e, f, g, h, a, b, (i) + 6, schedule);                                                     \
+    SHA256_SW_ROUND(b, c, d, e, f, g, h, a, (i) + 7, schedule)
+
+static const uint32_t sha256_sw_k[64] = {
+    0x428a2f98U, 0x71374491U, 0xb5c0fbcfU, 0xe9b5dba5U, 0x3956c25bU, 0x59f111f1U, 0x923f82a4U, 0xab1c5ed5U,
+    0xd807aa98U, 0x12835b01U, 0x243185beU, 0x550c7dc3U, 0x72be5d74U, 0x80deb1feU, 0x9bdc06a7U, 0xc19bf174U,
+    0xe49b69c1U, 0xefbe4786U, 0x0fc19dc6U, 0x240ca1ccU, 0x2de92c6fU, 0x4a7484aaU, 0x5cb0a9dcU, 0x76f988daU,
+    0x983e5152U, 0xa831c66dU, 0xb00327c8U, 0xbf597fc7U, 0xc6e00bf3U, 0xd5a79147U, 0x06ca6351U, 0x14292967U,
+    0x27b70a85U, 0x2e1b2138U, 0x4d2c6dfcU, 0x53380d13U, 0x650a7354U, 0x766a0abbU, 0x81c2c92eU, 0x92722c85U,
+    0xa2bfe8a1U, 0xa81a664bU, 0xc24b8b70U, 0xc76c51a3U, 0xd192e819U, 0xd6990624U, 0xf40e3585U, 0x106aa070U,
+    0x19a4c116U, 0x1e376c08U, 0x2748774cU, 0x34b0bcb5U, 0x391c0cb3U, 0x4ed8aa4aU, 0x5b9cca4fU, 0x682e6ff3U,
+    0x748f82eeU, 0x78a5636fU, 0x84c87814U, 0x8cc70208U, 0x90befffaU, 0xa4506cebU, 0xbef9a3f7U, 0xc67178f2U
+};
+
+/*
+ * sha256_sw_blocks()
+ *
+ * Hash num_blocks blocks from p_block into state.
+ *
+ *  */
+static void sha256_sw_blocks(uint32_t * state, const uint32_t * p_block, uint32_t num_blocks)
+{
+    uint32_t w[16];
+
+    while (num_blocks--)
+    {
+        uint32_t a = state[0];
+        uint32_t b = state[1];
+        uint32_t c = state[2];
+        uint32_t d = state[3];
+        uint32_t e = state[4];
+        uint32_t f = state[5];
+        uint32_t g = state[6];
+        uint32_t h = state[7];
+
+        SHA256_SW_ROUND8(0, SHA256_SW_LOAD);
+        SHA256_SW_ROUND8(8, SHA256_SW_LOAD);
+        SHA256_SW_ROUND8(16, SHA256_SW_EXTEND);
+        SHA256_SW_ROUND8(24, SHA256_SW_EXTEND);
+        SHA256_SW_ROUND8(32, SHA256_SW_EXTEND);
+        SHA256_SW_ROUND8(40, SHA256_SW_EXTEND);
+        SHA256_SW_ROUND8(48, SHA256_SW_EXTEND);
+        SHA256_SW_ROUND8(56, SHA256_SW_EXTEND);
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+
+        p_block += SHA256_BLOCK_SIZE_BYTES / 4;
+    }
+}
+
+static ssp_err_t sha256_sw_open(hash_ctrl_t * const p_ctrl, hash_cfg_t const * const p_cfg)
+{
+    (void)p_ctrl;
+    (void)p_cfg;
+
+    return SSP_SUCCESS;
+}
+
+static ssp_err_t sha256_sw_close(hash_ctrl_t * const p_ctrl)
+{
+    (void)p_ctrl;
+
+    return SSP_SUCCESS;
+}
+
+/*
+ * sha256_sw_update()
+ *
+ * hash_api_t hashUpdate: hash num_words words (whole blocks, on a 32-bit boundary) at p_data into p_digest.
+ *
+ *  */
+static ssp_err_t sha256_sw_update(hash_ctrl_t * const p_ctrl, uint32_t * p_data, uint32_t num_words, uint32_t * p_digest)
+{
+    uint32_t state[SHA256_DIGEST_SIZE_BYTES / 4];
+
+    (void)p_ctrl;
+
+    if ((NULL == p_digest) || ((NULL == p_data) && (0 != num_words)) || (0 != ((uint32_t)p_data & 3U)))
+    {
+        return SSP_ERR_ASSERTION;
+    }
+
+    if (0 != (num_words % (SHA256_BLOCK_SIZE_BYTES / 4)))
+    {
+        return SSP_ERR_INVALID_SIZE;
+    }
+
+    for (uint32_t i = 0; i < (SHA256_DIGEST_SIZE_BYTES / 4); i++)
+    {
+        state[i] = SHA256_SW_BE32(p_digest[i]);
+    }
+
+    sha256_sw_blocks(state, p_data, num_words / (SHA256_BLOCK_SIZE_BYTES / 4));
+
+    for (uint32_t i = 0; i < (SHA256_DIGEST_SIZE_BYTES / 4); i++)
+    {
+        p_digest[i] = SHA256_SW_BE32(state[i]);
+    }
+
+    return SSP_SUCCESS;
+}
+
+static ssp_err_t sha256_sw_version_get(ssp_version_t * const p_version)
+{
+    if (NULL == p_version)
+    {
+        return SSP_ERR_ASSERTION;
+    }
+
+    p_version->version_id = SHA256_SW_VERSION;
+
+    return SSP_SUCCESS;
+}
+
+const hash_api_t g_hash_on_software =
+{
+    .open       = sha256_sw_open,
+    .close      = sha256_sw_close,
+    .hashUpdate = sha256_sw_update,
+    .versionGet = sha256_sw_version_get
+};
+
+const hash_instance_t g_hash_software =
+{
+    .p_ctrl     = NULL,
+    .p_cfg      = NULL,
+    .p_api      = &g_hash_on_software
+};
+
+#ifdef SHA256_BENCHMARK
+/*
+ * sha256_backend_benchmark()
+ *
+ * Hash length bytes at p_data with the SCE hash driver (g_sce_hash_0, which must be open) and with the software
+ * backend, giving the cycles per byte of each in 1/100ths. Each is hashed with sha256_hash(), as images are, so the
+ * time includes the padding block and the boot timing of the hash driver calls. Needs BOOT_TIMING for the cycle
+ * counts.
+ *
+ * p_data   - Data on a 32-bit boundary
+ * length   - Number of bytes to hash, a multiple of SHA256_BLOCK_SIZE_BYTES
+ * p_result - Cycles per byte
+ *
+ * Returns  - SSP_SUCCESS, SSP_ERR_ASSERTION if a parameter is invalid, or error from hash HAL driver
+ *
+ *  */
+ssp_err_t sha256_backend_benchmark(const uint8_t * p_data, uint32_t length, sha256_backend_benchmark_t * p_result)
+{
+    const hash_instance_t * backends[2] = { &g_sce_hash_0, &g_hash_software };
+    uint32_t                cycles_per_byte_x100[2];
+    ssp_err_t               err = SSP_SUCCESS;
+
+    if ((NULL == p_data) || (NULL == p_result) || (0 == length) || (0 != ((uint32_t)p_data & 3U)) ||
+        (0 != (length % SHA256_BLOCK_SIZE_BYTES)))
+    {
+        return SSP_ERR_ASSERTION;
+    }
+
+    for (uint32_t i = 0; (SSP_SUCCESS == err) && (i < 2); i++)
+    {
+        uint32_t digest[SHA256_DIGEST_SIZE_BYTES / 4];
+        uint32_t start_cycles = boot_timing_now();
+
+        err = sha256_hash(backends[i], (uint8_t *)p_data, length, (uint8_t *)digest);
+        cycles_per_byte_x100[i] = (uint32_t)(((uint64_t)(boot_timing_now() - start_cycles) * 100U) / length);
+    }
+
+    p_result->sce_cycles_per_byte_x100 = cycles_per_byte_x100[0];
+    p_result->software_cycles_per_byte_x100 = cycles_per_byte_x100[1];
+
+    return err;
+}
+#endif
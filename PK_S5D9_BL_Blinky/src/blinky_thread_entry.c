@@ -4,6 +4,147 @@
 ***********************************************************************************************************************/
 
 #include "blinky_thread.h"
+#include "boot_timing_record.h"
+#include <stddef.h>
+
+/* Define below to check the update writer, and benchmark it, with this image at startup (see update_writer_check()).
+ * It takes UPDATE_SIM_AREA_SIZE bytes of RAM and delays the LEDs by the time it takes. */
+//#define UPDATE_WRITER_DEMO
+
+#ifdef UPDATE_WRITER_DEMO
+#include "update_writer.h"
+
+/* Programming page of the update area, and size of the pieces the update writer benchmark writes the image in (as
+ * they might arrive from a download) */
+#ifdef UPDATE_USES_QSPI_FLASH
+#define UPDATE_PAGE_SIZE        (FLASH_PROGRAMMING_PAGE_SIZE)
+#else
+#define UPDATE_PAGE_SIZE        (MAIN_FLASH_PROGRAMMING_PAGE_SIZE)
+#endif
+#define UPDATE_PIECE_SIZE       (100)
+#define UPDATE_SIM_AREA_SIZE    (4 * UPDATE_IMAGE_ERASE_BLOCK_SIZE)
+#endif
+
+/* Copy of the bootloader's boot timing record, taken at startup. Valid if g_boot_timing_valid is true. */
+boot_timing_record_t g_boot_timing;
+bool g_boot_timing_valid = false;
+
+/* The record left by the bootloader, in the .boot_record section reserved by the linker script */
+static boot_timing_record_t boot_timing_record BSP_PLACE_IN_SECTION_V2(".boot_record");
+
+#ifdef UPDATE_WRITER_DEMO
+/* Result of the update writer check at startup, see update_writer_check(). Valid if g_update_writer_err is
+ * SSP_SUCCESS. */
+update_writer_benchmark_t g_update_writer_benchmark;
+ssp_err_t g_update_writer_err = SSP_ERR_NOT_OPEN;
+
+/* RAM standing in for the update area (the real update area is left alone) */
+static uint8_t update_sim_area[UPDATE_SIM_AREA_SIZE];
+#endif
+
+/*******************************************************************************************************************//**
+ * @brief  Read the boot timing record
+ *
+ * Copies the record the bootloader left in RAM into g_boot_timing, if it is complete and its check matches.
+ * The phase cycle counts can be converted to time with g_boot_timing.core_clock_hz.
+ *
+ **********************************************************************************************************************/
+static void boot_timing_read(void)
+{
+    const uint32_t * p_word = (const uint32_t *)&boot_timing_record;
+    uint32_t sum = 0;
+
+    if ((BOOT_TIMING_RECORD_MAGIC != boot_timing_record.magic) ||
+        (BOOT_TIMING_RECORD_FORMAT != boot_timing_record.format) ||
+        (BOOT_PHASE_COUNT != boot_timing_record.phase_count))
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < (offsetof(boot_timing_record_t, check) / 4); i++)
+    {
+        sum += p_word[i];
+    }
+
+    if (boot_timing_record.check == ~sum)
+    {
+        g_boot_timing = boot_timing_record;
+        g_boot_timing_valid = true;
+    }
+}
+
+#ifdef UPDATE_WRITER_DEMO
+/*******************************************************************************************************************//**
+ * @brief  Check the update writer with the running image
+ *
+ * Writes this application's own signed image (from MAIN_IMAGE_START_ADDRESS), as if it was being downloaded, into a
+ * simulated update area: once for the benchmark of the writer against programming each piece as it arrives, and once
+ * hashed with the SCE, checking the digest of the written image against a hash of the image in place.
+ * An application downloading an update would instead use update_writer_flash_internal_init() (or
+ * update_writer_flash_qspi_init()) on the real update area at UPDATE_IMAGE_START_ADDRESS.
+ * The SCE drivers are closed again afterwards.
+ *
+ **********************************************************************************************************************/
+static void update_writer_check(void)
+{
+    uint8_t const *         p_image = (uint8_t const *)MAIN_IMAGE_START_ADDRESS;
+    bootloader_image_header_t const * p_header = (bootloader_image_header_t const *)MAIN_IMAGE_START_ADDRESS;
+    update_writer_sim_t     sim = { .p_memory = update_sim_area, .address = UPDATE_IMAGE_START_ADDRESS, .size = sizeof(update_sim_area) };
+    update_writer_flash_t   flash;
+    update_writer_t         writer;
+    uint8_t                 written_digest[SHA256_DIGEST_SIZE_BYTES];
+    uint8_t                 image_digest[SHA256_DIGEST_SIZE_BYTES];
+    uint32_t                image_size = p_header->length + IMAGE_HASH_OFFSET + 4;
+    ssp_err_t               err;
+    bool                    sce_open = false;
+    bool                    hash_open = false;
+
+    err = update_writer_benchmark(&g_update_writer_benchmark, &sim, UPDATE_PAGE_SIZE, p_image, UPDATE_PIECE_SIZE);
+
+    if (SSP_SUCCESS == err)
+    {
+        err = g_sce.p_api->open(g_sce.p_ctrl, g_sce.p_cfg);
+        sce_open = (SSP_SUCCESS == err);
+    }
+    if (SSP_SUCCESS == err)
+    {
+        err = g_sce_hash_0.p_api->open(g_sce_hash_0.p_ctrl, g_sce_hash_0.p_cfg);
+        hash_open = (SSP_SUCCESS == err);
+    }
+    if (SSP_SUCCESS == err)
+    {
+        update_writer_flash_sim_init(&flash, &sim, UPDATE_PAGE_SIZE);
+        err = update_writer_open(&writer, &flash, sim.address, sim.size, &g_sce_hash_0);
+    }
+    for (uint32_t offset = 0; (SSP_SUCCESS == err) && (offset < image_size); offset += UPDATE_PIECE_SIZE)
+    {
+        err = update_writer_write(&writer, p_image + offset, ((image_size - offset) > UPDATE_PIECE_SIZE) ? UPDATE_PIECE_SIZE : (image_size - offset));
+    }
+    if (SSP_SUCCESS == err)
+    {
+        err = update_writer_close(&writer, written_digest);
+    }
+    if (SSP_SUCCESS == err)
+    {
+        err = sha256_hash(&g_sce_hash_0, (uint8_t *)(p_image + IMAGE_HASH_OFFSET), image_size - IMAGE_HASH_OFFSET, image_digest);
+    }
+    if ((SSP_SUCCESS == err) && (0 != memcmp(written_digest, image_digest, sizeof(image_digest))))
+    {
+        err = SSP_ERR_INVALID_DATA;
+    }
+
+    if (hash_open)
+    {
+        g_sce_hash_0.p_api->close(g_sce_hash_0.p_ctrl);
+    }
+    if (sce_open)
+    {
+        g_sce.p_api->close(g_sce.p_ctrl);
+    }
+
+    g_update_writer_err = err;
+}
+#endif
 
 /*******************************************************************************************************************//**
  * @brief  Blinky example application
@@ -25,6 +166,14 @@ void blinky_thread_entry(void)
     /* LED state variable */
     ioport_level_t level = IOPORT_LEVEL_HIGH;
 
+    /* Keep the bootloader's timing of this boot */
+    boot_timing_read();
+
+#ifdef UPDATE_WRITER_DEMO
+    /* Check the update writer, and benchmark it, with this image */
+    update_writer_check();
+#endif
+
     /* Get LED information for this board */
     R_BSP_LedsGet(&leds);
 
@@ -0,0 +1,19 @@
+/***********************************************************************************************************************
+* File Name    : boot_timing.h
+* Description  : The application's version of the bootloader's boot_timing.h. The shared sources in Common
+*                (sha256_hal.c, sha256_sw.c) time themselves with these functions, the application does not keep a
+*                timing record so they do nothing here. The record the bootloader left is read with
+*                boot_timing_record.h.
+***********************************************************************************************************************/
+
+#ifndef BOOT_TIMING_H_
+#define BOOT_TIMING_H_
+
+#include "hal_data.h"
+#include "boot_timing_record.h"
+
+static inline uint32_t boot_timing_now(void) { return 0; }
+static inline void boot_timing_add(boot_phase_t phase, uint32_t start_cycles, uint32_t bytes) { (void)phase; (void)start_cycles; (void)bytes; }
+static inline void boot_timing_count(boot_count_t count) { (void)count; }
+
+#endif /* BOOT_TIMING_H_ */
@@ -0,0 +1,349 @@
+/***********************************************************************************************************************
+* File Name    : update_writer.c
+* Description  : Writes a signed update image, as it is received, into the update area of the bootloader.
+*                See update_writer.h.
+***********************************************************************************************************************/
+
+#include "update_writer.h"
+#include "tx_api.h"
+#include <stddef.h>
+
+/* Bytes of the header needed to check it: magic number, signature, Length, Version and Header version */
+#define UPDATE_WRITER_HEADER_CHECK_SIZE     (offsetof(bootloader_image_header_t, header_version) + 4)
+
+/*******************************************************************************************************************//**
+ * @brief  Check if a memory mapped area is erased
+ **********************************************************************************************************************/
+static bool memory_mapped_is_blank(update_writer_flash_t const * p_flash, uint32_t address, uint32_t size)
+{
+    uint32_t const * p_word = (uint32_t const *)address;
+
+    (void)p_flash;
+
+    for (uint32_t i = 0; i < (size / 4); i++)
+    {
+        if (0xFFFFFFFFU != p_word[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*******************************************************************************************************************//**
+ * @brief  Erase an erase block of the internal code flash
+ *
+ * Code flash cannot be read while it is being erased or programmed, and the flash_hp driver does code flash
+ * operations in blocking mode, so interrupts (and with them ThreadX) are masked until the operation is done.
+ **********************************************************************************************************************/
+static ssp_err_t internal_erase(update_writer_flash_t const * p_flash, uint32_t address)
+{
+    flash_instance_t const * p_driver = (flash_instance_t const *)p_flash->p_context;
+    uint32_t                 primask = __get_PRIMASK();
+    ssp_err_t                err;
+
+    __disable_irq();
+    err = p_driver->p_api->erase(p_driver->p_ctrl, address, 1);
+    __set_PRIMASK(primask);
+
+    return err;
+}
+
+/*******************************************************************************************************************//**
+ * @brief  Program a page of the internal code flash, with interrupts masked (see internal_erase())
+ **********************************************************************************************************************/
+static ssp_err_t internal_program(update_writer_flash_t const * p_flash, uint32_t address, uint8_t const * p_data, uint32_t length)
+{
+    flash_instance_t const * p_driver = (flash_instance_t const *)p_flash->p_context;
+    uint32_t                 primask = __get_PRIMASK();
+    ssp_err_t                err;
+
+    __disable_irq();
+    err = p_driver->p_api->write(p_driver->p_ctrl, (uint32_t)p_data, address, length);
+    __set_PRIMASK(primask);
+
+    return err;
+}
+
+/*******************************************************************************************************************//**
+ * @brief  Wait for a QSPI flash erase or program to complete
+ *
+ * The QSPI flash is not the code flash, so other threads can run while it is busy: the thread sleeps a tick between
+ * polls.
+ **********************************************************************************************************************/
+static ssp_err_t qspi_wait(qspi_instance_t const * p_driver)
+{
+    ssp_err_t   err;
+    bool        in_progress = true;
+
+    err = p_driver->p_api->statusGet(p_driver->p_ctrl, &in_progress);
+    while ((SSP_SUCCESS == err) && (true == in_progress))
+    {
+        tx_thread_sleep(1);
+        err = p_driver->p_api->statusGet(p_driver->p_ctrl, &in_progress);
+    }
+
+    return err;
+}
+
+/*******************************************************************************************************************//**
+ * @brief  Erase an erase block of the QSPI flash
+ **********************************************************************************************************************/
+static ssp_err_t qspi_erase(update_writer_flash_t const * p_flash, uint32_t address)
+{
+    qspi_instance_t const * p_driver = (qspi_instance_t const *)p_flash->p_context;
+    ssp_err_t               err;
+
+    err = p_driver->p_api->erase(p_driver->p_ctrl, (uint8_t *)address, p_flash->erase_block_size);
+    if (SSP_SUCCESS == err)
+    {
+        err = qspi_wait(p_driver);
+    }
+
+    return err;
+}
+
+/*******************************************************************************************************************//**
+ * @brief  Program a page of the QSPI flash
+ **********************************************************************************************************************/
+static ssp_err_t qspi_program(update_writer_flash_t const * p_flash, uint32_t address, uint8_t const * p_data, uint32_t length)
+{
+    qspi_instance_t const * p_driver = (qspi_instance_t const *)p_flash->p_context;
+    ssp_err_t               err;
+
+    err = p_driver->p_api->pageProgram(p_driver->p_ctrl, (uint8_t *)address, (uint8_t *)p_data, length);
+    if (SSP_SUCCESS == err)
+    {
+        err = qspi_wait(p_driver);
+    }
+
+    return err;
+}
+
+/*******************************************************************************************************************//**
+ * @brief  Set up the flash of the update area in internal code flash
+ *
+ * @param[out] p_flash      Flash to pass to update_writer_open()
+ * @param[in]  p_driver     Flash HP driver instance, already open
+ **********************************************************************************************************************/
+void update_writer_flash_internal_init(update_writer_flash_t * p_flash, flash_instance_t const * p_driver)
+{
+    p_flash->page_size          = MAIN_FLASH_PROGRAMMING_PAGE_SIZE;
+    p_flash->erase_block_size   = UPDATE_IMAGE_ERASE_BLOCK_SIZE;
+    p_flash->p_erase            = internal_erase;
+    p_flash->p_program          = internal_program;
+    p_flash->p_is_blank         = memory_mapped_is_blank;
+    p_flash->p_context          = p_driver;
+}
+
+/*******************************************************************************************************************//**
+ * @brief  Set up the flash of the update area in QSPI flash
+ *
+ * @param[out] p_flash      Flash to pass to update_writer_open()
+ * @param[in]  p_driver     QSPI driver instance, already open
+ **********************************************************************************************************************/
+void update_writer_flash_qspi_init(update_writer_flash_t * p_flash, qspi_instance_t const * p_driver)
+{
+    p_flash->page_size          = FLASH_PROGRAMMING_PAGE_SIZE;
+    p_flash->erase_block_size   = UPDATE_IMAGE_ERASE_BLOCK_SIZE;
+    p_flash->p_erase            = qspi_erase;
+    p_flash->p_program          = qspi_program;
+    p_flash->p_is_blank         = memory_mapped_is_blank;
+    p_flash->p_context          = p_driver;
+}
+
+/*******************************************************************************************************************//**
+ * @brief  Check the start of the header in the page buffer, and take the size of the image from it
+ **********************************************************************************************************************/
+static ssp_err_t update_writer_header_check(update_writer_t * p_writer)
+{
+    uint32_t length;
+    uint32_t header_version;
+
+    memcpy(&length, &p_writer->page[offsetof(bootloader_image_header_t, length)], sizeof(length));
+    memcpy(&header_version, &p_writer->page[offsetof(bootloader_image_header_t, header_version)], sizeof(header_version));
+
+    /* Total size is the Length, the Length field, signature and magic number */
+    uint32_t image_size = length + IMAGE_HASH_OFFSET + 4;
+
+    if ((0 != memcmp(p_writer->page, MAGIC_NUMBER, MAGIC_NUMBER_LEN)) ||
+        (image_size < length) || (image_size < IMAGE_HEADER_SIZE) || (image_size > p_writer->slot_size) ||
+        (header_version > IMAGE_HEADER_VERSION_COMPRESSED))
+    {
+        return SSP_ERR_INVALID_DATA;
+    }
+
+    p_writer->image_size = image_size;
+
+    return SSP_SUCCESS;
+}
+
+/*******************************************************************************************************************//**
+ * @brief  Program the page buffer at the page it belongs to, first erasing the erase block(s) it is in if they have
+ *         not been erased yet
+ **********************************************************************************************************************/
+static ssp_err_t update_writer_program_page(update_writer_t * p_writer)
+{
+    update_writer_flash_t const *   p_flash = p_writer->p_flash;
+    uint32_t                        page_offset = p_writer->offset - p_writer->page_fill;
+    ssp_err_t                       err = SSP_SUCCESS;
+
+    /* Erase only just ahead of the data, a block that is already blank does not need erasing */
+    while ((SSP_SUCCESS == err) && (p_writer->erased_end < (page_offset + p_flash->page_size)))
+    {
+        uint32_t block_address = p_writer->slot_address + p_writer->erased_end;
+
+        if (!p_flash->p_is_blank(p_flash, block_address, p_flash->erase_block_size))
+        {
+            err = p_flash->p_erase(p_flash, block_address);
+        }
+        p_writer->erased_end += p_flash->erase_block_size;
+    }
+
+    if (SSP_SUCCESS == err)
+    {
+        err = p_flash->p_program(p_flash, p_writer->slot_address + page_offset, p_writer->page, p_flash->page_size);
+    }
+
+    p_writer->page_fill = 0;
+
+    return err;
+}
+
+/*******************************************************************************************************************//**
+ * @brief  Start writing an update image
+ *
+ * @param[out] p_writer         Writer to pass to update_writer_write()
+ * @param[in]  p_flash          Flash of the update area, see update_writer_flash_internal_init()
+ * @param[in]  slot_address     Start of the update area (UPDATE_IMAGE_START_ADDRESS)
+ * @param[in]  slot_size        Size of the update area, the image must fit
+ * @param[in]  p_hash           Hash driver instance (already open) used to hash the image, or NULL to not hash it
+ *
+ * @retval SSP_SUCCESS          Ready for the image
+ * @retval SSP_ERR_ASSERTION    The flash or the update area is not usable
+ * @retval Errors from sha256_init()
+ **********************************************************************************************************************/
+ssp_err_t update_writer_open(update_writer_t * p_writer, update_writer_flash_t const * p_flash, uint32_t slot_address, uint32_t slot_size, hash_instance_t const * p_hash)
+{
+    if ((NULL == p_flash) || (p_flash->page_size > UPDATE_WRITER_PAGE_MAX_SIZE) ||
+        (p_flash->page_size < UPDATE_WRITER_HEADER_CHECK_SIZE) || (0 != (p_flash->erase_block_size % p_flash->page_size)) ||
+        (0 != (slot_address % p_flash->erase_block_size)))
+    {
+        return SSP_ERR_ASSERTION;
+    }
+
+    p_writer->p_flash       = p_flash;
+    p_writer->slot_address  = slot_address;
+    p_writer->slot_size     = slot_size;
+    p_writer->offset        = 0;
+    p_writer->image_size    = 0;
+    p_writer->erased_end    = 0;
+    p_writer->page_fill     = 0;
+    p_writer->hashing       = (NULL != p_hash);
+    p_writer->error         = SSP_SUCCESS;
+
+    if (p_writer->hashing)
+    {
+        p_writer->error = sha256_init(&p_writer->hash_ctx, p_hash);
+    }
+
+    return p_writer->error;
+}
+
+/*******************************************************************************************************************//**
+ * @brief  Write the next part of the image
+ *
+ * The data is held until a whole page can be programmed. Once a write has failed all later writes fail with the
+ * same error.
+ *
+ * @param[in]  p_writer     Writer started by update_writer_open()
+ * @param[in]  p_data       Next bytes of the image
+ * @param[in]  length       Number of bytes, any size
+ *
+ * @retval SSP_SUCCESS              Written (or held for the next page)
+ * @retval SSP_ERR_INVALID_DATA     The header is not the header of an image that fits the update area
+ * @retval SSP_ERR_INVALID_SIZE     The data is past the end of the image
+ * @retval Errors from the flash or hash driver
+ **********************************************************************************************************************/
+ssp_err_t update_writer_write(update_writer_t * p_writer, uint8_t const * p_data, uint32_t length)
+{
+    uint32_t page_size = p_writer->p_flash->page_size;
+
+    while ((SSP_SUCCESS == p_writer->error) && (0 != length))
+    {
+        uint32_t fill = page_size - p_writer->page_fill;
+
+        if (fill > length)
+        {
+            fill = length;
+        }
+
+        if ((0 != p_writer->image_size) && (fill > (p_writer->image_size - p_writer->offset)))
+        {
+            p_writer->error = SSP_ERR_INVALID_SIZE;
+            break;
+        }
+
+        memcpy(&p_writer->page[p_writer->page_fill], p_data, fill);
+
+        /* Hash from the Length field */
+        if ((p_writer->hashing) && ((p_writer->offset + fill) > IMAGE_HASH_OFFSET))
+        {
+            uint32_t skip = (p_writer->offset < IMAGE_HASH_OFFSET) ? (IMAGE_HASH_OFFSET - p_writer->offset) : 0;
+
+            p_writer->error = sha256_update(&p_writer->hash_ctx, p_data + skip, fill - skip);
+        }
+
+        p_data += fill;
+        length -= fill;
+        p_writer->offset += fill;
+        p_writer->page_fill += fill;
+
+        /* The header is checked before the first page is programmed */
+        if ((SSP_SUCCESS == p_writer->error) && (0 == p_writer->image_size) && (p_writer->offset >= UPDATE_WRITER_HEADER_CHECK_SIZE))
+        {
+            p_writer->error = update_writer_header_check(p_writer);
+        }
+
+        if ((SSP_SUCCESS == p_writer->error) && (page_size == p_writer->page_fill))
+        {
+            p_writer->error = update_writer_program_page(p_writer);
+        }
+    }
+
+    return p_writer->error;
+}
+
+/*******************************************************************************************************************//**
+ * @brief  Finish writing the image, programming the last page
+ *
+ * @param[in]  p_writer     Writer started by update_writer_open()
+ * @param[out] p_digest     SHA256 of the image from the Length field (SHA256_DIGEST_SIZE_BYTES), or NULL. Only set if
+ *                          a hash driver was passed to update_writer_open().
+ *
+ * @retval SSP_SUCCESS              The whole image has been written
+ * @retval SSP_ERR_INVALID_SIZE     Less than the whole image was written
+ * @retval Errors from earlier writes, or from the flash or hash driver
+ **********************************************************************************************************************/
+ssp_err_t update_writer_close(update_writer_t * p_writer, uint8_t * p_digest)
+{
+    if ((SSP_SUCCESS == p_writer->error) && ((0 == p_writer->image_size) || (p_writer->offset != p_writer->image_size)))
+    {
+        p_writer->error = SSP_ERR_INVALID_SIZE;
+    }
+
+    /* Pad the last page with the erased state */
+    if ((SSP_SUCCESS == p_writer->error) && (0 != p_writer->page_fill))
+    {
+        memset(&p_writer->page[p_writer->page_fill], ERASED_STATE, p_writer->p_flash->page_size - p_writer->page_fill);
+        p_writer->error = update_writer_program_page(p_writer);
+    }
+
+    if ((SSP_SUCCESS == p_writer->error) && (p_writer->hashing) && (NULL != p_digest))
+    {
+        p_writer->error = sha256_final(&p_writer->hash_ctx, p_digest);
+    }
+
+    return p_writer->error;
+}
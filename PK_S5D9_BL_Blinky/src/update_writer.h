@@ -0,0 +1,96 @@
+/***********************************************************************************************************************
+* File Name    : update_writer.h
+* Description  : Writes a signed update image, as it is received, into the update area of the bootloader.
+*
+* The image can arrive in pieces of any size (e.g. as it is downloaded). The writer:
+* - checks the header as soon as enough of it has arrived, before anything is programmed
+* - erases the update area one erase block at a time, only just ahead of the data being programmed, and skips blocks
+*   that are already blank
+* - collects the data into whole programming pages, so each page is programmed once
+* - hashes the data as it arrives (from the Length field, as the signature of a version 0 image is calculated)
+*
+* The flash written to is reached through an update_writer_flash_t, see update_writer_flash_internal_init() (the
+* update area in internal code flash), update_writer_flash_qspi_init() (the update area in QSPI flash, when the
+* bootloader is built with UPDATE_USES_QSPI_FLASH) and update_writer_flash_sim_init() (RAM with modelled flash timing,
+* for testing and the benchmark). The update area and image format are the bootloader's, from flash_layout.h and
+* image_header.h in the Common folder shared with the bootloader project.
+*
+* Usage:
+*   update_writer_flash_internal_init(&flash, &g_flash);
+*   update_writer_open(&writer, &flash, UPDATE_IMAGE_START_ADDRESS, UPDATE_IMAGE_MAX_SIZE, &g_sce_hash_0);
+*   for each piece received: update_writer_write(&writer, p_piece, piece_length);
+*   update_writer_close(&writer, digest);
+* then reset to let the bootloader install the update.
+***********************************************************************************************************************/
+
+#ifndef UPDATE_WRITER_H_
+#define UPDATE_WRITER_H_
+
+#include "hal_data.h"
+#include "sha256_hal.h"
+#include "image_header.h"
+
+/* Largest programming page of any flash written to (the QSPI flash, the internal code flash page is smaller) */
+#define UPDATE_WRITER_PAGE_MAX_SIZE         (FLASH_PROGRAMMING_PAGE_SIZE)
+
+/* Flash an update is written to. Addresses are the memory mapped addresses of the flash. */
+typedef struct update_writer_flash update_writer_flash_t;
+struct update_writer_flash {
+    uint32_t    page_size;              /* Programming page size, at most UPDATE_WRITER_PAGE_MAX_SIZE */
+    uint32_t    erase_block_size;
+    /* Erase the erase block at address */
+    ssp_err_t   (* p_erase)(update_writer_flash_t const * p_flash, uint32_t address);
+    /* Program length bytes (at most one page, not crossing a page) at address */
+    ssp_err_t   (* p_program)(update_writer_flash_t const * p_flash, uint32_t address, uint8_t const * p_data, uint32_t length);
+    /* Check if size bytes at address are erased */
+    bool        (* p_is_blank)(update_writer_flash_t const * p_flash, uint32_t address, uint32_t size);
+    void const * p_context;             /* Driver instance, or update_writer_sim_t */
+};
+
+/* RAM standing in for an update area, with a model of the time taken by the flash (see update_writer_flash_sim_init()) */
+typedef struct update_writer_sim {
+    uint8_t *   p_memory;               /* RAM holding the contents of the area */
+    uint32_t    address;                /* Address of the area, as passed to update_writer_open() */
+    uint32_t    size;
+    uint32_t    erase_us;               /* Modelled time of an erase block erase */
+    uint32_t    program_us;             /* Modelled time of programming a page, or part of one */
+    uint32_t    erases;
+    uint32_t    programs;
+    uint32_t    time_us;                /* Modelled time of all the erases and programs */
+} update_writer_sim_t;
+
+typedef struct update_writer {
+    update_writer_flash_t const *   p_flash;
+    uint32_t                        slot_address;
+    uint32_t                        slot_size;
+    uint32_t                        offset;         /* Number of bytes of the image received */
+    uint32_t                        image_size;     /* Total size of the image, 0 until the header has been checked */
+    uint32_t                        erased_end;     /* Offset of the end of the area erased so far */
+    uint32_t                        page_fill;      /* Bytes in page */
+    ssp_err_t                       error;          /* First error, all later writes fail with it */
+    bool                            hashing;
+    sha256_context_t                hash_ctx;
+    uint8_t                         page[UPDATE_WRITER_PAGE_MAX_SIZE];
+} update_writer_t;
+
+/* Result of update_writer_benchmark() */
+typedef struct update_writer_benchmark {
+    uint32_t    direct_us;              /* Modelled flash time programming each piece as it arrives */
+    uint32_t    direct_bytes_per_s;
+    uint32_t    writer_us;              /* Modelled flash time through the update writer */
+    uint32_t    writer_bytes_per_s;
+    uint32_t    writer_erases;
+    uint32_t    writer_programs;
+} update_writer_benchmark_t;
+
+void update_writer_flash_internal_init(update_writer_flash_t * p_flash, flash_instance_t const * p_driver);
+void update_writer_flash_qspi_init(update_writer_flash_t * p_flash, qspi_instance_t const * p_driver);
+void update_writer_flash_sim_init(update_writer_flash_t * p_flash, update_writer_sim_t * p_sim, uint32_t page_size);
+
+ssp_err_t update_writer_open(update_writer_t * p_writer, update_writer_flash_t const * p_flash, uint32_t slot_address, uint32_t slot_size, hash_instance_t const * p_hash);
+ssp_err_t update_writer_write(update_writer_t * p_writer, uint8_t const * p_data, uint32_t length);
+ssp_err_t update_writer_close(update_writer_t * p_writer, uint8_t * p_digest);
+
+ssp_err_t update_writer_benchmark(update_writer_benchmark_t * p_result, update_writer_sim_t * p_sim, uint32_t page_size, uint8_t const * p_image, uint32_t piece_size);
+
+#endif /* UPDATE_WRITER_H_ */
@@ -0,0 +1,227 @@
+/***********************************************************************************************************************
+* File Name    : update_writer_sim.c
+* Description  : Simulated flash for the update writer, and a benchmark of the writer against programming each piece
+*                of an image as it arrives.
+*
+* The simulated flash is RAM standing in for an update area. Erasing sets an erase block to the erased state and
+* programming clears bits, as on the real flash. The time the real flash would take is modelled from the number of
+* erases and programs (a program of part of a page takes as long as a whole page), so the benchmark can be run on
+* the target or a host without the flash being changed.
+***********************************************************************************************************************/
+
+#include "update_writer.h"
+
+/* Typical times, for the modelled flash time (QSPI W25Q64FV 32K block erase and page program) */
+#define UPDATE_WRITER_SIM_ERASE_US      (120000)
+#define UPDATE_WRITER_SIM_PROGRAM_US    (700)
+
+/*******************************************************************************************************************//**
+ * @brief  Check an address range is in the simulated area
+ **********************************************************************************************************************/
+static bool sim_in_area(update_writer_sim_t const * p_sim, uint32_t address, uint32_t size)
+{
+    return (address >= p_sim->address) && (size <= p_sim->size) && ((address - p_sim->address) <= (p_sim->size - size));
+}
+
+/*******************************************************************************************************************//**
+ * @brief  Erase an erase block of the simulated area
+ **********************************************************************************************************************/
+static ssp_err_t sim_erase(update_writer_flash_t const * p_flash, uint32_t address)
+{
+    update_writer_sim_t * p_sim = (update_writer_sim_t *)p_flash->p_context;
+
+    if ((0 != ((address - p_sim->address) % p_flash->erase_block_size)) || (!sim_in_area(p_sim, address, p_flash->erase_block_size)))
+    {
+        return SSP_ERR_INVALID_ADDRESS;
+    }
+
+    memset(p_sim->p_memory + (address - p_sim->address), ERASED_STATE, p_flash->erase_block_size);
+    p_sim->erases++;
+    p_sim->time_us += p_sim->erase_us;
+
+    return SSP_SUCCESS;
+}
+
+/*******************************************************************************************************************//**
+ * @brief  Program (part of) a page of the simulated area
+ **********************************************************************************************************************/
+static ssp_err_t sim_program(update_writer_flash_t const * p_flash, uint32_t address, uint8_t const * p_data, uint32_t length)
+{
+    update_writer_sim_t *   p_sim = (update_writer_sim_t *)p_flash->p_context;
+    uint32_t                page_offset = (address - p_sim->address) % p_flash->page_size;
+
+    if ((length > (p_flash->page_size - page_offset)) || (!sim_in_area(p_sim, address, length)))
+    {
+        return SSP_ERR_INVALID_ADDRESS;
+    }
+
+    /* Programming can only clear bits */
+    uint8_t * p_dest = p_sim->p_memory + (address - p_sim->address);
+    for (uint32_t i = 0; i < length; i++)
+    {
+        p_dest[i] &= p_data[i];
+    }
+    p_sim->programs++;
+    p_sim->time_us += p_sim->program_us;
+
+    return SSP_SUCCESS;
+}
+
+/*******************************************************************************************************************//**
+ * @brief  Check if part of the simulated area is erased
+ **********************************************************************************************************************/
+static bool sim_is_blank(update_writer_flash_t const * p_flash, uint32_t address, uint32_t size)
+{
+    update_writer_sim_t const * p_sim = (update_writer_sim_t const *)p_flash->p_context;
+
+    if (!sim_in_area(p_sim, address, size))
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < size; i++)
+    {
+        if (ERASED_STATE != p_sim->p_memory[(address - p_sim->address) + i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*******************************************************************************************************************//**
+ * @brief  Set up a simulated flash
+ *
+ * p_sim->p_memory, address and size must be set. The counts and modelled time are cleared, and the erase and program
+ * times set to typical values if they are 0.
+ *
+ * @param[out] p_flash      Flash to pass to update_writer_open()
+ * @param[in]  p_sim        Simulated area
+ * @param[in]  page_size    Programming page size to simulate (e.g. FLASH_PROGRAMMING_PAGE_SIZE)
+ **********************************************************************************************************************/
+void update_writer_flash_sim_init(update_writer_flash_t * p_flash, update_writer_sim_t * p_sim, uint32_t page_size)
+{
+    if (0 == p_sim->erase_us)
+    {
+        p_sim->erase_us = UPDATE_WRITER_SIM_ERASE_US;
+    }
+    if (0 == p_sim->program_us)
+    {
+        p_sim->program_us = UPDATE_WRITER_SIM_PROGRAM_US;
+    }
+    p_sim->erases   = 0;
+    p_sim->programs = 0;
+    p_sim->time_us  = 0;
+
+    p_flash->page_size          = page_size;
+    p_flash->erase_block_size   = UPDATE_IMAGE_ERASE_BLOCK_SIZE;
+    p_flash->p_erase            = sim_erase;
+    p_flash->p_program          = sim_program;
+    p_flash->p_is_blank         = sim_is_blank;
+    p_flash->p_context          = p_sim;
+}
+
+/*******************************************************************************************************************//**
+ * @brief  Bytes per second for a modelled time
+ **********************************************************************************************************************/
+static uint32_t benchmark_bytes_per_s(uint32_t bytes, uint32_t time_us)
+{
+    if (0 == time_us)
+    {
+        return 0;
+    }
+
+    return (uint32_t)(((uint64_t)bytes * 1000000U) / time_us);
+}
+
+/*******************************************************************************************************************//**
+ * @brief  Benchmark the update writer on a simulated flash
+ *
+ * Writes an image to the simulated area as if it arrived in pieces of piece_size bytes, twice:
+ * - direct, first erasing the erase blocks the image will occupy and then programming each piece as it arrives (as an
+ *   application without the writer would)
+ * - through the update writer
+ * and gives the modelled flash time of each. The contents of the simulated area are changed, p_sim is set up as for
+ * update_writer_flash_sim_init(). The image is not hashed.
+ *
+ * @param[out] p_result     Modelled times and rates
+ * @param[in]  p_sim        Simulated area, at least as large as the image
+ * @param[in]  page_size    Programming page size to simulate
+ * @param[in]  p_image      Signed image (e.g. the running application, from the start of its header)
+ * @param[in]  piece_size   Size of each piece the image arrives in
+ *
+ * @retval SSP_SUCCESS      Both writes completed and the area holds the image
+ * @retval SSP_ERR_INVALID_DATA  The area does not hold the image after a write
+ * @retval Errors from the update writer
+ **********************************************************************************************************************/
+ssp_err_t update_writer_benchmark(update_writer_benchmark_t * p_result, update_writer_sim_t * p_sim, uint32_t page_size, uint8_t const * p_image, uint32_t piece_size)
+{
+    update_writer_flash_t   flash;
+    update_writer_t         writer;
+    uint32_t                image_size;
+    ssp_err_t               err = SSP_SUCCESS;
+
+    memcpy(&image_size, p_image + IMAGE_HASH_OFFSET, sizeof(image_size));
+    image_size += IMAGE_HASH_OFFSET + 4;
+    if ((0 == piece_size) || (image_size > p_sim->size))
+    {
+        return SSP_ERR_ASSERTION;
+    }
+
+    /* Direct: erase the blocks the image occupies, then program each piece as it arrives */
+    update_writer_flash_sim_init(&flash, p_sim, page_size);
+    uint32_t image_blocks = (image_size + flash.erase_block_size - 1) / flash.erase_block_size;
+    for (uint32_t block = 0; (SSP_SUCCESS == err) && (block < image_blocks); block++)
+    {
+        err = flash.p_erase(&flash, p_sim->address + (block * flash.erase_block_size));
+    }
+    for (uint32_t offset = 0; (SSP_SUCCESS == err) && (offset < image_size); )
+    {
+        uint32_t piece_end = ((image_size - offset) > piece_size) ? (offset + piece_size) : image_size;
+
+        /* A piece crossing a page is programmed in two parts */
+        while ((SSP_SUCCESS == err) && (offset < piece_end))
+        {
+            uint32_t length = page_size - (offset % page_size);
+
+            if (length > (piece_end - offset))
+            {
+                length = piece_end - offset;
+            }
+            err = flash.p_program(&flash, p_sim->address + offset, p_image + offset, length);
+            offset += length;
+        }
+    }
+    if ((SSP_SUCCESS == err) && (0 != memcmp(p_sim->p_memory, p_image, image_size)))
+    {
+        err = SSP_ERR_INVALID_DATA;
+    }
+    p_result->direct_us = p_sim->time_us;
+    p_result->direct_bytes_per_s = benchmark_bytes_per_s(image_size, p_sim->time_us);
+
+    /* Through the writer, starting from a programmed area as a real update would */
+    update_writer_flash_sim_init(&flash, p_sim, page_size);
+    if (SSP_SUCCESS == err)
+    {
+        err = update_writer_open(&writer, &flash, p_sim->address, p_sim->size, NULL);
+    }
+    for (uint32_t offset = 0; (SSP_SUCCESS == err) && (offset < image_size); offset += piece_size)
+    {
+        err = update_writer_write(&writer, p_image + offset, ((image_size - offset) > piece_size) ? piece_size : (image_size - offset));
+    }
+    if (SSP_SUCCESS == err)
+    {
+        err = update_writer_close(&writer, NULL);
+    }
+    if ((SSP_SUCCESS == err) && (0 != memcmp(p_sim->p_memory, p_image, image_size)))
+    {
+        err = SSP_ERR_INVALID_DATA;
+    }
+    p_result->writer_us = p_sim->time_us;
+    p_result->writer_bytes_per_s = benchmark_bytes_per_s(image_size, p_sim->time_us);
+    p_result->writer_erases = p_sim->erases;
+    p_result->writer_programs = p_sim->programs;
+
+    return err;
+}